@@ -41,8 +41,8 @@ G_DEFINE_BOXED_TYPE (EggCounterArena, egg_counter_arena, egg_counter_arena_ref,
 
 #define MAX_COUNTERS       2000
 #define NAME_FORMAT        "/EggCounters-%u"
-#define MAGIC              0x71167125
-#define COUNTER_MAX_SHM    (1024 * 1024 * 4)
+#define MAGIC              0x71167126
+#define COUNTER_MAX_SHM    (1024 * 1024 * 64)
 #define COUNTERS_PER_GROUP 8
 #define DATA_CELL_SIZE     64
 #define CELLS_PER_INFO     (sizeof(CounterInfo) / DATA_CELL_SIZE)
@@ -52,13 +52,21 @@ G_DEFINE_BOXED_TYPE (EggCounterArena, egg_counter_arena, egg_counter_arena_ref,
     (sizeof(EggCounterValue) * (ncpu))) / DATA_CELL_SIZE)
 #define EGG_MEMORY_BARRIER __sync_synchronize()
 
+enum {
+  COUNTER_KIND_COUNTER   = 0,
+  COUNTER_KIND_HISTOGRAM = 1,
+};
+
 typedef struct
 {
-  guint cell : 29;       /* Counter groups starting cell */
-  guint position : 3;    /* Index within counter group */
-  gchar category[20];    /* Counter category name. */
-  gchar name[32];        /* Counter name. */
-  gchar description[72]; /* Counter description */
+  guint  cell : 29;       /* Counter groups starting cell */
+  guint  position : 3;    /* Index within counter group */
+  gchar  category[20];    /* Counter category name. */
+  gchar  name[32];        /* Counter name. */
+  guint8 kind;            /* COUNTER_KIND_* */
+  guint8 bucket;          /* Bucket index if kind is a histogram */
+  guint8 padding[2];
+  gchar  description[68]; /* Counter description */
 } CounterInfo __attribute__((aligned (DATA_CELL_SIZE)));
 
 G_STATIC_ASSERT (sizeof (CounterInfo) == 128);
@@ -100,6 +108,7 @@ struct _EggCounterArena
   GPid      pid;
   guint     n_counters;
   GList    *counters;
+  GList    *histograms;
 };
 
 G_LOCK_DEFINE_STATIC (reglock);
@@ -153,6 +162,23 @@ _egg_counter_arena_atexit (void)
   shm_unlink (name);
 }
 
+/*
+ * Enough space for MAX_COUNTERS counters with the current number of CPUs.
+ * The shm zone is sparse, so we only pay for the pages that are used.
+ */
+static gsize
+_egg_counter_arena_get_size (gint page_size)
+{
+  gsize n_groups = (MAX_COUNTERS + COUNTERS_PER_GROUP - 1) / COUNTERS_PER_GROUP;
+  gsize size;
+
+  size = (CELLS_PER_HEADER + (n_groups * CELLS_PER_GROUP (g_get_num_processors ())))
+       * DATA_CELL_SIZE;
+  size = (size + page_size - 1) / page_size * page_size;
+
+  return MIN (size, COUNTER_MAX_SHM);
+}
+
 static void
 _egg_counter_arena_init_local (EggCounterArena *arena)
 {
@@ -168,20 +194,14 @@ _egg_counter_arena_init_local (EggCounterArena *arena)
 
   /* Implausible, but squashes warnings. */
   if (page_size < 4096)
-    {
-      page_size = 4096;
-      size = page_size * 4;
-      goto use_malloc;
-    }
+    page_size = 4096;
 
   /*
-   * FIXME: https://bugzilla.gnome.org/show_bug.cgi?id=749280
-   *
-   * We have some very tricky work ahead of us to add unlimited numbers
-   * of counters at runtime. We basically need to avoid placing counters
-   * that could overlap a page.
+   * We reserve space for every counter up front, since counters must never
+   * move once registered. Counters registered after the arena is full are
+   * still usable, but not visible to external processes.
    */
-  size = page_size * 4;
+  size = _egg_counter_arena_get_size (page_size);
 
   arena->ref_count = 1;
   arena->is_local_arena = TRUE;
@@ -239,7 +259,6 @@ use_malloc:
              "Counters will not be available to external processes.");
 
   arena->data_is_mmapped = FALSE;
-  arena->cells = g_malloc0 (size << 1);
   arena->n_cells = (size / DATA_CELL_SIZE);
   arena->data_length = size;
 
@@ -248,12 +267,14 @@ use_malloc:
    * malloc. Since we are at least a page size, we should pretty much
    * be guaranteed this, but better to check with posix_memalign().
    */
-  if (posix_memalign ((void *)&arena->cells, page_size, size << 1) != 0)
+  if (posix_memalign ((void *)&arena->cells, page_size, size) != 0)
     {
       perror ("posix_memalign()");
       abort ();
     }
 
+  memset (arena->cells, 0, size);
+
   header = (void *)arena->cells;
   header->magic = MAGIC;
   header->ncpu = g_get_num_processors ();
@@ -304,7 +325,7 @@ _egg_counter_arena_init_remote (EggCounterArena *arena,
     goto failure;
 
   if (header.size <
-      CELLS_PER_HEADER + (((n_counters / COUNTERS_PER_GROUP) + 1) * CELLS_PER_GROUP(header.ncpu)))
+      (CELLS_PER_HEADER + (((n_counters / COUNTERS_PER_GROUP) + 1) * CELLS_PER_GROUP(header.ncpu))) * DATA_CELL_SIZE)
     goto failure;
 
   mem = mmap (NULL, header.size, PROT_READ, MAP_SHARED, fd, 0);
@@ -318,6 +339,7 @@ _egg_counter_arena_init_remote (EggCounterArena *arena,
   arena->n_cells = header.size / DATA_CELL_SIZE;
   arena->data_length = header.size;
   arena->counters = NULL;
+  arena->histograms = NULL;
 
   /* Not strictly required, but helpful for now */
   if (header.first_offset != CELLS_PER_HEADER)
@@ -333,13 +355,42 @@ _egg_counter_arena_init_remote (EggCounterArena *arena,
 
       group = i / COUNTERS_PER_GROUP;
       position = i % COUNTERS_PER_GROUP;
-      group_start_cell = header.first_offset + (CELLS_PER_GROUP (ncpu) * group);
+      group_start_cell = header.first_offset + (CELLS_PER_GROUP (header.ncpu) * group);
 
-      if (group_start_cell + CELLS_PER_GROUP (ncpu) >= arena->n_cells)
+      if (group_start_cell + CELLS_PER_GROUP (header.ncpu) > arena->n_cells)
         goto failure;
 
       info = &(((CounterInfo *)&arena->cells[group_start_cell])[position]);
 
+      if (info->kind == COUNTER_KIND_HISTOGRAM)
+        {
+          EggHistogram *histogram;
+
+          /*
+           * Buckets of a histogram are registered consecutively, so bucket 0
+           * always starts a new histogram.
+           */
+          if (info->bucket >= EGG_HISTOGRAM_N_BUCKETS)
+            goto failure;
+
+          if (info->bucket == 0)
+            {
+              histogram = g_new0 (EggHistogram, 1);
+              histogram->category = g_strndup (info->category, sizeof info->category);
+              histogram->name = g_strndup (info->name, sizeof info->name);
+              histogram->description = g_strndup (info->description, sizeof info->description);
+              arena->histograms = g_list_prepend (arena->histograms, histogram);
+            }
+          else if (arena->histograms == NULL)
+            goto failure;
+
+          histogram = arena->histograms->data;
+          histogram->buckets [info->bucket].values =
+            (EggCounterValue *)&arena->cells [info->cell].values[info->position];
+
+          continue;
+        }
+
       counter = g_new0 (EggCounter, 1);
       counter->category = g_strndup (info->category, sizeof info->category);
       counter->name = g_strndup (info->name, sizeof info->name);
@@ -395,6 +446,7 @@ _egg_counter_arena_destroy (EggCounterArena *arena)
     g_free (arena->cells);
 
   g_clear_pointer (&arena->counters, g_list_free);
+  g_clear_pointer (&arena->histograms, g_list_free);
 
   arena->cells = NULL;
 
@@ -460,9 +512,11 @@ egg_counter_arena_foreach (EggCounterArena       *arena,
     func (iter->data, user_data);
 }
 
-void
-egg_counter_arena_register (EggCounterArena *arena,
-                            EggCounter      *counter)
+static void
+_egg_counter_arena_register_locked (EggCounterArena *arena,
+                                    EggCounter      *counter,
+                                    guint8           kind,
+                                    guint8           bucket)
 {
   CounterInfo *info;
   guint group;
@@ -470,19 +524,8 @@ egg_counter_arena_register (EggCounterArena *arena,
   guint position;
   guint group_start_cell;
 
-  g_return_if_fail (arena != NULL);
-  g_return_if_fail (counter != NULL);
-
-  if (!arena->is_local_arena)
-    {
-      g_warning ("Cannot add counters to a remote arena.");
-      return;
-    }
-
   ncpu = g_get_num_processors ();
 
-  G_LOCK (reglock);
-
   /*
    * Get the counter group and position within the group of the counter.
    */
@@ -493,10 +536,32 @@ egg_counter_arena_register (EggCounterArena *arena,
    * Get the starting cell for this group. Cells roughly map to cachelines.
    */
   group_start_cell = CELLS_PER_HEADER + (CELLS_PER_GROUP (ncpu) * group);
-  info = &((CounterInfo *)&arena->cells [group_start_cell])[position];
 
   g_assert (position < COUNTERS_PER_GROUP);
-  g_assert (group_start_cell < arena->n_cells);
+
+  if (arena->n_counters >= MAX_COUNTERS ||
+      group_start_cell + CELLS_PER_GROUP (ncpu) > arena->n_cells)
+    {
+      static gboolean warned;
+
+      /*
+       * The arena is full. Give the counter private storage so that it
+       * still works locally, it just won't be visible to other processes.
+       */
+      if (!warned)
+        {
+          g_warning ("Counter arena is full, \"%s:%s\" and further counters "
+                     "will not be available to external processes.",
+                     counter->category, counter->name);
+          warned = TRUE;
+        }
+
+      counter->values = g_new0 (EggCounterValue, ncpu);
+
+      return;
+    }
+
+  info = &((CounterInfo *)&arena->cells [group_start_cell])[position];
 
   /*
    * Store information about the counter in the SHM area. Also, update
@@ -504,6 +569,8 @@ egg_counter_arena_register (EggCounterArena *arena,
    */
   info->cell = group_start_cell + (COUNTERS_PER_GROUP * CELLS_PER_INFO);
   info->position = position;
+  info->kind = kind;
+  info->bucket = bucket;
   g_snprintf (info->category, sizeof info->category, "%s", counter->category);
   g_snprintf (info->description, sizeof info->description, "%s", counter->description);
   g_snprintf (info->name, sizeof info->name, "%s", counter->name);
@@ -514,10 +581,6 @@ egg_counter_arena_register (EggCounterArena *arena,
            info->cell, info->position, info->category, info->name);
 #endif
 
-  /*
-   * Track the counter address, so we can _foreach() them.
-   */
-  arena->counters = g_list_append (arena->counters, counter);
   arena->n_counters++;
 
   /*
@@ -525,10 +588,176 @@ egg_counter_arena_register (EggCounterArena *arena,
    */
   EGG_MEMORY_BARRIER;
   ((ShmHeader *)&arena->cells[0])->n_counters++;
+}
+
+void
+egg_counter_arena_register (EggCounterArena *arena,
+                            EggCounter      *counter)
+{
+  g_return_if_fail (arena != NULL);
+  g_return_if_fail (counter != NULL);
+
+  if (!arena->is_local_arena)
+    {
+      g_warning ("Cannot add counters to a remote arena.");
+      return;
+    }
+
+  G_LOCK (reglock);
+
+  _egg_counter_arena_register_locked (arena, counter, COUNTER_KIND_COUNTER, 0);
+
+  /*
+   * Track the counter address, so we can _foreach() them.
+   */
+  arena->counters = g_list_append (arena->counters, counter);
+
+  G_UNLOCK (reglock);
+}
+
+/**
+ * egg_counter_arena_register_histogram:
+ * @arena: An #EggCounterArena
+ * @histogram: An #EggHistogram
+ *
+ * Registers every bucket of @histogram with @arena. The buckets are stored
+ * consecutively so that external processes can reassemble the histogram.
+ */
+void
+egg_counter_arena_register_histogram (EggCounterArena *arena,
+                                      EggHistogram    *histogram)
+{
+  guint i;
+
+  g_return_if_fail (arena != NULL);
+  g_return_if_fail (histogram != NULL);
+
+  if (!arena->is_local_arena)
+    {
+      g_warning ("Cannot add histograms to a remote arena.");
+      return;
+    }
+
+  G_LOCK (reglock);
+
+  for (i = 0; i < EGG_HISTOGRAM_N_BUCKETS; i++)
+    {
+      EggCounter *bucket = &histogram->buckets [i];
+
+      bucket->category = histogram->category;
+      bucket->name = histogram->name;
+      bucket->description = histogram->description;
+
+      _egg_counter_arena_register_locked (arena, bucket, COUNTER_KIND_HISTOGRAM, i);
+    }
+
+  arena->histograms = g_list_append (arena->histograms, histogram);
 
   G_UNLOCK (reglock);
 }
 
+/**
+ * egg_counter_arena_foreach_histogram:
+ * @arena: An #EggCounterArena
+ * @func: (scope call): A callback to execute
+ * @user_data: user data for @func
+ *
+ * Calls @func for every histogram found in @arena. The buckets of
+ * histograms are not included in egg_counter_arena_foreach().
+ */
+void
+egg_counter_arena_foreach_histogram (EggCounterArena         *arena,
+                                     EggHistogramForeachFunc  func,
+                                     gpointer                 user_data)
+{
+  GList *iter;
+
+  g_return_if_fail (arena != NULL);
+  g_return_if_fail (func != NULL);
+
+  for (iter = arena->histograms; iter; iter = iter->next)
+    func (iter->data, user_data);
+}
+
+gint64
+egg_histogram_get_count (EggHistogram *histogram)
+{
+  gint64 count = 0;
+  guint i;
+
+  g_return_val_if_fail (histogram, G_GINT64_CONSTANT (-1));
+
+  for (i = 0; i < EGG_HISTOGRAM_N_BUCKETS; i++)
+    {
+      if (histogram->buckets [i].values != NULL)
+        count += egg_counter_get (&histogram->buckets [i]);
+    }
+
+  return count;
+}
+
+/**
+ * egg_histogram_get_percentile:
+ * @histogram: An #EggHistogram
+ * @percentile: the percentile, between 0.0 and 100.0
+ *
+ * Gets the approximate value at @percentile. Since values are only
+ * tracked by bucket, this is the upper bound of the bucket containing
+ * the value, or the lower bound for the last (unbounded) bucket.
+ *
+ * Returns: the approximate value, or 0 if nothing was recorded.
+ */
+gint64
+egg_histogram_get_percentile (EggHistogram *histogram,
+                              gdouble       percentile)
+{
+  gint64 counts [EGG_HISTOGRAM_N_BUCKETS] = { 0 };
+  gint64 total = 0;
+  gint64 target;
+  gint64 seen = 0;
+  guint i;
+
+  g_return_val_if_fail (histogram, 0);
+
+  percentile = CLAMP (percentile, 0.0, 100.0);
+
+  for (i = 0; i < EGG_HISTOGRAM_N_BUCKETS; i++)
+    {
+      if (histogram->buckets [i].values != NULL)
+        counts [i] = MAX (0, egg_counter_get (&histogram->buckets [i]));
+      total += counts [i];
+    }
+
+  if (total == 0)
+    return 0;
+
+  target = MAX (1, (gint64)((total * percentile / 100.0) + 0.5));
+
+  for (i = 0; i < EGG_HISTOGRAM_N_BUCKETS - 1; i++)
+    {
+      seen += counts [i];
+
+      if (seen >= target)
+        return (i == 0) ? 0 : (G_GINT64_CONSTANT (1) << i);
+    }
+
+  return G_GINT64_CONSTANT (1) << (EGG_HISTOGRAM_N_BUCKETS - 2);
+}
+
+void
+egg_histogram_reset (EggHistogram *histogram)
+{
+  guint i;
+
+  g_return_if_fail (histogram);
+
+  for (i = 0; i < EGG_HISTOGRAM_N_BUCKETS; i++)
+    {
+      if (histogram->buckets [i].values != NULL)
+        egg_counter_reset (&histogram->buckets [i]);
+    }
+}
+
 #ifdef __linux__
 static void *
 _egg_counter_find_getcpu_in_vdso (void)
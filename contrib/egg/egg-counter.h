@@ -80,6 +80,25 @@
  * You cannot remove a counter once it has been registered.
  *
  *
+ * Using EggHistogram
+ * ==================
+ *
+ * Counters tell you about volume, but not about latency. EggHistogram is a
+ * set of counters, one per log2 bucket, stored in the same shared memory
+ * zone and updated the same way (per-CPU, without synchronization).
+ *
+ *   EGG_DEFINE_HISTOGRAM (Symbol, "Category", "Name", "Description")
+ *
+ * Record a value (in microseconds, by convention) with EGG_HISTOGRAM_RECORD,
+ * or time the rest of the enclosing scope with EGG_HISTOGRAM_TIME_SCOPE.
+ *
+ *   EGG_HISTOGRAM_TIME_SCOPE (Symbol);
+ *
+ * Bucket 0 contains values <= 0, and bucket N contains values in the range
+ * [2^(N-1), 2^N). The last bucket also contains everything larger. Use
+ * egg_histogram_get_percentile() to get the approximate Nth percentile.
+ *
+ *
  * Accessing Counters Remotely
  * ===========================
  *
@@ -241,9 +260,60 @@ G_BEGIN_DECLS
   } G_STMT_END
 #endif
 
+/**
+ * EGG_HISTOGRAM_N_BUCKETS:
+ *
+ * The number of buckets in an #EggHistogram. With microsecond values, the
+ * last bucket begins at roughly 4 seconds.
+ */
+#define EGG_HISTOGRAM_N_BUCKETS 24
+
+/**
+ * EGG_DEFINE_HISTOGRAM:
+ * @Identifier: The symbol name of the histogram
+ * @Category: A string category for the histogram.
+ * @Name: A string name for the histogram.
+ * @Description: A string description for the histogram.
+ *
+ * |[<!-- language="C" -->
+ * EGG_DEFINE_HISTOGRAM (my_latency, "My", "Latency", "My Latency Description");
+ * ]|
+ */
+#define EGG_DEFINE_HISTOGRAM(Identifier, Category, Name, Description)                       \
+ static EggHistogram Identifier##_hist = { { { NULL } }, Category, Name, Description };       \
+ static void Identifier##_hist_init (void) __attribute__((constructor));                     \
+ static void                                                                                 \
+ Identifier##_hist_init (void)                                                               \
+ {                                                                                           \
+   egg_counter_arena_register_histogram (egg_counter_arena_get_default(), &Identifier##_hist); \
+ }
+
+/**
+ * EGG_HISTOGRAM_RECORD:
+ * @Identifier: The identifier of the histogram.
+ * @Value: The value to record, such as a duration in microseconds.
+ *
+ * Adds @Value to the appropriate bucket of @Identifier.
+ */
+#define EGG_HISTOGRAM_RECORD(Identifier, Value) \
+  egg_histogram_record (&Identifier##_hist, (gint64)(Value))
+
+/**
+ * EGG_HISTOGRAM_TIME_SCOPE:
+ * @Identifier: The identifier of the histogram.
+ *
+ * Records the time, in microseconds, from this statement until the end of
+ * the enclosing scope into @Identifier. Since this declares a variable, it
+ * must be placed with the declarations at the top of a block.
+ */
+#define EGG_HISTOGRAM_TIME_SCOPE(Identifier)                                             \
+  EggHistogramScope Identifier##_scope __attribute__((cleanup(egg_histogram_scope_end))) = \
+    { &Identifier##_hist, g_get_monotonic_time () }
+
 typedef struct _EggCounter      EggCounter;
 typedef struct _EggCounterArena EggCounterArena;
 typedef struct _EggCounterValue EggCounterValue;
+typedef struct _EggHistogram    EggHistogram;
 
 /**
  * EggCounterForeachFunc:
@@ -270,6 +340,32 @@ struct _EggCounterValue
   gint64          padding [7];
 } __attribute__ ((aligned(8)));
 
+struct _EggHistogram
+{
+  /*< Private >*/
+  EggCounter   buckets [EGG_HISTOGRAM_N_BUCKETS];
+  const gchar *category;
+  const gchar *name;
+  const gchar *description;
+};
+
+typedef struct
+{
+  EggHistogram *histogram;
+  gint64        begin;
+} EggHistogramScope;
+
+/**
+ * EggHistogramForeachFunc:
+ * @histogram: the histogram.
+ * @user_data: data supplied to egg_counter_arena_foreach_histogram().
+ *
+ * Function prototype for callbacks provided to
+ * egg_counter_arena_foreach_histogram().
+ */
+typedef void (*EggHistogramForeachFunc) (EggHistogram *histogram,
+                                         gpointer      user_data);
+
 GType            egg_counter_arena_get_type     (void);
 guint            egg_get_current_cpu_call       (void);
 EggCounterArena *egg_counter_arena_get_default  (void);
@@ -283,6 +379,63 @@ void             egg_counter_arena_foreach      (EggCounterArena       *arena,
                                                  gpointer               user_data);
 void             egg_counter_reset              (EggCounter            *counter);
 gint64           egg_counter_get                (EggCounter            *counter);
+void             egg_counter_arena_register_histogram
+                                                (EggCounterArena       *arena,
+                                                 EggHistogram          *histogram);
+void             egg_counter_arena_foreach_histogram
+                                                (EggCounterArena       *arena,
+                                                 EggHistogramForeachFunc func,
+                                                 gpointer               user_data);
+gint64           egg_histogram_get_count        (EggHistogram          *histogram);
+gint64           egg_histogram_get_percentile   (EggHistogram          *histogram,
+                                                 gdouble                percentile);
+void             egg_histogram_reset            (EggHistogram          *histogram);
+
+static inline guint
+egg_histogram_get_bucket (gint64 value)
+{
+  if (value <= 0)
+    return 0;
+  return MIN (g_bit_storage ((guint64)value), EGG_HISTOGRAM_N_BUCKETS - 1);
+}
+
+/**
+ * egg_counter_add:
+ * @counter: An #EggCounter
+ * @count: the amount to add
+ *
+ * Like EGG_COUNTER_ADD() but for a counter known only by pointer, such as
+ * one stored in a table.
+ */
+static inline void
+egg_counter_add (EggCounter *counter,
+                 gint64      count)
+{
+#ifdef EGG_COUNTER_REQUIRES_ATOMIC
+  __sync_add_and_fetch ((gint64 *)&counter->values[0].value, count);
+#else
+  counter->values[egg_get_current_cpu()].value += count;
+#endif
+}
+
+static inline void
+egg_histogram_record (EggHistogram *histogram,
+                      gint64        value)
+{
+  EggCounter *bucket = &histogram->buckets [egg_histogram_get_bucket (value)];
+
+#ifdef EGG_COUNTER_REQUIRES_ATOMIC
+  __sync_add_and_fetch ((gint64 *)&bucket->values[0].value, G_GINT64_CONSTANT(1));
+#else
+  bucket->values[egg_get_current_cpu()].value++;
+#endif
+}
+
+static inline void
+egg_histogram_scope_end (EggHistogramScope *scope)
+{
+  egg_histogram_record (scope->histogram, g_get_monotonic_time () - scope->begin);
+}
 
 G_END_DECLS
 
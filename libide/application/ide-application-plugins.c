@@ -27,6 +27,7 @@
 #include "application/ide-application-addin.h"
 #include "application/ide-application-private.h"
 #include "theming/ide-css-provider.h"
+#include "util/ide-timeline.h"
 
 static gboolean
 ide_application_can_load_plugin (IdeApplication *self,
@@ -195,9 +196,12 @@ ide_application_load_plugins (IdeApplication *self)
 {
   PeasEngine *engine;
   const GList *list;
+  gint64 load_begin;
 
   g_return_if_fail (IDE_IS_APPLICATION (self));
 
+  load_begin = ide_timeline_begin ();
+
   engine = peas_engine_get_default ();
   list = peas_engine_get_plugin_list (engine);
 
@@ -223,11 +227,15 @@ ide_application_load_plugins (IdeApplication *self)
 
       if (ide_application_can_load_plugin (self, plugin_info))
         {
-          g_debug ("Loading plugin \"%s\"",
-                   peas_plugin_info_get_module_name (plugin_info));
+          gint64 begin = ide_timeline_begin ();
+
+          g_debug ("Loading plugin \"%s\"", module_name);
           peas_engine_load_plugin (engine, plugin_info);
+          ide_timeline_end ("Plugins", module_name, begin);
         }
     }
+
+  ide_timeline_end ("Plugins", "load-plugins", load_begin);
 }
 
 static void
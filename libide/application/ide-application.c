@@ -377,7 +377,10 @@ ide_application_startup (GApplication *application)
   G_APPLICATION_CLASS (ide_application_parent_class)->startup (application);
 
   if (self->mode == IDE_APPLICATION_MODE_PRIMARY)
-    ide_application_register_menus (self);
+    {
+      ide_application_register_menus (self);
+      _ide_stall_detector_init ();
+    }
 
   ide_application_load_addins (self);
 }
@@ -0,0 +1,893 @@
+/* ide-bracket-index.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define G_LOG_DOMAIN "ide-bracket-index"
+
+#include <egg-counter.h>
+#include <gtksourceview/gtksource.h>
+#include <string.h>
+
+#include "ide-macros.h"
+
+#include "buffers/ide-bracket-index.h"
+
+/*
+ * IdeBracketIndex keeps track of the brackets, comments and strings of a
+ * buffer so that indenters and movements do not need to walk the buffer
+ * one character at a time to find the enclosing scope.
+ *
+ * The index is built lazily, from the start of the buffer up to the
+ * position being queried. An edit truncates the index back to the start
+ * of the edited line (or the start of the comment or string containing
+ * it), so typing only causes the current line to be lexed again. Queries
+ * are a binary search followed by a walk up the enclosing brackets.
+ *
+ * Each bracket remembers the enclosing open bracket after it has been
+ * processed. That is enough to recover the stack of open brackets at any
+ * position, which is what lets us truncate without lexing again from the
+ * start of the buffer.
+ *
+ * The syntax is the C family: (), [] and {}, "strings" and 'c'haracters,
+ * and the comment delimiters provided by the GtkSourceLanguage metadata.
+ * Other languages would be misread (apostrophes in prose, lifetimes in
+ * Rust, etc), so callers should check
+ * ide_bracket_index_get_syntax_supported() and fall back to scanning the
+ * buffer for those.
+ *
+ * Edits are tracked from the insert-text and delete-range signals, which
+ * run before the buffer is modified.
+ */
+
+#define LEX_CHUNK_LINES 2000
+#define UNTERMINATED    G_MAXUINT
+
+struct _IdeBracketIndex
+{
+  GObject        parent_instance;
+
+  /* Weak pointer */
+  GtkTextBuffer *buffer;
+
+  GArray        *brackets;
+  GArray        *regions;
+
+  gchar         *line_comment;
+  gchar         *block_comment_start;
+  gchar         *block_comment_end;
+
+  /* Everything before this character offset has been lexed. */
+  guint          valid_until;
+
+  guint          syntax_supported : 1;
+};
+
+typedef struct
+{
+  guint offset;
+  gint  match;
+  gint  parent;
+  guint depth : 24;
+  guint ch : 8;
+} Bracket;
+
+typedef struct
+{
+  guint begin;
+  guint end;
+  guint kind : 8;
+  guint quote : 24;
+} Region;
+
+G_STATIC_ASSERT (sizeof (Bracket) == 16);
+
+G_DEFINE_TYPE (IdeBracketIndex, ide_bracket_index, G_TYPE_OBJECT)
+
+EGG_DEFINE_COUNTER (lexed_chars, "IdeBracketIndex", "Lexed Characters",
+                    "Number of characters lexed to build bracket indexes.")
+
+static const gchar *c_family_languages[] = {
+  "c", "chdr", "cpp", "cpphdr", "objc", "vala", "java", "js", "cs",
+};
+
+static inline gboolean
+is_open (gunichar ch)
+{
+  return ch == '(' || ch == '[' || ch == '{';
+}
+
+static inline gboolean
+is_close (gunichar ch)
+{
+  return ch == ')' || ch == ']' || ch == '}';
+}
+
+static inline gunichar
+get_opposite (gunichar ch)
+{
+  switch (ch)
+    {
+    case '(': return ')';
+    case ')': return '(';
+    case '[': return ']';
+    case ']': return '[';
+    case '{': return '}';
+    case '}': return '{';
+    default:  return 0;
+    }
+}
+
+static inline Bracket *
+get_bracket (IdeBracketIndex *self,
+             gint             index)
+{
+  return &g_array_index (self->brackets, Bracket, index);
+}
+
+static inline Region *
+get_region (IdeBracketIndex *self,
+            gint             index)
+{
+  return &g_array_index (self->regions, Region, index);
+}
+
+/*
+ * Gets the innermost open bracket after the bracket at @index has been
+ * processed, or -1 if there is none.
+ */
+static inline gint
+get_top_after (IdeBracketIndex *self,
+               gint             index)
+{
+  const Bracket *bracket;
+
+  if (index < 0)
+    return -1;
+
+  bracket = get_bracket (self, index);
+
+  if (is_open (bracket->ch))
+    return index;
+
+  return bracket->parent;
+}
+
+/* Gets the index of the first bracket at or after @offset. */
+static guint
+brackets_lower_bound (IdeBracketIndex *self,
+                      guint            offset)
+{
+  guint lo = 0;
+  guint hi = self->brackets->len;
+
+  while (lo < hi)
+    {
+      guint mid = lo + ((hi - lo) / 2);
+
+      if (get_bracket (self, mid)->offset < offset)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+  return lo;
+}
+
+/* Gets the index of the first region beginning at or after @offset. */
+static guint
+regions_lower_bound (IdeBracketIndex *self,
+                     guint            offset)
+{
+  guint lo = 0;
+  guint hi = self->regions->len;
+
+  while (lo < hi)
+    {
+      guint mid = lo + ((hi - lo) / 2);
+
+      if (get_region (self, mid)->begin < offset)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+  return lo;
+}
+
+static void
+ide_bracket_index_push_bracket (IdeBracketIndex *self,
+                                guint            offset,
+                                gunichar         ch)
+{
+  Bracket bracket = { offset, -1, -1, 0, ch };
+  gint index = self->brackets->len;
+  gint top;
+
+  top = get_top_after (self, index - 1);
+
+  if (is_open (ch))
+    {
+      bracket.parent = top;
+      bracket.depth = (top == -1) ? 1 : get_bracket (self, top)->depth + 1;
+    }
+  else
+    {
+      gunichar open_ch = get_opposite (ch);
+      gint candidate;
+
+      /*
+       * Find the innermost open bracket of the same kind. Any open brackets
+       * inside of it are left unmatched, which is the least surprising
+       * recovery for code that is in the middle of being typed.
+       */
+      for (candidate = top;
+           candidate != -1 && get_bracket (self, candidate)->ch != open_ch;
+           candidate = get_bracket (self, candidate)->parent)
+        { /* Do Nothing */ }
+
+      if (candidate != -1)
+        {
+          Bracket *open = get_bracket (self, candidate);
+
+          open->match = index;
+          bracket.match = candidate;
+          top = open->parent;
+        }
+
+      bracket.parent = top;
+      bracket.depth = (top == -1) ? 0 : get_bracket (self, top)->depth;
+    }
+
+  g_array_append_val (self->brackets, bracket);
+}
+
+static inline gboolean
+has_prefix (const gchar *str,
+            const gchar *prefix)
+{
+  return prefix != NULL && strncmp (str, prefix, strlen (prefix)) == 0;
+}
+
+/*
+ * Lexes @text, which starts at character @offset and ends at the end of a
+ * line (or the end of the buffer). Since delimiters never span lines, the
+ * only state we carry between chunks is the last region, if it is still
+ * unterminated.
+ */
+static void
+ide_bracket_index_lex (IdeBracketIndex *self,
+                       const gchar     *text,
+                       guint            offset)
+{
+  Region *open = NULL;
+  const gchar *p;
+  guint begin = offset;
+
+  g_assert (IDE_IS_BRACKET_INDEX (self));
+  g_assert (text != NULL);
+
+  if (self->regions->len > 0)
+    {
+      open = get_region (self, self->regions->len - 1);
+
+      if (open->end != UNTERMINATED)
+        open = NULL;
+    }
+
+  for (p = text; *p; p = g_utf8_next_char (p), offset++)
+    {
+      gunichar ch = g_utf8_get_char (p);
+
+      if (open == NULL)
+        {
+          Region region = { offset, UNTERMINATED, IDE_BRACKET_REGION_NONE, 0 };
+          const gchar *delim = NULL;
+
+          if (has_prefix (p, self->block_comment_start))
+            {
+              region.kind = IDE_BRACKET_REGION_BLOCK_COMMENT;
+              delim = self->block_comment_start;
+            }
+          else if (has_prefix (p, self->line_comment))
+            {
+              region.kind = IDE_BRACKET_REGION_LINE_COMMENT;
+              delim = self->line_comment;
+            }
+          else if (ch == '"' || ch == '\'')
+            {
+              region.kind = IDE_BRACKET_REGION_STRING;
+              region.quote = ch;
+            }
+          else if (is_open (ch) || is_close (ch))
+            {
+              ide_bracket_index_push_bracket (self, offset, ch);
+              continue;
+            }
+          else
+            continue;
+
+          g_array_append_val (self->regions, region);
+          open = get_region (self, self->regions->len - 1);
+
+          /* Comment delimiters are ASCII, so bytes and characters match */
+          if (delim != NULL)
+            {
+              gsize len = strlen (delim) - 1;
+
+              p += len;
+              offset += len;
+            }
+
+          continue;
+        }
+
+      switch (open->kind)
+        {
+        case IDE_BRACKET_REGION_BLOCK_COMMENT:
+          if (has_prefix (p, self->block_comment_end))
+            {
+              gsize len = strlen (self->block_comment_end) - 1;
+
+              p += len;
+              offset += len;
+              open->end = offset + 1;
+              open = NULL;
+            }
+          break;
+
+        case IDE_BRACKET_REGION_LINE_COMMENT:
+          if (ch == '\\' && p [1] == '\n')
+            {
+              p++;
+              offset++;
+            }
+          else if (ch == '\n')
+            {
+              open->end = offset;
+              open = NULL;
+            }
+          break;
+
+        case IDE_BRACKET_REGION_STRING:
+          if (ch == '\\' && p [1] != '\0')
+            {
+              p = g_utf8_next_char (p);
+              offset++;
+            }
+          else if (ch == open->quote)
+            {
+              open->end = offset + 1;
+              open = NULL;
+            }
+          else if (ch == '\n')
+            {
+              /* Unterminated strings end with the line */
+              open->end = offset;
+              open = NULL;
+            }
+          break;
+
+        default:
+          g_assert_not_reached ();
+        }
+    }
+
+  EGG_COUNTER_ADD (lexed_chars, offset - begin);
+}
+
+/*
+ * Lexes the next chunk of the buffer, stopping at the end of the line
+ * containing @target if it is within reach (use G_MAXUINT to lex as much
+ * as possible). Returns %FALSE if the whole buffer has already been lexed.
+ */
+static gboolean
+ide_bracket_index_lex_chunk (IdeBracketIndex *self,
+                             guint            target)
+{
+  g_autofree gchar *text = NULL;
+  GtkTextIter begin;
+  GtkTextIter end;
+  guint n_chars;
+
+  g_assert (IDE_IS_BRACKET_INDEX (self));
+
+  if (self->buffer == NULL)
+    return FALSE;
+
+  n_chars = gtk_text_buffer_get_char_count (self->buffer);
+
+  if (self->valid_until >= n_chars)
+    return FALSE;
+
+  target = CLAMP (target, self->valid_until, n_chars);
+
+  gtk_text_buffer_get_iter_at_offset (self->buffer, &begin, self->valid_until);
+  gtk_text_buffer_get_iter_at_offset (self->buffer, &end, target);
+
+  if (gtk_text_iter_get_line (&end) - gtk_text_iter_get_line (&begin) > LEX_CHUNK_LINES)
+    {
+      end = begin;
+      gtk_text_iter_forward_lines (&end, LEX_CHUNK_LINES);
+    }
+  else if (!gtk_text_iter_forward_line (&end))
+    {
+      gtk_text_buffer_get_end_iter (self->buffer, &end);
+    }
+
+  /* get_slice() keeps a character for embedded objects so offsets match */
+  text = gtk_text_iter_get_slice (&begin, &end);
+  ide_bracket_index_lex (self, text, self->valid_until);
+
+  self->valid_until = gtk_text_iter_get_offset (&end);
+
+  return TRUE;
+}
+
+/* Ensures the character at @offset has been lexed. */
+static void
+ide_bracket_index_ensure (IdeBracketIndex *self,
+                          guint            offset)
+{
+  while (self->valid_until <= offset)
+    {
+      if (!ide_bracket_index_lex_chunk (self, offset))
+        break;
+    }
+}
+
+static gboolean
+ide_bracket_index_ensure_matched (IdeBracketIndex *self,
+                                  gint             index)
+{
+  while (get_bracket (self, index)->match == -1)
+    {
+      if (!ide_bracket_index_lex_chunk (self, G_MAXUINT))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+/*
+ * Gets the innermost open bracket matching @open_ch that contains @offset,
+ * or -1 if there is none.
+ */
+static gint
+ide_bracket_index_find_enclosing (IdeBracketIndex *self,
+                                  guint            offset,
+                                  gunichar         open_ch)
+{
+  gint top;
+
+  ide_bracket_index_ensure (self, offset);
+
+  top = get_top_after (self, (gint)brackets_lower_bound (self, offset) - 1);
+
+  while (top != -1 && get_bracket (self, top)->ch != open_ch)
+    top = get_bracket (self, top)->parent;
+
+  return top;
+}
+
+/*
+ * Discards everything that may be affected by an edit at @iter, which is
+ * called before the edit is applied.
+ */
+static void
+ide_bracket_index_invalidate (IdeBracketIndex   *self,
+                              const GtkTextIter *iter)
+{
+  guint cut;
+  guint index;
+  gint top;
+
+  g_assert (IDE_IS_BRACKET_INDEX (self));
+  g_assert (iter != NULL);
+
+  cut = gtk_text_iter_get_offset (iter) - gtk_text_iter_get_line_offset (iter);
+
+  if (cut >= self->valid_until)
+    return;
+
+  /* Restart from the beginning of a comment or string spanning the line */
+  index = regions_lower_bound (self, cut);
+
+  if (index > 0)
+    {
+      const Region *region = get_region (self, index - 1);
+
+      if (region->end > cut)
+        {
+          cut = region->begin;
+          index--;
+        }
+    }
+
+  g_array_set_size (self->regions, index);
+  g_array_set_size (self->brackets, brackets_lower_bound (self, cut));
+
+  /* Brackets that are still open were matched by something we discarded */
+  for (top = get_top_after (self, (gint)self->brackets->len - 1);
+       top != -1;
+       top = get_bracket (self, top)->parent)
+    get_bracket (self, top)->match = -1;
+
+  self->valid_until = cut;
+}
+
+static void
+ide_bracket_index_insert_text (IdeBracketIndex *self,
+                               GtkTextIter     *location,
+                               const gchar     *text,
+                               gint             len,
+                               GtkTextBuffer   *buffer)
+{
+  ide_bracket_index_invalidate (self, location);
+}
+
+static void
+ide_bracket_index_delete_range (IdeBracketIndex *self,
+                                GtkTextIter     *begin,
+                                GtkTextIter     *end,
+                                GtkTextBuffer   *buffer)
+{
+  ide_bracket_index_invalidate (self, begin);
+}
+
+static void
+ide_bracket_index_notify_language (IdeBracketIndex *self,
+                                   GParamSpec      *pspec,
+                                   GtkTextBuffer   *buffer)
+{
+  GtkSourceLanguage *language = NULL;
+  const gchar *line_comment = NULL;
+  const gchar *block_comment_start = NULL;
+  const gchar *block_comment_end = NULL;
+
+  g_assert (IDE_IS_BRACKET_INDEX (self));
+  g_assert (GTK_IS_TEXT_BUFFER (buffer));
+
+  if (GTK_SOURCE_IS_BUFFER (buffer))
+    language = gtk_source_buffer_get_language (GTK_SOURCE_BUFFER (buffer));
+
+  self->syntax_supported = FALSE;
+
+  if (language != NULL)
+    {
+      const gchar *lang_id = gtk_source_language_get_id (language);
+
+      for (guint i = 0; i < G_N_ELEMENTS (c_family_languages); i++)
+        {
+          if (g_strcmp0 (lang_id, c_family_languages [i]) == 0)
+            {
+              self->syntax_supported = TRUE;
+              break;
+            }
+        }
+
+      line_comment = gtk_source_language_get_metadata (language, "line-comment-start");
+      block_comment_start = gtk_source_language_get_metadata (language, "block-comment-start");
+      block_comment_end = gtk_source_language_get_metadata (language, "block-comment-end");
+    }
+
+  if (!block_comment_start || !*block_comment_start || !block_comment_end || !*block_comment_end)
+    block_comment_start = block_comment_end = NULL;
+
+  if (line_comment && !*line_comment)
+    line_comment = NULL;
+
+  g_free (self->line_comment);
+  g_free (self->block_comment_start);
+  g_free (self->block_comment_end);
+
+  self->line_comment = g_strdup (line_comment);
+  self->block_comment_start = g_strdup (block_comment_start);
+  self->block_comment_end = g_strdup (block_comment_end);
+
+  g_array_set_size (self->brackets, 0);
+  g_array_set_size (self->regions, 0);
+  self->valid_until = 0;
+}
+
+static void
+ide_bracket_index_finalize (GObject *object)
+{
+  IdeBracketIndex *self = (IdeBracketIndex *)object;
+
+  ide_clear_weak_pointer (&self->buffer);
+
+  g_clear_pointer (&self->brackets, g_array_unref);
+  g_clear_pointer (&self->regions, g_array_unref);
+  g_clear_pointer (&self->line_comment, g_free);
+  g_clear_pointer (&self->block_comment_start, g_free);
+  g_clear_pointer (&self->block_comment_end, g_free);
+
+  G_OBJECT_CLASS (ide_bracket_index_parent_class)->finalize (object);
+}
+
+static void
+ide_bracket_index_class_init (IdeBracketIndexClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = ide_bracket_index_finalize;
+}
+
+static void
+ide_bracket_index_init (IdeBracketIndex *self)
+{
+  self->brackets = g_array_new (FALSE, FALSE, sizeof (Bracket));
+  self->regions = g_array_new (FALSE, FALSE, sizeof (Region));
+}
+
+/**
+ * ide_bracket_index_new:
+ * @buffer: A #GtkTextBuffer
+ *
+ * Creates a new index for @buffer which tracks edits to @buffer. Use
+ * ide_buffer_get_bracket_index() instead of creating another one for an
+ * #IdeBuffer.
+ *
+ * Returns: (transfer full): An #IdeBracketIndex.
+ */
+IdeBracketIndex *
+ide_bracket_index_new (GtkTextBuffer *buffer)
+{
+  IdeBracketIndex *self;
+
+  g_return_val_if_fail (GTK_IS_TEXT_BUFFER (buffer), NULL);
+
+  self = g_object_new (IDE_TYPE_BRACKET_INDEX, NULL);
+  ide_set_weak_pointer (&self->buffer, buffer);
+
+  g_signal_connect_object (buffer,
+                           "insert-text",
+                           G_CALLBACK (ide_bracket_index_insert_text),
+                           self,
+                           G_CONNECT_SWAPPED);
+
+  g_signal_connect_object (buffer,
+                           "delete-range",
+                           G_CALLBACK (ide_bracket_index_delete_range),
+                           self,
+                           G_CONNECT_SWAPPED);
+
+  if (GTK_SOURCE_IS_BUFFER (buffer))
+    g_signal_connect_object (buffer,
+                             "notify::language",
+                             G_CALLBACK (ide_bracket_index_notify_language),
+                             self,
+                             G_CONNECT_SWAPPED);
+
+  ide_bracket_index_notify_language (self, NULL, buffer);
+
+  return self;
+}
+
+/**
+ * ide_bracket_index_get_syntax_supported:
+ * @self: An #IdeBracketIndex
+ *
+ * Checks whether the language of the buffer uses the C-family syntax for
+ * strings and comments that the index understands. If not, the results of
+ * the index may be wrong and callers should scan the buffer instead.
+ *
+ * Returns: %TRUE if the buffer language is supported.
+ */
+gboolean
+ide_bracket_index_get_syntax_supported (IdeBracketIndex *self)
+{
+  g_return_val_if_fail (IDE_IS_BRACKET_INDEX (self), FALSE);
+
+  return self->syntax_supported;
+}
+
+/**
+ * ide_bracket_index_backward_find_unmatched:
+ * @self: An #IdeBracketIndex
+ * @iter: (inout): A #GtkTextIter
+ * @open_ch: an opening bracket such as '(' or '{'
+ *
+ * Moves @iter to the innermost unclosed @open_ch before @iter. Brackets
+ * within comments and strings are ignored. If there is no such bracket,
+ * @iter is left unchanged.
+ *
+ * Returns: %TRUE if @iter was moved.
+ */
+gboolean
+ide_bracket_index_backward_find_unmatched (IdeBracketIndex *self,
+                                           GtkTextIter     *iter,
+                                           gunichar         open_ch)
+{
+  gint index;
+
+  g_return_val_if_fail (IDE_IS_BRACKET_INDEX (self), FALSE);
+  g_return_val_if_fail (iter != NULL, FALSE);
+  g_return_val_if_fail (is_open (open_ch), FALSE);
+
+  index = ide_bracket_index_find_enclosing (self, gtk_text_iter_get_offset (iter), open_ch);
+
+  if (index == -1)
+    return FALSE;
+
+  gtk_text_iter_set_offset (iter, get_bracket (self, index)->offset);
+
+  return TRUE;
+}
+
+/**
+ * ide_bracket_index_forward_find_unmatched:
+ * @self: An #IdeBracketIndex
+ * @iter: (inout): A #GtkTextIter
+ * @close_ch: a closing bracket such as ')' or '}'
+ *
+ * Moves @iter to the @close_ch which closes the innermost scope of that
+ * kind containing @iter. If there is no such bracket, @iter is left
+ * unchanged.
+ *
+ * Returns: %TRUE if @iter was moved.
+ */
+gboolean
+ide_bracket_index_forward_find_unmatched (IdeBracketIndex *self,
+                                          GtkTextIter     *iter,
+                                          gunichar         close_ch)
+{
+  gint index;
+
+  g_return_val_if_fail (IDE_IS_BRACKET_INDEX (self), FALSE);
+  g_return_val_if_fail (iter != NULL, FALSE);
+  g_return_val_if_fail (is_close (close_ch), FALSE);
+
+  index = ide_bracket_index_find_enclosing (self,
+                                            gtk_text_iter_get_offset (iter),
+                                            get_opposite (close_ch));
+
+  if (index == -1 || !ide_bracket_index_ensure_matched (self, index))
+    return FALSE;
+
+  gtk_text_iter_set_offset (iter, get_bracket (self, get_bracket (self, index)->match)->offset);
+
+  return TRUE;
+}
+
+/**
+ * ide_bracket_index_get_match:
+ * @self: An #IdeBracketIndex
+ * @iter: (inout): A #GtkTextIter
+ *
+ * If @iter is on a bracket outside of comments and strings, moves @iter
+ * to the matching bracket.
+ *
+ * Returns: %TRUE if @iter was moved.
+ */
+gboolean
+ide_bracket_index_get_match (IdeBracketIndex *self,
+                             GtkTextIter     *iter)
+{
+  guint offset;
+  guint index;
+
+  g_return_val_if_fail (IDE_IS_BRACKET_INDEX (self), FALSE);
+  g_return_val_if_fail (iter != NULL, FALSE);
+
+  offset = gtk_text_iter_get_offset (iter);
+
+  ide_bracket_index_ensure (self, offset);
+
+  index = brackets_lower_bound (self, offset);
+
+  if (index >= self->brackets->len ||
+      get_bracket (self, index)->offset != offset ||
+      !ide_bracket_index_ensure_matched (self, index))
+    return FALSE;
+
+  gtk_text_iter_set_offset (iter, get_bracket (self, get_bracket (self, index)->match)->offset);
+
+  return TRUE;
+}
+
+/**
+ * ide_bracket_index_get_depth:
+ * @self: An #IdeBracketIndex
+ * @iter: A #GtkTextIter
+ *
+ * Gets the number of unclosed brackets before @iter.
+ *
+ * Returns: the bracket depth at @iter.
+ */
+guint
+ide_bracket_index_get_depth (IdeBracketIndex   *self,
+                             const GtkTextIter *iter)
+{
+  guint offset;
+  gint top;
+
+  g_return_val_if_fail (IDE_IS_BRACKET_INDEX (self), 0);
+  g_return_val_if_fail (iter != NULL, 0);
+
+  offset = gtk_text_iter_get_offset (iter);
+
+  ide_bracket_index_ensure (self, offset);
+
+  top = get_top_after (self, (gint)brackets_lower_bound (self, offset) - 1);
+
+  return (top == -1) ? 0 : get_bracket (self, top)->depth;
+}
+
+/**
+ * ide_bracket_index_get_region:
+ * @self: An #IdeBracketIndex
+ * @iter: A #GtkTextIter
+ * @begin: (out) (optional): A location for the start of the region
+ * @end: (out) (optional): A location for the end of the region
+ *
+ * Checks if the character at @iter is part of a comment or string,
+ * including its delimiters.
+ *
+ * Returns: the kind of region containing @iter.
+ */
+IdeBracketRegion
+ide_bracket_index_get_region (IdeBracketIndex   *self,
+                              const GtkTextIter *iter,
+                              GtkTextIter       *begin,
+                              GtkTextIter       *end)
+{
+  GtkTextBuffer *buffer;
+  const Region *region;
+  guint offset;
+  guint index;
+
+  g_return_val_if_fail (IDE_IS_BRACKET_INDEX (self), IDE_BRACKET_REGION_NONE);
+  g_return_val_if_fail (iter != NULL, IDE_BRACKET_REGION_NONE);
+
+  buffer = gtk_text_iter_get_buffer (iter);
+  offset = gtk_text_iter_get_offset (iter);
+
+  ide_bracket_index_ensure (self, offset);
+
+  index = regions_lower_bound (self, offset + 1);
+
+  if (index == 0)
+    return IDE_BRACKET_REGION_NONE;
+
+  region = get_region (self, index - 1);
+
+  if (region->end <= offset)
+    return IDE_BRACKET_REGION_NONE;
+
+  if (begin != NULL)
+    gtk_text_buffer_get_iter_at_offset (buffer, begin, region->begin);
+
+  if (end != NULL)
+    {
+      /* Only an unterminated region can still be growing */
+      while (get_region (self, index - 1)->end == UNTERMINATED)
+        {
+          if (!ide_bracket_index_lex_chunk (self, G_MAXUINT))
+            break;
+        }
+
+      region = get_region (self, index - 1);
+
+      if (region->end == UNTERMINATED)
+        gtk_text_buffer_get_end_iter (buffer, end);
+      else
+        gtk_text_buffer_get_iter_at_offset (buffer, end, region->end);
+    }
+
+  return region->kind;
+}
@@ -0,0 +1,57 @@
+/* ide-bracket-index.h
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef IDE_BRACKET_INDEX_H
+#define IDE_BRACKET_INDEX_H
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+#define IDE_TYPE_BRACKET_INDEX (ide_bracket_index_get_type())
+
+G_DECLARE_FINAL_TYPE (IdeBracketIndex, ide_bracket_index, IDE, BRACKET_INDEX, GObject)
+
+typedef enum
+{
+  IDE_BRACKET_REGION_NONE,
+  IDE_BRACKET_REGION_LINE_COMMENT,
+  IDE_BRACKET_REGION_BLOCK_COMMENT,
+  IDE_BRACKET_REGION_STRING,
+} IdeBracketRegion;
+
+IdeBracketIndex *ide_bracket_index_new                     (GtkTextBuffer     *buffer);
+gboolean         ide_bracket_index_get_syntax_supported    (IdeBracketIndex   *self);
+gboolean         ide_bracket_index_backward_find_unmatched (IdeBracketIndex   *self,
+                                                            GtkTextIter       *iter,
+                                                            gunichar           open_ch);
+gboolean         ide_bracket_index_forward_find_unmatched  (IdeBracketIndex   *self,
+                                                            GtkTextIter       *iter,
+                                                            gunichar           close_ch);
+gboolean         ide_bracket_index_get_match               (IdeBracketIndex   *self,
+                                                            GtkTextIter       *iter);
+guint            ide_bracket_index_get_depth               (IdeBracketIndex   *self,
+                                                            const GtkTextIter *iter);
+IdeBracketRegion ide_bracket_index_get_region              (IdeBracketIndex   *self,
+                                                            const GtkTextIter *iter,
+                                                            GtkTextIter       *begin,
+                                                            GtkTextIter       *end);
+
+G_END_DECLS
+
+#endif /* IDE_BRACKET_INDEX_H */
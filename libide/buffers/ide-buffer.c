@@ -44,14 +44,11 @@
 #include "sourceview/ide-source-style-scheme.h"
 #include "symbols/ide-symbol-resolver.h"
 #include "symbols/ide-symbol.h"
-#include "util/ide-battery-monitor.h"
 #include "util/ide-gtk.h"
 #include "vcs/ide-vcs.h"
 
-#define DEFAULT_DIAGNOSE_TIMEOUT_MSEC          333
-#define DEFAULT_DIAGNOSE_CONSERVE_TIMEOUT_MSEC 5000
-#define RECLAIMATION_TIMEOUT_SECS              1
-#define MODIFICATION_TIMEOUT_SECS              1
+#define RECLAIMATION_TIMEOUT_SECS 1
+#define MODIFICATION_TIMEOUT_SECS 1
 
 #define TAG_ERROR            "diagnostician::error"
 #define TAG_WARNING          "diagnostician::warning"
@@ -68,6 +65,7 @@
 typedef struct
 {
   IdeContext             *context;
+  IdeBracketIndex        *bracket_index;
   IdeDiagnostics         *diagnostics;
   GHashTable             *diagnostics_line_cache;
   EggSignalGroup         *diagnostics_manager_signals;
@@ -1228,6 +1226,7 @@ ide_buffer_dispose (GObject *object)
   g_clear_pointer (&priv->diagnostics, ide_diagnostics_unref);
   g_clear_pointer (&priv->content, g_bytes_unref);
   g_clear_pointer (&priv->title, g_free);
+  g_clear_object (&priv->bracket_index);
   g_clear_object (&priv->file);
   g_clear_object (&priv->highlight_engine);
   g_clear_object (&priv->rename_provider_adapter);
@@ -2512,6 +2511,20 @@ ide_buffer_hold (IdeBuffer *self)
     }
 }
 
+/*
+ * Each view displaying the buffer holds it, so this is a reasonable
+ * approximation of whether the buffer is visible to the user.
+ */
+gboolean
+_ide_buffer_get_held (IdeBuffer *self)
+{
+  IdeBufferPrivate *priv = ide_buffer_get_instance_private (self);
+
+  g_return_val_if_fail (IDE_IS_BUFFER (self), FALSE);
+
+  return priv->hold_count > 0;
+}
+
 void
 ide_buffer_release (IdeBuffer *self)
 {
@@ -2652,6 +2665,28 @@ ide_buffer_get_word_at_iter (IdeBuffer         *self,
   return gtk_text_iter_get_slice (&begin, &end);
 }
 
+/**
+ * ide_buffer_get_bracket_index:
+ * @self: An #IdeBuffer
+ *
+ * Gets the index of brackets, comments and strings within @self. It is
+ * created on first use and kept up to date as @self is edited.
+ *
+ * Returns: (transfer none): An #IdeBracketIndex.
+ */
+IdeBracketIndex *
+ide_buffer_get_bracket_index (IdeBuffer *self)
+{
+  IdeBufferPrivate *priv = ide_buffer_get_instance_private (self);
+
+  g_return_val_if_fail (IDE_IS_BUFFER (self), NULL);
+
+  if (priv->bracket_index == NULL)
+    priv->bracket_index = ide_bracket_index_new (GTK_TEXT_BUFFER (self));
+
+  return priv->bracket_index;
+}
+
 gsize
 ide_buffer_get_change_count (IdeBuffer *self)
 {
@@ -23,6 +23,8 @@
 
 #include "ide-types.h"
 
+#include "buffers/ide-bracket-index.h"
+
 G_BEGIN_DECLS
 
 #define IDE_TYPE_BUFFER (ide_buffer_get_type ())
@@ -60,6 +62,7 @@ struct _IdeBufferClass
   gpointer _reserved8;
 };
 
+IdeBracketIndex    *ide_buffer_get_bracket_index             (IdeBuffer            *self);
 gboolean            ide_buffer_get_busy                      (IdeBuffer            *self);
 gboolean            ide_buffer_get_changed_on_volume         (IdeBuffer            *self);
 gsize               ide_buffer_get_change_count              (IdeBuffer            *self);
@@ -18,10 +18,12 @@
 
 #define G_LOG_DOMAIN "ide-build-result"
 
+#include <errno.h>
 #include <gio/gunixoutputstream.h>
 #include <glib/gi18n.h>
 #include <glib/gstdio.h>
 #include <libpeas/peas.h>
+#include <unistd.h>
 
 #include "ide-debug.h"
 #include "ide-enums.h"
@@ -32,10 +34,7 @@
 #include "files/ide-file.h"
 #include "subprocess/ide-subprocess.h"
 
-#define POINTER_MARK(p)   GSIZE_TO_POINTER(GPOINTER_TO_SIZE(p)|1)
-#define POINTER_UNMARK(p) GSIZE_TO_POINTER(GPOINTER_TO_SIZE(p)&~(gsize)1)
-#define POINTER_MARKED(p) (GPOINTER_TO_SIZE(p)&1)
-#define DISPATCH_MAX      20
+#define DISPATCH_MAX 20
 
 typedef struct
 {
@@ -52,6 +51,20 @@ typedef struct
   GSource          *log_source;
   GAsyncQueue      *log_queue;
 
+  /* Bytes written to each log, protected by mutex */
+  guint64           stdout_length;
+  guint64           stderr_length;
+
+  /* Offset of the line being emitted by ::log, main thread only */
+  gint64            log_offset;
+
+  /* Replaced, never modified, so readers can use it without the lock */
+  GPtrArray        *line_parsers;
+  guint             last_line_parser_id;
+
+  GSource          *diagnostic_source;
+  GPtrArray        *diagnostics;
+
   GTimer           *timer;
   gchar            *mode;
   GSource          *running_time_source;
@@ -63,10 +76,27 @@ typedef struct
 typedef struct
 {
   IdeBuildResult    *self;
+  GDataInputStream  *reader;
   GOutputStream     *writer;
   IdeBuildResultLog  log;
 } Tail;
 
+typedef struct
+{
+  gchar             *message;
+  gint64             offset;
+  IdeBuildResultLog  log;
+} LogEntry;
+
+typedef struct
+{
+  volatile gint             ref_count;
+  guint                     id;
+  IdeBuildResultLineParser  func;
+  gpointer                  user_data;
+  GDestroyNotify            notify;
+} LineParser;
+
 G_DEFINE_TYPE_WITH_PRIVATE (IdeBuildResult, ide_build_result, IDE_TYPE_OBJECT)
 
 enum {
@@ -87,6 +117,60 @@ enum {
 static GParamSpec *properties [LAST_PROP];
 static guint signals [LAST_SIGNAL];
 
+static LineParser *
+line_parser_ref (LineParser *parser)
+{
+  g_assert (parser != NULL);
+  g_assert (parser->ref_count > 0);
+
+  g_atomic_int_inc (&parser->ref_count);
+
+  return parser;
+}
+
+static void
+line_parser_unref (gpointer data)
+{
+  LineParser *parser = data;
+
+  g_assert (parser != NULL);
+  g_assert (parser->ref_count > 0);
+
+  if (g_atomic_int_dec_and_test (&parser->ref_count))
+    {
+      if (parser->notify != NULL)
+        parser->notify (parser->user_data);
+      g_slice_free (LineParser, parser);
+    }
+}
+
+static void
+log_entry_free (gpointer data)
+{
+  LogEntry *entry = data;
+
+  g_free (entry->message);
+  g_slice_free (LogEntry, entry);
+}
+
+static void
+ide_build_result_emit_log (IdeBuildResult    *self,
+                           IdeBuildResultLog  log,
+                           const gchar       *message,
+                           gint64             offset)
+{
+  IdeBuildResultPrivate *priv = ide_build_result_get_instance_private (self);
+  gint64 previous = priv->log_offset;
+
+  g_assert (IDE_IS_BUILD_RESULT (self));
+  g_assert (message != NULL);
+
+  /* Handlers may log themselves, so restore the outer offset afterwards */
+  priv->log_offset = offset;
+  g_signal_emit (self, signals [LOG], 0, log, message);
+  priv->log_offset = previous;
+}
+
 static gboolean
 _ide_build_result_open_log (IdeBuildResult  *self,
                             GInputStream   **read_stream,
@@ -130,6 +214,9 @@ _ide_build_result_log (IdeBuildResult    *self,
   g_autofree gchar *freeme = NULL;
   gchar data[256];
   gchar *message = data;
+  guint64 *length;
+  gint64 offset = -1;
+  gsize n_written = 0;
   va_list copy;
   gint len;
 
@@ -152,19 +239,31 @@ _ide_build_result_log (IdeBuildResult    *self,
   message [len++] = '\n';
   message [len] = '\0';
 
-  g_output_stream_write_all (stream, message, len, NULL, NULL, NULL);
+  length = (log == IDE_BUILD_RESULT_LOG_STDERR) ? &priv->stderr_length : &priv->stdout_length;
+
+  /*
+   * Subprocess output is read from multiple threads. Remember where the
+   * line starts in the log so that it can be read back later with
+   * ide_build_result_read_log().
+   */
+  g_mutex_lock (&priv->mutex);
+  if (g_output_stream_write_all (stream, message, len, &n_written, NULL, NULL))
+    offset = *length;
+  *length += n_written;
+  g_mutex_unlock (&priv->mutex);
 
   if G_UNLIKELY (g_source_get_context (source) != g_main_context_get_thread_default ())
     {
-      gchar *copied;
+      LogEntry *entry;
+
+      entry = g_slice_new (LogEntry);
+      entry->log = log;
+      entry->offset = offset;
 
       if G_UNLIKELY (freeme != NULL)
-        copied = g_steal_pointer (&freeme);
+        entry->message = g_steal_pointer (&freeme);
       else
-        copied = g_strdup (message);
-
-      if G_UNLIKELY (log == IDE_BUILD_RESULT_LOG_STDERR)
-        copied = POINTER_MARK (copied);
+        entry->message = g_strdup (message);
 
       /*
        * Add the log entry to our queue to be dispatched in the main thread.
@@ -175,13 +274,13 @@ _ide_build_result_log (IdeBuildResult    *self,
        * main loop).
        */
       g_async_queue_lock (priv->log_queue);
-      g_async_queue_push_unlocked (priv->log_queue, copied);
+      g_async_queue_push_unlocked (priv->log_queue, entry);
       g_source_set_ready_time (source, 0);
       g_async_queue_unlock (priv->log_queue);
     }
   else
     {
-      g_signal_emit (self, signals [LOG], 0, log, message);
+      ide_build_result_emit_log (self, log, message, offset);
     }
 }
 
@@ -311,42 +410,195 @@ ide_build_result_get_stdout_stream (IdeBuildResult *self)
   return priv->stdout_reader;
 }
 
+/**
+ * ide_build_result_get_log_offset:
+ *
+ * Gets the offset of the line being delivered by #IdeBuildResult::log
+ * within its log. This is only valid from a handler of that signal and
+ * may be passed to ide_build_result_read_log() to read the line again.
+ *
+ * Returns: the offset in bytes, or -1 if the line was not logged.
+ */
+gint64
+ide_build_result_get_log_offset (IdeBuildResult *self)
+{
+  IdeBuildResultPrivate *priv = ide_build_result_get_instance_private (self);
+
+  g_return_val_if_fail (IDE_IS_BUILD_RESULT (self), -1);
+
+  return priv->log_offset;
+}
+
+/**
+ * ide_build_result_read_log:
+ * @self: An #IdeBuildResult
+ * @log: the log to read from
+ * @offset: the offset from ide_build_result_get_log_offset()
+ * @length: the number of bytes to read
+ * @str: A #GString to store the text in
+ *
+ * Reads @length bytes at @offset of @log into @str. This does not change
+ * the position of the streams returned from
+ * ide_build_result_get_stdout_stream() and
+ * ide_build_result_get_stderr_stream().
+ *
+ * Returns: %TRUE if @length bytes were read.
+ */
+gboolean
+ide_build_result_read_log (IdeBuildResult    *self,
+                           IdeBuildResultLog  log,
+                           guint64            offset,
+                           gsize              length,
+                           GString           *str)
+{
+  IdeBuildResultPrivate *priv = ide_build_result_get_instance_private (self);
+  GOutputStream *writer;
+  gsize pos;
+  gint fd;
+
+  g_return_val_if_fail (IDE_IS_BUILD_RESULT (self), FALSE);
+  g_return_val_if_fail (str != NULL, FALSE);
+
+  g_string_truncate (str, 0);
+
+  g_mutex_lock (&priv->mutex);
+  writer = (log == IDE_BUILD_RESULT_LOG_STDERR) ? priv->stderr_writer : priv->stdout_writer;
+  if (writer != NULL)
+    g_object_ref (writer);
+  g_mutex_unlock (&priv->mutex);
+
+  if (writer == NULL)
+    return FALSE;
+
+  /* The log is opened read-write, so read at the offset without seeking */
+  fd = g_unix_output_stream_get_fd (G_UNIX_OUTPUT_STREAM (writer));
+
+  g_string_set_size (str, length);
+
+  for (pos = 0; pos < length;)
+    {
+      gssize n_read = pread (fd, str->str + pos, length - pos, offset + pos);
+
+      if (n_read < 0 && errno == EINTR)
+        continue;
+
+      if (n_read <= 0)
+        break;
+
+      pos += n_read;
+    }
+
+  g_object_unref (writer);
+
+  if (pos < length)
+    {
+      g_string_truncate (str, 0);
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
 static void
-ide_build_result_tail_cb (GObject      *object,
-                          GAsyncResult *result,
-                          gpointer      user_data)
-{
-  GDataInputStream *reader = (GDataInputStream *)object;
-  g_autofree gchar *line = NULL;
-  g_autoptr(GError) error = NULL;
-  Tail *tail = user_data;
+ide_build_result_queue_diagnostic (IdeBuildResult *self,
+                                   IdeDiagnostic  *diagnostic)
+{
+  IdeBuildResultPrivate *priv = ide_build_result_get_instance_private (self);
+
+  g_assert (IDE_IS_BUILD_RESULT (self));
+  g_assert (diagnostic != NULL);
+
+  /*
+   * Diagnostics are batched and emitted from the main thread by
+   * emit_diagnostics_from_main() so that a build producing many warnings
+   * does not schedule a main loop dispatch for each of them.
+   */
+  g_mutex_lock (&priv->mutex);
+  g_ptr_array_add (priv->diagnostics, diagnostic);
+  if (priv->diagnostics->len == 1)
+    g_source_set_ready_time (priv->diagnostic_source, 0);
+  g_mutex_unlock (&priv->mutex);
+}
+
+static void
+ide_build_result_parse_line (IdeBuildResult    *self,
+                             IdeBuildResultLog  log,
+                             const gchar       *line)
+{
+  IdeBuildResultPrivate *priv = ide_build_result_get_instance_private (self);
+  g_autoptr(GPtrArray) parsers = NULL;
+  guint i;
+
+  g_assert (IDE_IS_BUILD_RESULT (self));
+  g_assert (line != NULL);
+
+  g_mutex_lock (&priv->mutex);
+  if (priv->line_parsers != NULL)
+    parsers = g_ptr_array_ref (priv->line_parsers);
+  g_mutex_unlock (&priv->mutex);
+
+  if (parsers == NULL)
+    return;
+
+  for (i = 0; i < parsers->len; i++)
+    {
+      LineParser *parser = g_ptr_array_index (parsers, i);
+      IdeDiagnostic *diagnostic;
+
+      if (NULL != (diagnostic = parser->func (self, log, line, parser->user_data)))
+        ide_build_result_queue_diagnostic (self, diagnostic);
+    }
+}
+
+static gboolean
+ide_build_result_unref_from_main (gpointer data)
+{
+  g_object_unref (data);
+  return G_SOURCE_REMOVE;
+}
+
+static gpointer
+ide_build_result_tail_worker (gpointer data)
+{
+  Tail *tail = data;
+  gchar *line;
   gsize n_read;
 
-  g_assert (G_IS_INPUT_STREAM (reader));
   g_assert (tail != NULL);
-  g_assert (G_IS_OUTPUT_STREAM (tail->writer));
-
-  line = g_data_input_stream_read_line_finish_utf8 (reader, result, &n_read, &error);
+  g_assert (IDE_IS_BUILD_RESULT (tail->self));
+  g_assert (G_IS_DATA_INPUT_STREAM (tail->reader));
 
-  if (line)
+  /*
+   * We read the subprocess with blocking reads from a dedicated thread so
+   * that line parsers, such as the compiler diagnostics extraction, run
+   * here rather than in the main loop.
+   */
+  while (NULL != (line = g_data_input_stream_read_line_utf8 (tail->reader, &n_read, NULL, NULL)))
     {
+      ide_build_result_parse_line (tail->self, tail->log, line);
+
       if (tail->log == IDE_BUILD_RESULT_LOG_STDOUT)
         ide_build_result_log_stdout (tail->self, "%s", line);
       else
         ide_build_result_log_stderr (tail->self, "%s", line);
 
-      g_data_input_stream_read_line_async (reader,
-                                           G_PRIORITY_DEFAULT,
-                                           NULL,
-                                           ide_build_result_tail_cb,
-                                           tail);
-    }
-  else
-    {
-      g_object_unref (tail->self);
-      g_object_unref (tail->writer);
-      g_slice_free1 (sizeof *tail, tail);
+      g_free (line);
     }
+
+  /*
+   * We may be holding the last reference, and finalizing the build result
+   * destroys sources attached to the main context and runs weak notifies
+   * that expect to be on the main thread. Drop it from there instead.
+   */
+  g_main_context_invoke (g_main_context_default (),
+                         ide_build_result_unref_from_main,
+                         tail->self);
+
+  g_object_unref (tail->reader);
+  g_object_unref (tail->writer);
+  g_slice_free1 (sizeof *tail, tail);
+
+  return NULL;
 }
 
 static void
@@ -355,25 +607,19 @@ ide_build_result_tail_into (IdeBuildResult    *self,
                             GInputStream      *reader,
                             GOutputStream     *writer)
 {
-  g_autoptr(GDataInputStream) data_reader = NULL;
   Tail *tail;
 
   g_return_if_fail (IDE_IS_BUILD_RESULT (self));
   g_return_if_fail (G_IS_INPUT_STREAM (reader));
   g_return_if_fail (G_IS_OUTPUT_STREAM (writer));
 
-  data_reader = g_data_input_stream_new (reader);
-
   tail = g_slice_alloc0 (sizeof *tail);
   tail->self = g_object_ref (self);
+  tail->reader = g_data_input_stream_new (reader);
   tail->writer = g_object_ref (writer);
   tail->log = log;
 
-  g_data_input_stream_read_line_async (data_reader,
-                                       G_PRIORITY_DEFAULT,
-                                       NULL,
-                                       ide_build_result_tail_cb,
-                                       tail);
+  g_thread_unref (g_thread_new ("IdeBuildResultTail", ide_build_result_tail_worker, tail));
 }
 
 void
@@ -468,18 +714,39 @@ emit_log_from_main (gpointer user_data)
 
   for (guint i = 0; i < ar->len; i++)
     {
-      IdeBuildResultLog log = IDE_BUILD_RESULT_LOG_STDOUT;
-      gchar *message;
+      LogEntry *entry = g_ptr_array_index (ar, i);
 
-      item = g_ptr_array_index (ar, i);
-      message = POINTER_UNMARK (item);
+      ide_build_result_emit_log (self, entry->log, entry->message, entry->offset);
+      log_entry_free (entry);
+    }
 
-      if (POINTER_MARKED (item))
-        log = IDE_BUILD_RESULT_LOG_STDERR;
+  return G_SOURCE_CONTINUE;
+}
 
-      g_signal_emit (self, signals[LOG], 0, log, message);
+static gboolean
+emit_diagnostics_from_main (gpointer user_data)
+{
+  IdeBuildResult *self = user_data;
+  IdeBuildResultPrivate *priv = ide_build_result_get_instance_private (self);
+  IdeDiagnostic *batch[DISPATCH_MAX];
+  guint n_batch;
+  guint i;
 
-      g_free (message);
+  g_assert (IDE_IS_BUILD_RESULT (self));
+
+  g_mutex_lock (&priv->mutex);
+  n_batch = MIN (priv->diagnostics->len, DISPATCH_MAX);
+  for (i = 0; i < n_batch; i++)
+    batch [i] = g_ptr_array_index (priv->diagnostics, i);
+  g_ptr_array_remove_range (priv->diagnostics, 0, n_batch);
+  if (priv->diagnostics->len == 0)
+    g_source_set_ready_time (priv->diagnostic_source, -1);
+  g_mutex_unlock (&priv->mutex);
+
+  for (i = 0; i < n_batch; i++)
+    {
+      g_signal_emit (self, signals [DIAGNOSTIC], 0, batch [i]);
+      ide_diagnostic_unref (batch [i]);
     }
 
   return G_SOURCE_CONTINUE;
@@ -537,6 +804,11 @@ ide_build_result_finalize (GObject *object)
 
   g_clear_pointer (&priv->log_queue, g_async_queue_unref);
 
+  g_clear_pointer (&priv->diagnostic_source, g_source_destroy);
+  g_ptr_array_foreach (priv->diagnostics, (GFunc)ide_diagnostic_unref, NULL);
+  g_clear_pointer (&priv->diagnostics, g_ptr_array_unref);
+  g_clear_pointer (&priv->line_parsers, g_ptr_array_unref);
+
   g_mutex_clear (&priv->mutex);
 
   G_OBJECT_CLASS (ide_build_result_parent_class)->finalize (object);
@@ -673,13 +945,22 @@ ide_build_result_init (IdeBuildResult *self)
 
   priv->timer = g_timer_new ();
 
-  priv->log_queue = g_async_queue_new ();
+  priv->log_queue = g_async_queue_new_full (log_entry_free);
+  priv->log_offset = -1;
 
   priv->log_source = g_timeout_source_new (G_MAXINT);
   g_source_set_ready_time (priv->log_source, -1);
   g_source_set_name (priv->log_source, "[ide] build_logs");
   g_source_set_callback (priv->log_source, emit_log_from_main, self, NULL);
   g_source_attach (priv->log_source, g_main_context_default ());
+
+  priv->diagnostics = g_ptr_array_new ();
+
+  priv->diagnostic_source = g_timeout_source_new (G_MAXINT);
+  g_source_set_ready_time (priv->diagnostic_source, -1);
+  g_source_set_name (priv->diagnostic_source, "[ide] build_diagnostics");
+  g_source_set_callback (priv->diagnostic_source, emit_diagnostics_from_main, self, NULL);
+  g_source_attach (priv->diagnostic_source, g_main_context_default ());
 }
 
 GTimeSpan
@@ -783,36 +1064,10 @@ ide_build_result_set_running (IdeBuildResult *self,
   g_mutex_unlock (&priv->mutex);
 }
 
-static gboolean
-ide_build_result_emit_diagnostic_cb (gpointer data)
-{
-  struct {
-    IdeBuildResult *result;
-    IdeDiagnostic  *diagnostic;
-  } *pair = data;
-
-  g_assert (pair != NULL);
-  g_assert (IDE_IS_BUILD_RESULT (pair->result));
-  g_assert (pair->diagnostic != NULL);
-
-  g_signal_emit (pair->result, signals [DIAGNOSTIC], 0, pair->diagnostic);
-
-  g_object_unref (pair->result);
-  ide_diagnostic_unref (pair->diagnostic);
-  g_slice_free1 (sizeof *pair, pair);
-
-  return G_SOURCE_REMOVE;
-}
-
 void
 ide_build_result_emit_diagnostic (IdeBuildResult *self,
                                   IdeDiagnostic  *diagnostic)
 {
-  struct {
-    IdeBuildResult *result;
-    IdeDiagnostic  *diagnostic;
-  } *pair;
-
   IDE_ENTRY;
 
   g_return_if_fail (IDE_IS_BUILD_RESULT (self));
@@ -822,14 +1077,10 @@ ide_build_result_emit_diagnostic (IdeBuildResult *self,
   if G_LIKELY (g_main_context_get_thread_default () == g_main_context_default ())
     {
       g_signal_emit (self, signals [DIAGNOSTIC], 0, diagnostic);
-      return;
+      IDE_EXIT;
     }
 
-  pair = g_slice_alloc0 (sizeof *pair);
-  pair->result = g_object_ref (self);
-  pair->diagnostic = ide_diagnostic_ref (diagnostic);
-
-  g_timeout_add (0, ide_build_result_emit_diagnostic_cb, pair);
+  ide_build_result_queue_diagnostic (self, ide_diagnostic_ref (diagnostic));
 
   IDE_EXIT;
 }
@@ -866,3 +1117,107 @@ ide_build_result_get_failed (IdeBuildResult *self)
 
   return priv->failed;
 }
+
+/**
+ * ide_build_result_add_line_parser:
+ * @self: An #IdeBuildResult
+ * @parser: (scope notified): A #IdeBuildResultLineParser
+ * @user_data: closure data for @parser
+ * @notify: A #GDestroyNotify for @user_data
+ *
+ * Adds a parser that is called for every line of output from subprocesses
+ * logged with ide_build_result_log_subprocess(). The parser is called from
+ * the thread reading the subprocess, and the diagnostics it returns are
+ * emitted in batches from the main thread using #IdeBuildResult::diagnostic.
+ *
+ * @notify may be called from the reader thread if it is still using the
+ * parser when it is removed.
+ *
+ * Returns: An identifier for use with ide_build_result_remove_line_parser().
+ */
+guint
+ide_build_result_add_line_parser (IdeBuildResult           *self,
+                                  IdeBuildResultLineParser  parser,
+                                  gpointer                  user_data,
+                                  GDestroyNotify            notify)
+{
+  IdeBuildResultPrivate *priv = ide_build_result_get_instance_private (self);
+  g_autoptr(GPtrArray) old_parsers = NULL;
+  GPtrArray *parsers;
+  LineParser *lp;
+  guint id;
+  guint i;
+
+  g_return_val_if_fail (IDE_IS_BUILD_RESULT (self), 0);
+  g_return_val_if_fail (parser != NULL, 0);
+
+  lp = g_slice_new0 (LineParser);
+  lp->ref_count = 1;
+  lp->func = parser;
+  lp->user_data = user_data;
+  lp->notify = notify;
+
+  parsers = g_ptr_array_new_with_free_func (line_parser_unref);
+
+  g_mutex_lock (&priv->mutex);
+
+  lp->id = id = ++priv->last_line_parser_id;
+
+  if (priv->line_parsers != NULL)
+    {
+      for (i = 0; i < priv->line_parsers->len; i++)
+        g_ptr_array_add (parsers, line_parser_ref (g_ptr_array_index (priv->line_parsers, i)));
+    }
+
+  g_ptr_array_add (parsers, lp);
+
+  old_parsers = priv->line_parsers;
+  priv->line_parsers = parsers;
+
+  g_mutex_unlock (&priv->mutex);
+
+  return id;
+}
+
+void
+ide_build_result_remove_line_parser (IdeBuildResult *self,
+                                     guint           parser_id)
+{
+  IdeBuildResultPrivate *priv = ide_build_result_get_instance_private (self);
+  g_autoptr(GPtrArray) old_parsers = NULL;
+  GPtrArray *parsers = NULL;
+  gboolean found = FALSE;
+  guint i;
+
+  g_return_if_fail (IDE_IS_BUILD_RESULT (self));
+  g_return_if_fail (parser_id != 0);
+
+  g_mutex_lock (&priv->mutex);
+
+  if (priv->line_parsers != NULL)
+    {
+      parsers = g_ptr_array_new_with_free_func (line_parser_unref);
+
+      for (i = 0; i < priv->line_parsers->len; i++)
+        {
+          LineParser *lp = g_ptr_array_index (priv->line_parsers, i);
+
+          if (lp->id == parser_id)
+            found = TRUE;
+          else
+            g_ptr_array_add (parsers, line_parser_ref (lp));
+        }
+
+      if (parsers->len == 0)
+        g_clear_pointer (&parsers, g_ptr_array_unref);
+
+      old_parsers = priv->line_parsers;
+      priv->line_parsers = parsers;
+    }
+
+  g_mutex_unlock (&priv->mutex);
+
+  /* The last reference to the parser is dropped with old_parsers */
+  if (!found)
+    g_warning ("No such line parser %u", parser_id);
+}
@@ -37,6 +37,24 @@ typedef enum
   IDE_BUILD_RESULT_LOG_STDERR,
 } IdeBuildResultLog;
 
+/**
+ * IdeBuildResultLineParser:
+ * @self: An #IdeBuildResult
+ * @log: the stream the line was read from
+ * @line: the line without the trailing newline
+ * @user_data: closure data for the parser
+ *
+ * Parses a line of subprocess output. This is called from the thread reading
+ * the subprocess, and may be called concurrently for stdout and stderr, so it
+ * must not touch main thread state.
+ *
+ * Returns: (transfer full) (nullable): An #IdeDiagnostic or %NULL.
+ */
+typedef IdeDiagnostic *(*IdeBuildResultLineParser) (IdeBuildResult    *self,
+                                                    IdeBuildResultLog  log,
+                                                    const gchar       *line,
+                                                    gpointer           user_data);
+
 struct _IdeBuildResultClass
 {
   IdeObjectClass parent;
@@ -59,6 +77,12 @@ struct _IdeBuildResultClass
 
 GInputStream  *ide_build_result_get_stdout_stream (IdeBuildResult *result);
 GInputStream  *ide_build_result_get_stderr_stream (IdeBuildResult *result);
+gint64         ide_build_result_get_log_offset    (IdeBuildResult *self);
+gboolean       ide_build_result_read_log          (IdeBuildResult *self,
+                                                   IdeBuildResultLog log,
+                                                   guint64         offset,
+                                                   gsize           length,
+                                                   GString        *str);
 void           ide_build_result_log_subprocess    (IdeBuildResult *result,
                                                    IdeSubprocess  *subprocess);
 GTimeSpan      ide_build_result_get_running_time  (IdeBuildResult *self);
@@ -83,6 +107,12 @@ void           ide_build_result_log_stdout_literal(IdeBuildResult *result,
                                                    const gchar    *str);
 void           ide_build_result_log_stderr_literal(IdeBuildResult *result,
                                                    const gchar    *str);
+guint          ide_build_result_add_line_parser   (IdeBuildResult *self,
+                                                   IdeBuildResultLineParser parser,
+                                                   gpointer        user_data,
+                                                   GDestroyNotify  notify);
+void           ide_build_result_remove_line_parser(IdeBuildResult *self,
+                                                   guint           parser_id);
 
 G_END_DECLS
 
@@ -0,0 +1,1184 @@
+/* ide-compile-commands.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define G_LOG_DOMAIN "ide-compile-commands"
+
+#include <egg-counter.h>
+#include <string.h>
+
+#include "ide-context.h"
+#include "ide-debug.h"
+#include "ide-macros.h"
+
+#include "buildsystem/ide-compile-commands.h"
+#include "threading/ide-thread-pool.h"
+
+/**
+ * SECTION:ide-compile-commands
+ * @title: IdeCompileCommands
+ * @short_description: Compiler flags from a compile_commands.json database
+ *
+ * #IdeCompileCommands loads a compilation database, as written by meson,
+ * cmake and bear, and answers which flags are used to compile a file.
+ *
+ * The database is loaded once on the %IDE_THREAD_POOL_INDEXER thread pool
+ * using a streaming scanner over the mapped file, so no document tree is
+ * built even for very large databases. Directories and arguments are
+ * interned, and the commands are indexed by their normalized path so that
+ * ide_compile_commands_lookup() does not need to scan the database.
+ *
+ * The file is monitored for changes and reloaded in the background. The
+ * previous contents continue to answer lookups until the reload completes,
+ * at which point #IdeCompileCommands::changed is emitted.
+ */
+
+#define RELOAD_TIMEOUT_MSEC 1000
+
+typedef struct
+{
+  const gchar *directory;
+  const gchar *command;
+  guint        argv_begin;
+  guint        argc;
+} CompileCommand;
+
+typedef struct
+{
+  GStringChunk *strings;
+  GArray       *commands;
+  GPtrArray    *arguments;
+  GHashTable   *index;
+} Database;
+
+typedef struct
+{
+  const gchar *pos;
+  const gchar *end;
+  const gchar *begin;
+  GString     *str;
+} Scanner;
+
+struct _IdeCompileCommands
+{
+  IdeObject     parent_instance;
+
+  GFile        *file;
+  Database     *db;
+  GFileMonitor *monitor;
+  GPtrArray    *waiting;
+
+  guint         reload_source;
+
+  guint         loading : 1;
+  guint         needs_reload : 1;
+};
+
+enum {
+  PROP_0,
+  PROP_FILE,
+  N_PROPS
+};
+
+enum {
+  CHANGED,
+  N_SIGNALS
+};
+
+G_DEFINE_TYPE (IdeCompileCommands, ide_compile_commands, IDE_TYPE_OBJECT)
+
+EGG_DEFINE_COUNTER (n_commands, "IdeCompileCommands", "Commands", "Number of compile commands loaded.")
+
+static GParamSpec *properties [N_PROPS];
+static guint signals [N_SIGNALS];
+
+static void ide_compile_commands_start_load (IdeCompileCommands *self);
+
+static Database *
+database_new (void)
+{
+  Database *db;
+
+  db = g_slice_new0 (Database);
+  db->strings = g_string_chunk_new (64 * 1024);
+  db->commands = g_array_new (FALSE, FALSE, sizeof (CompileCommand));
+  db->arguments = g_ptr_array_new ();
+  db->index = g_hash_table_new (g_str_hash, g_str_equal);
+
+  return db;
+}
+
+static void
+database_free (Database *db)
+{
+  if (db != NULL)
+    {
+      EGG_COUNTER_SUB (n_commands, db->commands->len);
+
+      g_clear_pointer (&db->index, g_hash_table_unref);
+      g_clear_pointer (&db->arguments, g_ptr_array_unref);
+      g_clear_pointer (&db->commands, g_array_unref);
+      g_clear_pointer (&db->strings, g_string_chunk_free);
+      g_slice_free (Database, db);
+    }
+}
+
+/*
+ * Joins @file to @directory unless it is absolute, and removes "." and
+ * ".." elements and duplicate separators so that we get the same path as
+ * g_file_get_path() does for the file.
+ */
+static gchar *
+normalize_path (const gchar *directory,
+                const gchar *file)
+{
+  g_autofree gchar *joined = NULL;
+  g_auto(GStrv) parts = NULL;
+  GString *str;
+  guint n_kept = 0;
+  guint i;
+
+  if (g_path_is_absolute (file) || directory == NULL)
+    joined = g_strdup (file);
+  else
+    joined = g_build_filename (directory, file, NULL);
+
+  parts = g_strsplit (joined, G_DIR_SEPARATOR_S, 0);
+
+  for (i = 0; parts [i] != NULL; i++)
+    {
+      if (parts [i][0] == '\0' || g_str_equal (parts [i], "."))
+        continue;
+
+      if (g_str_equal (parts [i], ".."))
+        {
+          if (n_kept > 0)
+            n_kept--;
+          continue;
+        }
+
+      /* Compact the kept elements at the front of the array */
+      if (n_kept != i)
+        {
+          gchar *tmp = parts [n_kept];
+          parts [n_kept] = parts [i];
+          parts [i] = tmp;
+        }
+
+      n_kept++;
+    }
+
+  str = g_string_new (NULL);
+
+  for (i = 0; i < n_kept; i++)
+    {
+      g_string_append_c (str, G_DIR_SEPARATOR);
+      g_string_append (str, parts [i]);
+    }
+
+  if (str->len == 0)
+    g_string_append_c (str, G_DIR_SEPARATOR);
+
+  return g_string_free (str, FALSE);
+}
+
+static gboolean
+scanner_error (Scanner      *scanner,
+               GError      **error,
+               const gchar  *message)
+{
+  g_set_error (error,
+               G_IO_ERROR,
+               G_IO_ERROR_INVALID_DATA,
+               "Invalid compilation database at byte %"G_GSIZE_FORMAT": %s",
+               (gsize)(scanner->pos - scanner->begin),
+               message);
+  return FALSE;
+}
+
+static inline void
+scanner_skip_ws (Scanner *scanner)
+{
+  while (scanner->pos < scanner->end &&
+         (*scanner->pos == ' ' || *scanner->pos == '\n' ||
+          *scanner->pos == '\r' || *scanner->pos == '\t'))
+    scanner->pos++;
+}
+
+static inline gboolean
+scanner_peek (Scanner *scanner,
+              gchar    ch)
+{
+  scanner_skip_ws (scanner);
+  return scanner->pos < scanner->end && *scanner->pos == ch;
+}
+
+static inline gboolean
+scanner_expect (Scanner  *scanner,
+                gchar     ch,
+                GError  **error)
+{
+  if (!scanner_peek (scanner, ch))
+    {
+      gchar message[] = "expected ' '";
+
+      message [10] = ch;
+      return scanner_error (scanner, error, message);
+    }
+
+  scanner->pos++;
+
+  return TRUE;
+}
+
+static gboolean
+scanner_read_hex4 (Scanner  *scanner,
+                   gunichar *value,
+                   GError  **error)
+{
+  guint i;
+
+  *value = 0;
+
+  if (scanner->end - scanner->pos < 4)
+    return scanner_error (scanner, error, "truncated escape");
+
+  for (i = 0; i < 4; i++)
+    {
+      gint digit = g_ascii_xdigit_value (scanner->pos [i]);
+
+      if (digit < 0)
+        return scanner_error (scanner, error, "invalid escape");
+
+      *value = (*value << 4) | digit;
+    }
+
+  scanner->pos += 4;
+
+  return TRUE;
+}
+
+/*
+ * Reads a string into scanner->str. Runs without escapes are copied in
+ * a single append, which is the common case for paths and flags.
+ */
+static gboolean
+scanner_read_string (Scanner  *scanner,
+                     GError  **error)
+{
+  if (!scanner_expect (scanner, '"', error))
+    return FALSE;
+
+  g_string_truncate (scanner->str, 0);
+
+  for (;;)
+    {
+      const gchar *run = scanner->pos;
+      gunichar ch;
+
+      while (scanner->pos < scanner->end && *scanner->pos != '"' && *scanner->pos != '\\')
+        scanner->pos++;
+
+      if (scanner->pos >= scanner->end)
+        return scanner_error (scanner, error, "unterminated string");
+
+      g_string_append_len (scanner->str, run, scanner->pos - run);
+
+      if (*scanner->pos == '"')
+        {
+          scanner->pos++;
+          return TRUE;
+        }
+
+      /* Skip the backslash */
+      if (++scanner->pos >= scanner->end)
+        return scanner_error (scanner, error, "unterminated string");
+
+      switch (*scanner->pos++)
+        {
+        case '"':  g_string_append_c (scanner->str, '"'); break;
+        case '\\': g_string_append_c (scanner->str, '\\'); break;
+        case '/':  g_string_append_c (scanner->str, '/'); break;
+        case 'b':  g_string_append_c (scanner->str, '\b'); break;
+        case 'f':  g_string_append_c (scanner->str, '\f'); break;
+        case 'n':  g_string_append_c (scanner->str, '\n'); break;
+        case 'r':  g_string_append_c (scanner->str, '\r'); break;
+        case 't':  g_string_append_c (scanner->str, '\t'); break;
+
+        case 'u':
+          if (!scanner_read_hex4 (scanner, &ch, error))
+            return FALSE;
+
+          /* Combine surrogate pairs */
+          if (ch >= 0xD800 && ch <= 0xDBFF &&
+              scanner->end - scanner->pos >= 6 &&
+              scanner->pos [0] == '\\' && scanner->pos [1] == 'u')
+            {
+              gunichar low;
+
+              scanner->pos += 2;
+              if (!scanner_read_hex4 (scanner, &low, error))
+                return FALSE;
+              ch = 0x10000 + ((ch - 0xD800) << 10) + (low - 0xDC00);
+            }
+
+          g_string_append_unichar (scanner->str, ch);
+          break;
+
+        default:
+          return scanner_error (scanner, error, "invalid escape");
+        }
+    }
+}
+
+static gboolean
+scanner_skip_value (Scanner  *scanner,
+                    guint     depth,
+                    GError  **error)
+{
+  if (depth > 64)
+    return scanner_error (scanner, error, "nested too deeply");
+
+  scanner_skip_ws (scanner);
+
+  if (scanner->pos >= scanner->end)
+    return scanner_error (scanner, error, "unexpected end of file");
+
+  switch (*scanner->pos)
+    {
+    case '"':
+      return scanner_read_string (scanner, error);
+
+    case '[':
+    case '{':
+      {
+        gboolean is_object = (*scanner->pos == '{');
+        gchar close = is_object ? '}' : ']';
+
+        scanner->pos++;
+
+        if (scanner_peek (scanner, close))
+          {
+            scanner->pos++;
+            return TRUE;
+          }
+
+        for (;;)
+          {
+            if (is_object)
+              {
+                if (!scanner_read_string (scanner, error) ||
+                    !scanner_expect (scanner, ':', error))
+                  return FALSE;
+              }
+
+            if (!scanner_skip_value (scanner, depth + 1, error))
+              return FALSE;
+
+            if (scanner_peek (scanner, ','))
+              {
+                scanner->pos++;
+                continue;
+              }
+
+            return scanner_expect (scanner, close, error);
+          }
+      }
+
+    default:
+      {
+        const gchar *begin = scanner->pos;
+
+        /* Numbers, true, false and null */
+        while (scanner->pos < scanner->end &&
+               (g_ascii_isalnum (*scanner->pos) || strchr ("+-.", *scanner->pos) != NULL))
+          scanner->pos++;
+
+        if (scanner->pos == begin)
+          return scanner_error (scanner, error, "unexpected character");
+
+        return TRUE;
+      }
+    }
+}
+
+static gboolean
+database_parse_command (Database  *db,
+                        Scanner   *scanner,
+                        GError   **error)
+{
+  g_autofree gchar *file = NULL;
+  const gchar *directory = NULL;
+  const gchar *command = NULL;
+  guint argv_begin = db->arguments->len;
+  guint argc = 0;
+
+  if (!scanner_expect (scanner, '{', error))
+    return FALSE;
+
+  if (scanner_peek (scanner, '}'))
+    {
+      scanner->pos++;
+      return TRUE;
+    }
+
+  for (;;)
+    {
+      enum { KEY_OTHER, KEY_DIRECTORY, KEY_FILE, KEY_COMMAND, KEY_ARGUMENTS } key = KEY_OTHER;
+
+      if (!scanner_read_string (scanner, error))
+        return FALSE;
+
+      if (g_str_equal (scanner->str->str, "directory"))
+        key = KEY_DIRECTORY;
+      else if (g_str_equal (scanner->str->str, "file"))
+        key = KEY_FILE;
+      else if (g_str_equal (scanner->str->str, "command"))
+        key = KEY_COMMAND;
+      else if (g_str_equal (scanner->str->str, "arguments"))
+        key = KEY_ARGUMENTS;
+
+      if (!scanner_expect (scanner, ':', error))
+        return FALSE;
+
+      if (key != KEY_OTHER && key != KEY_ARGUMENTS && scanner_peek (scanner, '"'))
+        {
+          if (!scanner_read_string (scanner, error))
+            return FALSE;
+
+          if (key == KEY_DIRECTORY)
+            directory = g_string_chunk_insert_const (db->strings, scanner->str->str);
+          else if (key == KEY_FILE)
+            {
+              g_free (file);
+              file = g_strndup (scanner->str->str, scanner->str->len);
+            }
+          else
+            command = g_string_chunk_insert_len (db->strings, scanner->str->str, scanner->str->len);
+        }
+      else if (key == KEY_ARGUMENTS && scanner_peek (scanner, '['))
+        {
+          /* Arguments repeat a lot between files, so intern them */
+          g_ptr_array_set_size (db->arguments, argv_begin);
+          argc = 0;
+
+          scanner->pos++;
+
+          if (scanner_peek (scanner, ']'))
+            scanner->pos++;
+          else
+            {
+              for (;;)
+                {
+                  if (!scanner_read_string (scanner, error))
+                    return FALSE;
+
+                  g_ptr_array_add (db->arguments,
+                                   g_string_chunk_insert_const (db->strings, scanner->str->str));
+                  argc++;
+
+                  if (scanner_peek (scanner, ','))
+                    {
+                      scanner->pos++;
+                      continue;
+                    }
+
+                  if (!scanner_expect (scanner, ']', error))
+                    return FALSE;
+
+                  break;
+                }
+            }
+        }
+      else if (!scanner_skip_value (scanner, 0, error))
+        return FALSE;
+
+      if (scanner_peek (scanner, ','))
+        {
+          scanner->pos++;
+          continue;
+        }
+
+      if (!scanner_expect (scanner, '}', error))
+        return FALSE;
+
+      break;
+    }
+
+  if (file != NULL && (command != NULL || argc > 0))
+    {
+      g_autofree gchar *path = normalize_path (directory, file);
+
+      /* Keep the first command if a file is compiled more than once */
+      if (!g_hash_table_contains (db->index, path))
+        {
+          CompileCommand cc;
+
+          cc.directory = directory;
+          cc.command = (argc > 0) ? NULL : command;
+          cc.argv_begin = argv_begin;
+          cc.argc = argc;
+
+          g_array_append_val (db->commands, cc);
+          g_hash_table_insert (db->index,
+                               g_string_chunk_insert (db->strings, path),
+                               GUINT_TO_POINTER (db->commands->len));
+
+          return TRUE;
+        }
+    }
+
+  /* Drop the arguments we interned for an unused entry */
+  g_ptr_array_set_size (db->arguments, argv_begin);
+
+  return TRUE;
+}
+
+static Database *
+database_parse (const gchar  *contents,
+                gsize         length,
+                GError      **error)
+{
+  Database *db;
+  Scanner scanner;
+
+  g_assert (contents != NULL || length == 0);
+
+  scanner.begin = contents;
+  scanner.pos = contents;
+  scanner.end = contents + length;
+  scanner.str = g_string_sized_new (4096);
+
+  db = database_new ();
+
+  if (!scanner_expect (&scanner, '[', error))
+    goto failure;
+
+  if (scanner_peek (&scanner, ']'))
+    goto success;
+
+  for (;;)
+    {
+      if (!database_parse_command (db, &scanner, error))
+        goto failure;
+
+      if (scanner_peek (&scanner, ','))
+        {
+          scanner.pos++;
+          continue;
+        }
+
+      if (!scanner_expect (&scanner, ']', error))
+        goto failure;
+
+      break;
+    }
+
+success:
+  g_string_free (scanner.str, TRUE);
+
+  EGG_COUNTER_ADD (n_commands, db->commands->len);
+
+  return db;
+
+failure:
+  g_string_free (scanner.str, TRUE);
+  database_free (db);
+
+  return NULL;
+}
+
+static void
+ide_compile_commands_load_worker (GTask        *task,
+                                  gpointer      source_object,
+                                  gpointer      task_data,
+                                  GCancellable *cancellable)
+{
+  GFile *file = task_data;
+  g_autoptr(GMappedFile) mapped = NULL;
+  g_autofree gchar *path = NULL;
+  GError *error = NULL;
+  Database *db;
+
+  IDE_ENTRY;
+
+  g_assert (G_IS_TASK (task));
+  g_assert (G_IS_FILE (file));
+
+  if (!(path = g_file_get_path (file)))
+    {
+      g_task_return_new_error (task,
+                               G_IO_ERROR,
+                               G_IO_ERROR_NOT_SUPPORTED,
+                               "Only local compilation databases are supported");
+      IDE_EXIT;
+    }
+
+  if (!(mapped = g_mapped_file_new (path, FALSE, &error)))
+    {
+      g_task_return_error (task, error);
+      IDE_EXIT;
+    }
+
+  if (!(db = database_parse (g_mapped_file_get_contents (mapped),
+                             g_mapped_file_get_length (mapped),
+                             &error)))
+    {
+      g_task_return_error (task, error);
+      IDE_EXIT;
+    }
+
+  IDE_TRACE_MSG ("Loaded %u compile commands from %s", db->commands->len, path);
+
+  g_task_return_pointer (task, db, (GDestroyNotify)database_free);
+
+  IDE_EXIT;
+}
+
+static gboolean
+ide_compile_commands_reload_timeout (gpointer data)
+{
+  IdeCompileCommands *self = data;
+
+  g_assert (IDE_IS_COMPILE_COMMANDS (self));
+
+  self->reload_source = 0;
+
+  if (!self->loading)
+    ide_compile_commands_start_load (self);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+ide_compile_commands_file_changed (IdeCompileCommands *self,
+                                   GFile              *file,
+                                   GFile              *other_file,
+                                   GFileMonitorEvent   event,
+                                   GFileMonitor       *monitor)
+{
+  g_assert (IDE_IS_COMPILE_COMMANDS (self));
+  g_assert (G_IS_FILE_MONITOR (monitor));
+
+  switch (event)
+    {
+    case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
+    case G_FILE_MONITOR_EVENT_CREATED:
+    case G_FILE_MONITOR_EVENT_DELETED:
+    case G_FILE_MONITOR_EVENT_MOVED_IN:
+    case G_FILE_MONITOR_EVENT_RENAMED:
+      /*
+       * Build systems rewrite the database in several steps, so wait for
+       * things to settle before we reload it.
+       */
+      self->needs_reload = TRUE;
+      ide_clear_source (&self->reload_source);
+      self->reload_source = g_timeout_add (RELOAD_TIMEOUT_MSEC,
+                                           ide_compile_commands_reload_timeout,
+                                           self);
+      break;
+
+    case G_FILE_MONITOR_EVENT_CHANGED:
+    case G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED:
+    case G_FILE_MONITOR_EVENT_PRE_UNMOUNT:
+    case G_FILE_MONITOR_EVENT_UNMOUNTED:
+    case G_FILE_MONITOR_EVENT_MOVED:
+    case G_FILE_MONITOR_EVENT_MOVED_OUT:
+    default:
+      break;
+    }
+}
+
+static void
+ide_compile_commands_ensure_monitor (IdeCompileCommands *self)
+{
+  g_autoptr(GError) error = NULL;
+
+  g_assert (IDE_IS_COMPILE_COMMANDS (self));
+
+  if (self->monitor != NULL)
+    return;
+
+  self->monitor = g_file_monitor_file (self->file,
+                                       G_FILE_MONITOR_WATCH_MOVES,
+                                       NULL,
+                                       &error);
+
+  if (self->monitor == NULL)
+    {
+      g_warning ("Failed to monitor compilation database: %s", error->message);
+      return;
+    }
+
+  g_signal_connect_object (self->monitor,
+                           "changed",
+                           G_CALLBACK (ide_compile_commands_file_changed),
+                           self,
+                           G_CONNECT_SWAPPED);
+}
+
+static void
+ide_compile_commands_load_cb (GObject      *object,
+                              GAsyncResult *result,
+                              gpointer      user_data)
+{
+  IdeCompileCommands *self = (IdeCompileCommands *)object;
+  g_autoptr(GPtrArray) waiting = NULL;
+  g_autoptr(GError) error = NULL;
+  gboolean had_db;
+  Database *db;
+  guint i;
+
+  IDE_ENTRY;
+
+  g_assert (IDE_IS_COMPILE_COMMANDS (self));
+  g_assert (G_IS_TASK (result));
+
+  self->loading = FALSE;
+
+  waiting = self->waiting;
+  self->waiting = g_ptr_array_new_with_free_func (g_object_unref);
+
+  had_db = (self->db != NULL);
+  db = g_task_propagate_pointer (G_TASK (result), &error);
+
+  ide_compile_commands_ensure_monitor (self);
+
+  if (db != NULL)
+    {
+      g_clear_pointer (&self->db, database_free);
+      self->db = db;
+    }
+  else if (had_db)
+    {
+      /* Keep answering with what we had, the file is likely being written */
+      g_warning ("Failed to reload compilation database: %s", error->message);
+    }
+
+  for (i = 0; i < waiting->len; i++)
+    {
+      GTask *task = g_ptr_array_index (waiting, i);
+
+      if (self->db != NULL)
+        g_task_return_boolean (task, TRUE);
+      else
+        g_task_return_error (task, g_error_copy (error));
+    }
+
+  if (db != NULL && had_db)
+    g_signal_emit (self, signals [CHANGED], 0);
+
+  /* The file changed again while we were loading it */
+  if (self->needs_reload && self->reload_source == 0)
+    ide_compile_commands_start_load (self);
+
+  IDE_EXIT;
+}
+
+static void
+ide_compile_commands_start_load (IdeCompileCommands *self)
+{
+  g_autoptr(GTask) task = NULL;
+
+  g_assert (IDE_IS_COMPILE_COMMANDS (self));
+  g_assert (!self->loading);
+
+  self->loading = TRUE;
+  self->needs_reload = FALSE;
+
+  task = g_task_new (self, NULL, ide_compile_commands_load_cb, NULL);
+  g_task_set_source_tag (task, ide_compile_commands_start_load);
+  g_task_set_task_data (task, g_object_ref (self->file), g_object_unref);
+
+  ide_thread_pool_push_task (IDE_THREAD_POOL_INDEXER, task, ide_compile_commands_load_worker);
+}
+
+/**
+ * ide_compile_commands_load_async:
+ *
+ * Loads the compilation database if it has not been loaded yet or has
+ * changed since it was loaded. Call this before
+ * ide_compile_commands_lookup(); it completes immediately when the
+ * database is up to date.
+ */
+void
+ide_compile_commands_load_async (IdeCompileCommands  *self,
+                                 GCancellable        *cancellable,
+                                 GAsyncReadyCallback  callback,
+                                 gpointer             user_data)
+{
+  g_autoptr(GTask) task = NULL;
+
+  IDE_ENTRY;
+
+  g_return_if_fail (IDE_IS_COMPILE_COMMANDS (self));
+  g_return_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable));
+
+  task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_source_tag (task, ide_compile_commands_load_async);
+
+  /*
+   * If a reload is pending, the current database is still good enough
+   * to answer with rather than waiting for the build system to settle.
+   */
+  if (self->db != NULL && (!self->needs_reload || self->reload_source != 0))
+    {
+      g_task_return_boolean (task, TRUE);
+      IDE_EXIT;
+    }
+
+  g_ptr_array_add (self->waiting, g_steal_pointer (&task));
+
+  if (!self->loading)
+    ide_compile_commands_start_load (self);
+
+  IDE_EXIT;
+}
+
+gboolean
+ide_compile_commands_load_finish (IdeCompileCommands  *self,
+                                  GAsyncResult        *result,
+                                  GError             **error)
+{
+  g_return_val_if_fail (IDE_IS_COMPILE_COMMANDS (self), FALSE);
+  g_return_val_if_fail (G_IS_TASK (result), FALSE);
+
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
+
+static void
+add_path_flag (GPtrArray   *ret,
+               const gchar *flag,
+               const gchar *path,
+               const gchar *directory)
+{
+  if (directory != NULL && !g_path_is_absolute (path))
+    {
+      g_autofree gchar *adjusted = normalize_path (directory, path);
+      g_ptr_array_add (ret, g_strconcat (flag, adjusted, NULL));
+    }
+  else
+    g_ptr_array_add (ret, g_strconcat (flag, path, NULL));
+}
+
+/*
+ * Keeps the flags that affect how a file is parsed, which is what the
+ * build system is expected to provide to IdeBuildSystem::get_build_flags.
+ * Include paths are made absolute since the command was run from
+ * @directory and not necessarily from where the flags will be used.
+ */
+static gchar **
+filter_flags (const gchar  *directory,
+              const gchar **argv,
+              guint         argc)
+{
+  static const gchar *path_flags[] = { "-I", "-isystem", "-iquote", "-idirafter", "-include" };
+  GPtrArray *ret;
+  guint i;
+
+  ret = g_ptr_array_new ();
+
+  /* Skip the compiler */
+  for (i = 1; i < argc; i++)
+    {
+      const gchar *flag = argv [i];
+      const gchar *next = (i + 1 < argc) ? argv [i + 1] : NULL;
+      gboolean handled = FALSE;
+      guint j;
+
+      if (flag [0] != '-' || flag [1] == '\0')
+        continue;
+
+      for (j = 0; j < G_N_ELEMENTS (path_flags); j++)
+        {
+          if (g_str_has_prefix (flag, path_flags [j]))
+            {
+              const gchar *path = flag + strlen (path_flags [j]);
+
+              handled = TRUE;
+
+              if (*path == '\0' && next != NULL)
+                {
+                  /* -I foo is normalized to -Ifoo, the others keep their argument */
+                  if (j == 0)
+                    add_path_flag (ret, flag, next, directory);
+                  else
+                    {
+                      g_ptr_array_add (ret, g_strdup (flag));
+                      add_path_flag (ret, "", next, directory);
+                    }
+                  i++;
+                }
+              else if (*path != '\0')
+                add_path_flag (ret, path_flags [j], path, directory);
+
+              break;
+            }
+        }
+
+      if (handled)
+        continue;
+
+      switch (flag [1])
+        {
+        case 'D': /* -Dfoo -D foo */
+        case 'U':
+        case 'x': /* -xc++ -x c++ */
+          g_ptr_array_add (ret, g_strdup (flag));
+          if (flag [2] == '\0' && next != NULL)
+            {
+              g_ptr_array_add (ret, g_strdup (next));
+              i++;
+            }
+          break;
+
+        case 'W': /* -Werror, but not -Wl,foo */
+          if (flag [2] != '\0' && flag [3] != ',')
+            g_ptr_array_add (ret, g_strdup (flag));
+          break;
+
+        case 'f': /* -fPIC... */
+        case 'm': /* -m64 -mtune=native */
+          g_ptr_array_add (ret, g_strdup (flag));
+          break;
+
+        default:
+          if (g_str_has_prefix (flag, "-std=") || g_str_equal (flag, "-pthread"))
+            g_ptr_array_add (ret, g_strdup (flag));
+          break;
+        }
+    }
+
+  g_ptr_array_add (ret, NULL);
+
+  return (gchar **)g_ptr_array_free (ret, FALSE);
+}
+
+/**
+ * ide_compile_commands_lookup:
+ * @self: An #IdeCompileCommands
+ * @file: the file to lookup
+ * @directory: (out) (optional) (transfer full): A location for the directory
+ *   the command was run from, or %NULL
+ * @error: A location for a #GError, or %NULL
+ *
+ * Looks up the compiler flags for @file that are needed to parse it, such as
+ * include paths, defines and warnings. Include paths are absolute.
+ *
+ * This does not perform I/O. The database must have been loaded using
+ * ide_compile_commands_load_async().
+ *
+ * Returns: (transfer full) (array zero-terminated=1): The flags, or %NULL
+ *   and @error is set if the file is not in the database.
+ */
+gchar **
+ide_compile_commands_lookup (IdeCompileCommands  *self,
+                             GFile               *file,
+                             GFile              **directory,
+                             GError             **error)
+{
+  g_autofree gchar *path = NULL;
+  const CompileCommand *cc;
+  g_auto(GStrv) parsed = NULL;
+  const gchar **argv;
+  gint argc = 0;
+  gchar **ret;
+  guint pos;
+
+  IDE_ENTRY;
+
+  g_return_val_if_fail (IDE_IS_COMPILE_COMMANDS (self), NULL);
+  g_return_val_if_fail (G_IS_FILE (file), NULL);
+
+  if (directory != NULL)
+    *directory = NULL;
+
+  if (self->db == NULL)
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_NOT_INITIALIZED,
+                   "The compilation database has not been loaded");
+      IDE_RETURN (NULL);
+    }
+
+  if (NULL == (path = g_file_get_path (file)) ||
+      0 == (pos = GPOINTER_TO_UINT (g_hash_table_lookup (self->db->index, path))))
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_NOT_FOUND,
+                   "No compile command was found for %s",
+                   path ?: "file");
+      IDE_RETURN (NULL);
+    }
+
+  cc = &g_array_index (self->db->commands, CompileCommand, pos - 1);
+
+  if (cc->command != NULL)
+    {
+      if (!g_shell_parse_argv (cc->command, &argc, &parsed, error))
+        IDE_RETURN (NULL);
+      argv = (const gchar **)parsed;
+    }
+  else
+    {
+      argv = (const gchar **)&g_ptr_array_index (self->db->arguments, cc->argv_begin);
+      argc = cc->argc;
+    }
+
+  ret = filter_flags (cc->directory, argv, argc);
+
+  if (directory != NULL && cc->directory != NULL)
+    *directory = g_file_new_for_path (cc->directory);
+
+  IDE_RETURN (ret);
+}
+
+/**
+ * ide_compile_commands_get_size:
+ *
+ * Returns: The number of files in the loaded database.
+ */
+guint
+ide_compile_commands_get_size (IdeCompileCommands *self)
+{
+  g_return_val_if_fail (IDE_IS_COMPILE_COMMANDS (self), 0);
+
+  return self->db ? self->db->commands->len : 0;
+}
+
+/**
+ * ide_compile_commands_get_file:
+ *
+ * Returns: (transfer none): The compile_commands.json file.
+ */
+GFile *
+ide_compile_commands_get_file (IdeCompileCommands *self)
+{
+  g_return_val_if_fail (IDE_IS_COMPILE_COMMANDS (self), NULL);
+
+  return self->file;
+}
+
+IdeCompileCommands *
+ide_compile_commands_new (IdeContext *context,
+                          GFile      *file)
+{
+  g_return_val_if_fail (!context || IDE_IS_CONTEXT (context), NULL);
+  g_return_val_if_fail (G_IS_FILE (file), NULL);
+
+  return g_object_new (IDE_TYPE_COMPILE_COMMANDS,
+                       "context", context,
+                       "file", file,
+                       NULL);
+}
+
+static void
+ide_compile_commands_finalize (GObject *object)
+{
+  IdeCompileCommands *self = (IdeCompileCommands *)object;
+
+  ide_clear_source (&self->reload_source);
+
+  if (self->monitor != NULL)
+    g_file_monitor_cancel (self->monitor);
+
+  g_clear_object (&self->monitor);
+  g_clear_object (&self->file);
+  g_clear_pointer (&self->db, database_free);
+  g_clear_pointer (&self->waiting, g_ptr_array_unref);
+
+  G_OBJECT_CLASS (ide_compile_commands_parent_class)->finalize (object);
+}
+
+static void
+ide_compile_commands_get_property (GObject    *object,
+                                   guint       prop_id,
+                                   GValue     *value,
+                                   GParamSpec *pspec)
+{
+  IdeCompileCommands *self = IDE_COMPILE_COMMANDS (object);
+
+  switch (prop_id)
+    {
+    case PROP_FILE:
+      g_value_set_object (value, self->file);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+    }
+}
+
+static void
+ide_compile_commands_set_property (GObject      *object,
+                                   guint         prop_id,
+                                   const GValue *value,
+                                   GParamSpec   *pspec)
+{
+  IdeCompileCommands *self = IDE_COMPILE_COMMANDS (object);
+
+  switch (prop_id)
+    {
+    case PROP_FILE:
+      self->file = g_value_dup_object (value);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+    }
+}
+
+static void
+ide_compile_commands_class_init (IdeCompileCommandsClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = ide_compile_commands_finalize;
+  object_class->get_property = ide_compile_commands_get_property;
+  object_class->set_property = ide_compile_commands_set_property;
+
+  properties [PROP_FILE] =
+    g_param_spec_object ("file",
+                         "File",
+                         "The compile_commands.json file",
+                         G_TYPE_FILE,
+                         (G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_properties (object_class, N_PROPS, properties);
+
+  /**
+   * IdeCompileCommands::changed:
+   *
+   * The "changed" signal is emitted after the database has been reloaded
+   * because the file changed on disk. Flags that were looked up before
+   * may be out of date.
+   */
+  signals [CHANGED] =
+    g_signal_new ("changed",
+                  G_TYPE_FROM_CLASS (klass),
+                  G_SIGNAL_RUN_LAST,
+                  0, NULL, NULL, NULL,
+                  G_TYPE_NONE, 0);
+}
+
+static void
+ide_compile_commands_init (IdeCompileCommands *self)
+{
+  self->waiting = g_ptr_array_new_with_free_func (g_object_unref);
+}
@@ -18,10 +18,12 @@
 
 #define G_LOG_DOMAIN "ide-diagnostics-manager"
 
+#include <egg-counter.h>
 #include <gtksourceview/gtksource.h>
 
 #include "ide-context.h"
 #include "ide-debug.h"
+#include "ide-internal.h"
 #include "ide-macros.h"
 
 #include "buffers/ide-buffer.h"
@@ -31,6 +33,59 @@
 #include "diagnostics/ide-diagnostics.h"
 #include "diagnostics/ide-diagnostics-manager.h"
 #include "plugins/ide-extension-set-adapter.h"
+#include "threading/ide-thread-pool.h"
+#include "util/ide-battery-monitor.h"
+#include "util/ide-timeline.h"
+
+/*
+ * The maximum number of diagnoses a single provider implementation (such as
+ * the clang provider) may have in flight at once for buffers that are not
+ * focused. The focused buffer has a slightly higher limit so that the file
+ * the user is looking at never waits behind background work, while still
+ * bounding how much cancelled-but-running work can pile up when switching
+ * between files quickly.
+ */
+#define MAX_IN_FLIGHT_PER_PROVIDER       2
+#define MAX_IN_FLIGHT_PER_PROVIDER_FOCUS (MAX_IN_FLIGHT_PER_PROVIDER + 1)
+
+/*
+ * Rather than using a fixed delay after the buffer changes before we
+ * re-diagnose, we track how long each provider takes for the file and use
+ * that to decide how long to wait. Fast providers (such as those checking
+ * Python) get quick feedback while slow providers (such as clang on a heavy
+ * translation unit) are not asked to do work faster than they can complete.
+ */
+#define DEFAULT_DIAGNOSE_TIMEOUT_MSEC          333
+#define DEFAULT_DIAGNOSE_CONSERVE_TIMEOUT_MSEC 5000
+#define MIN_DIAGNOSE_TIMEOUT_MSEC              50
+#define MAX_DIAGNOSE_TIMEOUT_MSEC              DEFAULT_DIAGNOSE_CONSERVE_TIMEOUT_MSEC
+#define LATENCY_EWMA_SHIFT                     2
+
+typedef enum
+{
+  DIAGNOSE_PRIORITY_FOCUS,
+  DIAGNOSE_PRIORITY_VISIBLE,
+  DIAGNOSE_PRIORITY_BACKGROUND,
+} DiagnosePriority;
+
+typedef struct
+{
+  IdeDiagnosticsManager *self;
+  guint                  limit;
+  gboolean               available;
+} CheckSlots;
+
+EGG_DEFINE_COUNTER (QueueDepth, "Diagnostics", "Queue Depth", "Number of files waiting to be diagnosed.")
+EGG_DEFINE_COUNTER (InFlight, "Diagnostics", "In Flight", "Number of diagnose requests currently executing.")
+EGG_DEFINE_COUNTER (Completed, "Diagnostics", "Completed", "Total number of diagnose requests completed.")
+EGG_DEFINE_COUNTER (Cancelled, "Diagnostics", "Cancelled", "Total number of diagnose requests superseded by buffer changes.")
+EGG_DEFINE_COUNTER (TotalLatency, "Diagnostics", "Total Latency", "Total time spent in diagnose requests, in microseconds.")
+
+/*
+ * Latency histograms (in microseconds) are registered in the counter arena
+ * per provider type so that they can be viewed with ide-list-counters.
+ */
+static GHashTable *histograms_by_type;
 
 typedef struct
 {
@@ -66,6 +121,38 @@ typedef struct
    */
   GHashTable *diagnostics_by_provider;
 
+  /*
+   * The cancellable for the diagnosis currently in flight. If the buffer
+   * is changed while we are diagnosing, the results will be stale by the
+   * time they arrive so we cancel the request and start over once all of
+   * the providers have completed.
+   */
+  GCancellable *cancellable;
+
+  /*
+   * The IdeBuffer:change-count when the current diagnosis was dispatched.
+   * This is used to determine if an in-flight diagnosis was superseded.
+   */
+  gsize dispatched_change_count;
+
+  /*
+   * The monotonic time at which the current diagnosis was dispatched so
+   * that we can track latency of diagnose requests.
+   */
+  gint64 dispatched_at;
+
+  /*
+   * If the buffer has changed and we are waiting for the adaptive debounce
+   * interval to elapse before queuing a diagnosis, this is set.
+   */
+  guint debounce_source;
+
+  /*
+   * The priority calculated for the group during the last scheduling pass.
+   * Only valid while inside ide_diagnostics_manager_begin_diagnose().
+   */
+  DiagnosePriority priority;
+
   /*
    * This extension set adapter is used to update the providers that are
    * available based on the buffers current language. They may change
@@ -109,6 +196,12 @@ typedef struct
    */
   guint was_removed : 1;
 
+  /*
+   * This bit is set once the first diagnosis of the group has completed
+   * so that it can be recorded in the startup timeline.
+   */
+  guint completed_first_diagnose : 1;
+
 } IdeDiagnosticsGroup;
 
 struct _IdeDiagnosticsManager
@@ -128,6 +221,30 @@ struct _IdeDiagnosticsManager
    * we can coalesce the dispatch of everything at the same time.
    */
   guint queued_diagnose_source;
+
+  /*
+   * The number of diagnose requests in flight, keyed by the GType of the
+   * provider implementation. This lets us limit how many parses a single
+   * provider (such as clang) is asked to perform at once.
+   */
+  GHashTable *in_flight_by_type;
+
+  /*
+   * This hash table uses the GFile as the key and a hash table as the
+   * value. The inner hash table uses the provider GType as the key and a
+   * pointer to a gint64 containing a moving average of how long, in
+   * microseconds, that provider takes to diagnose the file. Entries are
+   * only kept while the file is open in a buffer, so the table does not
+   * grow with every file diagnosed during the session.
+   */
+  GHashTable *latency_by_file;
+
+  /*
+   * The queue depth we last reported to the QueueDepth counter. Counters
+   * are shared between all of the managers in the process, so we only
+   * publish the delta from our previous value.
+   */
+  guint queue_depth;
 };
 
 enum {
@@ -150,6 +267,11 @@ static void     ide_diagnostics_manager_add_diagnostic    (IdeDiagnosticsManager
                                                            IdeDiagnostic         *diagnostic);
 static void     ide_diagnostics_group_queue_diagnose      (IdeDiagnosticsGroup   *group,
                                                            IdeDiagnosticsManager *self);
+static void     ide_diagnostics_manager_queue_begin       (IdeDiagnosticsManager *self);
+static void     ide_diagnostics_manager_acquire_slot      (IdeDiagnosticsManager *self,
+                                                           IdeDiagnosticProvider *provider);
+static void     ide_diagnostics_manager_release_slot      (IdeDiagnosticsManager *self,
+                                                           IdeDiagnosticProvider *provider);
 
 
 static GParamSpec *properties [N_PROPS];
@@ -178,6 +300,7 @@ ide_diagnostics_group_free (gpointer data)
   g_assert (group->ref_count == 0);
 
   g_clear_pointer (&group->diagnostics_by_provider, g_hash_table_unref);
+  g_clear_object (&group->cancellable);
   g_weak_ref_clear (&group->buffer_wr);
   g_clear_object (&group->adapter);
   g_clear_object (&group->file);
@@ -295,6 +418,142 @@ ide_diagnostics_group_add (IdeDiagnosticsGroup   *group,
   group->sequence++;
 }
 
+static EggHistogram *
+latency_histogram_get_for_type (GType type)
+{
+  EggHistogram *histogram;
+
+  if (histograms_by_type == NULL)
+    histograms_by_type = g_hash_table_new (NULL, NULL);
+
+  histogram = g_hash_table_lookup (histograms_by_type, GSIZE_TO_POINTER (type));
+
+  if (histogram == NULL)
+    {
+      const gchar *type_name = g_type_name (type);
+      gsize len = strlen (type_name);
+
+      /*
+       * Counters cannot be unregistered from the arena, so the histogram
+       * lives for the rest of the process. There are only ever a handful
+       * of diagnostic provider implementations.
+       */
+      if (g_str_has_suffix (type_name, "DiagnosticProvider"))
+        len -= strlen ("DiagnosticProvider");
+
+      histogram = g_new0 (EggHistogram, 1);
+      histogram->category = "Diagnostics";
+      histogram->name = g_strdup_printf ("%.*s Latency", (gint)len, type_name);
+      histogram->description = g_strdup_printf ("Time taken by %s to diagnose a file", type_name);
+
+      egg_counter_arena_register_histogram (egg_counter_arena_get_default (), histogram);
+
+      g_hash_table_insert (histograms_by_type, GSIZE_TO_POINTER (type), histogram);
+    }
+
+  return histogram;
+}
+
+static void
+ide_diagnostics_group_record_latency (IdeDiagnosticsGroup   *group,
+                                      IdeDiagnosticsManager *self,
+                                      IdeDiagnosticProvider *provider,
+                                      gint64                 latency)
+{
+  g_autoptr(IdeBuffer) buffer = NULL;
+  GType type = G_OBJECT_TYPE (provider);
+  GHashTable *latency_by_type;
+  gint64 *average;
+
+  g_assert (group != NULL);
+  g_assert (IDE_IS_DIAGNOSTICS_MANAGER (self));
+  g_assert (IDE_IS_DIAGNOSTIC_PROVIDER (provider));
+
+  if (latency < 0)
+    latency = 0;
+
+  /*
+   * Counters cannot be removed from the arena, so the histograms are only
+   * kept per provider. The moving average we adapt to is per file too.
+   */
+  egg_histogram_record (latency_histogram_get_for_type (type), latency);
+
+  /* The buffer was closed while this diagnosis was running */
+  if (NULL == (buffer = g_weak_ref_get (&group->buffer_wr)))
+    return;
+
+  latency_by_type = g_hash_table_lookup (self->latency_by_file, group->file);
+
+  if (latency_by_type == NULL)
+    {
+      latency_by_type = g_hash_table_new_full (NULL, NULL, NULL, g_free);
+      g_hash_table_insert (self->latency_by_file, g_object_ref (group->file), latency_by_type);
+    }
+
+  average = g_hash_table_lookup (latency_by_type, GSIZE_TO_POINTER (type));
+
+  if (average == NULL)
+    {
+      average = g_new (gint64, 1);
+      *average = latency;
+      g_hash_table_insert (latency_by_type, GSIZE_TO_POINTER (type), average);
+    }
+  else
+    {
+      *average += (latency - *average) >> LATENCY_EWMA_SHIFT;
+    }
+}
+
+static gint64
+ide_diagnostics_group_get_expected_latency (IdeDiagnosticsGroup   *group,
+                                            IdeDiagnosticsManager *self)
+{
+  GHashTable *latency_by_type;
+  GHashTableIter iter;
+  gpointer value;
+  gint64 expected = -1;
+
+  g_assert (group != NULL);
+  g_assert (IDE_IS_DIAGNOSTICS_MANAGER (self));
+
+  latency_by_type = g_hash_table_lookup (self->latency_by_file, group->file);
+
+  if (latency_by_type == NULL)
+    return -1;
+
+  /*
+   * All of the providers are dispatched together, so the diagnosis is not
+   * complete until the slowest of them has finished.
+   */
+
+  g_hash_table_iter_init (&iter, latency_by_type);
+
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    expected = MAX (expected, *(gint64 *)value);
+
+  return expected;
+}
+
+static guint
+ide_diagnostics_group_get_debounce_msec (IdeDiagnosticsGroup   *group,
+                                         IdeDiagnosticsManager *self)
+{
+  gint64 expected;
+
+  g_assert (group != NULL);
+  g_assert (IDE_IS_DIAGNOSTICS_MANAGER (self));
+
+  if (ide_battery_monitor_get_should_conserve () || ide_thread_pool_get_throttled ())
+    return DEFAULT_DIAGNOSE_CONSERVE_TIMEOUT_MSEC;
+
+  expected = ide_diagnostics_group_get_expected_latency (group, self);
+
+  if (expected < 0)
+    return DEFAULT_DIAGNOSE_TIMEOUT_MSEC;
+
+  return CLAMP (expected / 1000, MIN_DIAGNOSE_TIMEOUT_MSEC, MAX_DIAGNOSE_TIMEOUT_MSEC);
+}
+
 static void
 ide_diagnostics_group_diagnose_cb (GObject      *object,
                                    GAsyncResult *result,
@@ -305,7 +564,7 @@ ide_diagnostics_group_diagnose_cb (GObject      *object,
   g_autoptr(IdeDiagnostics) diagnostics = NULL;
   g_autoptr(GError) error = NULL;
   IdeDiagnosticsGroup *group;
-  gboolean changed;
+  gboolean changed = FALSE;
 
   IDE_ENTRY;
 
@@ -315,10 +574,9 @@ ide_diagnostics_group_diagnose_cb (GObject      *object,
 
   IDE_TRACE_MSG ("%s diagnosis completed", G_OBJECT_TYPE_NAME (provider));
 
-  diagnostics = ide_diagnostic_provider_diagnose_finish (provider, result, &error);
+  ide_diagnostics_manager_release_slot (self, provider);
 
-  if (error != NULL)
-    g_warning ("%s", error->message);
+  diagnostics = ide_diagnostic_provider_diagnose_finish (provider, result, &error);
 
   /*
    * This fetches the group our provider belongs to. Since the group is
@@ -328,6 +586,29 @@ ide_diagnostics_group_diagnose_cb (GObject      *object,
   group = g_object_get_data (G_OBJECT (provider), "IDE_DIAGNOSTICS_GROUP");
   g_assert (group != NULL);
 
+  EGG_COUNTER_INC (Completed);
+  EGG_COUNTER_ADD (TotalLatency, g_get_monotonic_time () - group->dispatched_at);
+
+  /*
+   * If the diagnosis was superseded by a change to the buffer, the results
+   * are stale. Keep the previous diagnostics around (which are likely closer
+   * to correct than nothing at all) until the next diagnosis completes.
+   *
+   * Cancelled requests are not representative of how long the provider
+   * takes, so they are not recorded in the latency histograms.
+   */
+  if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    {
+      IDE_TRACE_MSG ("%s diagnosis was superseded", G_OBJECT_TYPE_NAME (provider));
+      g_clear_pointer (&diagnostics, ide_diagnostics_unref);
+      goto complete;
+    }
+
+  ide_diagnostics_group_record_latency (group, self, provider, g_get_monotonic_time () - group->dispatched_at);
+
+  if (error != NULL)
+    g_warning ("%s", error->message);
+
   /*
    * Clear all of our old diagnostics no matter where they ended up.
    */
@@ -361,8 +642,20 @@ ide_diagnostics_group_diagnose_cb (GObject      *object,
         changed = TRUE;
     }
 
+complete:
   group->in_diagnose--;
 
+  if (group->in_diagnose == 0)
+    {
+      g_clear_object (&group->cancellable);
+
+      if (!group->completed_first_diagnose)
+        {
+          group->completed_first_diagnose = TRUE;
+          ide_timeline_end ("IdeDiagnostics", "first-diagnose", group->dispatched_at);
+        }
+    }
+
   /*
    * Ensure we increment our sequence number even when no diagnostics were
    * reported. This ensures that the gutter gets cleared and line-flags
@@ -395,10 +688,16 @@ ide_diagnostics_group_diagnose_cb (GObject      *object,
   else if (ide_diagnostics_group_can_dispose (group))
     {
       group->was_removed = TRUE;
+      g_hash_table_remove (self->latency_by_file, group->file);
       g_hash_table_remove (self->groups_by_file, group->file);
-      IDE_EXIT;
     }
 
+  /*
+   * We released a slot for this provider type, so other groups that were
+   * waiting on the per-provider limit may be able to make progress now.
+   */
+  ide_diagnostics_manager_queue_begin (self);
+
   IDE_EXIT;
 }
 
@@ -424,6 +723,8 @@ ide_diagnostics_group_diagnose_foreach (IdeExtensionSetAdapter *adapter,
   group = g_object_get_data (G_OBJECT (provider), "IDE_DIAGNOSTICS_GROUP");
   group->in_diagnose++;
 
+  ide_diagnostics_manager_acquire_slot (self, provider);
+
   context = ide_object_get_context (IDE_OBJECT (self));
 
   file = g_object_new (IDE_TYPE_FILE,
@@ -441,7 +742,7 @@ ide_diagnostics_group_diagnose_foreach (IdeExtensionSetAdapter *adapter,
 
   ide_diagnostic_provider_diagnose_async (provider,
                                           file,
-                                          NULL,
+                                          group->cancellable,
                                           ide_diagnostics_group_diagnose_cb,
                                           g_object_ref (self));
 }
@@ -461,6 +762,10 @@ ide_diagnostics_group_diagnose (IdeDiagnosticsGroup   *group,
 
   group->needs_diagnose = FALSE;
   group->has_diagnostics = FALSE;
+  group->dispatched_at = g_get_monotonic_time ();
+
+  g_clear_object (&group->cancellable);
+  group->cancellable = g_cancellable_new ();
 
   /*
    * We need to ensure that all the diagnostic providers have access to the
@@ -468,7 +773,10 @@ ide_diagnostics_group_diagnose (IdeDiagnosticsGroup   *group,
    * all providers from having to do this manually.
    */
   if (NULL != (buffer = g_weak_ref_get (&group->buffer_wr)))
-    ide_buffer_sync_to_unsaved_files (buffer);
+    {
+      group->dispatched_change_count = ide_buffer_get_change_count (buffer);
+      ide_buffer_sync_to_unsaved_files (buffer);
+    }
 
   ide_extension_set_adapter_foreach (group->adapter,
                                      ide_diagnostics_group_diagnose_foreach,
@@ -479,12 +787,140 @@ ide_diagnostics_group_diagnose (IdeDiagnosticsGroup   *group,
   IDE_EXIT;
 }
 
+static DiagnosePriority
+ide_diagnostics_group_get_priority (IdeDiagnosticsGroup *group,
+                                    IdeBuffer           *focus_buffer)
+{
+  g_autoptr(IdeBuffer) buffer = NULL;
+
+  g_assert (group != NULL);
+  g_assert (!focus_buffer || IDE_IS_BUFFER (focus_buffer));
+
+  buffer = g_weak_ref_get (&group->buffer_wr);
+
+  if (buffer == NULL)
+    return DIAGNOSE_PRIORITY_BACKGROUND;
+
+  if (buffer == focus_buffer)
+    return DIAGNOSE_PRIORITY_FOCUS;
+
+  /*
+   * A buffer is held by each view displaying it, so a held buffer is one
+   * that is (most likely) visible somewhere in the workbench.
+   */
+  if (_ide_buffer_get_held (buffer))
+    return DIAGNOSE_PRIORITY_VISIBLE;
+
+  return DIAGNOSE_PRIORITY_BACKGROUND;
+}
+
+static gint
+compare_by_priority (gconstpointer a,
+                     gconstpointer b)
+{
+  const IdeDiagnosticsGroup *group_a = *(const IdeDiagnosticsGroup **)a;
+  const IdeDiagnosticsGroup *group_b = *(const IdeDiagnosticsGroup **)b;
+
+  return (gint)group_a->priority - (gint)group_b->priority;
+}
+
+static void
+ide_diagnostics_manager_acquire_slot (IdeDiagnosticsManager *self,
+                                      IdeDiagnosticProvider *provider)
+{
+  gpointer key = GSIZE_TO_POINTER (G_OBJECT_TYPE (provider));
+  guint count;
+
+  g_assert (IDE_IS_DIAGNOSTICS_MANAGER (self));
+  g_assert (IDE_IS_DIAGNOSTIC_PROVIDER (provider));
+
+  count = GPOINTER_TO_UINT (g_hash_table_lookup (self->in_flight_by_type, key));
+  g_hash_table_insert (self->in_flight_by_type, key, GUINT_TO_POINTER (count + 1));
+
+  EGG_COUNTER_INC (InFlight);
+}
+
+static void
+ide_diagnostics_manager_release_slot (IdeDiagnosticsManager *self,
+                                      IdeDiagnosticProvider *provider)
+{
+  gpointer key = GSIZE_TO_POINTER (G_OBJECT_TYPE (provider));
+  guint count;
+
+  g_assert (IDE_IS_DIAGNOSTICS_MANAGER (self));
+  g_assert (IDE_IS_DIAGNOSTIC_PROVIDER (provider));
+
+  count = GPOINTER_TO_UINT (g_hash_table_lookup (self->in_flight_by_type, key));
+  g_return_if_fail (count > 0);
+
+  if (count == 1)
+    g_hash_table_remove (self->in_flight_by_type, key);
+  else
+    g_hash_table_insert (self->in_flight_by_type, key, GUINT_TO_POINTER (count - 1));
+
+  EGG_COUNTER_DEC (InFlight);
+}
+
+static void
+ide_diagnostics_group_check_slots_foreach (IdeExtensionSetAdapter *adapter,
+                                           PeasPluginInfo         *plugin_info,
+                                           PeasExtension          *exten,
+                                           gpointer                user_data)
+{
+  CheckSlots *state = user_data;
+  gpointer key = GSIZE_TO_POINTER (G_OBJECT_TYPE (exten));
+  guint count;
+
+  count = GPOINTER_TO_UINT (g_hash_table_lookup (state->self->in_flight_by_type, key));
+
+  if (count >= state->limit)
+    state->available = FALSE;
+}
+
+static gboolean
+ide_diagnostics_group_can_dispatch (IdeDiagnosticsGroup   *group,
+                                    IdeDiagnosticsManager *self)
+{
+  CheckSlots state = { self, MAX_IN_FLIGHT_PER_PROVIDER, TRUE };
+
+  g_assert (group != NULL);
+  g_assert (IDE_IS_DIAGNOSTICS_MANAGER (self));
+
+  /*
+   * The focused buffer may use a slot that background buffers cannot, so
+   * it is dispatched even when background work has saturated the provider.
+   */
+  if (group->priority == DIAGNOSE_PRIORITY_FOCUS)
+    state.limit = MAX_IN_FLIGHT_PER_PROVIDER_FOCUS;
+
+  ide_extension_set_adapter_foreach (group->adapter,
+                                     ide_diagnostics_group_check_slots_foreach,
+                                     &state);
+
+  return state.available;
+}
+
+static void
+ide_diagnostics_manager_set_queue_depth (IdeDiagnosticsManager *self,
+                                         guint                  queue_depth)
+{
+  g_assert (IDE_IS_DIAGNOSTICS_MANAGER (self));
+
+  EGG_COUNTER_ADD (QueueDepth, (gint64)queue_depth - (gint64)self->queue_depth);
+  self->queue_depth = queue_depth;
+}
+
 static gboolean
 ide_diagnostics_manager_begin_diagnose (gpointer data)
 {
   IdeDiagnosticsManager *self = data;
+  g_autoptr(GPtrArray) pending = NULL;
+  IdeBufferManager *buffer_manager;
+  IdeBuffer *focus_buffer;
+  IdeContext *context;
   GHashTableIter iter;
   gpointer value;
+  guint queue_depth = 0;
 
   IDE_ENTRY;
 
@@ -492,19 +928,63 @@ ide_diagnostics_manager_begin_diagnose (gpointer data)
 
   self->queued_diagnose_source = 0;
 
+  context = ide_object_get_context (IDE_OBJECT (self));
+  buffer_manager = ide_context_get_buffer_manager (context);
+  focus_buffer = ide_buffer_manager_get_focus_buffer (buffer_manager);
+
+  /*
+   * Collect all of the groups that are waiting on a diagnosis and order
+   * them so that the focused buffer is first, followed by buffers that
+   * are visible, followed by everything else.
+   */
+  pending = g_ptr_array_new_with_free_func ((GDestroyNotify)ide_diagnostics_group_unref);
+
   g_hash_table_iter_init (&iter, self->groups_by_file);
 
   while (g_hash_table_iter_next (&iter, NULL, &value))
     {
       IdeDiagnosticsGroup *group = value;
 
-      if (group->needs_diagnose && group->adapter != NULL)
+      if (group->needs_diagnose && group->adapter != NULL && group->in_diagnose == 0)
+        {
+          group->priority = ide_diagnostics_group_get_priority (group, focus_buffer);
+          g_ptr_array_add (pending, ide_diagnostics_group_ref (group));
+        }
+    }
+
+  g_ptr_array_sort (pending, compare_by_priority);
+
+  for (guint i = 0; i < pending->len; i++)
+    {
+      IdeDiagnosticsGroup *group = g_ptr_array_index (pending, i);
+
+      if (group->was_removed || group->adapter == NULL)
+        continue;
+
+      if (ide_diagnostics_group_can_dispatch (group, self))
         ide_diagnostics_group_diagnose (group, self);
+      else
+        queue_depth++;
     }
 
+  ide_diagnostics_manager_set_queue_depth (self, queue_depth);
+
   IDE_RETURN (G_SOURCE_REMOVE);
 }
 
+static void
+ide_diagnostics_manager_queue_begin (IdeDiagnosticsManager *self)
+{
+  g_assert (IDE_IS_DIAGNOSTICS_MANAGER (self));
+
+  if (self->queued_diagnose_source == 0)
+    self->queued_diagnose_source =
+      gdk_threads_add_idle_full (G_PRIORITY_DEFAULT,
+                                 ide_diagnostics_manager_begin_diagnose,
+                                 g_object_ref (self),
+                                 g_object_unref);
+}
+
 static void
 ide_diagnostics_group_queue_diagnose (IdeDiagnosticsGroup   *group,
                                       IdeDiagnosticsManager *self)
@@ -516,16 +996,41 @@ ide_diagnostics_group_queue_diagnose (IdeDiagnosticsGroup   *group,
    * If a diagnosis is already running, we don't need to do anything now
    * because the completion of the diagnose will tick off the next diagnose
    * upon seening group->needs_diagnose==TRUE.
+   *
+   * If the buffer has changed since the running diagnosis was dispatched,
+   * the results are already stale. Cancel the request so that providers
+   * which support cancellation can bail early and we get to the next
+   * diagnosis sooner.
    */
 
   group->needs_diagnose = TRUE;
 
-  if (group->in_diagnose == 0 && self->queued_diagnose_source == 0)
-    self->queued_diagnose_source =
-      gdk_threads_add_idle_full (G_PRIORITY_DEFAULT,
-                                 ide_diagnostics_manager_begin_diagnose,
-                                 g_object_ref (self),
-                                 g_object_unref);
+  if (group->in_diagnose > 0)
+    {
+      g_autoptr(IdeBuffer) buffer = g_weak_ref_get (&group->buffer_wr);
+
+      gint64 elapsed = g_get_monotonic_time () - group->dispatched_at;
+      gint64 expected = ide_diagnostics_group_get_expected_latency (group, self);
+
+      /*
+       * If the diagnosis is more than half way done, it is cheaper to let it
+       * complete and skip the intermediate sequences than to restart it. This
+       * keeps slow providers from being starved while the user is typing.
+       */
+      if (buffer != NULL &&
+          group->cancellable != NULL &&
+          !g_cancellable_is_cancelled (group->cancellable) &&
+          group->dispatched_change_count != ide_buffer_get_change_count (buffer) &&
+          (expected < 0 || elapsed < expected / 2))
+        {
+          EGG_COUNTER_INC (Cancelled);
+          g_cancellable_cancel (group->cancellable);
+        }
+
+      return;
+    }
+
+  ide_diagnostics_manager_queue_begin (self);
 }
 
 static void
@@ -534,7 +1039,10 @@ ide_diagnostics_manager_finalize (GObject *object)
   IdeDiagnosticsManager *self = (IdeDiagnosticsManager *)object;
 
   ide_clear_source (&self->queued_diagnose_source);
+  ide_diagnostics_manager_set_queue_depth (self, 0);
   g_clear_pointer (&self->groups_by_file, g_hash_table_unref);
+  g_clear_pointer (&self->in_flight_by_type, g_hash_table_unref);
+  g_clear_pointer (&self->latency_by_file, g_hash_table_unref);
 
   G_OBJECT_CLASS (ide_diagnostics_manager_parent_class)->finalize (object);
 }
@@ -596,6 +1104,11 @@ ide_diagnostics_manager_init (IdeDiagnosticsManager *self)
                                                 (GEqualFunc)g_file_equal,
                                                 NULL,
                                                 (GDestroyNotify)ide_diagnostics_group_unref);
+  self->in_flight_by_type = g_hash_table_new (NULL, NULL);
+  self->latency_by_file = g_hash_table_new_full (g_file_hash,
+                                                 (GEqualFunc)g_file_equal,
+                                                 g_object_unref,
+                                                 (GDestroyNotify)g_hash_table_unref);
 }
 
 static void
@@ -824,6 +1337,52 @@ ide_diagnostics_manager_extension_removed (IdeExtensionSetAdapter *adapter,
   IDE_EXIT;
 }
 
+typedef struct
+{
+  IdeDiagnosticsManager *self;
+  IdeDiagnosticsGroup   *group;
+} DebounceState;
+
+static DebounceState *
+debounce_state_new (IdeDiagnosticsManager *self,
+                    IdeDiagnosticsGroup   *group)
+{
+  DebounceState *state;
+
+  state = g_slice_new0 (DebounceState);
+  state->self = g_object_ref (self);
+  state->group = ide_diagnostics_group_ref (group);
+
+  return state;
+}
+
+static void
+debounce_state_free (gpointer data)
+{
+  DebounceState *state = data;
+
+  g_clear_object (&state->self);
+  g_clear_pointer (&state->group, ide_diagnostics_group_unref);
+  g_slice_free (DebounceState, state);
+}
+
+static gboolean
+ide_diagnostics_manager_debounce_cb (gpointer data)
+{
+  DebounceState *state = data;
+
+  g_assert (state != NULL);
+  g_assert (IDE_IS_DIAGNOSTICS_MANAGER (state->self));
+  g_assert (state->group != NULL);
+
+  state->group->debounce_source = 0;
+
+  if (!state->group->was_removed)
+    ide_diagnostics_group_queue_diagnose (state->group, state->self);
+
+  return G_SOURCE_REMOVE;
+}
+
 static void
 ide_diagnostics_manager_buffer_changed (IdeDiagnosticsManager *self,
                                         IdeBuffer             *buffer)
@@ -836,7 +1395,18 @@ ide_diagnostics_manager_buffer_changed (IdeDiagnosticsManager *self,
   g_assert (IDE_IS_BUFFER (buffer));
 
   group = ide_diagnostics_manager_find_group_from_buffer (self, buffer);
-  ide_diagnostics_group_queue_diagnose (group, self);
+
+  /*
+   * Restart the debounce timeout so that we only diagnose once the user
+   * has paused for roughly as long as the providers take to complete.
+   */
+  ide_clear_source (&group->debounce_source);
+  group->debounce_source =
+    g_timeout_add_full (G_PRIORITY_LOW,
+                        ide_diagnostics_group_get_debounce_msec (group, self),
+                        ide_diagnostics_manager_debounce_cb,
+                        debounce_state_new (self, group),
+                        debounce_state_free);
 
   IDE_EXIT;
 }
@@ -910,6 +1480,7 @@ ide_diagnostics_manager_buffer_notify_file (IdeDiagnosticsManager *self,
       if (buffer == group_buffer)
         {
           g_hash_table_steal (self->groups_by_file, group->file);
+          g_hash_table_remove (self->latency_by_file, group->file);
           g_set_object (&group->file, gfile);
           g_hash_table_insert (self->groups_by_file, group->file, group);
           IDE_EXIT;
@@ -1045,6 +1616,10 @@ ide_diagnostics_manager_buffer_unloaded (IdeDiagnosticsManager *self,
    */
   has_diagnostics = ide_diagnostics_group_has_diagnostics (group);
 
+  ide_clear_source (&group->debounce_source);
+
+  g_hash_table_remove (self->latency_by_file, group->file);
+
   /*
    * Force our diagnostic providers to unload. This will cause them
    * extension-removed signal to be called for each provider which
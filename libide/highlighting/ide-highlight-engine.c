@@ -18,6 +18,7 @@
 
 #define G_LOG_DOMAIN "ide-highlight-engine"
 
+#include <egg-counter.h>
 #include <egg-signal-group.h>
 #include <glib/gi18n.h>
 #include <string.h>
@@ -28,10 +29,16 @@
 
 #include "highlighting/ide-highlight-engine.h"
 #include "plugins/ide-extension-adapter.h"
+#include "util/ide-timeline.h"
 
 #define HIGHLIGHT_QUANTA_USEC 5000
 #define PRIVATE_TAG_PREFIX    "gb-private-tag"
 
+EGG_DEFINE_HISTOGRAM (TickLatency, "Highlighting", "Tick Latency",
+                      "Time spent in each highlighting tick, in microseconds.")
+EGG_DEFINE_COUNTER (PendingEngines, "Highlighting", "Pending Engines",
+                    "Number of highlight engines with queued work.")
+
 struct _IdeHighlightEngine
 {
   IdeObject            parent_instance;
@@ -51,9 +58,13 @@ struct _IdeHighlightEngine
 
   guint64              quanta_expiration;
 
+  /* When the first highlight pass was queued, for the timeline */
+  gint64               first_pass_begin;
+
   guint                work_timeout;
 
   guint                enabled : 1;
+  guint                completed_first_pass : 1;
 };
 
 G_DEFINE_TYPE (IdeHighlightEngine, ide_highlight_engine, IDE_TYPE_OBJECT)
@@ -302,6 +313,7 @@ ide_highlight_engine_tick (IdeHighlightEngine *self)
   GtkTextIter invalid_begin;
   GtkTextIter invalid_end;
   GSList *tags_iter;
+  EGG_HISTOGRAM_TIME_SCOPE (TickLatency);
 
   IDE_PROBE;
 
@@ -370,13 +382,33 @@ ide_highlight_engine_work_timeout_handler (gpointer data)
     {
       if (ide_highlight_engine_tick (self))
         return G_SOURCE_CONTINUE;
+
+      if (!self->completed_first_pass)
+        {
+          self->completed_first_pass = TRUE;
+          ide_timeline_end ("IdeHighlightEngine", "first-highlight", self->first_pass_begin);
+        }
     }
 
   self->work_timeout = 0;
+  EGG_COUNTER_DEC (PendingEngines);
 
   return G_SOURCE_REMOVE;
 }
 
+static void
+ide_highlight_engine_clear_work (IdeHighlightEngine *self)
+{
+  g_assert (IDE_IS_HIGHLIGHT_ENGINE (self));
+
+  if (self->work_timeout != 0)
+    {
+      g_source_remove (self->work_timeout);
+      self->work_timeout = 0;
+      EGG_COUNTER_DEC (PendingEngines);
+    }
+}
+
 static void
 ide_highlight_engine_queue_work (IdeHighlightEngine *self)
 {
@@ -385,10 +417,14 @@ ide_highlight_engine_queue_work (IdeHighlightEngine *self)
   if ((self->highlighter == NULL) || (self->buffer == NULL) || (self->work_timeout != 0))
     return;
 
+  if (!self->completed_first_pass && self->first_pass_begin == 0)
+    self->first_pass_begin = ide_timeline_begin ();
+
   self->work_timeout =  gdk_threads_add_idle_full (G_PRIORITY_LOW,
                                                    ide_highlight_engine_work_timeout_handler,
                                                    self,
                                                    NULL);
+  EGG_COUNTER_INC (PendingEngines);
 }
 
 static gboolean
@@ -446,11 +482,7 @@ ide_highlight_engine_reload (IdeHighlightEngine *self)
 
   g_assert (IDE_IS_HIGHLIGHT_ENGINE (self));
 
-  if (self->work_timeout != 0)
-    {
-      g_source_remove (self->work_timeout);
-      self->work_timeout = 0;
-    }
+  ide_highlight_engine_clear_work (self);
 
   if (self->buffer == NULL)
     IDE_EXIT;
@@ -665,11 +697,7 @@ ide_highlight_engine__unbind_buffer_cb (IdeHighlightEngine  *self,
 
   text_buffer = GTK_TEXT_BUFFER (self->buffer);
 
-  if (self->work_timeout)
-    {
-      g_source_remove (self->work_timeout);
-      self->work_timeout = 0;
-    }
+  ide_highlight_engine_clear_work (self);
 
   g_object_set_qdata (G_OBJECT (text_buffer), engineQuark, NULL);
 
@@ -18,6 +18,7 @@
 
 #define G_LOG_DOMAIN "ide-context"
 
+#include <egg-counter.h>
 #include <glib/gi18n.h>
 #include <libpeas/peas.h>
 
@@ -57,6 +58,21 @@
 
 #define RESTORE_FILES_MAX_FILES 20
 
+EGG_DEFINE_COUNTER (InitBuildSystem, "ContextInit", "Build System", "Time spent initializing the build system (usec).")
+EGG_DEFINE_COUNTER (InitVcs, "ContextInit", "VCS", "Time spent initializing the version control system (usec).")
+EGG_DEFINE_COUNTER (InitServices, "ContextInit", "Services", "Time spent starting services (usec).")
+EGG_DEFINE_COUNTER (InitProjectName, "ContextInit", "Project Name", "Time spent discovering the project name (usec).")
+EGG_DEFINE_COUNTER (InitBackForwardList, "ContextInit", "Back Forward List", "Time spent loading the back/forward list (usec).")
+EGG_DEFINE_COUNTER (InitSnippets, "ContextInit", "Snippets", "Time spent loading snippets (usec).")
+EGG_DEFINE_COUNTER (InitScripts, "ContextInit", "Scripts", "Time spent loading scripts (usec).")
+EGG_DEFINE_COUNTER (InitUnsavedFiles, "ContextInit", "Unsaved Files", "Time spent restoring unsaved file drafts (usec).")
+EGG_DEFINE_COUNTER (InitAddRecent, "ContextInit", "Recent Projects", "Time spent registering the recent project (usec).")
+EGG_DEFINE_COUNTER (InitSearchEngine, "ContextInit", "Search Engine", "Time spent creating the search engine (usec).")
+EGG_DEFINE_COUNTER (InitRuntimes, "ContextInit", "Runtimes", "Time spent initializing runtimes (usec).")
+EGG_DEFINE_COUNTER (InitConfigurationManager, "ContextInit", "Configuration Manager", "Time spent loading build configurations (usec).")
+EGG_DEFINE_COUNTER (InitDiagnosticsManager, "ContextInit", "Diagnostics Manager", "Time spent initializing the diagnostics manager (usec).")
+EGG_DEFINE_COUNTER (InitLoaded, "ContextInit", "Loaded", "Time spent in IdeContext::loaded handlers (usec).")
+
 struct _IdeContext
 {
   GObject                   parent_instance;
@@ -1560,6 +1576,103 @@ ide_context_init_loaded (gpointer             source_object,
   g_task_return_boolean (task, TRUE);
 }
 
+enum {
+  INIT_BUILD_SYSTEM,
+  INIT_VCS,
+  INIT_SERVICES,
+  INIT_PROJECT_NAME,
+  INIT_BACK_FORWARD_LIST,
+  INIT_SNIPPETS,
+  INIT_SCRIPTS,
+  INIT_UNSAVED_FILES,
+  INIT_ADD_RECENT,
+  INIT_SEARCH_ENGINE,
+  INIT_RUNTIMES,
+  INIT_CONFIGURATION_MANAGER,
+  INIT_DIAGNOSTICS_MANAGER,
+  INIT_LOADED,
+  N_INIT_STEPS
+};
+
+#define DEP(step) IDE_ASYNC_GRAPH_DEP(step)
+
+/*
+ * The steps required to initialize the context, along with the steps that
+ * must be completed before they can run. Steps without a dependency between
+ * them (such as loading snippets and restoring drafts) are run concurrently.
+ *
+ * The build system may change the project file, so most everything that
+ * needs to know about the location of the project must wait for it. Things
+ * that use the project name (which might come from the .doap) must wait for
+ * that to be discovered. That includes the runtimes and build configurations,
+ * whose providers may key their state off the project. The loaded step runs
+ * once every other step has completed.
+ */
+static const IdeAsyncGraphStep init_steps [N_INIT_STEPS] = {
+  [INIT_BUILD_SYSTEM] = {
+    "build-system", ide_context_init_build_system,
+    0,
+    &InitBuildSystem_ctr },
+  [INIT_VCS] = {
+    "vcs", ide_context_init_vcs,
+    DEP (INIT_BUILD_SYSTEM),
+    &InitVcs_ctr },
+  [INIT_SERVICES] = {
+    "services", ide_context_init_services,
+    DEP (INIT_BUILD_SYSTEM) | DEP (INIT_VCS),
+    &InitServices_ctr },
+  [INIT_PROJECT_NAME] = {
+    "project-name", ide_context_init_project_name,
+    DEP (INIT_BUILD_SYSTEM),
+    &InitProjectName_ctr },
+  [INIT_BACK_FORWARD_LIST] = {
+    "back-forward-list", ide_context_init_back_forward_list,
+    DEP (INIT_PROJECT_NAME),
+    &InitBackForwardList_ctr },
+  [INIT_SNIPPETS] = {
+    "snippets", ide_context_init_snippets,
+    0,
+    &InitSnippets_ctr },
+  [INIT_SCRIPTS] = {
+    "scripts", ide_context_init_scripts,
+    DEP (INIT_SERVICES),
+    &InitScripts_ctr },
+  [INIT_UNSAVED_FILES] = {
+    "unsaved-files", ide_context_init_unsaved_files,
+    DEP (INIT_PROJECT_NAME),
+    &InitUnsavedFiles_ctr },
+  [INIT_ADD_RECENT] = {
+    "add-recent", ide_context_init_add_recent,
+    DEP (INIT_PROJECT_NAME),
+    &InitAddRecent_ctr },
+  [INIT_SEARCH_ENGINE] = {
+    "search-engine", ide_context_init_search_engine,
+    DEP (INIT_SERVICES),
+    &InitSearchEngine_ctr },
+  [INIT_RUNTIMES] = {
+    "runtimes", ide_context_init_runtimes,
+    DEP (INIT_BUILD_SYSTEM) | DEP (INIT_VCS) | DEP (INIT_PROJECT_NAME),
+    &InitRuntimes_ctr },
+  [INIT_CONFIGURATION_MANAGER] = {
+    "configuration-manager", ide_context_init_configuration_manager,
+    DEP (INIT_PROJECT_NAME) | DEP (INIT_RUNTIMES),
+    &InitConfigurationManager_ctr },
+  [INIT_DIAGNOSTICS_MANAGER] = {
+    "diagnostics-manager", ide_context_init_diagnostics_manager,
+    DEP (INIT_SERVICES) | DEP (INIT_UNSAVED_FILES) | DEP (INIT_CONFIGURATION_MANAGER),
+    &InitDiagnosticsManager_ctr },
+  [INIT_LOADED] = {
+    "loaded", ide_context_init_loaded,
+    DEP (INIT_BUILD_SYSTEM) | DEP (INIT_VCS) | DEP (INIT_SERVICES) |
+    DEP (INIT_PROJECT_NAME) | DEP (INIT_BACK_FORWARD_LIST) | DEP (INIT_SNIPPETS) |
+    DEP (INIT_SCRIPTS) | DEP (INIT_UNSAVED_FILES) | DEP (INIT_ADD_RECENT) |
+    DEP (INIT_SEARCH_ENGINE) | DEP (INIT_RUNTIMES) | DEP (INIT_CONFIGURATION_MANAGER) |
+    DEP (INIT_DIAGNOSTICS_MANAGER),
+    &InitLoaded_ctr },
+};
+
+#undef DEP
+
 static void
 ide_context_init_async (GAsyncInitable      *initable,
                         int                  io_priority,
@@ -1572,25 +1685,12 @@ ide_context_init_async (GAsyncInitable      *initable,
   g_return_if_fail (G_IS_ASYNC_INITABLE (context));
   g_return_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable));
 
-  ide_async_helper_run (context,
-                        cancellable,
-                        callback,
-                        user_data,
-                        ide_context_init_build_system,
-                        ide_context_init_vcs,
-                        ide_context_init_services,
-                        ide_context_init_project_name,
-                        ide_context_init_back_forward_list,
-                        ide_context_init_snippets,
-                        ide_context_init_scripts,
-                        ide_context_init_unsaved_files,
-                        ide_context_init_add_recent,
-                        ide_context_init_search_engine,
-                        ide_context_init_runtimes,
-                        ide_context_init_configuration_manager,
-                        ide_context_init_diagnostics_manager,
-                        ide_context_init_loaded,
-                        NULL);
+  ide_async_helper_run_graph (context,
+                              init_steps,
+                              G_N_ELEMENTS (init_steps),
+                              cancellable,
+                              callback,
+                              user_data);
 }
 
 static gboolean
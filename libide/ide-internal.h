@@ -37,6 +37,7 @@ void                _ide_battery_monitor_init               (void);
 void                _ide_battery_monitor_shutdown           (void);
 void                _ide_buffer_set_changed_on_volume       (IdeBuffer             *self,
                                                              gboolean               changed_on_volume);
+gboolean            _ide_buffer_get_held                    (IdeBuffer             *self);
 gboolean            _ide_buffer_get_loading                 (IdeBuffer             *self);
 void                _ide_buffer_set_loading                 (IdeBuffer             *self,
                                                              gboolean               loading);
@@ -81,7 +82,10 @@ void                _ide_source_view_set_count              (IdeSourceView
                                                              gint                   count);
 void                _ide_source_view_set_modifier           (IdeSourceView         *self,
                                                              gunichar               modifier);
+void                _ide_stall_detector_init                (void);
 void                _ide_thread_pool_init                   (gboolean               is_worker);
+void                _ide_thread_pool_update_governor        (gboolean               on_battery,
+                                                             gdouble                load);
 IdeUnsavedFile     *_ide_unsaved_file_new                   (GFile                 *file,
                                                              GBytes                *content,
                                                              const gchar           *temp_path,
@@ -25,6 +25,8 @@
 #include "ide-debug.h"
 #include "ide-object.h"
 
+#include "util/ide-timeline.h"
+
 typedef struct
 {
   IdeContext *context;
@@ -45,6 +47,8 @@ typedef struct
   GPtrArray *plugins;
   gint       position;
   gint       io_priority;
+  GType      interface_gtype;
+  gint64     begin_time;
 } InitExtensionAsyncState;
 
 static void ide_object_new_async_try_next (InitAsyncState *state);
@@ -346,6 +350,10 @@ extension_init_cb (GObject      *object,
 
   state = g_task_get_task_data (task);
 
+  ide_timeline_end (g_type_name (state->interface_gtype),
+                    G_OBJECT_TYPE_NAME (initable),
+                    state->begin_time);
+
   if (!g_async_initable_init_finish (initable, result, &error))
     {
       if (state->position == state->plugins->len)
@@ -383,6 +391,8 @@ ide_object_new_for_extension_async_try_next (GTask *task)
 
   build_system = g_ptr_array_index (state->plugins, state->position++);
 
+  state->begin_time = ide_timeline_begin ();
+
   g_async_initable_init_async (G_ASYNC_INITABLE (build_system),
                                state->io_priority,
                                g_task_get_cancellable (task),
@@ -427,6 +437,7 @@ ide_object_new_for_extension_async (GType                 interface_gtype,
   state->plugins = g_ptr_array_new_with_free_func (g_object_unref);
   state->position = 0;
   state->io_priority = io_priority;
+  state->interface_gtype = interface_gtype;
 
   peas_extension_set_foreach (set, extensions_foreach_cb, state);
 
@@ -105,6 +105,8 @@ typedef struct _IdeSearchProvider              IdeSearchProvider;
 
 typedef struct _IdeSearchResult                IdeSearchResult;
 
+typedef struct _IdeSearchResults               IdeSearchResults;
+
 typedef struct _IdeService                     IdeService;
 
 typedef struct _IdeSettings                    IdeSettings;
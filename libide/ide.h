@@ -30,6 +30,7 @@ G_BEGIN_DECLS
 #include "application/ide-application-addin.h"
 #include "application/ide-application-tool.h"
 #include "application/ide-application.h"
+#include "buffers/ide-bracket-index.h"
 #include "buffers/ide-buffer-change-monitor.h"
 #include "buffers/ide-buffer-manager.h"
 #include "buffers/ide-buffer.h"
@@ -43,6 +44,7 @@ G_BEGIN_DECLS
 #include "buildsystem/ide-build-system.h"
 #include "buildsystem/ide-build-target.h"
 #include "buildsystem/ide-builder.h"
+#include "buildsystem/ide-compile-commands.h"
 #include "buildsystem/ide-configuration-manager.h"
 #include "buildsystem/ide-configuration.h"
 #include "buildsystem/ide-environment-variable.h"
@@ -106,9 +108,12 @@ G_BEGIN_DECLS
 #include "search/ide-pattern-spec.h"
 #include "search/ide-search-context.h"
 #include "search/ide-search-engine.h"
+#include "search/ide-search-hit.h"
 #include "search/ide-search-provider.h"
 #include "search/ide-search-reducer.h"
 #include "search/ide-search-result.h"
+#include "search/ide-search-results.h"
+#include "search/ide-text-search.h"
 #include "snippets/ide-source-snippet-chunk.h"
 #include "snippets/ide-source-snippet-context.h"
 #include "snippets/ide-source-snippet.h"
@@ -146,6 +151,7 @@ G_BEGIN_DECLS
 #include "util/ide-posix.h"
 #include "util/ide-progress.h"
 #include "util/ide-ref-ptr.h"
+#include "util/ide-stall-detector.h"
 #include "util/ide-uri.h"
 #include "vcs/ide-vcs-config.h"
 #include "vcs/ide-vcs-initializer.h"
@@ -25,6 +25,7 @@
 
 #include "search/ide-omni-search-group.h"
 #include "search/ide-omni-search-display.h"
+#include "search/ide-search-results.h"
 
 struct _IdeOmniSearchDisplay
 {
@@ -33,8 +34,6 @@ struct _IdeOmniSearchDisplay
   IdeSearchContext    *context;
   GPtrArray           *providers;
 
-  gulong               result_added_handler;
-  gulong               result_removed_handler;
   gulong               count_set_handler;
 
   guint                do_autoselect : 1;
@@ -43,7 +42,9 @@ struct _IdeOmniSearchDisplay
 typedef struct
 {
   IdeSearchProvider   *provider;
+  IdeSearchResults    *results;
   IdeOmniSearchGroup  *group;
+  gulong               items_changed_handler;
 } ProviderEntry;
 
 G_DEFINE_TYPE (IdeOmniSearchDisplay, ide_omni_search_display, GTK_TYPE_BOX)
@@ -72,7 +73,9 @@ provider_entry_destroy (gpointer data)
 
   IDE_TRACE_MSG ("releasing %p", data);
 
+  ide_clear_signal_handler (entry->results, &entry->items_changed_handler);
   ide_clear_weak_pointer (&entry->group);
+  g_clear_object (&entry->results);
   g_clear_object (&entry->provider);
   g_free (entry);
 
@@ -246,15 +249,55 @@ ide_omni_search_display_activate (IdeOmniSearchDisplay *self)
     }
 }
 
+static void
+ide_omni_search_display_results_changed (IdeOmniSearchDisplay *self,
+                                         guint                 position,
+                                         guint                 removed,
+                                         guint                 added,
+                                         IdeSearchResults     *results)
+{
+  guint i;
+
+  g_assert (IDE_IS_OMNI_SEARCH_DISPLAY (self));
+  g_assert (IDE_IS_SEARCH_RESULTS (results));
+
+  for (i = 0; i < self->providers->len; i++)
+    {
+      ProviderEntry *ptr;
+
+      ptr = g_ptr_array_index (self->providers, i);
+
+      if (ptr->results == results)
+        {
+          if (ptr->group != NULL)
+            {
+              guint n_items = g_list_model_get_n_items (G_LIST_MODEL (results));
+
+              gtk_widget_set_visible (GTK_WIDGET (ptr->group), n_items > 0);
+
+              /*
+               * If this is the first group and we are still auto-selecting
+               * the first row, we might need to update the selection.
+               */
+              if ((i == 0) && self->do_autoselect && (position == 0) && (n_items > 0))
+                ide_omni_search_group_select_first (ptr->group);
+            }
+          break;
+        }
+    }
+}
+
 static void
 ide_omni_search_display_add_provider (IdeOmniSearchDisplay *self,
-                                      IdeSearchProvider    *provider)
+                                      IdeSearchProvider    *provider,
+                                      IdeSearchResults     *results)
 {
   ProviderEntry *entry;
   guint i;
 
   g_return_if_fail (IDE_IS_OMNI_SEARCH_DISPLAY (self));
   g_return_if_fail (IDE_IS_SEARCH_PROVIDER (provider));
+  g_return_if_fail (IDE_IS_SEARCH_RESULTS (results));
 
   /*
    * Make sure we don't add an item twice. Probably can assert here, but
@@ -279,10 +322,18 @@ ide_omni_search_display_add_provider (IdeOmniSearchDisplay *self,
    */
   entry = g_new0 (ProviderEntry, 1);
   entry->provider = g_object_ref (provider);
+  entry->results = g_object_ref (results);
   entry->group = g_object_new (IDE_TYPE_OMNI_SEARCH_GROUP,
                                "provider", provider,
+                               "results", results,
                                "visible", FALSE,
                                NULL);
+  entry->items_changed_handler =
+    g_signal_connect_object (results,
+                             "items-changed",
+                             G_CALLBACK (ide_omni_search_display_results_changed),
+                             self,
+                             G_CONNECT_SWAPPED);
   g_object_add_weak_pointer (G_OBJECT (entry->group), (gpointer *)&entry->group);
   g_signal_connect_object (entry->group,
                            "result-activated",
@@ -347,72 +398,6 @@ ide_omni_search_display_remove_provider (IdeOmniSearchDisplay *self,
   g_warning (_("The provider could not be found."));
 }
 
-static void
-ide_omni_search_display_result_added (IdeOmniSearchDisplay *self,
-                                      IdeSearchProvider    *provider,
-                                      IdeSearchResult      *result,
-                                      IdeSearchContext     *context)
-{
-  guint i;
-
-  g_return_if_fail (IDE_IS_OMNI_SEARCH_DISPLAY (self));
-  g_return_if_fail (IDE_IS_SEARCH_PROVIDER (provider));
-  g_return_if_fail (IDE_IS_SEARCH_RESULT (result));
-  g_return_if_fail (IDE_IS_SEARCH_CONTEXT (context));
-
-  for (i = 0; i < self->providers->len; i++)
-    {
-      ProviderEntry *ptr;
-
-      ptr = g_ptr_array_index (self->providers, i);
-
-      if (ptr->provider == provider)
-        {
-          if (ptr->group != NULL)
-            {
-              ide_omni_search_group_add_result (ptr->group, result);
-              gtk_widget_show (GTK_WIDGET (ptr->group));
-
-              /*
-               * If this is the first group and we are still auto-selecting
-               * the first row, we might need to update the selection.
-               */
-              if ((i == 0) && self->do_autoselect)
-                ide_omni_search_group_select_first (ptr->group);
-            }
-          break;
-        }
-    }
-}
-
-static void
-ide_omni_search_display_result_removed (IdeOmniSearchDisplay *self,
-                                        IdeSearchProvider    *provider,
-                                        IdeSearchResult      *result,
-                                        IdeSearchContext     *context)
-{
-  guint i;
-
-  g_return_if_fail (IDE_IS_OMNI_SEARCH_DISPLAY (self));
-  g_return_if_fail (IDE_IS_SEARCH_PROVIDER (provider));
-  g_return_if_fail (IDE_IS_SEARCH_RESULT (result));
-  g_return_if_fail (IDE_IS_SEARCH_CONTEXT (context));
-
-  for (i = 0; i < self->providers->len; i++)
-    {
-      ProviderEntry *ptr;
-
-      ptr = g_ptr_array_index (self->providers, i);
-
-      if (ptr->provider == provider)
-        {
-          if (ptr->group != NULL)
-            ide_omni_search_group_remove_result (ptr->group, result);
-          break;
-        }
-    }
-}
-
 static void
 ide_omni_search_display_count_set (IdeOmniSearchDisplay *self,
                                    IdeSearchProvider    *provider,
@@ -457,21 +442,9 @@ ide_omni_search_display_connect_context (IdeOmniSearchDisplay *self,
   providers = ide_search_context_get_providers (context);
 
   for (iter = providers; iter; iter = iter->next)
-    ide_omni_search_display_add_provider (self, iter->data);
-
-  self->result_added_handler =
-    g_signal_connect_object (context,
-                             "result-added",
-                             G_CALLBACK (ide_omni_search_display_result_added),
-                             self,
-                             G_CONNECT_SWAPPED);
-
-  self->result_removed_handler =
-    g_signal_connect_object (context,
-                             "result-removed",
-                             G_CALLBACK (ide_omni_search_display_result_removed),
-                             self,
-                             G_CONNECT_SWAPPED);
+    ide_omni_search_display_add_provider (self,
+                                          iter->data,
+                                          ide_search_context_get_results (context, iter->data));
 
   self->count_set_handler =
     g_signal_connect_object (context,
@@ -488,8 +461,6 @@ ide_omni_search_display_disconnect_context (IdeOmniSearchDisplay *self,
   g_return_if_fail (IDE_IS_OMNI_SEARCH_DISPLAY (self));
   g_return_if_fail (IDE_IS_SEARCH_CONTEXT (context));
 
-  ide_clear_signal_handler (context, &self->result_added_handler);
-  ide_clear_signal_handler (context, &self->result_removed_handler);
   ide_clear_signal_handler (context, &self->count_set_handler);
 
   while (self->providers->len)
@@ -30,7 +30,7 @@
 #define SHORT_DELAY_TIMEOUT_MSEC 20
 #define LONG_DELAY_TIMEOUT_MSEC  50
 #define LONG_DELAY_MAX_CHARS     3
-#define RESULTS_PER_PROVIDER     7
+#define RESULTS_PER_PROVIDER     500
 
 struct _IdeOmniSearchEntry
 {
@@ -21,17 +21,32 @@
 #include "ide-omni-search-group.h"
 #include "ide-omni-search-row.h"
 
+/*
+ * Only this many rows are created up front. More rows are created, a page
+ * at a time, as the user navigates past the last row or activates the
+ * "more" row. This keeps the cost of each keystroke independent of how
+ * many results a provider returns.
+ */
+#define ROWS_PER_PAGE 7
+
 struct _IdeOmniSearchGroup
 {
   GtkBox             parent_instance;
 
   /* References owned by instance */
   IdeSearchProvider *provider;
+  IdeSearchResults  *results;
 
   /* References owned by template */
   GtkListBox        *rows;
 
-  guint64            count;
+  /* Owned by rows */
+  GtkListBoxRow     *more_row;
+  GtkLabel          *more_label;
+
+  /* Rows [0..n_realized) of rows mirror the same positions in results */
+  guint              n_realized;
+  guint              n_visible;
 };
 
 G_DEFINE_TYPE (IdeOmniSearchGroup, ide_omni_search_group, GTK_TYPE_BOX)
@@ -39,6 +54,7 @@ G_DEFINE_TYPE (IdeOmniSearchGroup, ide_omni_search_group, GTK_TYPE_BOX)
 enum {
   PROP_0,
   PROP_PROVIDER,
+  PROP_RESULTS,
   LAST_PROP
 };
 
@@ -48,20 +64,9 @@ enum {
   LAST_SIGNAL
 };
 
-static GQuark      quarkRow;
 static GParamSpec *properties [LAST_PROP];
 static guint       signals [LAST_SIGNAL];
 
-static void
-ide_omni_search_group_foreach_cb (GtkWidget *widget,
-                                  gpointer   user_data)
-{
-  GtkWidget **row = user_data;
-
-  if (*row == NULL)
-    *row = widget;
-}
-
 /**
  * ide_omni_search_group_get_first:
  *
@@ -70,19 +75,16 @@ ide_omni_search_group_foreach_cb (GtkWidget *widget,
 IdeSearchResult *
 ide_omni_search_group_get_first (IdeOmniSearchGroup *self)
 {
-  GtkListBoxRow *row = NULL;
-  IdeSearchResult *ret = NULL;
+  GtkListBoxRow *row;
 
   g_return_val_if_fail (IDE_IS_OMNI_SEARCH_GROUP (self), NULL);
 
-  gtk_container_foreach (GTK_CONTAINER (self->rows),
-                         ide_omni_search_group_foreach_cb,
-                         &row);
+  row = gtk_list_box_get_row_at_index (self->rows, 0);
 
   if (IDE_IS_OMNI_SEARCH_ROW (row))
-    ret = ide_omni_search_row_get_result (IDE_OMNI_SEARCH_ROW (row));
+    return ide_omni_search_row_get_result (IDE_OMNI_SEARCH_ROW (row));
 
-  return ret;
+  return NULL;
 }
 
 /**
@@ -109,78 +111,152 @@ ide_omni_search_group_set_provider (IdeOmniSearchGroup *self,
     self->provider = g_object_ref (provider);
 }
 
-GtkWidget *
-ide_omni_search_group_create_row (IdeSearchResult *result)
+static GtkWidget *
+ide_omni_search_group_create_row (IdeOmniSearchGroup *self,
+                                  IdeSearchResult    *result)
 {
-  IdeSearchProvider *provider;
   GtkWidget *row;
 
-  g_return_val_if_fail (IDE_IS_SEARCH_RESULT (result), NULL);
+  g_assert (IDE_IS_OMNI_SEARCH_GROUP (self));
+  g_assert (IDE_IS_SEARCH_RESULT (result));
 
-  provider = ide_search_result_get_provider (result);
-  row = ide_search_provider_create_row (provider, result);
-  g_object_set_qdata (G_OBJECT (result), quarkRow, row);
+  row = ide_search_provider_create_row (self->provider, result);
+
+  if (row == NULL)
+    row = g_object_new (IDE_TYPE_OMNI_SEARCH_ROW,
+                        "result", result,
+                        "visible", TRUE,
+                        NULL);
 
   return row;
 }
 
-void
-ide_omni_search_group_remove_result (IdeOmniSearchGroup *self,
-                                     IdeSearchResult    *result)
+static void
+ide_omni_search_group_update_more_row (IdeOmniSearchGroup *self)
 {
-  GtkWidget *row;
+  g_autofree gchar *label = NULL;
+  guint n_items;
 
-  g_return_if_fail (IDE_IS_OMNI_SEARCH_GROUP (self));
-  g_return_if_fail (IDE_IS_SEARCH_RESULT (result));
+  g_assert (IDE_IS_OMNI_SEARCH_GROUP (self));
 
-  row = g_object_get_qdata (G_OBJECT (result), quarkRow);
+  n_items = g_list_model_get_n_items (G_LIST_MODEL (self->results));
 
-  if (IDE_IS_OMNI_SEARCH_ROW (row))
+  if (n_items > self->n_realized)
     {
-      g_object_set_qdata (G_OBJECT (result), quarkRow, NULL);
-      gtk_widget_destroy (row);
+      guint remaining = n_items - self->n_realized;
+
+      label = g_strdup_printf (ngettext ("%u more result", "%u more results", remaining), remaining);
+      gtk_label_set_label (self->more_label, label);
     }
+
+  gtk_widget_set_visible (GTK_WIDGET (self->more_row), n_items > self->n_realized);
 }
 
-void
-ide_omni_search_group_add_result (IdeOmniSearchGroup *self,
-                                  IdeSearchResult    *result)
+static void
+ide_omni_search_group_realize_rows (IdeOmniSearchGroup *self)
 {
-  GtkWidget *row;
+  guint n_items;
+  guint target;
 
-  g_return_if_fail (IDE_IS_OMNI_SEARCH_GROUP (self));
-  g_return_if_fail (IDE_IS_SEARCH_RESULT (result));
+  g_assert (IDE_IS_OMNI_SEARCH_GROUP (self));
 
-  row = ide_omni_search_group_create_row (result);
-  gtk_container_add (GTK_CONTAINER (self->rows), row);
+  n_items = g_list_model_get_n_items (G_LIST_MODEL (self->results));
+  target = MIN (n_items, self->n_visible);
 
-  gtk_list_box_invalidate_sort (self->rows);
+  while (self->n_realized < target)
+    {
+      g_autoptr(IdeSearchResult) result = NULL;
+      GtkWidget *row;
+
+      result = g_list_model_get_item (G_LIST_MODEL (self->results), self->n_realized);
+      if (result == NULL)
+        break;
+
+      row = ide_omni_search_group_create_row (self, result);
+      gtk_list_box_insert (self->rows, row, self->n_realized);
+      self->n_realized++;
+    }
 
-  self->count++;
+  ide_omni_search_group_update_more_row (self);
 }
 
-static gint
-compare_cb (GtkListBoxRow *row1,
-            GtkListBoxRow *row2,
-            gpointer       user_data)
+static void
+ide_omni_search_group_unrealize_rows (IdeOmniSearchGroup *self,
+                                      guint               position)
 {
-  IdeSearchResult *result1;
-  IdeSearchResult *result2;
-  gfloat score1;
-  gfloat score2;
+  g_assert (IDE_IS_OMNI_SEARCH_GROUP (self));
 
-  result1 = ide_omni_search_row_get_result (IDE_OMNI_SEARCH_ROW (row1));
-  result2 = ide_omni_search_row_get_result (IDE_OMNI_SEARCH_ROW (row2));
+  while (self->n_realized > position)
+    {
+      GtkListBoxRow *row;
 
-  score1 = ide_search_result_get_score (result1);
-  score2 = ide_search_result_get_score (result2);
+      row = gtk_list_box_get_row_at_index (self->rows, self->n_realized - 1);
+      g_assert (row != self->more_row);
+      gtk_widget_destroy (GTK_WIDGET (row));
+      self->n_realized--;
+    }
+}
 
-  if (score1 < score2)
-    return 1;
-  else if (score1 > score2)
-    return -1;
-  else
-    return 0;
+static void
+ide_omni_search_group_show_more (IdeOmniSearchGroup *self)
+{
+  g_assert (IDE_IS_OMNI_SEARCH_GROUP (self));
+
+  self->n_visible = self->n_realized + ROWS_PER_PAGE;
+  ide_omni_search_group_realize_rows (self);
+}
+
+static void
+ide_omni_search_group_items_changed (IdeOmniSearchGroup *self,
+                                     guint               position,
+                                     guint               removed,
+                                     guint               added,
+                                     GListModel         *model)
+{
+  g_assert (IDE_IS_OMNI_SEARCH_GROUP (self));
+  g_assert (G_IS_LIST_MODEL (model));
+
+  /*
+   * Rows past the visible window do not exist, so changes there only
+   * affect the "more" row. Otherwise recreate the rows after position,
+   * which is at most a page worth of widgets.
+   */
+  if (position < self->n_realized)
+    ide_omni_search_group_unrealize_rows (self, position);
+
+  ide_omni_search_group_realize_rows (self);
+}
+
+/**
+ * ide_omni_search_group_get_results:
+ *
+ * Returns: (transfer none): An #IdeSearchResults
+ */
+IdeSearchResults *
+ide_omni_search_group_get_results (IdeOmniSearchGroup *self)
+{
+  g_return_val_if_fail (IDE_IS_OMNI_SEARCH_GROUP (self), NULL);
+
+  return self->results;
+}
+
+static void
+ide_omni_search_group_set_results (IdeOmniSearchGroup *self,
+                                   IdeSearchResults   *results)
+{
+  g_assert (IDE_IS_OMNI_SEARCH_GROUP (self));
+  g_assert (!results || IDE_IS_SEARCH_RESULTS (results));
+
+  if (results != NULL)
+    {
+      self->results = g_object_ref (results);
+      g_signal_connect_object (results,
+                               "items-changed",
+                               G_CALLBACK (ide_omni_search_group_items_changed),
+                               self,
+                               G_CONNECT_SWAPPED);
+      ide_omni_search_group_realize_rows (self);
+    }
 }
 
 static void
@@ -214,9 +290,15 @@ ide_omni_search_group_row_activated (IdeOmniSearchGroup *self,
   IdeSearchResult *result;
 
   g_return_if_fail (IDE_IS_OMNI_SEARCH_GROUP (self));
-  g_return_if_fail (IDE_IS_OMNI_SEARCH_ROW (row));
+  g_return_if_fail (GTK_IS_LIST_BOX_ROW (row));
   g_return_if_fail (GTK_IS_LIST_BOX (list_box));
 
+  if (row == self->more_row)
+    {
+      ide_omni_search_group_show_more (self);
+      return;
+    }
+
   result = ide_omni_search_row_get_result (IDE_OMNI_SEARCH_ROW (row));
   if (result)
     g_signal_emit (self, signals [RESULT_ACTIVATED], 0, row, result);
@@ -227,24 +309,17 @@ ide_omni_search_group_row_selected (IdeOmniSearchGroup *self,
                                     GtkListBoxRow      *row,
                                     GtkListBox         *list_box)
 {
-  GtkWidget *child;
-
   g_return_if_fail (IDE_IS_OMNI_SEARCH_GROUP (self));
   g_return_if_fail (!row || GTK_IS_LIST_BOX_ROW (row));
   g_return_if_fail (GTK_IS_LIST_BOX (list_box));
 
-  if (row)
+  if (IDE_IS_OMNI_SEARCH_ROW (row))
     {
-      child = gtk_bin_get_child (GTK_BIN (row));
-
-      if (IDE_IS_OMNI_SEARCH_ROW (child))
-        {
-          IdeSearchResult *result;
+      IdeSearchResult *result;
 
-          result = ide_omni_search_row_get_result (IDE_OMNI_SEARCH_ROW (child));
-          if (result)
-            g_signal_emit (self, signals [RESULT_SELECTED], 0, result);
-        }
+      result = ide_omni_search_row_get_result (IDE_OMNI_SEARCH_ROW (row));
+      if (result)
+        g_signal_emit (self, signals [RESULT_SELECTED], 0, result);
     }
 }
 
@@ -255,6 +330,9 @@ ide_omni_search_group_select_first (IdeOmniSearchGroup *self)
 
   g_return_if_fail (IDE_IS_OMNI_SEARCH_GROUP (self));
 
+  if (self->n_realized == 0)
+    return;
+
   row = gtk_list_box_get_row_at_index (self->rows, 0);
 
   if (row)
@@ -303,6 +381,7 @@ ide_omni_search_group_finalize (GObject *object)
   IdeOmniSearchGroup *self = (IdeOmniSearchGroup *)object;
 
   g_clear_object (&self->provider);
+  g_clear_object (&self->results);
 
   G_OBJECT_CLASS (ide_omni_search_group_parent_class)->finalize (object);
 }
@@ -321,6 +400,10 @@ ide_omni_search_group_get_property (GObject    *object,
       g_value_set_object (value, ide_omni_search_group_get_provider (self));
       break;
 
+    case PROP_RESULTS:
+      g_value_set_object (value, ide_omni_search_group_get_results (self));
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
     }
@@ -340,6 +423,10 @@ ide_omni_search_group_set_property (GObject      *object,
       ide_omni_search_group_set_provider (self, g_value_get_object (value));
       break;
 
+    case PROP_RESULTS:
+      ide_omni_search_group_set_results (self, g_value_get_object (value));
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
     }
@@ -362,6 +449,13 @@ ide_omni_search_group_class_init (IdeOmniSearchGroupClass *klass)
                          IDE_TYPE_SEARCH_PROVIDER,
                          (G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS));
 
+  properties [PROP_RESULTS] =
+    g_param_spec_object ("results",
+                         "Results",
+                         "The results to display",
+                         IDE_TYPE_SEARCH_RESULTS,
+                         (G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS));
+
   g_object_class_install_properties (object_class, LAST_PROP, properties);
 
   signals [RESULT_ACTIVATED] =
@@ -388,8 +482,6 @@ ide_omni_search_group_class_init (IdeOmniSearchGroupClass *klass)
   gtk_widget_class_set_template_from_resource (widget_class, "/org/gnome/builder/ui/ide-omni-search-group.ui");
   gtk_widget_class_set_css_name (widget_class, "omnisearchgroup");
   gtk_widget_class_bind_template_child (widget_class, IdeOmniSearchGroup, rows);
-
-  quarkRow = g_quark_from_static_string ("IDE_OMNI_SEARCH_ROW");
 }
 
 static void
@@ -413,7 +505,19 @@ ide_omni_search_group_init (IdeOmniSearchGroup *self)
                            self,
                            G_CONNECT_SWAPPED);
 
-  gtk_list_box_set_sort_func (self->rows, compare_cb, NULL, NULL);
+  self->more_label = g_object_new (GTK_TYPE_LABEL,
+                                   "visible", TRUE,
+                                   "xalign", 0.0f,
+                                   NULL);
+  gtk_style_context_add_class (gtk_widget_get_style_context (GTK_WIDGET (self->more_label)),
+                               "dim-label");
+  self->more_row = g_object_new (GTK_TYPE_LIST_BOX_ROW,
+                                 "child", self->more_label,
+                                 "visible", FALSE,
+                                 NULL);
+  gtk_container_add (GTK_CONTAINER (self->rows), GTK_WIDGET (self->more_row));
+
+  self->n_visible = ROWS_PER_PAGE;
 }
 
 gboolean
@@ -425,6 +529,12 @@ ide_omni_search_group_activate (IdeOmniSearchGroup *group)
 
   row = gtk_list_box_get_selected_row (group->rows);
 
+  if (row == group->more_row)
+    {
+      ide_omni_search_group_show_more (group);
+      return TRUE;
+    }
+
   if (row != NULL)
     {
       IdeSearchResult *result;
@@ -447,59 +557,33 @@ ide_omni_search_group_get_count (IdeOmniSearchGroup *self)
 {
   g_return_val_if_fail (IDE_IS_OMNI_SEARCH_GROUP (self), 0);
 
-  return self->count;
-}
-
-static void
-find_nth_row_cb (GtkWidget *widget,
-                 gpointer   user_data)
-{
-  struct {
-    GtkListBox    *list;
-    GtkListBoxRow *row;
-    gint           nth;
-    gint           last_n;
-  } *lookup = user_data;
-  gint position;
-
-  /*
-   * This tries to find a matching index, but also handles the special case of
-   * -1, where we are trying to find the last row by position. This would not
-   *  be very efficient if the lists were long, but currently the lists are
-   *  all < 10 items.
-   */
-
-  if ((lookup->row != NULL) && (lookup->nth != -1))
-    return;
-
-  position = gtk_list_box_row_get_index (GTK_LIST_BOX_ROW (widget));
+  if (self->results == NULL)
+    return 0;
 
-  if (position == lookup->nth)
-    lookup->row = GTK_LIST_BOX_ROW (widget);
-  else if ((lookup->nth == -1) && (position > lookup->last_n))
-    {
-      lookup->row = GTK_LIST_BOX_ROW (widget);
-      lookup->last_n = position;
-    }
+  return g_list_model_get_n_items (G_LIST_MODEL (self->results));
 }
 
 static GtkListBoxRow *
-find_nth_row (GtkListBox *list,
-              gint        nth)
+find_nth_row (IdeOmniSearchGroup *self,
+              gint                nth)
 {
-  struct {
-    GtkListBox    *list;
-    GtkListBoxRow *row;
-    gint           nth;
-    gint           last_n;
-  } lookup = { list, NULL, nth, -1 };
-
-  g_assert (GTK_IS_LIST_BOX (list));
+  g_assert (IDE_IS_OMNI_SEARCH_GROUP (self));
   g_assert (nth >= -1);
 
-  gtk_container_foreach (GTK_CONTAINER (list), find_nth_row_cb, &lookup);
+  if (nth == -1)
+    nth = (gint)self->n_realized - 1;
+
+  /*
+   * Moving past the last realized row creates the next page of rows, so
+   * keyboard navigation can reach every result.
+   */
+  if (nth >= 0 && (guint)nth == self->n_realized)
+    ide_omni_search_group_show_more (self);
+
+  if (nth < 0 || (guint)nth >= self->n_realized)
+    return NULL;
 
-  return lookup.row;
+  return gtk_list_box_get_row_at_index (self->rows, nth);
 }
 
 gboolean
@@ -516,10 +600,10 @@ ide_omni_search_group_move_next (IdeOmniSearchGroup *self)
       gint position;
 
       position = gtk_list_box_row_get_index (row);
-      row = find_nth_row (self->rows, position + 1);
+      row = find_nth_row (self, position + 1);
     }
   else
-    row = find_nth_row (self->rows, 0);
+    row = find_nth_row (self, 0);
 
   if (row != NULL)
     {
@@ -548,10 +632,10 @@ ide_omni_search_group_move_previous (IdeOmniSearchGroup *self)
       if (position == 0)
         return FALSE;
 
-      row = find_nth_row (self->rows, position - 1);
+      row = find_nth_row (self, position - 1);
     }
   else
-    row = find_nth_row (self->rows, -1);
+    row = find_nth_row (self, -1);
 
   if (row != NULL)
     {
@@ -22,6 +22,7 @@
 #include <gtk/gtk.h>
 
 #include "ide-search-result.h"
+#include "ide-search-results.h"
 
 G_BEGIN_DECLS
 
@@ -31,10 +32,7 @@ G_DECLARE_FINAL_TYPE (IdeOmniSearchGroup, ide_omni_search_group, IDE, OMNI_SEARC
 
 void               ide_omni_search_group_clear         (IdeOmniSearchGroup *self);
 IdeSearchProvider *ide_omni_search_group_get_provider  (IdeOmniSearchGroup *self);
-void               ide_omni_search_group_add_result    (IdeOmniSearchGroup *self,
-                                                        IdeSearchResult    *result);
-void               ide_omni_search_group_remove_result (IdeOmniSearchGroup *self,
-                                                        IdeSearchResult    *result);
+IdeSearchResults  *ide_omni_search_group_get_results   (IdeOmniSearchGroup *self);
 void               ide_omni_search_group_unselect      (IdeOmniSearchGroup *self);
 void               ide_omni_search_group_select_first  (IdeOmniSearchGroup *self);
 void               ide_omni_search_group_select_last   (IdeOmniSearchGroup *self);
@@ -24,6 +24,7 @@
 #include "search/ide-search-context.h"
 #include "search/ide-search-provider.h"
 #include "search/ide-search-result.h"
+#include "search/ide-search-results.h"
 
 struct _IdeSearchContext
 {
@@ -31,6 +32,7 @@ struct _IdeSearchContext
 
   GCancellable *cancellable;
   GList        *providers;
+  GHashTable   *results;
   gsize         max_results;
   guint         in_progress;
   guint         executed : 1;
@@ -96,9 +98,59 @@ ide_search_context_add_result (IdeSearchContext  *self,
   g_return_if_fail (IDE_IS_SEARCH_PROVIDER (provider));
   g_return_if_fail (IDE_IS_SEARCH_RESULT (result));
 
+  ide_search_results_add_result (ide_search_context_get_results (self, provider), result);
+
   g_signal_emit (self, signals [RESULT_ADDED], 0, provider, result);
 }
 
+/**
+ * ide_search_context_add_hits:
+ * @self: An #IdeSearchContext
+ * @provider: The #IdeSearchProvider that produced @hits
+ * @hits: (array length=n_hits): An array of #IdeSearchHit
+ * @n_hits: The number of elements in @hits
+ *
+ * Adds a batch of hits to the results of @provider. See
+ * ide_search_results_add_hits() for the ownership of @hits.
+ *
+ * Unlike ide_search_context_add_result(), this does not emit
+ * #IdeSearchContext::result-added; consumers should observe the
+ * #IdeSearchResults returned from ide_search_context_get_results().
+ */
+void
+ide_search_context_add_hits (IdeSearchContext  *self,
+                             IdeSearchProvider *provider,
+                             IdeSearchHit      *hits,
+                             guint              n_hits)
+{
+  g_return_if_fail (IDE_IS_MAIN_THREAD ());
+  g_return_if_fail (IDE_IS_SEARCH_CONTEXT (self));
+  g_return_if_fail (IDE_IS_SEARCH_PROVIDER (provider));
+  g_return_if_fail (hits != NULL || n_hits == 0);
+
+  ide_search_results_add_hits (ide_search_context_get_results (self, provider), hits, n_hits);
+}
+
+/**
+ * ide_search_context_get_results:
+ * @self: An #IdeSearchContext
+ * @provider: An #IdeSearchProvider of the context
+ *
+ * Gets the results that have been collected for @provider so far. The
+ * #IdeSearchResults is updated as the provider delivers results.
+ *
+ * Returns: (transfer none): An #IdeSearchResults.
+ */
+IdeSearchResults *
+ide_search_context_get_results (IdeSearchContext  *self,
+                                IdeSearchProvider *provider)
+{
+  g_return_val_if_fail (IDE_IS_SEARCH_CONTEXT (self), NULL);
+  g_return_val_if_fail (IDE_IS_SEARCH_PROVIDER (provider), NULL);
+
+  return g_hash_table_lookup (self->results, provider);
+}
+
 void
 ide_search_context_remove_result (IdeSearchContext  *self,
                                   IdeSearchProvider *provider,
@@ -109,6 +161,8 @@ ide_search_context_remove_result (IdeSearchContext  *self,
   g_return_if_fail (IDE_IS_SEARCH_PROVIDER (provider));
   g_return_if_fail (IDE_IS_SEARCH_RESULT (result));
 
+  ide_search_results_remove_result (ide_search_context_get_results (self, provider), result);
+
   g_signal_emit (self, signals [RESULT_REMOVED], 0, provider, result);
 }
 
@@ -142,6 +196,10 @@ ide_search_context_execute (IdeSearchContext *self,
   self->in_progress = g_list_length (self->providers);
   self->max_results = max_results;
 
+  for (iter = self->providers; iter; iter = iter->next)
+    ide_search_results_set_max_results (ide_search_context_get_results (self, iter->data),
+                                        max_results);
+
   if (!self->in_progress)
     {
       g_signal_emit (self, signals [COMPLETED], 0);
@@ -181,6 +239,7 @@ _ide_search_context_add_provider (IdeSearchContext  *self,
   g_return_if_fail (!self->executed);
 
   self->providers = g_list_append (self->providers, g_object_ref (provider));
+  g_hash_table_insert (self->results, provider, ide_search_results_new (provider));
 }
 
 static void
@@ -193,6 +252,7 @@ ide_search_context_finalize (GObject *object)
   g_list_foreach (copy, (GFunc)g_object_unref, NULL);
   g_list_free (copy);
 
+  g_clear_pointer (&self->results, g_hash_table_unref);
   g_clear_object (&self->cancellable);
 
   G_OBJECT_CLASS (ide_search_context_parent_class)->finalize (object);
@@ -252,6 +312,7 @@ static void
 ide_search_context_init (IdeSearchContext *self)
 {
   self->cancellable = g_cancellable_new ();
+  self->results = g_hash_table_new_full (NULL, NULL, NULL, g_object_unref);
 }
 
 gsize
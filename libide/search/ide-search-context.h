@@ -21,29 +21,37 @@
 
 #include "ide-object.h"
 
+#include "search/ide-search-hit.h"
+
 G_BEGIN_DECLS
 
 #define IDE_TYPE_SEARCH_CONTEXT (ide_search_context_get_type())
 
 G_DECLARE_FINAL_TYPE (IdeSearchContext, ide_search_context, IDE, SEARCH_CONTEXT, IdeObject)
 
-const GList *ide_search_context_get_providers      (IdeSearchContext  *self);
-void         ide_search_context_provider_completed (IdeSearchContext  *self,
-                                                    IdeSearchProvider *provider);
-void         ide_search_context_add_result         (IdeSearchContext  *self,
-                                                    IdeSearchProvider *provider,
-                                                    IdeSearchResult   *result);
-void         ide_search_context_remove_result      (IdeSearchContext  *self,
-                                                    IdeSearchProvider *provider,
-                                                    IdeSearchResult   *result);
-void         ide_search_context_cancel             (IdeSearchContext  *self);
-void         ide_search_context_execute            (IdeSearchContext  *self,
-                                                    const gchar       *search_terms,
-                                                    gsize              max_results);
-void         ide_search_context_set_provider_count (IdeSearchContext  *self,
-                                                    IdeSearchProvider *provider,
-                                                    guint64            count);
-gsize        ide_search_context_get_max_results    (IdeSearchContext  *self);
+const GList      *ide_search_context_get_providers      (IdeSearchContext  *self);
+void              ide_search_context_provider_completed (IdeSearchContext  *self,
+                                                         IdeSearchProvider *provider);
+void              ide_search_context_add_result         (IdeSearchContext  *self,
+                                                         IdeSearchProvider *provider,
+                                                         IdeSearchResult   *result);
+void              ide_search_context_add_hits           (IdeSearchContext  *self,
+                                                         IdeSearchProvider *provider,
+                                                         IdeSearchHit      *hits,
+                                                         guint              n_hits);
+IdeSearchResults *ide_search_context_get_results        (IdeSearchContext  *self,
+                                                         IdeSearchProvider *provider);
+void              ide_search_context_remove_result      (IdeSearchContext  *self,
+                                                         IdeSearchProvider *provider,
+                                                         IdeSearchResult   *result);
+void              ide_search_context_cancel             (IdeSearchContext  *self);
+void              ide_search_context_execute            (IdeSearchContext  *self,
+                                                         const gchar       *search_terms,
+                                                         gsize              max_results);
+void              ide_search_context_set_provider_count (IdeSearchContext  *self,
+                                                         IdeSearchProvider *provider,
+                                                         guint64            count);
+gsize             ide_search_context_get_max_results    (IdeSearchContext  *self);
 
 G_END_DECLS
 
@@ -0,0 +1,36 @@
+/* ide-search-hit.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ide-search-hit.h"
+
+/**
+ * ide_search_hit_clear:
+ * @hit: An #IdeSearchHit
+ *
+ * Frees the strings owned by @hit. This is suitable for use with
+ * g_array_set_clear_func().
+ */
+void
+ide_search_hit_clear (IdeSearchHit *hit)
+{
+  g_return_if_fail (hit != NULL);
+
+  g_clear_pointer (&hit->title, g_free);
+  g_clear_pointer (&hit->subtitle, g_free);
+  g_clear_pointer (&hit->key, g_free);
+}
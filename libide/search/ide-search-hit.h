@@ -0,0 +1,51 @@
+/* ide-search-hit.h
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef IDE_SEARCH_HIT_H
+#define IDE_SEARCH_HIT_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * IdeSearchHit:
+ * @title: the markup to display for the hit
+ * @subtitle: (nullable): secondary text for the hit
+ * @key: (nullable): a provider specific key, such as a relative path, that
+ *   the provider uses to create an #IdeSearchResult when the hit is shown
+ * @score: the score of the hit, higher is better
+ *
+ * A compact search result that does not require a #GObject per match.
+ * Providers push these to an #IdeSearchReducer, and an #IdeSearchResult is
+ * only created by ide_search_provider_create_result() once the hit is
+ * actually displayed.
+ */
+typedef struct
+{
+  gchar  *title;
+  gchar  *subtitle;
+  gchar  *key;
+  gfloat  score;
+} IdeSearchHit;
+
+void ide_search_hit_clear (IdeSearchHit *hit);
+
+G_END_DECLS
+
+#endif /* IDE_SEARCH_HIT_H */
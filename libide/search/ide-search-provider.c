@@ -57,6 +57,13 @@ ide_search_provider_real_activate (IdeSearchProvider *self,
 {
 }
 
+static IdeSearchResult *
+ide_search_provider_real_create_result (IdeSearchProvider  *self,
+                                        const IdeSearchHit *hit)
+{
+  return ide_search_result_new (self, hit->title, hit->subtitle, hit->score);
+}
+
 static void
 ide_search_provider_default_init (IdeSearchProviderInterface *iface)
 {
@@ -65,6 +72,7 @@ ide_search_provider_default_init (IdeSearchProviderInterface *iface)
   iface->get_prefix = ide_search_provider_real_get_prefix;
   iface->create_row = ide_search_provider_real_create_row;
   iface->activate = ide_search_provider_real_activate;
+  iface->create_result = ide_search_provider_real_create_result;
 
   g_object_interface_install_property (iface,
                                        g_param_spec_object ("context",
@@ -147,3 +155,25 @@ ide_search_provider_activate (IdeSearchProvider *self,
 
   return IDE_SEARCH_PROVIDER_GET_IFACE (self)->activate (self, row, result);
 }
+
+/**
+ * ide_search_provider_create_result:
+ * @provider: A #IdeSearchProvider.
+ * @hit: An #IdeSearchHit that was pushed by @provider.
+ *
+ * Creates the #IdeSearchResult for @hit. This is called lazily, when the
+ * hit is about to be displayed. The default implementation creates a plain
+ * #IdeSearchResult from the title, subtitle and score of @hit; providers
+ * that need the #IdeSearchHit:key should override it.
+ *
+ * Returns: (transfer full): A #IdeSearchResult.
+ */
+IdeSearchResult *
+ide_search_provider_create_result (IdeSearchProvider  *self,
+                                   const IdeSearchHit *hit)
+{
+  g_return_val_if_fail (IDE_IS_SEARCH_PROVIDER (self), NULL);
+  g_return_val_if_fail (hit != NULL, NULL);
+
+  return IDE_SEARCH_PROVIDER_GET_IFACE (self)->create_result (self, hit);
+}
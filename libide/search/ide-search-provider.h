@@ -23,6 +23,8 @@
 
 #include "ide-object.h"
 
+#include "search/ide-search-hit.h"
+
 G_BEGIN_DECLS
 
 #define IDE_TYPE_SEARCH_PROVIDER (ide_search_provider_get_type())
@@ -46,21 +48,25 @@ struct _IdeSearchProviderInterface
   void        (*activate)      (IdeSearchProvider *provider,
                                 GtkWidget         *row,
                                 IdeSearchResult   *result);
+  IdeSearchResult *(*create_result) (IdeSearchProvider  *provider,
+                                     const IdeSearchHit *hit);
 };
 
-gunichar     ide_search_provider_get_prefix   (IdeSearchProvider *provider);
-gint         ide_search_provider_get_priority (IdeSearchProvider *provider);
-const gchar *ide_search_provider_get_verb     (IdeSearchProvider *provider);
-void         ide_search_provider_populate     (IdeSearchProvider *provider,
-                                               IdeSearchContext  *context,
-                                               const gchar       *search_terms,
-                                               gsize              max_results,
-                                               GCancellable      *cancellable);
-GtkWidget   *ide_search_provider_create_row   (IdeSearchProvider *provider,
-                                               IdeSearchResult   *result);
-void         ide_search_provider_activate     (IdeSearchProvider *provider,
-                                               GtkWidget         *row,
-                                               IdeSearchResult   *result);
+gunichar         ide_search_provider_get_prefix        (IdeSearchProvider  *provider);
+gint             ide_search_provider_get_priority      (IdeSearchProvider  *provider);
+const gchar     *ide_search_provider_get_verb          (IdeSearchProvider  *provider);
+void             ide_search_provider_populate          (IdeSearchProvider  *provider,
+                                                        IdeSearchContext   *context,
+                                                        const gchar        *search_terms,
+                                                        gsize               max_results,
+                                                        GCancellable       *cancellable);
+GtkWidget       *ide_search_provider_create_row        (IdeSearchProvider  *provider,
+                                                        IdeSearchResult    *result);
+void             ide_search_provider_activate          (IdeSearchProvider  *provider,
+                                                        GtkWidget          *row,
+                                                        IdeSearchResult    *result);
+IdeSearchResult *ide_search_provider_create_result     (IdeSearchProvider  *provider,
+                                                        const IdeSearchHit *hit);
 
 G_END_DECLS
 
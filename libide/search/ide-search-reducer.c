@@ -16,10 +16,20 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <string.h>
+
 #include "ide-search-context.h"
 #include "ide-search-provider.h"
 #include "ide-search-reducer.h"
 #include "ide-search-result.h"
+#include "ide-search-results.h"
+
+/*
+ * Hits are handed to the IdeSearchResults in batches of this size so that
+ * the display sees results while the provider is still producing them,
+ * without paying for an items-changed emission per hit.
+ */
+#define HIT_BATCH_SIZE 64
 
 void
 ide_search_reducer_init (IdeSearchReducer  *reducer,
@@ -36,6 +46,8 @@ ide_search_reducer_init (IdeSearchReducer  *reducer,
   reducer->sequence = g_sequence_new (g_object_unref);
   reducer->max_results = max_results ?: G_MAXSIZE;
   reducer->count = 0;
+  reducer->results = ide_search_context_get_results (context, provider);
+  reducer->hits = NULL;
 }
 
 void
@@ -43,10 +55,71 @@ ide_search_reducer_destroy (IdeSearchReducer *reducer)
 {
   g_return_if_fail (reducer);
 
+  ide_search_reducer_flush (reducer);
+
+  g_clear_pointer (&reducer->hits, g_array_unref);
+
   if (reducer->sequence)
     g_sequence_free (reducer->sequence);
 }
 
+/**
+ * ide_search_reducer_push_hit:
+ * @reducer: An #IdeSearchReducer
+ * @hit: An #IdeSearchHit
+ *
+ * Queues @hit to be added to the results of the provider. The contents of
+ * @hit are stolen, and @hit is left zeroed.
+ *
+ * Hits are delivered in batches. Call ide_search_reducer_flush() to deliver
+ * the pending hits immediately; ide_search_reducer_destroy() will flush
+ * any that remain.
+ */
+void
+ide_search_reducer_push_hit (IdeSearchReducer *reducer,
+                             IdeSearchHit     *hit)
+{
+  g_return_if_fail (reducer);
+  g_return_if_fail (hit);
+
+  if (reducer->hits == NULL)
+    {
+      reducer->hits = g_array_sized_new (FALSE, FALSE, sizeof (IdeSearchHit), HIT_BATCH_SIZE);
+      g_array_set_clear_func (reducer->hits, (GDestroyNotify)ide_search_hit_clear);
+    }
+
+  g_array_append_val (reducer->hits, *hit);
+  memset (hit, 0, sizeof *hit);
+
+  reducer->count++;
+
+  if (reducer->hits->len >= HIT_BATCH_SIZE)
+    ide_search_reducer_flush (reducer);
+}
+
+/**
+ * ide_search_reducer_flush:
+ * @reducer: An #IdeSearchReducer
+ *
+ * Delivers any pending hits to the search context.
+ */
+void
+ide_search_reducer_flush (IdeSearchReducer *reducer)
+{
+  g_return_if_fail (reducer);
+
+  if (reducer->hits == NULL || reducer->hits->len == 0)
+    return;
+
+  ide_search_context_add_hits (reducer->context,
+                               reducer->provider,
+                               (IdeSearchHit *)(gpointer)reducer->hits->data,
+                               reducer->hits->len);
+
+  /* The hits have been stolen, so this only releases the slots. */
+  g_array_set_size (reducer->hits, 0);
+}
+
 void
 ide_search_reducer_push (IdeSearchReducer *reducer,
                          IdeSearchResult  *result)
@@ -81,6 +154,16 @@ ide_search_reducer_accepts (IdeSearchReducer *reducer,
 
   g_return_val_if_fail (reducer, FALSE);
 
+  if (reducer->hits != NULL)
+    {
+      guint n_items = g_list_model_get_n_items (G_LIST_MODEL (reducer->results));
+
+      if (n_items < reducer->max_results)
+        return TRUE;
+
+      return score > ide_search_results_get_score (reducer->results, n_items - 1);
+    }
+
   if (g_sequence_get_length (reducer->sequence) < reducer->max_results)
     return TRUE;
 
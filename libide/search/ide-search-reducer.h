@@ -21,6 +21,8 @@
 
 #include "ide-types.h"
 
+#include "search/ide-search-hit.h"
+
 G_BEGIN_DECLS
 
 typedef struct
@@ -30,17 +32,22 @@ typedef struct
   GSequence         *sequence;
   gsize              max_results;
   gsize              count;
+  IdeSearchResults  *results;
+  GArray            *hits;
 } IdeSearchReducer;
 
-void     ide_search_reducer_init    (IdeSearchReducer  *reducer,
-                                     IdeSearchContext  *context,
-                                     IdeSearchProvider *provider,
-                                     gsize              max_results);
-gboolean ide_search_reducer_accepts (IdeSearchReducer  *reducer,
-                                     gfloat             score);
-void     ide_search_reducer_push    (IdeSearchReducer  *reducer,
-                                     IdeSearchResult   *result);
-void     ide_search_reducer_destroy (IdeSearchReducer  *reducer);
+void     ide_search_reducer_init     (IdeSearchReducer  *reducer,
+                                      IdeSearchContext  *context,
+                                      IdeSearchProvider *provider,
+                                      gsize              max_results);
+gboolean ide_search_reducer_accepts  (IdeSearchReducer  *reducer,
+                                      gfloat             score);
+void     ide_search_reducer_push     (IdeSearchReducer  *reducer,
+                                      IdeSearchResult   *result);
+void     ide_search_reducer_push_hit (IdeSearchReducer  *reducer,
+                                      IdeSearchHit      *hit);
+void     ide_search_reducer_flush    (IdeSearchReducer  *reducer);
+void     ide_search_reducer_destroy  (IdeSearchReducer  *reducer);
 
 G_DEFINE_AUTO_CLEANUP_CLEAR_FUNC (IdeSearchReducer, ide_search_reducer_destroy)
 
@@ -0,0 +1,386 @@
+/* ide-search-results.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define G_LOG_DOMAIN "ide-search-results"
+
+#include <string.h>
+
+#include "egg-counter.h"
+
+#include "search/ide-search-provider.h"
+#include "search/ide-search-result.h"
+#include "search/ide-search-results.h"
+
+/**
+ * SECTION:ide-search-results
+ * @title: IdeSearchResults
+ * @short_description: A list model of results for a search provider
+ *
+ * #IdeSearchResults contains the results of a single #IdeSearchProvider,
+ * sorted by score with the best match first.
+ *
+ * Results may be added as #IdeSearchHit records, which are much cheaper
+ * than an #IdeSearchResult. The #IdeSearchResult for a hit is only created
+ * when the item is requested with g_list_model_get_item(), which allows
+ * displays to only pay for the rows they actually show.
+ */
+
+typedef struct
+{
+  IdeSearchHit     hit;
+  IdeSearchResult *result;
+} Item;
+
+struct _IdeSearchResults
+{
+  GObject            parent_instance;
+
+  IdeSearchProvider *provider;
+
+  /* Sorted by score, descending. Contains Item. */
+  GArray            *items;
+
+  guint              max_results;
+};
+
+static void list_model_iface_init (GListModelInterface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (IdeSearchResults, ide_search_results, G_TYPE_OBJECT,
+                         G_IMPLEMENT_INTERFACE (G_TYPE_LIST_MODEL, list_model_iface_init))
+
+EGG_DEFINE_COUNTER (materialized, "IdeSearchResults", "Materialized", "Number of search hits converted to IdeSearchResult")
+
+static void
+item_clear (gpointer data)
+{
+  Item *item = data;
+
+  ide_search_hit_clear (&item->hit);
+  g_clear_object (&item->result);
+}
+
+static gint
+compare_hits_descending (gconstpointer a,
+                         gconstpointer b,
+                         gpointer      user_data)
+{
+  const IdeSearchHit *hit_a = a;
+  const IdeSearchHit *hit_b = b;
+
+  if (hit_a->score < hit_b->score)
+    return 1;
+  else if (hit_a->score > hit_b->score)
+    return -1;
+  else
+    return 0;
+}
+
+IdeSearchResults *
+ide_search_results_new (IdeSearchProvider *provider)
+{
+  IdeSearchResults *self;
+
+  g_return_val_if_fail (IDE_IS_SEARCH_PROVIDER (provider), NULL);
+
+  self = g_object_new (IDE_TYPE_SEARCH_RESULTS, NULL);
+  self->provider = g_object_ref (provider);
+
+  return self;
+}
+
+/**
+ * ide_search_results_get_provider:
+ *
+ * Returns: (transfer none): An #IdeSearchProvider.
+ */
+IdeSearchProvider *
+ide_search_results_get_provider (IdeSearchResults *self)
+{
+  g_return_val_if_fail (IDE_IS_SEARCH_RESULTS (self), NULL);
+
+  return self->provider;
+}
+
+guint
+ide_search_results_get_max_results (IdeSearchResults *self)
+{
+  g_return_val_if_fail (IDE_IS_SEARCH_RESULTS (self), 0);
+
+  return self->max_results;
+}
+
+/**
+ * ide_search_results_set_max_results:
+ * @self: An #IdeSearchResults
+ * @max_results: the maximum number of results, or 0 for no limit
+ *
+ * Sets the maximum number of results to keep. When more results are added,
+ * those with the lowest score are discarded.
+ */
+void
+ide_search_results_set_max_results (IdeSearchResults *self,
+                                    guint             max_results)
+{
+  guint old_len;
+
+  g_return_if_fail (IDE_IS_SEARCH_RESULTS (self));
+
+  self->max_results = max_results ?: G_MAXUINT;
+
+  old_len = self->items->len;
+
+  if (old_len > self->max_results)
+    {
+      g_array_set_size (self->items, self->max_results);
+      g_list_model_items_changed (G_LIST_MODEL (self), self->max_results, old_len - self->max_results, 0);
+    }
+}
+
+/**
+ * ide_search_results_get_score:
+ * @self: An #IdeSearchResults
+ * @position: the position of the item
+ *
+ * Gets the score of the item at @position without creating an
+ * #IdeSearchResult for it.
+ *
+ * Returns: The score of the item.
+ */
+gfloat
+ide_search_results_get_score (IdeSearchResults *self,
+                              guint             position)
+{
+  g_return_val_if_fail (IDE_IS_SEARCH_RESULTS (self), 0.0);
+  g_return_val_if_fail (position < self->items->len, 0.0);
+
+  return g_array_index (self->items, Item, position).hit.score;
+}
+
+/**
+ * ide_search_results_add_hits:
+ * @self: An #IdeSearchResults
+ * @hits: (array length=n_hits): An array of #IdeSearchHit
+ * @n_hits: the number of elements in @hits
+ *
+ * Merges @hits into the results. The contents of each hit are stolen and
+ * the elements of @hits are left zeroed, so the caller may still clear them
+ * with ide_search_hit_clear(). @hits may be reordered.
+ *
+ * This emits a single #GListModel::items-changed for the whole batch.
+ */
+void
+ide_search_results_add_hits (IdeSearchResults *self,
+                             IdeSearchHit     *hits,
+                             guint             n_hits)
+{
+  g_autofree Item *old_items = NULL;
+  guint old_len;
+  guint changed = G_MAXUINT;
+  guint i = 0;
+  guint j = 0;
+
+  g_return_if_fail (IDE_IS_SEARCH_RESULTS (self));
+  g_return_if_fail (hits != NULL || n_hits == 0);
+
+  if (n_hits == 0)
+    return;
+
+  g_qsort_with_data (hits, n_hits, sizeof *hits, compare_hits_descending, NULL);
+
+  /*
+   * Steal the existing items so that we can merge both sorted runs into a
+   * fresh array. Freeing without the segment does not run the clear func.
+   */
+  old_len = self->items->len;
+  old_items = (Item *)(gpointer)g_array_free (self->items, FALSE);
+  self->items = g_array_sized_new (FALSE, FALSE, sizeof (Item), MIN (old_len + n_hits, self->max_results));
+  g_array_set_clear_func (self->items, item_clear);
+
+  while (i < old_len || j < n_hits)
+    {
+      Item item;
+
+      if (j == n_hits || (i < old_len && old_items [i].hit.score >= hits [j].score))
+        {
+          item = old_items [i++];
+        }
+      else
+        {
+          item.hit = hits [j];
+          item.result = NULL;
+          memset (&hits [j], 0, sizeof hits [j]);
+          j++;
+
+          if (changed == G_MAXUINT)
+            changed = self->items->len;
+        }
+
+      if (self->items->len < self->max_results)
+        g_array_append_val (self->items, item);
+      else
+        item_clear (&item);
+    }
+
+  if (changed < self->max_results)
+    g_list_model_items_changed (G_LIST_MODEL (self),
+                                changed,
+                                old_len - changed,
+                                self->items->len - changed);
+}
+
+/**
+ * ide_search_results_add_result:
+ * @self: An #IdeSearchResults
+ * @result: An #IdeSearchResult
+ *
+ * Inserts @result into the results, sorted by its score.
+ */
+void
+ide_search_results_add_result (IdeSearchResults *self,
+                               IdeSearchResult  *result)
+{
+  Item item = { { 0 } };
+  guint old_len;
+  guint lo = 0;
+  guint hi;
+
+  g_return_if_fail (IDE_IS_SEARCH_RESULTS (self));
+  g_return_if_fail (IDE_IS_SEARCH_RESULT (result));
+
+  item.hit.score = ide_search_result_get_score (result);
+
+  /* Insert after any items with an equal score */
+  hi = old_len = self->items->len;
+  while (lo < hi)
+    {
+      guint mid = (lo + hi) / 2;
+
+      if (g_array_index (self->items, Item, mid).hit.score >= item.hit.score)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+  if (lo >= self->max_results)
+    return;
+
+  item.result = g_object_ref (result);
+  g_array_insert_val (self->items, lo, item);
+
+  if (self->items->len > self->max_results)
+    g_array_set_size (self->items, self->max_results);
+
+  g_list_model_items_changed (G_LIST_MODEL (self), lo, old_len - lo, self->items->len - lo);
+}
+
+void
+ide_search_results_remove_result (IdeSearchResults *self,
+                                  IdeSearchResult  *result)
+{
+  guint i;
+
+  g_return_if_fail (IDE_IS_SEARCH_RESULTS (self));
+  g_return_if_fail (IDE_IS_SEARCH_RESULT (result));
+
+  for (i = 0; i < self->items->len; i++)
+    {
+      if (g_array_index (self->items, Item, i).result == result)
+        {
+          g_array_remove_index (self->items, i);
+          g_list_model_items_changed (G_LIST_MODEL (self), i, 1, 0);
+          break;
+        }
+    }
+}
+
+static GType
+ide_search_results_get_item_type (GListModel *model)
+{
+  return IDE_TYPE_SEARCH_RESULT;
+}
+
+static guint
+ide_search_results_get_n_items (GListModel *model)
+{
+  IdeSearchResults *self = (IdeSearchResults *)model;
+
+  g_assert (IDE_IS_SEARCH_RESULTS (self));
+
+  return self->items->len;
+}
+
+static gpointer
+ide_search_results_get_item (GListModel *model,
+                             guint       position)
+{
+  IdeSearchResults *self = (IdeSearchResults *)model;
+  Item *item;
+
+  g_assert (IDE_IS_SEARCH_RESULTS (self));
+
+  if (position >= self->items->len)
+    return NULL;
+
+  item = &g_array_index (self->items, Item, position);
+
+  if (item->result == NULL)
+    {
+      item->result = ide_search_provider_create_result (self->provider, &item->hit);
+      EGG_COUNTER_INC (materialized);
+
+      if (item->result == NULL)
+        return NULL;
+    }
+
+  return g_object_ref (item->result);
+}
+
+static void
+list_model_iface_init (GListModelInterface *iface)
+{
+  iface->get_item_type = ide_search_results_get_item_type;
+  iface->get_n_items = ide_search_results_get_n_items;
+  iface->get_item = ide_search_results_get_item;
+}
+
+static void
+ide_search_results_finalize (GObject *object)
+{
+  IdeSearchResults *self = (IdeSearchResults *)object;
+
+  g_clear_pointer (&self->items, g_array_unref);
+  g_clear_object (&self->provider);
+
+  G_OBJECT_CLASS (ide_search_results_parent_class)->finalize (object);
+}
+
+static void
+ide_search_results_class_init (IdeSearchResultsClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = ide_search_results_finalize;
+}
+
+static void
+ide_search_results_init (IdeSearchResults *self)
+{
+  self->max_results = G_MAXUINT;
+  self->items = g_array_new (FALSE, FALSE, sizeof (Item));
+  g_array_set_clear_func (self->items, item_clear);
+}
@@ -0,0 +1,51 @@
+/* ide-search-results.h
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef IDE_SEARCH_RESULTS_H
+#define IDE_SEARCH_RESULTS_H
+
+#include <gio/gio.h>
+
+#include "ide-types.h"
+
+#include "search/ide-search-hit.h"
+
+G_BEGIN_DECLS
+
+#define IDE_TYPE_SEARCH_RESULTS (ide_search_results_get_type())
+
+G_DECLARE_FINAL_TYPE (IdeSearchResults, ide_search_results, IDE, SEARCH_RESULTS, GObject)
+
+IdeSearchResults  *ide_search_results_new             (IdeSearchProvider *provider);
+IdeSearchProvider *ide_search_results_get_provider    (IdeSearchResults  *self);
+guint              ide_search_results_get_max_results (IdeSearchResults  *self);
+void               ide_search_results_set_max_results (IdeSearchResults  *self,
+                                                       guint              max_results);
+gfloat             ide_search_results_get_score       (IdeSearchResults  *self,
+                                                       guint              position);
+void               ide_search_results_add_hits        (IdeSearchResults  *self,
+                                                       IdeSearchHit      *hits,
+                                                       guint              n_hits);
+void               ide_search_results_add_result      (IdeSearchResults  *self,
+                                                       IdeSearchResult   *result);
+void               ide_search_results_remove_result   (IdeSearchResults  *self,
+                                                       IdeSearchResult   *result);
+
+G_END_DECLS
+
+#endif /* IDE_SEARCH_RESULTS_H */
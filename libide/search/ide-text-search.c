@@ -0,0 +1,1502 @@
+/* ide-text-search.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define G_LOG_DOMAIN "ide-text-search"
+
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE
+#endif
+
+#include <egg-counter.h>
+#include <string.h>
+
+#include "ide-context.h"
+#include "ide-debug.h"
+#include "ide-enums.h"
+
+#include "buffers/ide-unsaved-file.h"
+#include "buffers/ide-unsaved-files.h"
+#include "search/ide-text-search.h"
+#include "threading/ide-thread-pool.h"
+#include "vcs/ide-vcs.h"
+
+/**
+ * SECTION:ide-text-search
+ * @title: IdeTextSearch
+ * @short_description: Search the text of every file in the project
+ *
+ * #IdeTextSearch looks for a string or regular expression in all of the
+ * files of the project that are not ignored by the version control system.
+ *
+ * The file list is walked on a worker thread and the files are searched in
+ * batches on the %IDE_THREAD_POOL_SEARCH thread pool. Files are mapped into
+ * memory rather than read, and each file is scanned with memmem() or
+ * memchr() for a literal part of the query so that only candidate lines are
+ * given to the regular expression engine. Binary files are skipped.
+ *
+ * If a file has unsaved changes in #IdeUnsavedFiles, those contents are
+ * searched instead of the file on disk.
+ *
+ * Matches are delivered in batches from the main loop using the
+ * #IdeTextSearch::matches-found signal while the search is running. To
+ * restart a search as the user types, cancel the #GCancellable given to
+ * ide_text_search_execute_async() and create a new #IdeTextSearch.
+ */
+
+#define FILES_PER_JOB       64
+#define BINARY_CHECK_LEN    8000
+#define MAX_FILE_SIZE       (32 * 1024 * 1024)
+#define MAX_LINE_TEXT       512
+#define MAX_CONTEXT_TEXT    2048
+#define DEFAULT_MAX_MATCHES 10000
+
+struct _IdeTextSearch
+{
+  IdeObject           parent_instance;
+
+  gchar              *query;
+  GFile              *directory;
+
+  IdeTextSearchFlags  flags;
+  guint               context_lines;
+  guint               max_matches;
+  guint               n_matches;
+  guint               n_files;
+
+  guint               active : 1;
+};
+
+typedef struct
+{
+  volatile gint       ref_count;
+
+  /* The walker plus each outstanding job */
+  volatile gint       n_pending;
+  volatile gint       n_matches;
+  volatile gint       n_files;
+
+  IdeTextSearch      *self;
+  GTask              *task;
+  GCancellable       *cancellable;
+  GMainContext       *main_context;
+  IdeVcs             *vcs;
+  GFile              *directory;
+
+  /* Path to GBytes of unsaved content, read-only after creation */
+  GHashTable         *unsaved;
+
+  /* If set, the literal is only a prefilter for the regex */
+  GRegex             *regex;
+  gchar              *literal;
+  gsize               literal_len;
+
+  IdeTextSearchFlags  flags;
+  guint               context_lines;
+  gint                max_matches;
+  gint64              begin_time;
+
+  GMutex              mutex;
+  GArray             *pending_matches;
+  guint               flush_source;
+} SearchState;
+
+typedef struct
+{
+  SearchState *state;
+  GPtrArray   *paths;
+} SearchJob;
+
+enum {
+  PROP_0,
+  PROP_CONTEXT_LINES,
+  PROP_DIRECTORY,
+  PROP_FLAGS,
+  PROP_MAX_MATCHES,
+  PROP_QUERY,
+  N_PROPS
+};
+
+enum {
+  MATCHES_FOUND,
+  N_SIGNALS
+};
+
+G_DEFINE_TYPE (IdeTextSearch, ide_text_search, IDE_TYPE_OBJECT)
+
+EGG_DEFINE_COUNTER (FilesSearched, "TextSearch", "Files Searched", "Number of files searched by IdeTextSearch")
+EGG_DEFINE_COUNTER (BytesSearched, "TextSearch", "Bytes Searched", "Number of bytes searched by IdeTextSearch")
+EGG_DEFINE_HISTOGRAM (SearchLatency, "TextSearch", "Search Latency",
+                      "Time to complete a project text search, in microseconds.")
+
+static GParamSpec *properties [N_PROPS];
+static guint signals [N_SIGNALS];
+
+static SearchState *
+search_state_ref (SearchState *state)
+{
+  g_assert (state != NULL);
+  g_assert (state->ref_count > 0);
+
+  g_atomic_int_inc (&state->ref_count);
+
+  return state;
+}
+
+static void
+search_state_unref (gpointer data)
+{
+  SearchState *state = data;
+
+  g_assert (state != NULL);
+  g_assert (state->ref_count > 0);
+
+  if (g_atomic_int_dec_and_test (&state->ref_count))
+    {
+      g_clear_object (&state->self);
+      g_clear_object (&state->task);
+      g_clear_object (&state->cancellable);
+      g_clear_object (&state->vcs);
+      g_clear_object (&state->directory);
+      g_clear_pointer (&state->main_context, g_main_context_unref);
+      g_clear_pointer (&state->unsaved, g_hash_table_unref);
+      g_clear_pointer (&state->regex, g_regex_unref);
+      g_clear_pointer (&state->literal, g_free);
+      g_clear_pointer (&state->pending_matches, g_array_unref);
+      g_mutex_clear (&state->mutex);
+      g_slice_free (SearchState, state);
+    }
+}
+
+static inline gboolean
+search_state_is_done (SearchState *state)
+{
+  return g_cancellable_is_cancelled (state->cancellable) ||
+         g_atomic_int_get (&state->n_matches) >= state->max_matches;
+}
+
+void
+ide_text_search_match_clear (IdeTextSearchMatch *match)
+{
+  g_return_if_fail (match != NULL);
+
+  g_clear_object (&match->file);
+  g_clear_pointer (&match->line_text, g_free);
+  g_clear_pointer (&match->context, g_free);
+}
+
+static GArray *
+match_array_new (void)
+{
+  GArray *ar;
+
+  ar = g_array_new (FALSE, FALSE, sizeof (IdeTextSearchMatch));
+  g_array_set_clear_func (ar, (GDestroyNotify)ide_text_search_match_clear);
+
+  return ar;
+}
+
+/*
+ * Finds the longest run of characters that must appear in any match of
+ * @pattern so that we can skip lines with memmem() before running the regex.
+ * This is conservative, returning %NULL whenever the pattern is not simple
+ * enough to be sure.
+ */
+static gchar *
+extract_required_literal (const gchar *pattern)
+{
+  g_autoptr(GString) best = g_string_new (NULL);
+  g_autoptr(GString) run = g_string_new (NULL);
+  const gchar *iter;
+  guint depth = 0;
+
+  g_assert (pattern != NULL);
+
+#define BREAK_RUN()                          \
+  G_STMT_START {                             \
+    if (run->len > best->len)                \
+      g_string_assign (best, run->str);      \
+    g_string_truncate (run, 0);              \
+  } G_STMT_END
+
+  for (iter = pattern; *iter != '\0'; iter++)
+    {
+      guchar ch = *iter;
+
+      switch (ch)
+        {
+        case '(':
+          /* Inline options such as (?i) change how the rest is matched */
+          if (iter[1] == '?' && iter[2] != '\0' && strchr ("imsxJUX-", iter[2]) != NULL)
+            return NULL;
+          BREAK_RUN ();
+          depth++;
+          break;
+
+        case '|':
+          /* Alternation inside of a group does not affect the runs outside */
+          if (depth == 0)
+            return NULL;
+          break;
+
+        case ')':
+          BREAK_RUN ();
+          if (depth > 0)
+            depth--;
+          break;
+
+        case '[':
+          BREAK_RUN ();
+          iter++;
+          if (*iter == '^')
+            iter++;
+          if (*iter == ']')
+            iter++;
+          for (; *iter != '\0' && *iter != ']'; iter++)
+            {
+              if (*iter == '\\' && iter[1] != '\0')
+                iter++;
+            }
+          if (*iter == '\0')
+            goto finish;
+          break;
+
+        case '*':
+        case '?':
+        case '{':
+          /* The previous character is optional */
+          if (run->len > 0)
+            g_string_truncate (run, run->len - 1);
+          BREAK_RUN ();
+          if (ch == '{')
+            {
+              while (*iter != '\0' && *iter != '}')
+                iter++;
+              if (*iter == '\0')
+                goto finish;
+            }
+          break;
+
+        case '+':
+        case '.':
+        case '^':
+        case '$':
+          BREAK_RUN ();
+          break;
+
+        case '\\':
+          if (iter[1] == '\0')
+            goto finish;
+          iter++;
+          if (depth == 0 && g_ascii_ispunct (*iter))
+            g_string_append_c (run, *iter);
+          /*
+           * Assertions, character types and single character escapes stand
+           * on their own. Anything else, such as \x{41}, \101, \cA, \k<name>
+           * or \Q...\E, has arguments we do not parse, so give up on them.
+           */
+          else if (g_ascii_isalnum (*iter) && strchr ("bBAzZGKdDwWsShHvVRXNnrtfea", *iter) == NULL)
+            return NULL;
+          else
+            BREAK_RUN ();
+          break;
+
+        default:
+          if (depth == 0 && ch < 0x80)
+            g_string_append_c (run, ch);
+          else
+            BREAK_RUN ();
+          break;
+        }
+    }
+
+finish:
+  BREAK_RUN ();
+
+#undef BREAK_RUN
+
+  if (best->len == 0)
+    return NULL;
+
+  return g_string_free (g_steal_pointer (&best), FALSE);
+}
+
+static const gchar *
+find_literal_caseless (const gchar *haystack,
+                       gsize        haystack_len,
+                       const gchar *needle,
+                       gsize        needle_len)
+{
+  const gchar *end = haystack + haystack_len;
+  const gchar *pos = haystack;
+  const gchar *next_lower = NULL;
+  const gchar *next_upper = NULL;
+  gchar lc = needle [0];
+  gchar uc = g_ascii_toupper (needle [0]);
+
+  /*
+   * Use memchr() to jump to either case of the first character, remembering
+   * where the other case was found so each byte is only scanned once.
+   */
+  if (lc == uc)
+    next_upper = end;
+
+  for (;;)
+    {
+      const gchar *candidate;
+
+      if (next_lower == NULL || next_lower < pos)
+        {
+          next_lower = memchr (pos, lc, end - pos);
+          if (next_lower == NULL)
+            next_lower = end;
+        }
+
+      if (next_upper == NULL || next_upper < pos)
+        {
+          next_upper = memchr (pos, uc, end - pos);
+          if (next_upper == NULL)
+            next_upper = end;
+        }
+
+      candidate = MIN (next_lower, next_upper);
+
+      if ((gsize)(end - candidate) < needle_len)
+        return NULL;
+
+      if (g_ascii_strncasecmp (candidate, needle, needle_len) == 0)
+        return candidate;
+
+      pos = candidate + 1;
+    }
+}
+
+static inline const gchar *
+find_literal (SearchState *state,
+              const gchar *haystack,
+              gsize        haystack_len)
+{
+  if (haystack_len < state->literal_len)
+    return NULL;
+
+  if (state->flags & IDE_TEXT_SEARCH_CASE_SENSITIVE)
+    return memmem (haystack, haystack_len, state->literal, state->literal_len);
+
+  return find_literal_caseless (haystack, haystack_len, state->literal, state->literal_len);
+}
+
+static inline gboolean
+is_word_byte (gchar ch)
+{
+  return g_ascii_isalnum (ch) || ch == '_' || (guchar)ch >= 0x80;
+}
+
+static guint
+count_lines (const gchar *begin,
+             const gchar *end)
+{
+  guint count = 0;
+
+  while (begin < end && NULL != (begin = memchr (begin, '\n', end - begin)))
+    {
+      count++;
+      begin++;
+    }
+
+  return count;
+}
+
+static gchar *
+copy_text (const gchar *begin,
+           const gchar *end,
+           gsize        max_len,
+           gboolean     valid_utf8)
+{
+  gsize len = end - begin;
+  const gchar *invalid;
+  gchar *ret;
+
+  if (len > max_len)
+    {
+      len = max_len;
+      while (valid_utf8 && len > 0 && ((guchar)begin [len] & 0xC0) == 0x80)
+        len--;
+    }
+
+  ret = g_strndup (begin, len);
+
+  if (!valid_utf8)
+    {
+      while (!g_utf8_validate (ret, -1, &invalid))
+        *(gchar *)invalid = '?';
+    }
+
+  return ret;
+}
+
+static gchar *
+copy_context (SearchState *state,
+              const gchar *line_end,
+              const gchar *buffer_end)
+{
+  const gchar *begin;
+  const gchar *end;
+  guint i;
+
+  if (state->context_lines == 0 ||
+      NULL == (begin = memchr (line_end, '\n', buffer_end - line_end)))
+    return NULL;
+
+  begin++;
+
+  for (end = begin, i = 0; i < state->context_lines && end < buffer_end; i++)
+    {
+      const gchar *next = memchr (end, '\n', buffer_end - end);
+      end = next ? next + 1 : buffer_end;
+    }
+
+  if (end > begin && end [-1] == '\n')
+    end--;
+
+  if (end == begin)
+    return NULL;
+
+  return copy_text (begin, end, MAX_CONTEXT_TEXT, g_utf8_validate (begin, end - begin, NULL));
+}
+
+static gboolean
+add_match (SearchState *state,
+           GArray      *matches,
+           GFile      **file,
+           const gchar *path,
+           guint        line,
+           const gchar *line_begin,
+           const gchar *line_end,
+           const gchar *buffer_end,
+           const gchar *match_begin,
+           const gchar *match_end)
+{
+  IdeTextSearchMatch match;
+  gboolean valid_utf8;
+
+  if (g_atomic_int_add (&state->n_matches, 1) >= state->max_matches)
+    return FALSE;
+
+  if (*file == NULL)
+    *file = g_file_new_for_path (path);
+
+  valid_utf8 = g_utf8_validate (line_begin, line_end - line_begin, NULL);
+
+  match.file = g_object_ref (*file);
+  match.line = line;
+  match.line_text = copy_text (line_begin, line_end, MAX_LINE_TEXT, valid_utf8);
+  match.context = copy_context (state, line_end, buffer_end);
+
+  if (valid_utf8)
+    {
+      match.line_offset = g_utf8_strlen (line_begin, match_begin - line_begin);
+      match.length = g_utf8_strlen (match_begin, match_end - match_begin);
+    }
+  else
+    {
+      match.line_offset = match_begin - line_begin;
+      match.length = match_end - match_begin;
+    }
+
+  g_array_append_val (matches, match);
+
+  return TRUE;
+}
+
+/*
+ * Searches a single line, which does not include the trailing newline.
+ * Returns %FALSE if the maximum number of matches was reached.
+ */
+static gboolean
+search_line (SearchState *state,
+             GArray      *matches,
+             GFile      **file,
+             const gchar *path,
+             guint        line,
+             const gchar *begin,
+             const gchar *end,
+             const gchar *buffer_end)
+{
+  if (end > begin && end [-1] == '\r')
+    end--;
+
+  if (state->regex != NULL)
+    {
+      GMatchInfo *match_info = NULL;
+      gboolean ret = TRUE;
+
+      if (!g_utf8_validate (begin, end - begin, NULL))
+        return TRUE;
+
+      g_regex_match_full (state->regex, begin, end - begin, 0, 0, &match_info, NULL);
+
+      while (g_match_info_matches (match_info))
+        {
+          gint match_begin;
+          gint match_end;
+
+          if (g_match_info_fetch_pos (match_info, 0, &match_begin, &match_end) &&
+              match_end > match_begin &&
+              !add_match (state, matches, file, path, line, begin, end, buffer_end,
+                          begin + match_begin, begin + match_end))
+            {
+              ret = FALSE;
+              break;
+            }
+
+          g_match_info_next (match_info, NULL);
+        }
+
+      g_match_info_free (match_info);
+
+      return ret;
+    }
+  else
+    {
+      const gchar *pos = begin;
+      const gchar *found;
+
+      while (NULL != (found = find_literal (state, pos, end - pos)))
+        {
+          const gchar *found_end = found + state->literal_len;
+
+          if (!(state->flags & IDE_TEXT_SEARCH_WHOLE_WORDS) ||
+              ((found == begin || !is_word_byte (found [-1])) &&
+               (found_end == end || !is_word_byte (*found_end))))
+            {
+              if (!add_match (state, matches, file, path, line, begin, end, buffer_end,
+                              found, found_end))
+                return FALSE;
+            }
+
+          pos = found_end;
+        }
+
+      return TRUE;
+    }
+}
+
+static void
+search_buffer (SearchState *state,
+               GArray      *matches,
+               GFile       *for_file,
+               const gchar *path,
+               const gchar *data,
+               gsize        len)
+{
+  g_autoptr(GFile) file = for_file ? g_object_ref (for_file) : NULL;
+  const gchar *end = data + len;
+  const gchar *pos = data;
+  guint line = 0;
+
+  g_assert (state != NULL);
+  g_assert (matches != NULL);
+  g_assert (for_file != NULL || path != NULL);
+
+  if (len == 0 || memchr (data, '\0', MIN (len, BINARY_CHECK_LEN)) != NULL)
+    return;
+
+  EGG_COUNTER_ADD (BytesSearched, len);
+
+  /*
+   * @pos is always at the beginning of line number @line. If we have a
+   * literal, jump straight to the next line containing it instead of
+   * looking at every line.
+   */
+  while (pos < end)
+    {
+      const gchar *line_begin;
+      const gchar *line_end;
+
+      if (state->literal != NULL)
+        {
+          const gchar *found;
+
+          if (NULL == (found = find_literal (state, pos, end - pos)))
+            break;
+
+          for (line_begin = found; line_begin > pos && line_begin [-1] != '\n'; line_begin--)
+            { /* Do Nothing */ }
+
+          line += count_lines (pos, line_begin);
+          line_end = memchr (found, '\n', end - found);
+        }
+      else
+        {
+          line_begin = pos;
+          line_end = memchr (pos, '\n', end - pos);
+        }
+
+      if (line_end == NULL)
+        line_end = end;
+
+      if (!search_line (state, matches, &file, path, line, line_begin, line_end, end))
+        break;
+
+      pos = line_end + 1;
+      line++;
+    }
+}
+
+static void
+search_file (SearchState *state,
+             GArray      *matches,
+             const gchar *path)
+{
+  GMappedFile *mapped;
+  GBytes *bytes;
+
+  g_assert (state != NULL);
+  g_assert (path != NULL);
+
+  EGG_COUNTER_INC (FilesSearched);
+
+  if (NULL != (bytes = g_hash_table_lookup (state->unsaved, path)))
+    {
+      gsize len = 0;
+      const gchar *data = g_bytes_get_data (bytes, &len);
+
+      search_buffer (state, matches, NULL, path, data, len);
+
+      return;
+    }
+
+  if (NULL == (mapped = g_mapped_file_new (path, FALSE, NULL)))
+    return;
+
+  if (g_mapped_file_get_contents (mapped) != NULL)
+    search_buffer (state, matches, NULL, path,
+                   g_mapped_file_get_contents (mapped),
+                   g_mapped_file_get_length (mapped));
+
+  g_mapped_file_unref (mapped);
+}
+
+static void
+search_state_flush (SearchState *state)
+{
+  GArray *matches;
+
+  g_assert (state != NULL);
+  g_assert (g_main_context_is_owner (state->main_context));
+
+  g_mutex_lock (&state->mutex);
+  matches = g_steal_pointer (&state->pending_matches);
+  state->flush_source = 0;
+  g_mutex_unlock (&state->mutex);
+
+  if (matches == NULL)
+    return;
+
+  if (!g_cancellable_is_cancelled (state->cancellable))
+    {
+      state->self->n_matches += matches->len;
+      g_signal_emit (state->self, signals [MATCHES_FOUND], 0, matches);
+    }
+
+  g_array_unref (matches);
+}
+
+static gboolean
+search_state_flush_cb (gpointer data)
+{
+  search_state_flush (data);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+search_state_push_matches (SearchState *state,
+                           GArray      *matches)
+{
+  g_assert (state != NULL);
+  g_assert (matches != NULL);
+
+  if (matches->len == 0)
+    return;
+
+  g_mutex_lock (&state->mutex);
+
+  if (state->pending_matches == NULL)
+    state->pending_matches = match_array_new ();
+
+  /* The array now owns the file and line text */
+  g_array_append_vals (state->pending_matches, matches->data, matches->len);
+  g_array_set_clear_func (matches, NULL);
+  g_array_set_size (matches, 0);
+  g_array_set_clear_func (matches, (GDestroyNotify)ide_text_search_match_clear);
+
+  if (state->flush_source == 0)
+    {
+      GSource *source;
+
+      source = g_idle_source_new ();
+      g_source_set_name (source, "[ide] IdeTextSearch flush");
+      g_source_set_callback (source,
+                             search_state_flush_cb,
+                             search_state_ref (state),
+                             search_state_unref);
+      state->flush_source = g_source_attach (source, state->main_context);
+      g_source_unref (source);
+    }
+
+  g_mutex_unlock (&state->mutex);
+}
+
+static gboolean
+search_state_complete (gpointer data)
+{
+  SearchState *state = data;
+  IdeTextSearch *self = state->self;
+
+  g_assert (state != NULL);
+  g_assert (IDE_IS_TEXT_SEARCH (self));
+
+  search_state_flush (state);
+
+  self->active = FALSE;
+  self->n_files = g_atomic_int_get (&state->n_files);
+
+  EGG_HISTOGRAM_RECORD (SearchLatency, g_get_monotonic_time () - state->begin_time);
+
+  IDE_TRACE_MSG ("Searched %u files for \"%s\" with %u matches",
+                 self->n_files, self->query, self->n_matches);
+
+  /* Returns an error if the search was cancelled */
+  g_task_return_boolean (state->task, TRUE);
+
+  /* Workers may hold the last reference, so drop these on the main thread */
+  g_clear_object (&state->task);
+  g_clear_object (&state->self);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+search_state_release_pending (SearchState *state)
+{
+  g_assert (state != NULL);
+
+  if (g_atomic_int_dec_and_test (&state->n_pending))
+    g_main_context_invoke_full (state->main_context,
+                                G_PRIORITY_DEFAULT,
+                                search_state_complete,
+                                search_state_ref (state),
+                                search_state_unref);
+}
+
+static void
+search_job_worker (gpointer data)
+{
+  SearchJob *job = data;
+  g_autoptr(GArray) matches = NULL;
+  guint i;
+
+  g_assert (job != NULL);
+  g_assert (job->state != NULL);
+  g_assert (job->paths != NULL);
+
+  matches = match_array_new ();
+
+  for (i = 0; i < job->paths->len; i++)
+    {
+      if (search_state_is_done (job->state))
+        break;
+
+      search_file (job->state, matches, g_ptr_array_index (job->paths, i));
+
+      /* Stream results per file so the first matches show up quickly */
+      search_state_push_matches (job->state, matches);
+    }
+
+  search_state_release_pending (job->state);
+
+  g_ptr_array_unref (job->paths);
+  search_state_unref (job->state);
+  g_slice_free (SearchJob, job);
+}
+
+static void
+search_state_push_job (SearchState *state,
+                       GPtrArray   *paths)
+{
+  SearchJob *job;
+
+  g_assert (state != NULL);
+  g_assert (paths != NULL);
+
+  if (paths->len == 0)
+    {
+      g_ptr_array_unref (paths);
+      return;
+    }
+
+  job = g_slice_new0 (SearchJob);
+  job->state = search_state_ref (state);
+  job->paths = paths;
+
+  g_atomic_int_inc (&state->n_pending);
+
+  ide_thread_pool_push (IDE_THREAD_POOL_SEARCH, search_job_worker, job);
+}
+
+static void
+walk_directory (SearchState  *state,
+                GFile        *directory,
+                GPtrArray   **paths)
+{
+  g_autoptr(GFileEnumerator) enumerator = NULL;
+  g_autoptr(GPtrArray) children = NULL;
+  gpointer file_info_ptr;
+  guint i;
+
+  g_assert (state != NULL);
+  g_assert (G_IS_FILE (directory));
+  g_assert (paths != NULL);
+
+  enumerator = g_file_enumerate_children (directory,
+                                          G_FILE_ATTRIBUTE_STANDARD_NAME","
+                                          G_FILE_ATTRIBUTE_STANDARD_TYPE","
+                                          G_FILE_ATTRIBUTE_STANDARD_SIZE,
+                                          G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                          state->cancellable,
+                                          NULL);
+
+  if (enumerator == NULL)
+    return;
+
+  while (!search_state_is_done (state) &&
+         NULL != (file_info_ptr = g_file_enumerator_next_file (enumerator, state->cancellable, NULL)))
+    {
+      g_autoptr(GFileInfo) file_info = file_info_ptr;
+      g_autoptr(GFile) file = NULL;
+      GFileType file_type;
+
+      file_type = g_file_info_get_file_type (file_info);
+
+      if (file_type != G_FILE_TYPE_DIRECTORY && file_type != G_FILE_TYPE_REGULAR)
+        continue;
+
+      file = g_file_get_child (directory, g_file_info_get_name (file_info));
+
+      if (ide_vcs_is_ignored (state->vcs, file, NULL))
+        continue;
+
+      if (file_type == G_FILE_TYPE_DIRECTORY)
+        {
+          /* Recurse after closing this enumerator to limit open descriptors */
+          if (children == NULL)
+            children = g_ptr_array_new_with_free_func (g_object_unref);
+          g_ptr_array_add (children, g_steal_pointer (&file));
+          continue;
+        }
+
+      if (g_file_info_get_size (file_info) > MAX_FILE_SIZE)
+        continue;
+
+      g_ptr_array_add (*paths, g_file_get_path (file));
+      g_atomic_int_inc (&state->n_files);
+
+      if ((*paths)->len == FILES_PER_JOB)
+        {
+          search_state_push_job (state, *paths);
+          *paths = g_ptr_array_new_with_free_func (g_free);
+        }
+    }
+
+  g_clear_object (&enumerator);
+
+  if (children != NULL)
+    {
+      for (i = 0; i < children->len && !search_state_is_done (state); i++)
+        walk_directory (state, g_ptr_array_index (children, i), paths);
+    }
+}
+
+static void
+search_walker (gpointer data)
+{
+  SearchState *state = data;
+  GPtrArray *paths;
+
+  g_assert (state != NULL);
+
+  paths = g_ptr_array_new_with_free_func (g_free);
+  walk_directory (state, state->directory, &paths);
+  search_state_push_job (state, paths);
+
+  search_state_release_pending (state);
+  search_state_unref (state);
+}
+
+static GHashTable *
+snapshot_unsaved_files (IdeContext *context)
+{
+  g_autoptr(GPtrArray) ar = NULL;
+  IdeUnsavedFiles *unsaved_files;
+  GHashTable *ret;
+  guint i;
+
+  g_assert (IDE_IS_CONTEXT (context));
+
+  ret = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify)g_bytes_unref);
+
+  unsaved_files = ide_context_get_unsaved_files (context);
+  ar = ide_unsaved_files_to_array (unsaved_files);
+
+  for (i = 0; i < ar->len; i++)
+    {
+      IdeUnsavedFile *unsaved_file = g_ptr_array_index (ar, i);
+      GFile *file = ide_unsaved_file_get_file (unsaved_file);
+      gchar *path = g_file_get_path (file);
+
+      if (path != NULL)
+        g_hash_table_insert (ret, path, g_bytes_ref (ide_unsaved_file_get_content (unsaved_file)));
+    }
+
+  return ret;
+}
+
+static gboolean
+contains_non_ascii (const gchar *str)
+{
+  for (; *str != '\0'; str++)
+    {
+      if ((guchar)*str >= 0x80)
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+static gboolean
+search_state_compile (SearchState  *state,
+                      const gchar  *query,
+                      GError      **error)
+{
+  GRegexCompileFlags compile_flags = G_REGEX_OPTIMIZE;
+  g_autofree gchar *escaped = NULL;
+  g_autofree gchar *pattern = NULL;
+  gboolean case_sensitive;
+
+  g_assert (state != NULL);
+  g_assert (query != NULL);
+
+  case_sensitive = !!(state->flags & IDE_TEXT_SEARCH_CASE_SENSITIVE);
+
+  /*
+   * Plain ASCII (or case sensitive) strings are matched with memmem() alone.
+   * Anything else goes through GRegex, using a required literal from the
+   * pattern, if any, to skip lines that cannot match.
+   */
+  if (!(state->flags & IDE_TEXT_SEARCH_REGEX) &&
+      (case_sensitive || !contains_non_ascii (query)))
+    {
+      state->literal = case_sensitive ? g_strdup (query) : g_ascii_strdown (query, -1);
+      state->literal_len = strlen (query);
+      return TRUE;
+    }
+
+  if (!(state->flags & IDE_TEXT_SEARCH_REGEX))
+    escaped = g_regex_escape_string (query, -1);
+
+  if (state->flags & IDE_TEXT_SEARCH_WHOLE_WORDS)
+    pattern = g_strdup_printf ("\\b(?:%s)\\b", escaped ? escaped : query);
+  else
+    pattern = g_strdup (escaped ? escaped : query);
+
+  if (!case_sensitive)
+    compile_flags |= G_REGEX_CASELESS;
+
+  if (NULL == (state->regex = g_regex_new (pattern, compile_flags, 0, error)))
+    return FALSE;
+
+  if (escaped == NULL &&
+      NULL != (state->literal = extract_required_literal (query)))
+    {
+      if (!case_sensitive)
+        {
+          gchar *tmp = g_ascii_strdown (state->literal, -1);
+          g_free (state->literal);
+          state->literal = tmp;
+        }
+
+      state->literal_len = strlen (state->literal);
+    }
+
+  return TRUE;
+}
+
+/**
+ * ide_text_search_execute_async:
+ * @self: An #IdeTextSearch
+ * @cancellable: (nullable): A #GCancellable or %NULL
+ * @callback: the callback to execute upon completion
+ * @user_data: user data for @callback
+ *
+ * Starts searching the project. #IdeTextSearch::matches-found is emitted
+ * as matches are found, and @callback is executed once every file has been
+ * searched or the maximum number of matches was reached.
+ *
+ * The contents of #IdeUnsavedFiles are captured when this function is
+ * called, so that later edits do not affect a running search.
+ */
+void
+ide_text_search_execute_async (IdeTextSearch       *self,
+                               GCancellable        *cancellable,
+                               GAsyncReadyCallback  callback,
+                               gpointer             user_data)
+{
+  g_autoptr(GTask) task = NULL;
+  g_autoptr(GError) error = NULL;
+  SearchState *state;
+  IdeContext *context;
+
+  IDE_ENTRY;
+
+  g_return_if_fail (IDE_IS_TEXT_SEARCH (self));
+  g_return_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable));
+
+  task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_source_tag (task, ide_text_search_execute_async);
+
+  if (self->active)
+    {
+      g_task_return_new_error (task,
+                               G_IO_ERROR,
+                               G_IO_ERROR_PENDING,
+                               "The search is already running");
+      IDE_EXIT;
+    }
+
+  if (self->query == NULL || *self->query == '\0')
+    {
+      g_task_return_boolean (task, TRUE);
+      IDE_EXIT;
+    }
+
+  context = ide_object_get_context (IDE_OBJECT (self));
+
+  state = g_slice_new0 (SearchState);
+  state->ref_count = 1;
+  state->n_pending = 1;
+  state->self = g_object_ref (self);
+  state->task = g_object_ref (task);
+  state->cancellable = cancellable ? g_object_ref (cancellable) : g_cancellable_new ();
+  state->main_context = g_main_context_ref_thread_default ();
+  state->vcs = g_object_ref (ide_context_get_vcs (context));
+  state->flags = self->flags;
+  state->context_lines = self->context_lines;
+  state->max_matches = self->max_matches ? MIN (self->max_matches, (guint)G_MAXINT) : G_MAXINT;
+  state->begin_time = g_get_monotonic_time ();
+  g_mutex_init (&state->mutex);
+
+  if (self->directory != NULL)
+    state->directory = g_object_ref (self->directory);
+  else
+    state->directory = g_object_ref (ide_vcs_get_working_directory (state->vcs));
+
+  if (!search_state_compile (state, self->query, &error))
+    {
+      g_task_return_error (task, g_steal_pointer (&error));
+      search_state_unref (state);
+      IDE_EXIT;
+    }
+
+  state->unsaved = snapshot_unsaved_files (context);
+
+  self->active = TRUE;
+  self->n_matches = 0;
+  self->n_files = 0;
+
+  ide_thread_pool_push (IDE_THREAD_POOL_SEARCH, search_walker, state);
+
+  IDE_EXIT;
+}
+
+/**
+ * ide_text_search_search_bytes:
+ * @self: An #IdeTextSearch
+ * @file: the file that @bytes belong to
+ * @bytes: the contents to search
+ * @error: a location for a #GError, or %NULL
+ *
+ * Synchronously searches @bytes with the query of @self, as if they were
+ * the contents of @file. This is useful to update the results for a single
+ * buffer as it is edited, using the same rules as a project-wide search.
+ *
+ * Returns: (transfer full) (element-type Ide.TextSearchMatch): a #GArray of
+ *   #IdeTextSearchMatch, or %NULL if the query is invalid.
+ */
+GArray *
+ide_text_search_search_bytes (IdeTextSearch  *self,
+                              GFile          *file,
+                              GBytes         *bytes,
+                              GError        **error)
+{
+  SearchState *state;
+  GArray *matches = NULL;
+  const gchar *data;
+  gsize len = 0;
+
+  g_return_val_if_fail (IDE_IS_TEXT_SEARCH (self), NULL);
+  g_return_val_if_fail (G_IS_FILE (file), NULL);
+  g_return_val_if_fail (bytes != NULL, NULL);
+
+  if (self->query == NULL || *self->query == '\0')
+    return match_array_new ();
+
+  state = g_slice_new0 (SearchState);
+  state->ref_count = 1;
+  state->cancellable = g_cancellable_new ();
+  state->flags = self->flags;
+  state->context_lines = self->context_lines;
+  state->max_matches = self->max_matches ? MIN (self->max_matches, (guint)G_MAXINT) : G_MAXINT;
+  g_mutex_init (&state->mutex);
+
+  if (search_state_compile (state, self->query, error))
+    {
+      data = g_bytes_get_data (bytes, &len);
+      matches = match_array_new ();
+      search_buffer (state, matches, file, NULL, data, len);
+    }
+
+  search_state_unref (state);
+
+  return matches;
+}
+
+/**
+ * ide_text_search_execute_finish:
+ *
+ * Completes a request to ide_text_search_execute_async().
+ *
+ * Returns: %TRUE if the search completed, otherwise %FALSE and @error is set.
+ */
+gboolean
+ide_text_search_execute_finish (IdeTextSearch  *self,
+                                GAsyncResult   *result,
+                                GError        **error)
+{
+  g_return_val_if_fail (IDE_IS_TEXT_SEARCH (self), FALSE);
+  g_return_val_if_fail (G_IS_TASK (result), FALSE);
+
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
+
+static void
+ide_text_search_finalize (GObject *object)
+{
+  IdeTextSearch *self = (IdeTextSearch *)object;
+
+  g_clear_pointer (&self->query, g_free);
+  g_clear_object (&self->directory);
+
+  G_OBJECT_CLASS (ide_text_search_parent_class)->finalize (object);
+}
+
+static void
+ide_text_search_get_property (GObject    *object,
+                              guint       prop_id,
+                              GValue     *value,
+                              GParamSpec *pspec)
+{
+  IdeTextSearch *self = IDE_TEXT_SEARCH (object);
+
+  switch (prop_id)
+    {
+    case PROP_CONTEXT_LINES:
+      g_value_set_uint (value, self->context_lines);
+      break;
+
+    case PROP_DIRECTORY:
+      g_value_set_object (value, self->directory);
+      break;
+
+    case PROP_FLAGS:
+      g_value_set_flags (value, self->flags);
+      break;
+
+    case PROP_MAX_MATCHES:
+      g_value_set_uint (value, self->max_matches);
+      break;
+
+    case PROP_QUERY:
+      g_value_set_string (value, self->query);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+    }
+}
+
+static void
+ide_text_search_set_property (GObject      *object,
+                              guint         prop_id,
+                              const GValue *value,
+                              GParamSpec   *pspec)
+{
+  IdeTextSearch *self = IDE_TEXT_SEARCH (object);
+
+  switch (prop_id)
+    {
+    case PROP_CONTEXT_LINES:
+      ide_text_search_set_context_lines (self, g_value_get_uint (value));
+      break;
+
+    case PROP_DIRECTORY:
+      ide_text_search_set_directory (self, g_value_get_object (value));
+      break;
+
+    case PROP_FLAGS:
+      self->flags = g_value_get_flags (value);
+      break;
+
+    case PROP_MAX_MATCHES:
+      ide_text_search_set_max_matches (self, g_value_get_uint (value));
+      break;
+
+    case PROP_QUERY:
+      self->query = g_value_dup_string (value);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+    }
+}
+
+static void
+ide_text_search_class_init (IdeTextSearchClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = ide_text_search_finalize;
+  object_class->get_property = ide_text_search_get_property;
+  object_class->set_property = ide_text_search_set_property;
+
+  properties [PROP_CONTEXT_LINES] =
+    g_param_spec_uint ("context-lines",
+                       "Context Lines",
+                       "The number of lines after each match to include in the match",
+                       0, G_MAXUINT, 0,
+                       (G_PARAM_READWRITE | G_PARAM_EXPLICIT_NOTIFY | G_PARAM_STATIC_STRINGS));
+
+  properties [PROP_DIRECTORY] =
+    g_param_spec_object ("directory",
+                         "Directory",
+                         "The directory to search, or NULL for the working directory",
+                         G_TYPE_FILE,
+                         (G_PARAM_READWRITE | G_PARAM_EXPLICIT_NOTIFY | G_PARAM_STATIC_STRINGS));
+
+  properties [PROP_FLAGS] =
+    g_param_spec_flags ("flags",
+                        "Flags",
+                        "The flags for the query",
+                        IDE_TYPE_TEXT_SEARCH_FLAGS,
+                        IDE_TEXT_SEARCH_NONE,
+                        (G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS));
+
+  properties [PROP_MAX_MATCHES] =
+    g_param_spec_uint ("max-matches",
+                       "Max Matches",
+                       "The maximum number of matches, or 0 for no limit",
+                       0, G_MAXUINT, DEFAULT_MAX_MATCHES,
+                       (G_PARAM_READWRITE | G_PARAM_EXPLICIT_NOTIFY | G_PARAM_STATIC_STRINGS));
+
+  properties [PROP_QUERY] =
+    g_param_spec_string ("query",
+                         "Query",
+                         "The text or regular expression to search for",
+                         NULL,
+                         (G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_properties (object_class, N_PROPS, properties);
+
+  /**
+   * IdeTextSearch::matches-found:
+   * @self: An #IdeTextSearch
+   * @matches: (element-type Ide.TextSearchMatch): a #GArray of #IdeTextSearchMatch
+   *
+   * This signal is emitted on the main loop with a batch of new matches
+   * while the search is running. The order of matches between files is
+   * not defined. Handlers must copy anything they want to keep.
+   */
+  signals [MATCHES_FOUND] =
+    g_signal_new ("matches-found",
+                  G_TYPE_FROM_CLASS (klass),
+                  G_SIGNAL_RUN_LAST,
+                  0,
+                  NULL, NULL, NULL,
+                  G_TYPE_NONE,
+                  1,
+                  G_TYPE_ARRAY | G_SIGNAL_TYPE_STATIC_SCOPE);
+}
+
+static void
+ide_text_search_init (IdeTextSearch *self)
+{
+  self->max_matches = DEFAULT_MAX_MATCHES;
+}
+
+IdeTextSearch *
+ide_text_search_new (IdeContext         *context,
+                     const gchar        *query,
+                     IdeTextSearchFlags  flags)
+{
+  g_return_val_if_fail (IDE_IS_CONTEXT (context), NULL);
+  g_return_val_if_fail (query != NULL, NULL);
+
+  return g_object_new (IDE_TYPE_TEXT_SEARCH,
+                       "context", context,
+                       "flags", flags,
+                       "query", query,
+                       NULL);
+}
+
+const gchar *
+ide_text_search_get_query (IdeTextSearch *self)
+{
+  g_return_val_if_fail (IDE_IS_TEXT_SEARCH (self), NULL);
+
+  return self->query;
+}
+
+IdeTextSearchFlags
+ide_text_search_get_flags (IdeTextSearch *self)
+{
+  g_return_val_if_fail (IDE_IS_TEXT_SEARCH (self), 0);
+
+  return self->flags;
+}
+
+/**
+ * ide_text_search_get_directory:
+ *
+ * Gets the directory to search. If %NULL, the working directory of the
+ * version control system is searched.
+ *
+ * Returns: (transfer none) (nullable): A #GFile or %NULL.
+ */
+GFile *
+ide_text_search_get_directory (IdeTextSearch *self)
+{
+  g_return_val_if_fail (IDE_IS_TEXT_SEARCH (self), NULL);
+
+  return self->directory;
+}
+
+void
+ide_text_search_set_directory (IdeTextSearch *self,
+                               GFile         *directory)
+{
+  g_return_if_fail (IDE_IS_TEXT_SEARCH (self));
+  g_return_if_fail (!directory || G_IS_FILE (directory));
+
+  if (g_set_object (&self->directory, directory))
+    g_object_notify_by_pspec (G_OBJECT (self), properties [PROP_DIRECTORY]);
+}
+
+guint
+ide_text_search_get_context_lines (IdeTextSearch *self)
+{
+  g_return_val_if_fail (IDE_IS_TEXT_SEARCH (self), 0);
+
+  return self->context_lines;
+}
+
+/**
+ * ide_text_search_set_context_lines:
+ * @self: An #IdeTextSearch
+ * @context_lines: the number of lines
+ *
+ * Sets the number of lines following each match that are copied into
+ * #IdeTextSearchMatch.context, like `grep -A`.
+ */
+void
+ide_text_search_set_context_lines (IdeTextSearch *self,
+                                   guint          context_lines)
+{
+  g_return_if_fail (IDE_IS_TEXT_SEARCH (self));
+
+  if (self->context_lines != context_lines)
+    {
+      self->context_lines = context_lines;
+      g_object_notify_by_pspec (G_OBJECT (self), properties [PROP_CONTEXT_LINES]);
+    }
+}
+
+guint
+ide_text_search_get_max_matches (IdeTextSearch *self)
+{
+  g_return_val_if_fail (IDE_IS_TEXT_SEARCH (self), 0);
+
+  return self->max_matches;
+}
+
+/**
+ * ide_text_search_set_max_matches:
+ * @self: An #IdeTextSearch
+ * @max_matches: the maximum number of matches, or 0 for no limit
+ *
+ * Sets the number of matches after which the search stops. This only
+ * affects searches started after it is changed.
+ */
+void
+ide_text_search_set_max_matches (IdeTextSearch *self,
+                                 guint          max_matches)
+{
+  g_return_if_fail (IDE_IS_TEXT_SEARCH (self));
+
+  if (self->max_matches != max_matches)
+    {
+      self->max_matches = max_matches;
+      g_object_notify_by_pspec (G_OBJECT (self), properties [PROP_MAX_MATCHES]);
+    }
+}
+
+/**
+ * ide_text_search_get_n_matches:
+ *
+ * Gets the number of matches delivered so far by
+ * #IdeTextSearch::matches-found.
+ */
+guint
+ide_text_search_get_n_matches (IdeTextSearch *self)
+{
+  g_return_val_if_fail (IDE_IS_TEXT_SEARCH (self), 0);
+
+  return self->n_matches;
+}
+
+/**
+ * ide_text_search_get_n_files:
+ *
+ * Gets the number of files that were considered by the last completed
+ * search.
+ */
+guint
+ide_text_search_get_n_files (IdeTextSearch *self)
+{
+  g_return_val_if_fail (IDE_IS_TEXT_SEARCH (self), 0);
+
+  return self->n_files;
+}
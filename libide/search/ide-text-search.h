@@ -0,0 +1,91 @@
+/* ide-text-search.h
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef IDE_TEXT_SEARCH_H
+#define IDE_TEXT_SEARCH_H
+
+#include "ide-object.h"
+
+G_BEGIN_DECLS
+
+#define IDE_TYPE_TEXT_SEARCH (ide_text_search_get_type())
+
+G_DECLARE_FINAL_TYPE (IdeTextSearch, ide_text_search, IDE, TEXT_SEARCH, IdeObject)
+
+typedef enum
+{
+  IDE_TEXT_SEARCH_NONE           = 0,
+  IDE_TEXT_SEARCH_CASE_SENSITIVE = 1 << 0,
+  IDE_TEXT_SEARCH_REGEX          = 1 << 1,
+  IDE_TEXT_SEARCH_WHOLE_WORDS    = 1 << 2,
+} IdeTextSearchFlags;
+
+/**
+ * IdeTextSearchMatch:
+ * @file: the file containing the match
+ * @line_text: the text of the line containing the match, possibly truncated
+ * @context: (nullable): the lines following the match, if
+ *   #IdeTextSearch:context-lines is set
+ * @line: the line of the match, starting from zero
+ * @line_offset: the character offset of the match within the line
+ * @length: the length of the match in characters
+ *
+ * A single match found by #IdeTextSearch.
+ */
+typedef struct
+{
+  GFile *file;
+  gchar *line_text;
+  gchar *context;
+  guint  line;
+  guint  line_offset;
+  guint  length;
+} IdeTextSearchMatch;
+
+IdeTextSearch      *ide_text_search_new               (IdeContext           *context,
+                                                       const gchar          *query,
+                                                       IdeTextSearchFlags    flags);
+const gchar        *ide_text_search_get_query         (IdeTextSearch        *self);
+IdeTextSearchFlags  ide_text_search_get_flags         (IdeTextSearch        *self);
+GFile              *ide_text_search_get_directory     (IdeTextSearch        *self);
+void                ide_text_search_set_directory     (IdeTextSearch        *self,
+                                                       GFile                *directory);
+guint               ide_text_search_get_context_lines (IdeTextSearch        *self);
+void                ide_text_search_set_context_lines (IdeTextSearch        *self,
+                                                       guint                 context_lines);
+guint               ide_text_search_get_max_matches   (IdeTextSearch        *self);
+void                ide_text_search_set_max_matches   (IdeTextSearch        *self,
+                                                       guint                 max_matches);
+guint               ide_text_search_get_n_matches     (IdeTextSearch        *self);
+guint               ide_text_search_get_n_files       (IdeTextSearch        *self);
+void                ide_text_search_execute_async     (IdeTextSearch        *self,
+                                                       GCancellable         *cancellable,
+                                                       GAsyncReadyCallback   callback,
+                                                       gpointer              user_data);
+gboolean            ide_text_search_execute_finish    (IdeTextSearch        *self,
+                                                       GAsyncResult         *result,
+                                                       GError              **error);
+GArray             *ide_text_search_search_bytes      (IdeTextSearch        *self,
+                                                       GFile                *file,
+                                                       GBytes               *bytes,
+                                                       GError              **error);
+void                ide_text_search_match_clear       (IdeTextSearchMatch   *match);
+
+G_END_DECLS
+
+#endif /* IDE_TEXT_SEARCH_H */
@@ -128,6 +128,86 @@ ide_completion_item_fuzzy_match (const gchar *haystack,
   return TRUE;
 }
 
+/**
+ * ide_completion_item_fuzzy_match_folded:
+ * @folded_haystack: the string to be searched, with ASCII characters in lower case.
+ * @casefold_needle: A g_utf8_casefold() version of the needle.
+ * @priority: (out) (allow-none): An optional location for the score of the match
+ *
+ * This is like ide_completion_item_fuzzy_match() but requires that the
+ * haystack was folded to lower case ahead of time, such as when the item
+ * was created. That allows for a single scan of the haystack per needle
+ * character instead of one for each case.
+ *
+ * Returns: %TRUE if @folded_haystack matched @casefold_needle, otherwise %FALSE.
+ */
+gboolean
+ide_completion_item_fuzzy_match_folded (const gchar *folded_haystack,
+                                        const gchar *casefold_needle,
+                                        guint       *priority)
+{
+  const gchar *haystack = folded_haystack;
+  gint real_score = 0;
+
+  for (; *casefold_needle; casefold_needle++)
+    {
+      const gchar *tmp;
+
+      if (!(tmp = strchr (haystack, *casefold_needle)))
+        return FALSE;
+
+      real_score += (tmp - haystack);
+      haystack = tmp;
+    }
+
+  if (priority != NULL)
+    *priority = real_score + strlen (haystack);
+
+  return TRUE;
+}
+
+/**
+ * ide_completion_item_get_char_mask:
+ * @str: a string
+ *
+ * Computes a bitmask of the characters found in @str, ignoring case for
+ * ASCII characters. Letters, digits and underscore each have their own
+ * bit, everything else shares a few bits.
+ *
+ * Compute this once for each item when it is created and once for each
+ * query, then use ide_completion_item_mask_match() to reject items before
+ * performing a fuzzy match.
+ *
+ * Returns: the character mask for @str.
+ */
+guint64
+ide_completion_item_get_char_mask (const gchar *str)
+{
+  guint64 mask = 0;
+
+  g_return_val_if_fail (str != NULL, 0);
+
+  for (; *str; str++)
+    {
+      guchar ch = *str;
+
+      if (ch >= 'a' && ch <= 'z')
+        mask |= G_GUINT64_CONSTANT (1) << (ch - 'a');
+      else if (ch >= 'A' && ch <= 'Z')
+        mask |= G_GUINT64_CONSTANT (1) << (ch - 'A');
+      else if (ch >= '0' && ch <= '9')
+        mask |= G_GUINT64_CONSTANT (1) << (26 + ch - '0');
+      else if (ch == '_')
+        mask |= G_GUINT64_CONSTANT (1) << 36;
+      else if (ch >= 0x80)
+        mask |= G_GUINT64_CONSTANT (1) << 63;
+      else
+        mask |= G_GUINT64_CONSTANT (1) << (37 + (ch % 26));
+    }
+
+  return mask;
+}
+
 gchar *
 ide_completion_item_fuzzy_highlight (const gchar *str,
                                      const gchar *match)
@@ -77,9 +77,32 @@ void               ide_completion_item_set_priority    (IdeCompletionItem   *sel
 gboolean           ide_completion_item_fuzzy_match     (const gchar         *haystack,
                                                         const gchar         *casefold_needle,
                                                         guint               *priority);
+gboolean           ide_completion_item_fuzzy_match_folded
+                                                       (const gchar         *folded_haystack,
+                                                        const gchar         *casefold_needle,
+                                                        guint               *priority);
+guint64            ide_completion_item_get_char_mask   (const gchar         *str);
 gchar             *ide_completion_item_fuzzy_highlight (const gchar         *haystack,
                                                         const gchar         *casefold_query);
 
+/**
+ * ide_completion_item_mask_match:
+ * @haystack_mask: the result of ide_completion_item_get_char_mask() for the haystack
+ * @needle_mask: the result of ide_completion_item_get_char_mask() for the needle
+ *
+ * Checks that every character class in the needle is present in the
+ * haystack. This is a necessary condition for a fuzzy match and can be
+ * used to reject most candidates before looking at their strings.
+ *
+ * Returns: %FALSE if the haystack cannot match the needle.
+ */
+static inline gboolean
+ide_completion_item_mask_match (guint64 haystack_mask,
+                                guint64 needle_mask)
+{
+  return (haystack_mask & needle_mask) == needle_mask;
+}
+
 G_END_DECLS
 
 #endif /* IDE_COMPLETION_ITEM_H */
@@ -22,8 +22,10 @@
 #include <string.h>
 
 #include "ide-debug.h"
+#include "ide-macros.h"
 
 #include "sourceview/ide-completion-results.h"
+#include "util/ide-gtk.h"
 #include "util/ide-list-inline.h"
 
 typedef struct
@@ -73,6 +75,42 @@ typedef struct
    * upon it except for g_list_sort().
    */
   GList *head;
+  /*
+   * heap is a scratch array used to select the best max_results items
+   * when there are more visible items than we want to present. It is
+   * kept around so that successive presents do not need to allocate.
+   */
+  GPtrArray *heap;
+  /*
+   * When only part of the visible items have been presented, context
+   * and provider are the population we are still adding items to, and
+   * vadjustment is the scroll adjustment of the completion window that
+   * tells us when the user nears the end of the list. These are weak
+   * pointers.
+   */
+  GtkSourceCompletionContext  *context;
+  GtkSourceCompletionProvider *provider;
+  GtkAdjustment               *vadjustment;
+  /*
+   * The number of items in the linked list starting at head.
+   */
+  guint n_visible;
+  /*
+   * The number of items at the beginning of the linked list that are
+   * known to be in sorted order. The remainder of the list is in no
+   * particular order.
+   */
+  guint n_sorted;
+  /*
+   * The number of items at the beginning of the linked list that we
+   * have handed to the GtkSourceCompletionContext so far.
+   */
+  guint n_presented;
+  /*
+   * max_results is the number of items to present at once.
+   */
+  guint max_results;
+  guint expand_source;
 } IdeCompletionResultsPrivate;
 
 typedef struct
@@ -83,15 +121,26 @@ typedef struct
                    IdeCompletionItem *);
 } SortState;
 
+typedef struct
+{
+  GCompareDataFunc compare;
+  gpointer         user_data;
+} SelectState;
+
+static void ide_completion_results_untrack (IdeCompletionResults *self);
+
 G_DEFINE_TYPE_WITH_PRIVATE (IdeCompletionResults, ide_completion_results, G_TYPE_OBJECT)
 
 EGG_DEFINE_COUNTER (instances, "IdeCompletionResults", "Instances", "Number of IdeCompletionResults")
 
+#define DEFAULT_MAX_RESULTS 100
+
 #define GET_ITEM(i) ((IdeCompletionItem *)(g_ptr_array_index((priv)->results, (i))))
 #define GET_ITEM_LINK(item) (&((IdeCompletionItem *)(item))->link)
 
 enum {
   PROP_0,
+  PROP_MAX_RESULTS,
   PROP_QUERY,
   LAST_PROP
 };
@@ -135,6 +184,8 @@ ide_completion_results_finalize (GObject *object)
   g_clear_pointer (&priv->query, g_free);
   g_clear_pointer (&priv->replay, g_free);
   g_clear_pointer (&priv->results, g_ptr_array_unref);
+  g_clear_pointer (&priv->heap, g_ptr_array_unref);
+  ide_completion_results_untrack (self);
   priv->head = NULL;
 
   G_OBJECT_CLASS (ide_completion_results_parent_class)->finalize (object);
@@ -171,6 +222,63 @@ ide_completion_results_set_query (IdeCompletionResults *self,
   priv->needs_sort = TRUE;
 }
 
+/**
+ * ide_completion_results_get_max_results:
+ *
+ * Gets the maximum number of items that will be presented to the
+ * #GtkSourceCompletionContext at once. See
+ * ide_completion_results_set_max_results().
+ *
+ * Returns: The maximum number of items, or 0 if unbounded.
+ */
+guint
+ide_completion_results_get_max_results (IdeCompletionResults *self)
+{
+  IdeCompletionResultsPrivate *priv = ide_completion_results_get_instance_private (self);
+
+  g_return_val_if_fail (IDE_IS_COMPLETION_RESULTS (self), 0);
+
+  return priv->max_results;
+}
+
+/**
+ * ide_completion_results_set_max_results:
+ * @max_results: the maximum number of items to present, or 0
+ *
+ * Sets the maximum number of items to present to the completion window.
+ *
+ * When more items match the query, only the best @max_results items are
+ * selected, sorted and presented, which is much cheaper than sorting the
+ * entire result set. The following items are added to the completion window
+ * in chunks of @max_results when the user scrolls towards the end of it.
+ *
+ * Set @max_results to 0 to always present and sort every matching item.
+ */
+void
+ide_completion_results_set_max_results (IdeCompletionResults *self,
+                                        guint                 max_results)
+{
+  IdeCompletionResultsPrivate *priv = ide_completion_results_get_instance_private (self);
+
+  g_return_if_fail (IDE_IS_COMPLETION_RESULTS (self));
+
+  if (priv->max_results != max_results)
+    {
+      priv->max_results = max_results;
+      g_object_notify_by_pspec (G_OBJECT (self), properties [PROP_MAX_RESULTS]);
+    }
+}
+
+void
+ide_completion_results_invalidate_sort (IdeCompletionResults *self)
+{
+  IdeCompletionResultsPrivate *priv = ide_completion_results_get_instance_private (self);
+
+  g_return_if_fail (IDE_IS_COMPLETION_RESULTS (self));
+
+  priv->needs_sort = TRUE;
+}
+
 gboolean
 ide_completion_results_replay (IdeCompletionResults *self,
                                const gchar          *query)
@@ -226,6 +334,8 @@ ide_completion_results_update_links (IdeCompletionResults *self)
   g_assert (IDE_IS_COMPLETION_RESULTS (self));
   g_assert (priv->results != NULL);
 
+  priv->n_visible = priv->results->len;
+
   if (G_UNLIKELY (priv->results->len == 0))
     {
       priv->head = NULL;
@@ -305,6 +415,8 @@ ide_completion_results_refilter (IdeCompletionResults *self)
 
           if (iter->next != NULL)
             iter->next->prev = iter->prev;
+
+          priv->n_visible--;
         }
     }
 }
@@ -321,6 +433,13 @@ compare_fast (const IdeCompletionItem *left,
     return 0;
 }
 
+static gint
+compare_fast_with_data (gconstpointer a,
+                        gconstpointer b,
+                        gpointer      user_data)
+{
+  return compare_fast (a, b);
+}
 
 static gint
 sort_state_compare (gconstpointer a,
@@ -332,34 +451,451 @@ sort_state_compare (gconstpointer a,
   return state->compare (state->self, (IdeCompletionItem *)a, (IdeCompletionItem *)b);
 }
 
+static gint
+select_state_compare (gconstpointer a,
+                      gconstpointer b,
+                      gpointer      user_data)
+{
+  SelectState *state = user_data;
+
+  return state->compare (*(gpointer *)a, *(gpointer *)b, state->user_data);
+}
+
+/*
+ * The heap is a max-heap, the root is the worst item we have selected
+ * so far and the first one to be evicted when a better item comes along.
+ */
+static inline void
+heap_sift_up (GPtrArray        *heap,
+              guint             i,
+              GCompareDataFunc  compare,
+              gpointer          user_data)
+{
+  gpointer *pdata = heap->pdata;
+
+  while (i > 0)
+    {
+      guint parent = (i - 1) / 2;
+      gpointer tmp;
+
+      if (compare (pdata [i], pdata [parent], user_data) <= 0)
+        break;
+
+      tmp = pdata [i];
+      pdata [i] = pdata [parent];
+      pdata [parent] = tmp;
+
+      i = parent;
+    }
+}
+
+static inline void
+heap_sift_down (GPtrArray        *heap,
+                guint             i,
+                GCompareDataFunc  compare,
+                gpointer          user_data)
+{
+  gpointer *pdata = heap->pdata;
+  guint len = heap->len;
+
+  for (;;)
+    {
+      guint left = (i * 2) + 1;
+      guint right = left + 1;
+      guint largest = i;
+      gpointer tmp;
+
+      if (left < len && compare (pdata [left], pdata [largest], user_data) > 0)
+        largest = left;
+
+      if (right < len && compare (pdata [right], pdata [largest], user_data) > 0)
+        largest = right;
+
+      if (largest == i)
+        break;
+
+      tmp = pdata [i];
+      pdata [i] = pdata [largest];
+      pdata [largest] = tmp;
+
+      i = largest;
+    }
+}
+
+/*
+ * Selects the best @limit items from the visible items following @before
+ * (or from the head of the list if @before is %NULL) using a bounded heap,
+ * and relinks the list so that they come directly after @before, in sorted
+ * order. This is O(n log k) instead of the O(n log n) required to sort the
+ * entire list, and the items we did not select are never compared against
+ * each other.
+ */
+static void
+ide_completion_results_select (IdeCompletionResults *self,
+                               GList                *before,
+                               guint                 limit,
+                               GCompareDataFunc      compare,
+                               gpointer              user_data)
+{
+  IdeCompletionResultsPrivate *priv = ide_completion_results_get_instance_private (self);
+  SelectState state = { compare, user_data };
+  GList rest = { 0 };
+  GList *tail = &rest;
+  GList *prev = before;
+  GList *next;
+  guint i;
+
+  g_assert (IDE_IS_COMPLETION_RESULTS (self));
+  g_assert (limit > 0);
+
+  g_ptr_array_set_size (priv->heap, 0);
+
+  for (GList *iter = (before != NULL) ? before->next : priv->head; iter != NULL; iter = next)
+    {
+      IdeCompletionItem *item = iter->data;
+      IdeCompletionItem *evicted;
+
+      next = iter->next;
+
+      if (priv->heap->len < limit)
+        {
+          g_ptr_array_add (priv->heap, item);
+          heap_sift_up (priv->heap, priv->heap->len - 1, compare, user_data);
+          continue;
+        }
+
+      if (compare (item, g_ptr_array_index (priv->heap, 0), user_data) < 0)
+        {
+          evicted = g_ptr_array_index (priv->heap, 0);
+          priv->heap->pdata [0] = item;
+          heap_sift_down (priv->heap, 0, compare, user_data);
+        }
+      else
+        {
+          evicted = item;
+        }
+
+      GET_ITEM_LINK (evicted)->prev = tail;
+      tail->next = GET_ITEM_LINK (evicted);
+      tail = GET_ITEM_LINK (evicted);
+    }
+
+  tail->next = NULL;
+
+  g_qsort_with_data (priv->heap->pdata,
+                     priv->heap->len,
+                     sizeof (gpointer),
+                     select_state_compare,
+                     &state);
+
+  for (i = 0; i < priv->heap->len; i++)
+    {
+      GList *link = GET_ITEM_LINK (g_ptr_array_index (priv->heap, i));
+
+      link->prev = prev;
+
+      if (prev != NULL)
+        prev->next = link;
+      else
+        priv->head = link;
+
+      prev = link;
+    }
+
+  g_assert (prev != NULL);
+
+  prev->next = rest.next;
+  if (rest.next != NULL)
+    rest.next->prev = prev;
+
+  g_ptr_array_set_size (priv->heap, 0);
+}
+
+/*
+ * Sorts the visible items following @before, which is the @offset'th
+ * item in the list. Only the best max_results items are sorted when
+ * more than that remain.
+ */
 static void
-ide_completion_results_resort (IdeCompletionResults *self)
+ide_completion_results_resort (IdeCompletionResults *self,
+                               GList                *before,
+                               guint                 offset)
 {
   IdeCompletionResultsPrivate *priv = ide_completion_results_get_instance_private (self);
   IdeCompletionResultsClass *klass = IDE_COMPLETION_RESULTS_GET_CLASS (self);
   SortState state;
+  GList *head;
+
+  g_assert (IDE_IS_COMPLETION_RESULTS (self));
+  g_assert (offset <= priv->n_visible);
+
+  state.self = self;
+  state.compare = klass->compare;
+
+  if (priv->max_results > 0 && (priv->n_visible - offset) > priv->max_results)
+    {
+      if (G_LIKELY (klass->compare == NULL))
+        ide_completion_results_select (self, before, priv->max_results, compare_fast_with_data, NULL);
+      else
+        ide_completion_results_select (self, before, priv->max_results, sort_state_compare, &state);
+      priv->n_sorted = offset + priv->max_results;
+      return;
+    }
+
+  priv->n_sorted = priv->n_visible;
+
+  head = (before != NULL) ? before->next : priv->head;
+
+  if (head == NULL)
+    return;
+
+  head->prev = NULL;
 
   /*
    * Instead of invoking the vfunc for every item, save ourself an extra
    * dereference and call g_list_sort() directly with our compare funcs.
    */
   if (G_LIKELY (klass->compare == NULL))
+    head = ide_list_sort (head, (GCompareFunc)compare_fast);
+  else
+    head = ide_list_sort_with_data (head, sort_state_compare, &state);
+
+  if (before != NULL)
+    {
+      before->next = head;
+      head->prev = before;
+    }
+  else
+    {
+      priv->head = head;
+    }
+}
+
+/*
+ * Adds @n_items items starting from @first to @context. The list is
+ * temporarily terminated after the last of them, GtkSourceCompletion
+ * copies what it needs so we can restore the link immediately afterwards.
+ */
+static void
+ide_completion_results_add_range (IdeCompletionResults        *self,
+                                  GtkSourceCompletionProvider *provider,
+                                  GtkSourceCompletionContext  *context,
+                                  GList                       *first,
+                                  guint                        n_items,
+                                  gboolean                     finished)
+{
+  GList *last = first;
+  GList *rest;
+  guint i;
+
+  g_assert (IDE_IS_COMPLETION_RESULTS (self));
+  g_assert (first != NULL);
+  g_assert (n_items > 0);
+
+  for (i = 1; i < n_items; i++)
+    last = last->next;
+
+  rest = last->next;
+  last->next = NULL;
+  gtk_source_completion_context_add_proposals (context, provider, first, finished);
+  last->next = rest;
+}
+
+static gboolean
+ide_completion_results_expand_cb (gpointer user_data)
+{
+  IdeCompletionResults *self = user_data;
+  IdeCompletionResultsPrivate *priv = ide_completion_results_get_instance_private (self);
+  GList *last;
+  guint n_items;
+  guint i;
+
+  IDE_ENTRY;
+
+  g_assert (IDE_IS_COMPLETION_RESULTS (self));
+  g_assert (priv->n_presented > 0);
+  g_assert (priv->n_presented < priv->n_visible);
+
+  if (priv->context == NULL || priv->provider == NULL)
+    {
+      priv->expand_source = 0;
+      ide_completion_results_untrack (self);
+      IDE_RETURN (G_SOURCE_REMOVE);
+    }
+
+  last = priv->head;
+  for (i = 1; i < priv->n_presented; i++)
+    last = last->next;
+
+  n_items = MIN (priv->max_results, priv->n_visible - priv->n_presented);
+
+  if (priv->n_sorted < priv->n_presented + n_items)
+    ide_completion_results_resort (self, last, priv->n_presented);
+
+  priv->n_presented += n_items;
+
+  /*
+   * The population is still running, so the new items are appended to
+   * the rows that are already displayed. The selection, scroll position
+   * and filtering of the completion window are left untouched.
+   */
+  ide_completion_results_add_range (self,
+                                    priv->provider,
+                                    priv->context,
+                                    last->next,
+                                    n_items,
+                                    priv->n_presented == priv->n_visible);
+
+  if (priv->n_presented == priv->n_visible)
     {
-      priv->head = ide_list_sort (priv->head, (GCompareFunc)compare_fast);
+      priv->expand_source = 0;
+      ide_completion_results_untrack (self);
+      IDE_RETURN (G_SOURCE_REMOVE);
+    }
+
+  /*
+   * Without a scroll adjustment to watch, keep adding the remaining
+   * items from idle, like the words provider does.
+   */
+  if (priv->vadjustment == NULL)
+    IDE_RETURN (G_SOURCE_CONTINUE);
+
+  priv->expand_source = 0;
+
+  IDE_RETURN (G_SOURCE_REMOVE);
+}
+
+static void
+ide_completion_results_value_changed (IdeCompletionResults *self,
+                                      GtkAdjustment        *adjustment)
+{
+  IdeCompletionResultsPrivate *priv = ide_completion_results_get_instance_private (self);
+  gdouble page_size;
+
+  g_assert (IDE_IS_COMPLETION_RESULTS (self));
+  g_assert (GTK_IS_ADJUSTMENT (adjustment));
+
+  if (priv->context == NULL || priv->expand_source != 0)
+    return;
+
+  /* Expand once the user is within a page of the end of the list. */
+  page_size = gtk_adjustment_get_page_size (adjustment);
+
+  if (gtk_adjustment_get_value (adjustment) + (page_size * 2) >= gtk_adjustment_get_upper (adjustment))
+    priv->expand_source = g_idle_add_full (G_PRIORITY_LOW,
+                                           ide_completion_results_expand_cb,
+                                           self,
+                                           NULL);
+}
+
+/*
+ * GtkSourceCompletion does not expose the tree view of its window, but
+ * the info window is transient for it, so we can find the scroll
+ * adjustment of the proposals from there.
+ */
+static GtkAdjustment *
+ide_completion_results_find_vadjustment (GtkSourceCompletionContext *context)
+{
+  g_autoptr(GtkSourceCompletion) completion = NULL;
+  GtkSourceCompletionInfo *info;
+  GtkWindow *window;
+  GtkWidget *tree_view;
+
+  g_assert (GTK_SOURCE_IS_COMPLETION_CONTEXT (context));
+
+  g_object_get (context, "completion", &completion, NULL);
+
+  if (completion == NULL ||
+      NULL == (info = gtk_source_completion_get_info_window (completion)) ||
+      NULL == (window = gtk_window_get_transient_for (GTK_WINDOW (info))) ||
+      NULL == (tree_view = ide_widget_find_child_typed (GTK_WIDGET (window), GTK_TYPE_TREE_VIEW)))
+    return NULL;
+
+  return gtk_scrollable_get_vadjustment (GTK_SCROLLABLE (tree_view));
+}
+
+static void
+ide_completion_results_untrack (IdeCompletionResults *self)
+{
+  IdeCompletionResultsPrivate *priv = ide_completion_results_get_instance_private (self);
+
+  g_assert (IDE_IS_COMPLETION_RESULTS (self));
+
+  ide_clear_source (&priv->expand_source);
+
+  if (priv->context != NULL)
+    {
+      g_signal_handlers_disconnect_by_data (priv->context, self);
+      ide_clear_weak_pointer (&priv->context);
+    }
+
+  if (priv->vadjustment != NULL)
+    {
+      g_signal_handlers_disconnect_by_data (priv->vadjustment, self);
+      ide_clear_weak_pointer (&priv->vadjustment);
+    }
+
+  ide_clear_weak_pointer (&priv->provider);
+}
+
+static void
+ide_completion_results_track (IdeCompletionResults        *self,
+                              GtkSourceCompletionProvider *provider,
+                              GtkSourceCompletionContext  *context)
+{
+  IdeCompletionResultsPrivate *priv = ide_completion_results_get_instance_private (self);
+  GtkAdjustment *vadjustment;
+
+  g_assert (IDE_IS_COMPLETION_RESULTS (self));
+  g_assert (GTK_SOURCE_IS_COMPLETION_PROVIDER (provider));
+  g_assert (GTK_SOURCE_IS_COMPLETION_CONTEXT (context));
+
+  ide_set_weak_pointer (&priv->context, context);
+  ide_set_weak_pointer (&priv->provider, provider);
+
+  g_signal_connect_object (context,
+                           "cancelled",
+                           G_CALLBACK (ide_completion_results_untrack),
+                           self,
+                           G_CONNECT_SWAPPED);
+
+  vadjustment = ide_completion_results_find_vadjustment (context);
+
+  if (vadjustment != NULL)
+    {
+      ide_set_weak_pointer (&priv->vadjustment, vadjustment);
+      g_signal_connect_object (vadjustment,
+                               "value-changed",
+                               G_CALLBACK (ide_completion_results_value_changed),
+                               self,
+                               G_CONNECT_SWAPPED);
       return;
     }
 
-  state.self = self;
-  state.compare = klass->compare;
-  priv->head = ide_list_sort_with_data (priv->head, sort_state_compare, &state);
+  priv->expand_source = g_idle_add_full (G_PRIORITY_LOW,
+                                         ide_completion_results_expand_cb,
+                                         self,
+                                         NULL);
 }
 
+/**
+ * ide_completion_results_present:
+ *
+ * Filters and sorts the results for the current query and adds them to
+ * @context.
+ *
+ * If more items match than #IdeCompletionResults:max-results, only the
+ * best items are sorted and added, and the population of @context is left
+ * running. The following items are added to @context when the user scrolls
+ * towards the end of the completion window.
+ */
 void
 ide_completion_results_present (IdeCompletionResults        *self,
                                 GtkSourceCompletionProvider *provider,
                                 GtkSourceCompletionContext  *context)
 {
   IdeCompletionResultsPrivate *priv = ide_completion_results_get_instance_private (self);
+  guint n_present;
 
   g_return_if_fail (IDE_IS_COMPLETION_RESULTS (self));
   g_return_if_fail (GTK_SOURCE_IS_COMPLETION_PROVIDER (provider));
@@ -367,18 +903,33 @@ ide_completion_results_present (IdeCompletionResults        *self,
   g_return_if_fail (priv->query != NULL);
   g_return_if_fail (priv->replay != NULL);
 
+  ide_completion_results_untrack (self);
+
   if (priv->needs_refilter)
     {
       ide_completion_results_refilter (self);
       priv->needs_refilter = FALSE;
     }
 
-  if (priv->needs_sort)
+  n_present = priv->n_visible;
+  if (priv->max_results > 0)
+    n_present = MIN (n_present, priv->max_results);
+
+  if (priv->needs_sort || priv->n_sorted < n_present)
     {
-      ide_completion_results_resort (self);
+      ide_completion_results_resort (self, NULL, 0);
       priv->needs_sort = FALSE;
     }
 
+  priv->n_presented = n_present;
+
+  if (n_present < priv->n_visible)
+    {
+      ide_completion_results_add_range (self, provider, context, priv->head, n_present, FALSE);
+      ide_completion_results_track (self, provider, context);
+      return;
+    }
+
   gtk_source_completion_context_add_proposals (context, provider, priv->head, TRUE);
 }
 
@@ -392,6 +943,10 @@ ide_completion_results_get_property (GObject    *object,
 
   switch (prop_id)
     {
+    case PROP_MAX_RESULTS:
+      g_value_set_uint (value, ide_completion_results_get_max_results (self));
+      break;
+
     case PROP_QUERY:
       g_value_set_string (value, ide_completion_results_get_query (self));
       break;
@@ -411,6 +966,10 @@ ide_completion_results_set_property (GObject      *object,
 
   switch (prop_id)
     {
+    case PROP_MAX_RESULTS:
+      ide_completion_results_set_max_results (self, g_value_get_uint (value));
+      break;
+
     case PROP_QUERY:
       ide_completion_results_set_query (self, g_value_get_string (value));
       break;
@@ -429,6 +988,15 @@ ide_completion_results_class_init (IdeCompletionResultsClass *klass)
   object_class->get_property = ide_completion_results_get_property;
   object_class->set_property = ide_completion_results_set_property;
 
+  properties [PROP_MAX_RESULTS] =
+    g_param_spec_uint ("max-results",
+                       "Max Results",
+                       "The maximum number of results to present at once, or 0 for all",
+                       0,
+                       G_MAXUINT,
+                       DEFAULT_MAX_RESULTS,
+                       (G_PARAM_READWRITE | G_PARAM_EXPLICIT_NOTIFY | G_PARAM_STATIC_STRINGS));
+
   properties [PROP_QUERY] =
     g_param_spec_string ("query",
                          "Query",
@@ -447,6 +1015,8 @@ ide_completion_results_init (IdeCompletionResults *self)
   EGG_COUNTER_INC (instances);
 
   priv->results = g_ptr_array_new_with_free_func (g_object_unref);
+  priv->heap = g_ptr_array_new ();
   priv->head = NULL;
+  priv->max_results = DEFAULT_MAX_RESULTS;
   priv->query = NULL;
 }
@@ -1724,11 +1724,32 @@ ide_source_view_movements_line_percentage (Movement *mv)
   ide_source_view_movements_first_nonspace_char (mv);
 }
 
+static IdeBracketIndex *
+get_bracket_index (Movement *mv)
+{
+  GtkTextBuffer *buffer = gtk_text_iter_get_buffer (&mv->insert);
+  IdeBracketIndex *index;
+
+  if (!IDE_IS_BUFFER (buffer))
+    return NULL;
+
+  /*
+   * The index skips brackets within C-style strings and comments. For
+   * other languages that would be wrong, so use the plain scan below.
+   */
+  index = ide_buffer_get_bracket_index (IDE_BUFFER (buffer));
+  if (!ide_bracket_index_get_syntax_supported (index))
+    return NULL;
+
+  return index;
+}
+
 static void
 ide_source_view_movements_previous_unmatched (Movement *mv,
                                               gunichar  target,
                                               gunichar  opposite)
 {
+  IdeBracketIndex *index;
   GtkTextIter copy;
   guint count = 1;
 
@@ -1736,6 +1757,13 @@ ide_source_view_movements_previous_unmatched (Movement *mv,
   g_assert (target);
   g_assert (opposite);
 
+  if ((index = get_bracket_index (mv)))
+    {
+      if (ide_bracket_index_backward_find_unmatched (index, &mv->insert, target) && !mv->exclusive)
+        gtk_text_iter_forward_char (&mv->insert);
+      return;
+    }
+
   copy = mv->insert;
 
   do
@@ -1772,6 +1800,7 @@ ide_source_view_movements_next_unmatched (Movement *mv,
                                           gunichar  target,
                                           gunichar  opposite)
 {
+  IdeBracketIndex *index;
   GtkTextIter copy;
   guint count = 1;
 
@@ -1781,6 +1810,19 @@ ide_source_view_movements_next_unmatched (Movement *mv,
 
   copy = mv->insert;
 
+  if ((index = get_bracket_index (mv)))
+    {
+      /* Like below, the character under the cursor is not considered */
+      if (gtk_text_iter_forward_char (&copy) &&
+          ide_bracket_index_forward_find_unmatched (index, &copy, target))
+        {
+          mv->insert = copy;
+          if (!mv->exclusive)
+            gtk_text_iter_forward_char (&mv->insert);
+        }
+      return;
+    }
+
   do
     {
       gunichar ch;
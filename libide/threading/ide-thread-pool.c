@@ -18,18 +18,57 @@
 
 #define G_LOG_DOMAIN "ide-thread-pool"
 
+#include "config.h"
+
 #include <egg-counter.h>
+#include <stdlib.h>
 
 #include "ide-debug.h"
 
 #include "threading/ide-thread-pool.h"
+#include "util/ide-battery-monitor.h"
+
+#define MIN_THREADS       3
+#define MAX_THREADS       8
+#define BACKGROUND_BUDGET 1
+#define GOVERNOR_INTERVAL (G_USEC_PER_SEC * 5)
 
-#define COMPILER_MAX_THREADS 4
-#define INDEXER_MAX_THREADS  1
+/*
+ * All work is run by a single set of worker threads. Each priority class
+ * has its own FIFO queue, and idle workers always take the oldest item of
+ * the most important class that is allowed to run.
+ *
+ * A class is allowed to run while the number of running items of that class
+ * or any less important class is below the budget of the class. Budgets
+ * strictly increase with importance, so every class always has a worker
+ * that less important classes cannot take: interactive work always finds a
+ * worker even while visible work is busy, and visible work always finds
+ * one even while indexers are busy. This is why we need at least three
+ * workers.
+ *
+ * Background (and idle) work shares a budget of a single worker, the same
+ * concurrency the indexer pool had before all work shared one set of
+ * threads. Indexers are I/O heavy and gain little from running wide.
+ *
+ * Work items for GTask that have been cancelled while queued are completed
+ * with G_IO_ERROR_CANCELLED without running the worker. They do not count
+ * against any budget.
+ *
+ * The governor checks every few seconds whether we are on battery or the
+ * system load exceeds the number of processors. While that is the case,
+ * background and idle work is deferred entirely, while interactive and
+ * visible work keep all of their threads. Workers wake up for the next
+ * check while work is deferred, so it resumes on its own once the system
+ * recovers. Setting the environment variable IDE_THREAD_POOL_GOVERNOR=0
+ * disables the governor.
+ */
 
 typedef struct
 {
-  int type;
+  GList                  link;
+  int                    type;
+  IdeThreadPoolPriority  priority;
+  gint64                 queued_at;
   union {
     struct {
       GTask           *task;
@@ -42,20 +81,347 @@ typedef struct
   };
 } WorkItem;
 
+typedef struct
+{
+  GMutex  mutex;
+  GCond   cond;
+  GQueue  queues [IDE_THREAD_POOL_PRIORITY_LAST];
+  guint   running [IDE_THREAD_POOL_PRIORITY_LAST];
+  guint   budget [IDE_THREAD_POOL_PRIORITY_LAST];
+  guint   n_threads;
+  gint64  next_governor_check;
+  gint    throttled;
+  gint64  last_on_battery;
+  gint64  last_load;
+  guint   governor_enabled : 1;
+} Scheduler;
+
 EGG_DEFINE_COUNTER (TotalTasks, "ThreadPool", "Total Tasks", "Total number of tasks processed.")
 EGG_DEFINE_COUNTER (QueuedTasks, "ThreadPool", "Queued Tasks", "Current number of pending tasks.")
+EGG_DEFINE_COUNTER (CancelledTasks, "ThreadPool", "Cancelled Tasks", "Total number of tasks cancelled before they ran.")
+EGG_DEFINE_COUNTER (Throttled, "ThreadPool", "Throttled", "1 while background work is throttled, otherwise 0.")
+EGG_DEFINE_COUNTER (OnBattery, "ThreadPool", "On Battery", "1 while the governor sees the system on battery, otherwise 0.")
+EGG_DEFINE_COUNTER (LoadAverage, "ThreadPool", "Load Average", "The last one minute load average seen by the governor, in hundredths.")
+EGG_DEFINE_HISTOGRAM (InteractiveWait, "ThreadPool", "Interactive Wait", "Time interactive tasks spent queued, in microseconds.")
+EGG_DEFINE_HISTOGRAM (VisibleWait, "ThreadPool", "Visible Wait", "Time visible tasks spent queued, in microseconds.")
+EGG_DEFINE_HISTOGRAM (BackgroundWait, "ThreadPool", "Background Wait", "Time background tasks spent queued, in microseconds.")
+EGG_DEFINE_HISTOGRAM (IdleWait, "ThreadPool", "Idle Wait", "Time idle tasks spent queued, in microseconds.")
+
+static EggHistogram *wait_histograms [IDE_THREAD_POOL_PRIORITY_LAST] = {
+  &InteractiveWait_hist,
+  &VisibleWait_hist,
+  &BackgroundWait_hist,
+  &IdleWait_hist,
+};
 
-static GThreadPool *thread_pools [IDE_THREAD_POOL_LAST];
+static const IdeThreadPoolPriority default_priorities [IDE_THREAD_POOL_LAST] = {
+  IDE_THREAD_POOL_PRIORITY_VISIBLE,     /* IDE_THREAD_POOL_COMPILER */
+  IDE_THREAD_POOL_PRIORITY_BACKGROUND,  /* IDE_THREAD_POOL_INDEXER */
+  IDE_THREAD_POOL_PRIORITY_VISIBLE,     /* IDE_THREAD_POOL_SEARCH */
+};
+
+static Scheduler scheduler;
+static gboolean is_worker_process;
 
 enum {
   TYPE_TASK,
   TYPE_FUNC,
 };
 
-static inline GThreadPool *
-ide_thread_pool_get_pool (IdeThreadPoolKind kind)
+static gboolean
+work_item_is_cancelled (WorkItem *work_item)
+{
+  return work_item->type == TYPE_TASK &&
+         g_cancellable_is_cancelled (g_task_get_cancellable (work_item->task.task));
+}
+
+static void
+ide_thread_pool_set_budgets_locked (gboolean throttled)
+{
+  guint n_threads = scheduler.n_threads;
+
+  g_assert (n_threads >= MIN_THREADS);
+
+  scheduler.budget [IDE_THREAD_POOL_PRIORITY_INTERACTIVE] = n_threads;
+  scheduler.budget [IDE_THREAD_POOL_PRIORITY_VISIBLE] = n_threads - 1;
+
+  /* Indexers and other background work wait until we are no longer throttled */
+  if (throttled)
+    {
+      scheduler.budget [IDE_THREAD_POOL_PRIORITY_BACKGROUND] = 0;
+      scheduler.budget [IDE_THREAD_POOL_PRIORITY_IDLE] = 0;
+    }
+  else
+    {
+      scheduler.budget [IDE_THREAD_POOL_PRIORITY_BACKGROUND] = BACKGROUND_BUDGET;
+      scheduler.budget [IDE_THREAD_POOL_PRIORITY_IDLE] = BACKGROUND_BUDGET;
+    }
+
+  g_assert (scheduler.budget [IDE_THREAD_POOL_PRIORITY_VISIBLE] < scheduler.budget [IDE_THREAD_POOL_PRIORITY_INTERACTIVE]);
+  g_assert (scheduler.budget [IDE_THREAD_POOL_PRIORITY_BACKGROUND] < scheduler.budget [IDE_THREAD_POOL_PRIORITY_VISIBLE]);
+}
+
+static void
+ide_thread_pool_set_throttled_locked (gboolean throttled)
+{
+  throttled = !!throttled;
+
+  if (throttled == scheduler.throttled)
+    return;
+
+  g_atomic_int_set (&scheduler.throttled, throttled);
+  ide_thread_pool_set_budgets_locked (throttled);
+
+  EGG_COUNTER_ADD (Throttled, throttled ? 1 : -1);
+
+  g_debug ("%s background work", throttled ? "Throttling" : "Resuming");
+
+  /* Deferred work may run now */
+  if (!throttled)
+    g_cond_broadcast (&scheduler.cond);
+}
+
+static void
+ide_thread_pool_apply_governor_locked (gboolean on_battery,
+                                       gdouble  load)
+{
+  gint64 load_hundredths = (gint64)(load * 100.0);
+  gdouble n_cpus = g_get_num_processors ();
+  gboolean throttled;
+
+  EGG_COUNTER_ADD (LoadAverage, load_hundredths - scheduler.last_load);
+  scheduler.last_load = load_hundredths;
+
+  EGG_COUNTER_ADD (OnBattery, (gint64)on_battery - scheduler.last_on_battery);
+  scheduler.last_on_battery = on_battery;
+
+  /* Use some hysteresis so we do not flap around the threshold */
+  if (scheduler.throttled)
+    throttled = on_battery || load > (n_cpus * 0.75);
+  else
+    throttled = on_battery || load > n_cpus;
+
+  ide_thread_pool_set_throttled_locked (throttled);
+}
+
+static void
+ide_thread_pool_update_governor_locked (void)
+{
+  gint64 now = g_get_monotonic_time ();
+  gboolean on_battery;
+  gdouble load = 0.0;
+
+  if (!scheduler.governor_enabled || now < scheduler.next_governor_check)
+    return;
+
+  scheduler.next_governor_check = now + GOVERNOR_INTERVAL;
+
+  /*
+   * The UPower proxy was created by _ide_thread_pool_init() on the main
+   * thread, so this only reads its cached property.
+   */
+  g_mutex_unlock (&scheduler.mutex);
+  on_battery = ide_battery_monitor_get_on_battery ();
+#ifdef HAVE_GETLOADAVG
+  if (getloadavg (&load, 1) != 1)
+    load = 0.0;
+#endif
+  g_mutex_lock (&scheduler.mutex);
+
+  ide_thread_pool_apply_governor_locked (on_battery, load);
+}
+
+static gboolean
+ide_thread_pool_has_queued_locked (void)
+{
+  for (guint i = 0; i < IDE_THREAD_POOL_PRIORITY_LAST; i++)
+    {
+      if (scheduler.queues [i].length > 0)
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+static guint
+ide_thread_pool_running_at_or_below (IdeThreadPoolPriority priority)
+{
+  guint running = 0;
+
+  for (guint i = priority; i < IDE_THREAD_POOL_PRIORITY_LAST; i++)
+    running += scheduler.running [i];
+
+  return running;
+}
+
+static WorkItem *
+ide_thread_pool_pop_locked (gboolean *counted)
+{
+  g_assert (counted != NULL);
+
+  for (guint i = 0; i < IDE_THREAD_POOL_PRIORITY_LAST; i++)
+    {
+      GQueue *queue = &scheduler.queues [i];
+      WorkItem *work_item;
+
+      if (queue->length == 0)
+        continue;
+
+      work_item = g_queue_peek_head (queue);
+
+      if (work_item_is_cancelled (work_item))
+        {
+          g_queue_unlink (queue, &work_item->link);
+          *counted = FALSE;
+          return work_item;
+        }
+
+      if (ide_thread_pool_running_at_or_below (i) < scheduler.budget [i])
+        {
+          g_queue_unlink (queue, &work_item->link);
+          scheduler.running [i]++;
+          *counted = TRUE;
+          return work_item;
+        }
+    }
+
+  return NULL;
+}
+
+static void
+ide_thread_pool_run (WorkItem *work_item,
+                     gboolean  cancelled)
 {
-  return thread_pools [kind];
+  gpointer source_object;
+  gpointer task_data;
+  GCancellable *cancellable;
+
+  g_assert (work_item != NULL);
+
+  EGG_COUNTER_DEC (QueuedTasks);
+
+  egg_histogram_record (wait_histograms [work_item->priority],
+                        g_get_monotonic_time () - work_item->queued_at);
+
+  if (work_item->type == TYPE_TASK)
+    {
+      if (cancelled)
+        {
+          EGG_COUNTER_INC (CancelledTasks);
+          g_task_return_error_if_cancelled (work_item->task.task);
+        }
+      else
+        {
+          source_object = g_task_get_source_object (work_item->task.task);
+          task_data = g_task_get_task_data (work_item->task.task);
+          cancellable = g_task_get_cancellable (work_item->task.task);
+
+          work_item->task.func (work_item->task.task, source_object, task_data, cancellable);
+        }
+
+      g_object_unref (work_item->task.task);
+    }
+  else if (work_item->type == TYPE_FUNC)
+    {
+      work_item->func.callback (work_item->func.data);
+    }
+}
+
+static gpointer
+ide_thread_pool_worker (gpointer data)
+{
+  for (;;)
+    {
+      WorkItem *work_item;
+      gboolean counted = FALSE;
+
+      g_mutex_lock (&scheduler.mutex);
+
+      for (;;)
+        {
+          ide_thread_pool_update_governor_locked ();
+
+          if (NULL != (work_item = ide_thread_pool_pop_locked (&counted)))
+            break;
+
+          /* Work that is queued but not allowed to run may be deferred by the governor */
+          if (scheduler.governor_enabled && ide_thread_pool_has_queued_locked ())
+            g_cond_wait_until (&scheduler.cond, &scheduler.mutex, scheduler.next_governor_check);
+          else
+            g_cond_wait (&scheduler.cond, &scheduler.mutex);
+        }
+
+      g_mutex_unlock (&scheduler.mutex);
+
+      ide_thread_pool_run (work_item, !counted);
+
+      if (counted)
+        {
+          g_mutex_lock (&scheduler.mutex);
+          scheduler.running [work_item->priority]--;
+          /* Freeing a slot may let queued work of another class run */
+          g_cond_signal (&scheduler.cond);
+          g_mutex_unlock (&scheduler.mutex);
+        }
+
+      g_slice_free (WorkItem, work_item);
+    }
+
+  return NULL;
+}
+
+static void
+ide_thread_pool_ensure_started (void)
+{
+  static gsize initialized;
+
+  if (g_once_init_enter (&initialized))
+    {
+      guint n_threads = CLAMP (g_get_num_processors (), MIN_THREADS, MAX_THREADS);
+
+      /* Worker processes only serve a single client, keep them small */
+      if (is_worker_process)
+        n_threads = MIN_THREADS;
+
+      g_mutex_init (&scheduler.mutex);
+      g_cond_init (&scheduler.cond);
+
+      for (guint i = 0; i < IDE_THREAD_POOL_PRIORITY_LAST; i++)
+        g_queue_init (&scheduler.queues [i]);
+
+      scheduler.n_threads = n_threads;
+      scheduler.governor_enabled = g_strcmp0 (g_getenv ("IDE_THREAD_POOL_GOVERNOR"), "0") != 0;
+      ide_thread_pool_set_budgets_locked (FALSE);
+
+      for (guint i = 0; i < n_threads; i++)
+        {
+          g_autofree gchar *name = g_strdup_printf ("ide-thread-pool-%u", i);
+
+          g_thread_unref (g_thread_new (name, ide_thread_pool_worker, NULL));
+        }
+
+      g_once_init_leave (&initialized, 1);
+    }
+}
+
+static void
+ide_thread_pool_push_work_item (WorkItem *work_item)
+{
+  g_assert (work_item != NULL);
+  g_assert (work_item->priority < IDE_THREAD_POOL_PRIORITY_LAST);
+
+  ide_thread_pool_ensure_started ();
+
+  EGG_COUNTER_INC (TotalTasks);
+  EGG_COUNTER_INC (QueuedTasks);
+
+  work_item->link.data = work_item;
+  work_item->queued_at = g_get_monotonic_time ();
+
+  g_mutex_lock (&scheduler.mutex);
+  g_queue_push_tail_link (&scheduler.queues [work_item->priority], &work_item->link);
+  g_cond_signal (&scheduler.cond);
+  g_mutex_unlock (&scheduler.mutex);
 }
 
 /**
@@ -66,42 +432,62 @@ ide_thread_pool_get_pool (IdeThreadPoolKind kind)
  *
  * This pushes a task to be executed on a worker thread based on the task kind as denoted by
  * @kind. Some tasks will be placed on special work queues or throttled based on priority.
+ *
+ * This is equivalent to ide_thread_pool_push_task_with_priority() using the default
+ * priority for @kind.
  */
 void
 ide_thread_pool_push_task (IdeThreadPoolKind  kind,
                            GTask             *task,
                            GTaskThreadFunc    func)
 {
-  GThreadPool *pool;
-
   IDE_ENTRY;
 
   g_return_if_fail (kind >= 0);
   g_return_if_fail (kind < IDE_THREAD_POOL_LAST);
-  g_return_if_fail (G_IS_TASK (task));
-  g_return_if_fail (func != NULL);
 
-  EGG_COUNTER_INC (TotalTasks);
+  ide_thread_pool_push_task_with_priority (kind, default_priorities [kind], task, func);
 
-  pool = ide_thread_pool_get_pool (kind);
+  IDE_EXIT;
+}
 
-  if (pool != NULL)
-    {
-      WorkItem *work_item;
+/**
+ * ide_thread_pool_push_task_with_priority:
+ * @kind: The task kind.
+ * @priority: The priority class of the task.
+ * @task: A #GTask to execute.
+ * @func: (scope async): The thread worker to execute for @task.
+ *
+ * Pushes a task to be executed on a worker thread. Tasks of a more important
+ * @priority are always started before less important ones.
+ *
+ * If the cancellable of @task is cancelled before a worker thread picks it
+ * up, @func is not called and @task returns %G_IO_ERROR_CANCELLED.
+ */
+void
+ide_thread_pool_push_task_with_priority (IdeThreadPoolKind      kind,
+                                         IdeThreadPoolPriority  priority,
+                                         GTask                 *task,
+                                         GTaskThreadFunc        func)
+{
+  WorkItem *work_item;
 
-      work_item = g_slice_new0 (WorkItem);
-      work_item->type = TYPE_TASK;
-      work_item->task.task = g_object_ref (task);
-      work_item->task.func = func;
+  IDE_ENTRY;
 
-      EGG_COUNTER_INC (QueuedTasks);
+  g_return_if_fail (kind >= 0);
+  g_return_if_fail (kind < IDE_THREAD_POOL_LAST);
+  g_return_if_fail (priority >= 0);
+  g_return_if_fail (priority < IDE_THREAD_POOL_PRIORITY_LAST);
+  g_return_if_fail (G_IS_TASK (task));
+  g_return_if_fail (func != NULL);
 
-      g_thread_pool_push (pool, work_item, NULL);
-    }
-  else
-    {
-      g_task_run_in_thread (task, func);
-    }
+  work_item = g_slice_new0 (WorkItem);
+  work_item->type = TYPE_TASK;
+  work_item->priority = priority;
+  work_item->task.task = g_object_ref (task);
+  work_item->task.func = func;
+
+  ide_thread_pool_push_work_item (work_item);
 
   IDE_EXIT;
 }
@@ -112,109 +498,99 @@ ide_thread_pool_push_task (IdeThreadPoolKind  kind,
  * @func: (scope async) (closure func_data): A function to call in the worker thread.
  * @func_data: user data for @func.
  *
- * Runs the callback on the thread pool thread.
+ * Runs the callback on the thread pool thread, using the default priority
+ * for @kind.
  */
 void
 ide_thread_pool_push (IdeThreadPoolKind kind,
                       IdeThreadFunc     func,
                       gpointer          func_data)
 {
-  GThreadPool *pool;
-
   IDE_ENTRY;
 
   g_return_if_fail (kind >= 0);
   g_return_if_fail (kind < IDE_THREAD_POOL_LAST);
-  g_return_if_fail (func != NULL);
 
-  EGG_COUNTER_INC (TotalTasks);
-
-  pool = ide_thread_pool_get_pool (kind);
-
-  if (pool != NULL)
-    {
-      WorkItem *work_item;
-
-      work_item = g_slice_new0 (WorkItem);
-      work_item->type = TYPE_FUNC;
-      work_item->func.callback = func;
-      work_item->func.data = func_data;
-
-      EGG_COUNTER_INC (QueuedTasks);
-
-      g_thread_pool_push (pool, work_item, NULL);
-    }
-  else
-    {
-      g_critical ("No such thread pool %02x", kind);
-    }
+  ide_thread_pool_push_with_priority (kind, default_priorities [kind], func, func_data);
 
   IDE_EXIT;
 }
 
-static void
-ide_thread_pool_worker (gpointer data,
-                        gpointer user_data)
+/**
+ * ide_thread_pool_push_with_priority:
+ * @kind: the threadpool kind to use.
+ * @priority: the priority class of the work.
+ * @func: (scope async) (closure func_data): A function to call in the worker thread.
+ * @func_data: user data for @func.
+ *
+ * Runs the callback on a thread pool thread once no more important work is
+ * waiting.
+ */
+void
+ide_thread_pool_push_with_priority (IdeThreadPoolKind     kind,
+                                    IdeThreadPoolPriority priority,
+                                    IdeThreadFunc         func,
+                                    gpointer              func_data)
 {
-  WorkItem *work_item = data;
-  gpointer source_object;
-  gpointer task_data;
-  GCancellable *cancellable;
+  WorkItem *work_item;
 
-  g_assert (work_item != NULL);
+  IDE_ENTRY;
 
-  EGG_COUNTER_DEC (QueuedTasks);
+  g_return_if_fail (kind >= 0);
+  g_return_if_fail (kind < IDE_THREAD_POOL_LAST);
+  g_return_if_fail (priority >= 0);
+  g_return_if_fail (priority < IDE_THREAD_POOL_PRIORITY_LAST);
+  g_return_if_fail (func != NULL);
 
-  if (work_item->type == TYPE_TASK)
-    {
-      source_object = g_task_get_source_object (work_item->task.task);
-      task_data = g_task_get_task_data (work_item->task.task);
-      cancellable = g_task_get_cancellable (work_item->task.task);
+  work_item = g_slice_new0 (WorkItem);
+  work_item->type = TYPE_FUNC;
+  work_item->priority = priority;
+  work_item->func.callback = func;
+  work_item->func.data = func_data;
 
-      work_item->task.func (work_item->task.task, source_object, task_data, cancellable);
+  ide_thread_pool_push_work_item (work_item);
 
-      g_object_unref (work_item->task.task);
-    }
-  else if (work_item->type == TYPE_FUNC)
-    {
-      work_item->func.callback (work_item->func.data);
-    }
+  IDE_EXIT;
+}
 
-  g_slice_free (WorkItem, work_item);
+/**
+ * ide_thread_pool_get_throttled:
+ *
+ * Checks if the thread pool is currently throttling background work, such
+ * as when running on battery or when the system is heavily loaded. Callers
+ * may use this to defer their own non-interactive work.
+ *
+ * Returns: %TRUE if background work is being throttled.
+ */
+gboolean
+ide_thread_pool_get_throttled (void)
+{
+  return g_atomic_int_get (&scheduler.throttled);
 }
 
 void
 _ide_thread_pool_init (gboolean is_worker)
 {
-  gint compiler = COMPILER_MAX_THREADS;
-  gint indexer = INDEXER_MAX_THREADS;
-  gboolean exclusive = FALSE;
+  is_worker_process = is_worker;
 
-  if (is_worker)
-    {
-      compiler = 1;
-      indexer = 1;
-      exclusive = TRUE;
-    }
+  ide_thread_pool_ensure_started ();
 
-  /*
-   * Create our thread pool exclusive to compiler tasks (such as those from Clang).
-   * We don't want to consume threads from other GTask's such as those regarding IO so we manage
-   * these work items exclusively.
-   */
-  thread_pools [IDE_THREAD_POOL_COMPILER] = g_thread_pool_new (ide_thread_pool_worker,
-                                                               NULL,
-                                                               compiler,
-                                                               exclusive,
-                                                               NULL);
+  /* Connect to UPower now so the governor never blocks a worker doing so */
+  if (scheduler.governor_enabled)
+    ide_battery_monitor_get_on_battery ();
+}
 
-  /*
-   * Create our pool exclusive to things like indexing. Such examples including building of
-   * ctags indexes or highlight indexes.
-   */
-  thread_pools [IDE_THREAD_POOL_INDEXER] = g_thread_pool_new (ide_thread_pool_worker,
-                                                              NULL,
-                                                              indexer,
-                                                              exclusive,
-                                                              NULL);
+/*
+ * Feeds the governor as if a worker had seen @on_battery and @load, so
+ * tests can check the throttled state without depending on the machine.
+ */
+void
+_ide_thread_pool_update_governor (gboolean on_battery,
+                                  gdouble  load)
+{
+  ide_thread_pool_ensure_started ();
+
+  g_mutex_lock (&scheduler.mutex);
+  ide_thread_pool_apply_governor_locked (on_battery, load);
+  g_mutex_unlock (&scheduler.mutex);
 }
@@ -29,9 +29,29 @@ typedef enum
 {
   IDE_THREAD_POOL_COMPILER,
   IDE_THREAD_POOL_INDEXER,
+  IDE_THREAD_POOL_SEARCH,
   IDE_THREAD_POOL_LAST
 } IdeThreadPoolKind;
 
+/**
+ * IdeThreadPoolPriority:
+ * @IDE_THREAD_POOL_PRIORITY_INTERACTIVE: work the user is waiting on, such as completion.
+ * @IDE_THREAD_POOL_PRIORITY_VISIBLE: work with visible results, such as diagnostics.
+ * @IDE_THREAD_POOL_PRIORITY_BACKGROUND: work such as building indexes.
+ * @IDE_THREAD_POOL_PRIORITY_IDLE: work that may be deferred indefinitely.
+ *
+ * The priority class of work pushed to the thread pool. More important
+ * classes are always started first.
+ */
+typedef enum
+{
+  IDE_THREAD_POOL_PRIORITY_INTERACTIVE,
+  IDE_THREAD_POOL_PRIORITY_VISIBLE,
+  IDE_THREAD_POOL_PRIORITY_BACKGROUND,
+  IDE_THREAD_POOL_PRIORITY_IDLE,
+  IDE_THREAD_POOL_PRIORITY_LAST
+} IdeThreadPoolPriority;
+
 /**
  * IdeThreadFunc:
  * @user_data: (closure) (transfer full): The closure for the callback.
@@ -39,12 +59,21 @@ typedef enum
  */
 typedef void (*IdeThreadFunc) (gpointer user_data);
 
-void     ide_thread_pool_push      (IdeThreadPoolKind     kind,
-                                    IdeThreadFunc         func,
-                                    gpointer              func_data);
-void     ide_thread_pool_push_task (IdeThreadPoolKind     kind,
-                                    GTask                *task,
-                                    GTaskThreadFunc       func);
+gboolean ide_thread_pool_get_throttled           (void);
+void     ide_thread_pool_push                    (IdeThreadPoolKind      kind,
+                                                  IdeThreadFunc          func,
+                                                  gpointer               func_data);
+void     ide_thread_pool_push_with_priority      (IdeThreadPoolKind      kind,
+                                                  IdeThreadPoolPriority  priority,
+                                                  IdeThreadFunc          func,
+                                                  gpointer               func_data);
+void     ide_thread_pool_push_task               (IdeThreadPoolKind      kind,
+                                                  GTask                 *task,
+                                                  GTaskThreadFunc        func);
+void     ide_thread_pool_push_task_with_priority (IdeThreadPoolKind      kind,
+                                                  IdeThreadPoolPriority  priority,
+                                                  GTask                 *task,
+                                                  GTaskThreadFunc        func);
 
 G_END_DECLS
 
@@ -151,6 +151,34 @@ ide_tree_node_insert_sorted (IdeTreeNode            *node,
   _ide_tree_insert_sorted (node->tree, node, child, compare_func, user_data);
 }
 
+/**
+ * ide_tree_node_insert_sorted_batch:
+ * @node: A #IdeTreeNode.
+ * @children: (element-type Ide.TreeNode): An array of #IdeTreeNode.
+ * @compare_func: (scope call): A compare func to compare nodes.
+ * @user_data: user data for @compare_func.
+ *
+ * Inserts all of @children as children of @node, sorting them among the
+ * other children. This is much faster than calling
+ * ide_tree_node_insert_sorted() for each child when adding many nodes, as
+ * the children are sorted up front and merged into the tree in one pass.
+ *
+ * If a child has #IdeTreeNode:children-possible set before it is inserted,
+ * the expander is created as part of the insertion.
+ */
+void
+ide_tree_node_insert_sorted_batch (IdeTreeNode            *node,
+                                   GPtrArray              *children,
+                                   IdeTreeNodeCompareFunc  compare_func,
+                                   gpointer                user_data)
+{
+  g_return_if_fail (IDE_IS_TREE_NODE (node));
+  g_return_if_fail (children != NULL);
+  g_return_if_fail (compare_func != NULL);
+
+  _ide_tree_insert_sorted_batch (node->tree, node, children, compare_func, user_data);
+}
+
 /**
  * ide_tree_node_append:
  * @node: A #IdeTreeNode.
@@ -40,6 +40,11 @@ void         _ide_tree_insert_sorted           (IdeTree        *self,
                                                 IdeTreeNode    *child,
                                                 IdeTreeNodeCompareFunc compare_func,
                                                 gpointer        user_data);
+void         _ide_tree_insert_sorted_batch     (IdeTree        *self,
+                                                IdeTreeNode    *node,
+                                                GPtrArray      *children,
+                                                IdeTreeNodeCompareFunc compare_func,
+                                                gpointer        user_data);
 void         _ide_tree_remove                  (IdeTree        *self,
                                                 IdeTreeNode    *node);
 gboolean     _ide_tree_get_iter                (IdeTree        *self,
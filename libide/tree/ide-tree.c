@@ -537,6 +537,114 @@ inserted:
   g_object_unref (child);
 }
 
+typedef struct
+{
+  IdeTreeNodeCompareFunc compare_func;
+  gpointer               user_data;
+} SortClosure;
+
+static gint
+sort_closure_compare (gconstpointer a,
+                      gconstpointer b,
+                      gpointer      user_data)
+{
+  IdeTreeNode *node_a = *(IdeTreeNode **)a;
+  IdeTreeNode *node_b = *(IdeTreeNode **)b;
+  SortClosure *closure = user_data;
+
+  return closure->compare_func (node_a, node_b, closure->user_data);
+}
+
+void
+_ide_tree_insert_sorted_batch (IdeTree                *self,
+                               IdeTreeNode            *node,
+                               GPtrArray              *children,
+                               IdeTreeNodeCompareFunc  compare_func,
+                               gpointer                user_data)
+{
+  IdeTreePrivate *priv = ide_tree_get_instance_private (self);
+  g_autoptr(GPtrArray) sorted = NULL;
+  g_autoptr(IdeTreeNode) sibling = NULL;
+  SortClosure closure = { compare_func, user_data };
+  GtkTreeModel *model;
+  GtkTreeIter *parent = NULL;
+  GtkTreeIter node_iter;
+  GtkTreeIter sibling_iter;
+  guint i;
+
+  g_return_if_fail (IDE_IS_TREE (self));
+  g_return_if_fail (IDE_IS_TREE_NODE (node));
+  g_return_if_fail (children != NULL);
+  g_return_if_fail (compare_func != NULL);
+
+  if (children->len == 0)
+    return;
+
+  model = GTK_TREE_MODEL (priv->store);
+
+  if (node != priv->root)
+    {
+      if (!ide_tree_node_get_iter (node, &node_iter))
+        return;
+      parent = &node_iter;
+    }
+
+  /*
+   * Sort the new children off to the side, and then merge them with the
+   * existing (already sorted) siblings in a single pass over the store.
+   * GtkTreeStore iters persist across insertions, so the sibling cursor
+   * stays valid while we insert in front of it.
+   */
+  sorted = g_ptr_array_new_full (children->len, g_object_unref);
+  for (i = 0; i < children->len; i++)
+    g_ptr_array_add (sorted, g_object_ref_sink (g_ptr_array_index (children, i)));
+  g_ptr_array_sort_with_data (sorted, sort_closure_compare, &closure);
+
+  if (gtk_tree_model_iter_children (model, &sibling_iter, parent))
+    gtk_tree_model_get (model, &sibling_iter, 0, &sibling, -1);
+
+  for (i = 0; i < sorted->len; i++)
+    {
+      IdeTreeNode *child = g_ptr_array_index (sorted, i);
+      GtkTreeIter iter;
+
+      while (sibling != NULL && compare_func (sibling, child, user_data) <= 0)
+        {
+          g_clear_object (&sibling);
+          if (gtk_tree_model_iter_next (model, &sibling_iter))
+            gtk_tree_model_get (model, &sibling_iter, 0, &sibling, -1);
+        }
+
+      _ide_tree_node_set_tree (child, self);
+      _ide_tree_node_set_parent (child, node);
+
+      gtk_tree_store_insert_before (priv->store, &iter, parent,
+                                    sibling != NULL ? &sibling_iter : NULL);
+      gtk_tree_store_set (priv->store, &iter, 0, child, -1);
+
+      /*
+       * Add the dummy child using the iter we already have instead of
+       * _ide_tree_node_add_dummy_child(), which would have to locate the
+       * node by walking its siblings again.
+       */
+      if (ide_tree_node_get_children_possible (child) &&
+          _ide_tree_node_get_needs_build (child))
+        {
+          IdeTreeNode *dummy;
+          GtkTreeIter dummy_iter;
+
+          dummy = g_object_ref_sink (ide_tree_node_new ());
+          gtk_tree_store_insert_with_values (priv->store, &dummy_iter, &iter, -1,
+                                             0, dummy,
+                                             -1);
+          g_object_unref (dummy);
+        }
+
+      if (node == priv->root)
+        _ide_tree_build_node (self, child);
+    }
+}
+
 static void
 ide_tree_row_activated (GtkTreeView       *tree_view,
                         GtkTreePath       *path,
@@ -16,7 +16,28 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#define G_LOG_DOMAIN "ide-async-helper"
+
 #include "ide-async-helper.h"
+#include "ide-timeline.h"
+
+typedef struct
+{
+  const IdeAsyncGraphStep *steps;
+  guint                    n_steps;
+  guint                    n_active;
+  guint64                  started;
+  guint64                  completed;
+  gint64                   begin_time;
+  gint64                  *step_begin_time;
+  GError                  *error;
+} GraphState;
+
+typedef struct
+{
+  GTask *task;
+  guint  index;
+} GraphStepClosure;
 
 static void
 ide_async_helper_cb (GObject      *object,
@@ -83,3 +104,185 @@ ide_async_helper_run (gpointer             source_object,
          ide_async_helper_cb,
          g_object_ref (task));
 }
+
+static void
+graph_state_free (gpointer data)
+{
+  GraphState *state = data;
+
+  g_clear_error (&state->error);
+  g_free (state->step_begin_time);
+  g_slice_free (GraphState, state);
+}
+
+static void ide_async_helper_graph_advance (GTask *task);
+
+static void
+ide_async_helper_graph_cb (GObject      *object,
+                           GAsyncResult *result,
+                           gpointer      user_data)
+{
+  GraphStepClosure *closure = user_data;
+  g_autoptr(GTask) task = closure->task;
+  const IdeAsyncGraphStep *step;
+  GraphState *state;
+  GError *error = NULL;
+  gint64 elapsed;
+
+  g_assert (G_IS_TASK (task));
+  g_assert (G_IS_TASK (result));
+
+  state = g_task_get_task_data (task);
+  step = &state->steps [closure->index];
+
+  elapsed = g_get_monotonic_time () - state->step_begin_time [closure->index];
+
+  ide_timeline_end (G_OBJECT_TYPE_NAME (g_task_get_source_object (task)),
+                    step->name,
+                    state->step_begin_time [closure->index]);
+
+  if (step->counter != NULL)
+    egg_counter_add (step->counter, elapsed);
+
+  g_debug ("Step \"%s\" completed in %.3lf msec",
+           step->name, elapsed / 1000.0);
+
+  state->n_active--;
+
+  if (!g_task_propagate_boolean (G_TASK (result), &error))
+    {
+      /* Only the first error is reported to the caller */
+      if (state->error == NULL)
+        state->error = error;
+      else
+        g_error_free (error);
+    }
+  else
+    {
+      state->completed |= IDE_ASYNC_GRAPH_DEP (closure->index);
+    }
+
+  g_slice_free (GraphStepClosure, closure);
+
+  ide_async_helper_graph_advance (task);
+}
+
+static void
+ide_async_helper_graph_advance (GTask *task)
+{
+  GraphState *state;
+  guint64 all;
+
+  g_assert (G_IS_TASK (task));
+
+  state = g_task_get_task_data (task);
+  all = (state->n_steps == 64) ? G_MAXUINT64 : (IDE_ASYNC_GRAPH_DEP (state->n_steps) - 1);
+
+  /*
+   * Start every step whose dependencies have all completed. Once a step
+   * fails, we stop starting new steps but wait for those already running
+   * to complete so that nothing outlives the task.
+   */
+  if (state->error == NULL)
+    {
+      for (guint i = 0; i < state->n_steps; i++)
+        {
+          const IdeAsyncGraphStep *step = &state->steps [i];
+          GraphStepClosure *closure;
+
+          if ((state->started & IDE_ASYNC_GRAPH_DEP (i)) != 0)
+            continue;
+
+          if ((step->depends_on & state->completed) != step->depends_on)
+            continue;
+
+          state->started |= IDE_ASYNC_GRAPH_DEP (i);
+          state->n_active++;
+          state->step_begin_time [i] = g_get_monotonic_time ();
+
+          closure = g_slice_new0 (GraphStepClosure);
+          closure->task = g_object_ref (task);
+          closure->index = i;
+
+          step->step (g_task_get_source_object (task),
+                      g_task_get_cancellable (task),
+                      ide_async_helper_graph_cb,
+                      closure);
+        }
+    }
+
+  if (state->n_active > 0)
+    return;
+
+  if (state->error != NULL)
+    {
+      g_task_return_error (task, g_steal_pointer (&state->error));
+      return;
+    }
+
+  if (state->completed != all)
+    {
+      g_task_return_new_error (task,
+                               G_IO_ERROR,
+                               G_IO_ERROR_FAILED,
+                               "Unsatisfiable dependencies in async graph");
+      return;
+    }
+
+  g_debug ("All steps completed in %.3lf msec",
+           (g_get_monotonic_time () - state->begin_time) / 1000.0);
+
+  ide_timeline_end (G_OBJECT_TYPE_NAME (g_task_get_source_object (task)),
+                    "all-steps",
+                    state->begin_time);
+
+  g_task_return_boolean (task, TRUE);
+}
+
+/**
+ * ide_async_helper_run_graph:
+ * @source_object: (type GObject.Object): the source object for the steps
+ * @steps: (array length=n_steps): the steps to execute
+ * @n_steps: the number of steps, which must be no more than 64
+ * @cancellable: (nullable): a #GCancellable or %NULL
+ * @callback: a callback to execute upon completion
+ * @user_data: closure data for @callback
+ *
+ * This is similar to ide_async_helper_run() except that instead of running
+ * the steps one after another, each step declares which steps it depends on.
+ * Steps are started as soon as their dependencies complete, allowing steps
+ * that are independent of one another to overlap.
+ *
+ * The wall time of each step is added to the step's counter, if any.
+ *
+ * @steps must remain valid until @callback is executed. Complete the
+ * operation with g_task_propagate_boolean().
+ */
+void
+ide_async_helper_run_graph (gpointer                  source_object,
+                            const IdeAsyncGraphStep  *steps,
+                            guint                     n_steps,
+                            GCancellable             *cancellable,
+                            GAsyncReadyCallback       callback,
+                            gpointer                  user_data)
+{
+  g_autoptr(GTask) task = NULL;
+  GraphState *state;
+
+  g_return_if_fail (steps != NULL);
+  g_return_if_fail (n_steps > 0);
+  g_return_if_fail (n_steps <= 64);
+  g_return_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable));
+
+  state = g_slice_new0 (GraphState);
+  state->steps = steps;
+  state->n_steps = n_steps;
+  state->begin_time = g_get_monotonic_time ();
+  state->step_begin_time = g_new0 (gint64, n_steps);
+
+  task = g_task_new (source_object, cancellable, callback, user_data);
+  g_task_set_source_tag (task, ide_async_helper_run_graph);
+  g_task_set_task_data (task, state, graph_state_free);
+
+  ide_async_helper_graph_advance (task);
+}
@@ -19,21 +19,51 @@
 #ifndef IDE_ASYNC_HELPER_H
 #define IDE_ASYNC_HELPER_H
 
+#include <egg-counter.h>
 #include <gio/gio.h>
 
 G_BEGIN_DECLS
 
+/**
+ * IDE_ASYNC_GRAPH_DEP:
+ * @index: the index of a step within the #IdeAsyncGraphStep array
+ *
+ * Creates a dependency mask for use in #IdeAsyncGraphStep.depends_on.
+ */
+#define IDE_ASYNC_GRAPH_DEP(index) (G_GUINT64_CONSTANT(1) << (index))
+
 typedef void (*IdeAsyncStep) (gpointer             source_object,
                               GCancellable        *cancellable,
                               GAsyncReadyCallback  callback,
                               gpointer             user_data);
 
-void ide_async_helper_run (gpointer             source_object,
-                           GCancellable        *cancellable,
-                           GAsyncReadyCallback  callback,
-                           gpointer             user_data,
-                           IdeAsyncStep         step1,
-                           ...);
+typedef struct
+{
+  /* A name for the step, used for debugging and timing reports. */
+  const gchar  *name;
+
+  /* The step to execute once all of the dependencies have completed. */
+  IdeAsyncStep  step;
+
+  /* A mask of IDE_ASYNC_GRAPH_DEP() for the steps that must complete first. */
+  guint64       depends_on;
+
+  /* An optional counter to which the wall time of the step is added (usec). */
+  EggCounter   *counter;
+} IdeAsyncGraphStep;
+
+void ide_async_helper_run       (gpointer                  source_object,
+                                 GCancellable             *cancellable,
+                                 GAsyncReadyCallback       callback,
+                                 gpointer                  user_data,
+                                 IdeAsyncStep              step1,
+                                 ...);
+void ide_async_helper_run_graph (gpointer                  source_object,
+                                 const IdeAsyncGraphStep  *steps,
+                                 guint                     n_steps,
+                                 GCancellable             *cancellable,
+                                 GAsyncReadyCallback       callback,
+                                 gpointer                  user_data);
 
 G_END_DECLS
 
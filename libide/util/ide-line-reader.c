@@ -20,8 +20,48 @@
 
 #include <string.h>
 
+#if defined(__SSE2__) && defined(__GNUC__)
+# include <emmintrin.h>
+# define HAVE_SSE2_SCAN 1
+#endif
+
 #include "ide-line-reader.h"
 
+/*
+ * Lines are found with memchr(), which libc already vectorizes and which
+ * wins for the long distances between newlines. Fields are usually only a
+ * few bytes long, so the call overhead of memchr() dominates there and we
+ * use an inline 16-byte SSE2 scan instead, falling back to a byte loop.
+ */
+static inline gchar *
+find_byte (gchar *begin,
+           gchar *end,
+           gchar  ch)
+{
+#ifdef HAVE_SSE2_SCAN
+  const __m128i needle = _mm_set1_epi8 (ch);
+
+  while (end - begin >= 16)
+    {
+      __m128i chunk = _mm_loadu_si128 ((const __m128i *)(gpointer)begin);
+      guint mask = (guint)_mm_movemask_epi8 (_mm_cmpeq_epi8 (chunk, needle));
+
+      if (mask != 0)
+        return begin + __builtin_ctz (mask);
+
+      begin += 16;
+    }
+#endif
+
+  for (; begin < end; begin++)
+    {
+      if (*begin == ch)
+        return begin;
+    }
+
+  return NULL;
+}
+
 void
 ide_line_reader_init (IdeLineReader *reader,
                       gchar         *contents,
@@ -63,6 +103,8 @@ ide_line_reader_next (IdeLineReader *reader,
                       gsize         *length)
 {
   gchar *ret = NULL;
+  gchar *eol;
+  gsize remaining;
 
   g_assert (reader);
   g_assert (length != NULL);
@@ -74,18 +116,69 @@ ide_line_reader_next (IdeLineReader *reader,
     }
 
   ret = &reader->contents [reader->pos];
+  remaining = reader->length - reader->pos;
 
-  for (; reader->pos < reader->length; reader->pos++)
+  if (NULL != (eol = memchr (ret, '\n', remaining)))
     {
-      if (reader->contents [reader->pos] == '\n')
-        {
-          *length = &reader->contents [reader->pos] - ret;
-          reader->pos++;
-          return ret;
-        }
+      *length = eol - ret;
+      reader->pos += *length + 1;
+      return ret;
     }
 
-  *length = &reader->contents [reader->pos] - ret;
+  *length = remaining;
+  reader->pos = reader->length;
 
   return ret;
 }
+
+/**
+ * ide_line_reader_split:
+ * @line: a line, such as returned from ide_line_reader_next()
+ * @length: the length of @line in bytes
+ * @delimiter: the byte separating fields
+ * @fields: (out caller-allocates) (array length=n_fields): a location for
+ *   the beginning of each field
+ * @n_fields: the maximum number of fields
+ *
+ * Splits @line in place at runs of @delimiter, replacing the delimiters
+ * with NULL bytes so that each field but the last can be used as a C string.
+ * Splitting stops after @n_fields - 1 fields, so the last field contains
+ * the remainder of the line, including any further delimiters. It is only
+ * terminated if @line is.
+ *
+ * This is meant for formats such as ctags, where a line contains a small
+ * number of tab separated fields.
+ *
+ * Returns: The number of fields stored in @fields.
+ */
+guint
+ide_line_reader_split (gchar  *line,
+                       gsize   length,
+                       gchar   delimiter,
+                       gchar **fields,
+                       guint   n_fields)
+{
+  gchar *end = line + length;
+  gchar *iter = line;
+  guint n = 0;
+
+  g_assert (line != NULL || length == 0);
+  g_assert (fields != NULL || n_fields == 0);
+
+  while (n < n_fields && iter < end)
+    {
+      gchar *delim;
+
+      fields [n++] = iter;
+
+      if (n == n_fields || NULL == (delim = find_byte (iter, end, delimiter)))
+        break;
+
+      for (; delim < end && *delim == delimiter; delim++)
+        *delim = '\0';
+
+      iter = delim;
+    }
+
+  return n;
+}
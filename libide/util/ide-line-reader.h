@@ -30,11 +30,16 @@ typedef struct
   gssize  pos;
 } IdeLineReader;
 
-void   ide_line_reader_init (IdeLineReader *reader,
-                             gchar         *contents,
-                             gssize         length);
-gchar *ide_line_reader_next (IdeLineReader *reader,
-                             gsize         *length);
+void   ide_line_reader_init  (IdeLineReader  *reader,
+                              gchar          *contents,
+                              gssize          length);
+gchar *ide_line_reader_next  (IdeLineReader  *reader,
+                              gsize          *length);
+guint  ide_line_reader_split (gchar          *line,
+                              gsize           length,
+                              gchar           delimiter,
+                              gchar         **fields,
+                              guint           n_fields);
 
 G_END_DECLS
 
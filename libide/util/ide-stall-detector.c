@@ -0,0 +1,577 @@
+/* ide-stall-detector.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define G_LOG_DOMAIN "ide-stall-detector"
+
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE
+#endif
+
+#include "config.h"
+
+#ifdef HAVE_DLADDR
+# include <dlfcn.h>
+#endif
+#include <egg-counter.h>
+#include <errno.h>
+#ifdef HAVE_EXECINFO_H
+# include <execinfo.h>
+#endif
+#include <fcntl.h>
+#include <gio/gio.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "ide-internal.h"
+
+#include "util/ide-stall-detector.h"
+
+#define NAME_FORMAT       "/IdeStalls-%u"
+#define MAGIC             0x1DE57A12
+#define N_STALLS          64
+#define DEFAULT_THRESHOLD 100
+#define STALL_SIGNAL      SIGPROF
+#define MEMORY_BARRIER    __sync_synchronize()
+
+/* The signal handler and the signal trampoline */
+#define SKIP_FRAMES       2
+
+/* How long the watchdog waits for the signal handler, in microseconds */
+#define CAPTURE_TIMEOUT   (G_USEC_PER_SEC / 10)
+
+/*
+ * How It Works
+ * ============
+ *
+ * We replace the poll function of the default main context. The main thread
+ * notes the time whenever poll() returns, which is when the main loop starts
+ * dispatching, and bumps the iteration number. The watchdog thread wakes up
+ * a few times per threshold and, if the main thread has not gone back to
+ * poll() within the threshold, sends STALL_SIGNAL to the main thread.
+ *
+ * The signal handler runs on the (stalled) main thread and only does
+ * async-signal-safe work: it saves the raw return addresses of its own
+ * stack. Everything else happens on the watchdog thread, which waits for
+ * the capture, resolves each address to a module and offset with dladdr(),
+ * and writes the stall to the shared memory ring right away. That way a
+ * main loop that never returns to poll() is still visible. While the stall
+ * lasts, the watchdog keeps its duration up to date. When the main thread
+ * gets back to poll(), it publishes the final duration, and the watchdog
+ * finishes the stall and records it in the counters.
+ *
+ * The poll function also copies the name of the GSource being dispatched,
+ * if any, into a fixed buffer so that neither the signal handler nor the
+ * watchdog needs to look at the main context.
+ *
+ * The ring is written only by the watchdog thread. The writer fills in the
+ * stall and then, after a memory barrier, increments the head. Afterwards
+ * only the duration and flags of the newest stall are changed. A reader
+ * copies the stalls and then re-reads the head to discard anything that
+ * may have been overwritten meanwhile.
+ */
+
+typedef struct
+{
+  guint32          magic;
+  guint32          size;
+  guint32          n_stalls;
+  guint32          padding0;
+  volatile guint64 head;
+  gchar            padding [40];
+} StallsHeader;
+
+G_STATIC_ASSERT (sizeof (StallsHeader) == 64);
+
+#define STALLS_SIZE (sizeof (StallsHeader) + (sizeof (IdeStall) * N_STALLS))
+
+typedef struct
+{
+  StallsHeader *header;
+  IdeStall     *stalls;
+} Stalls;
+
+typedef struct
+{
+  /* Written by the main thread */
+  GPollFunc              poll_func;
+  volatile gint          in_poll;
+  volatile guint         iteration;
+  volatile gint64        dispatch_begin;
+  volatile guint         finished_iteration;
+  gint64                 finished_duration;
+  gchar                  source_name [104];
+
+  /* Written by the watchdog thread */
+  volatile guint         stalled_iteration;
+
+  /* Written by the signal handler, on the main thread */
+  volatile gint          captured;
+  guint                  captured_iteration;
+  gint                   n_addresses;
+  gpointer               addresses [IDE_STALL_MAX_FRAMES + SKIP_FRAMES];
+
+  pthread_t              main_thread;
+  gint64                 threshold;
+  GThread               *thread;
+} Detector;
+
+EGG_DEFINE_COUNTER (StallCount, "MainLoop", "Stalls",
+                    "Number of main loop iterations that exceeded the stall threshold.")
+EGG_DEFINE_HISTOGRAM (StallDuration, "MainLoop", "Stall Duration",
+                      "Duration of main loop stalls, in microseconds.")
+
+static Stalls stalls;
+static Detector detector;
+
+static void
+stalls_map (Stalls   *s,
+            gpointer  mem)
+{
+  s->header = mem;
+  s->stalls = (IdeStall *)&s->header [1];
+}
+
+static void
+stalls_atexit (void)
+{
+  gchar name [32];
+
+  g_snprintf (name, sizeof name, NAME_FORMAT, (guint)getpid ());
+  shm_unlink (name);
+}
+
+static gboolean
+stalls_init_local (void)
+{
+  gchar name [32];
+  gpointer mem;
+  gint fd;
+
+  g_snprintf (name, sizeof name, NAME_FORMAT, (guint)getpid ());
+
+  if (-1 == (fd = shm_open (name, O_CREAT|O_RDWR, S_IRUSR|S_IWUSR|S_IRGRP)))
+    return FALSE;
+
+  if (-1 == ftruncate (fd, STALLS_SIZE))
+    goto failure;
+
+  mem = mmap (NULL, STALLS_SIZE, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+
+  if (mem == MAP_FAILED)
+    goto failure;
+
+  close (fd);
+  atexit (stalls_atexit);
+
+  stalls_map (&stalls, mem);
+
+  stalls.header->magic = MAGIC;
+  stalls.header->n_stalls = N_STALLS;
+
+  MEMORY_BARRIER;
+
+  stalls.header->size = STALLS_SIZE;
+
+  return TRUE;
+
+failure:
+  shm_unlink (name);
+  close (fd);
+
+  return FALSE;
+}
+
+static void
+ide_stall_detector_resolve (IdeStallFrame *frame,
+                            gpointer       address)
+{
+#ifdef HAVE_DLADDR
+  Dl_info info;
+#endif
+
+  g_assert (frame != NULL);
+
+  frame->address = GPOINTER_TO_SIZE (address);
+
+#ifdef HAVE_DLADDR
+  if (dladdr (address, &info) != 0 && info.dli_fname != NULL)
+    {
+      frame->offset = GPOINTER_TO_SIZE (address) - GPOINTER_TO_SIZE (info.dli_fbase);
+      g_strlcpy (frame->module, info.dli_fname, sizeof frame->module);
+    }
+#endif
+}
+
+/*
+ * Waits for the signal handler to capture the stack of the main thread and
+ * writes the stall to the ring. Returns %NULL if the main loop recovered
+ * before the stack could be captured.
+ */
+static IdeStall *
+ide_stall_detector_begin_stall (guint  iteration,
+                                gint64 begin)
+{
+  IdeStall *stall;
+  gint64 deadline;
+
+  g_assert (stalls.header != NULL);
+
+  deadline = g_get_monotonic_time () + CAPTURE_TIMEOUT;
+
+  while (!g_atomic_int_get (&detector.captured))
+    {
+      if (g_get_monotonic_time () > deadline)
+        return NULL;
+      g_usleep (100);
+    }
+
+  MEMORY_BARRIER;
+
+  /* The signal may have raced with the main loop going back to poll() */
+  if (detector.captured_iteration != iteration || g_atomic_int_get (&detector.in_poll))
+    return NULL;
+
+  stall = &stalls.stalls [stalls.header->head % N_STALLS];
+
+  memset (stall, 0, sizeof *stall);
+  stall->begin = begin;
+  stall->duration = g_get_monotonic_time () - begin;
+  stall->flags = IDE_STALL_ONGOING;
+
+  /* The main thread is stalled, so it is not writing the name */
+  memcpy (stall->source_name, detector.source_name, sizeof stall->source_name);
+
+  if (detector.n_addresses > SKIP_FRAMES)
+    {
+      stall->n_frames = detector.n_addresses - SKIP_FRAMES;
+
+      for (guint i = 0; i < stall->n_frames; i++)
+        ide_stall_detector_resolve (&stall->frames [i], detector.addresses [SKIP_FRAMES + i]);
+    }
+
+  MEMORY_BARRIER;
+
+  stalls.header->head++;
+
+  return stall;
+}
+
+static void
+ide_stall_detector_finish_stall (IdeStall *stall,
+                                 gint64    duration)
+{
+  g_assert (stall != NULL);
+
+  stall->duration = duration;
+  MEMORY_BARRIER;
+  stall->flags &= ~IDE_STALL_ONGOING;
+
+  EGG_COUNTER_INC (StallCount);
+  EGG_HISTOGRAM_RECORD (StallDuration, duration);
+
+  g_debug ("Main loop stalled for %"G_GINT64_FORMAT" msec",
+           duration / 1000);
+}
+
+static void
+ide_stall_detector_signal_handler (gint signum)
+{
+  gint saved_errno = errno;
+
+  if (!detector.captured)
+    {
+#ifdef HAVE_EXECINFO_H
+      detector.n_addresses = backtrace (detector.addresses, G_N_ELEMENTS (detector.addresses));
+#endif
+      detector.captured_iteration = detector.iteration;
+      MEMORY_BARRIER;
+      detector.captured = TRUE;
+    }
+
+  errno = saved_errno;
+}
+
+static gint
+ide_stall_detector_poll (GPollFD *fds,
+                         guint    nfds,
+                         gint     timeout)
+{
+  GSource *source;
+  const gchar *name = NULL;
+  gint ret;
+
+  /*
+   * If the watchdog caught the iteration that just finished, tell it how
+   * long the iteration took so that it can finish the stall.
+   */
+  if G_UNLIKELY (g_atomic_int_get (&detector.stalled_iteration) == detector.iteration)
+    {
+      detector.finished_duration = g_get_monotonic_time () - detector.dispatch_begin;
+      MEMORY_BARRIER;
+      g_atomic_int_set (&detector.finished_iteration, detector.iteration);
+    }
+
+  g_atomic_int_set (&detector.in_poll, TRUE);
+
+  ret = detector.poll_func (fds, nfds, timeout);
+
+  /* Only set while a nested main loop is running from a dispatch */
+  if G_UNLIKELY (NULL != (source = g_main_current_source ()))
+    name = g_source_get_name (source);
+  g_strlcpy (detector.source_name, name ? name : "", sizeof detector.source_name);
+
+  detector.dispatch_begin = g_get_monotonic_time ();
+  g_atomic_int_inc (&detector.iteration);
+  g_atomic_int_set (&detector.in_poll, FALSE);
+
+  return ret;
+}
+
+static gpointer
+ide_stall_detector_worker (gpointer data)
+{
+  gulong interval = MAX (1000, detector.threshold / 4);
+  IdeStall *stall = NULL;
+
+  for (;;)
+    {
+      guint iteration;
+      gint64 begin;
+
+      g_usleep (interval);
+
+      if (stall != NULL)
+        {
+          if (g_atomic_int_get (&detector.finished_iteration) == detector.stalled_iteration)
+            {
+              MEMORY_BARRIER;
+              ide_stall_detector_finish_stall (stall, detector.finished_duration);
+              stall = NULL;
+            }
+          else if (g_atomic_int_get (&detector.in_poll) ||
+                   g_atomic_int_get (&detector.iteration) != detector.stalled_iteration)
+            {
+              /* The main loop went back to poll() before it saw the stall */
+              ide_stall_detector_finish_stall (stall, stall->duration);
+              stall = NULL;
+            }
+          else
+            {
+              stall->duration = g_get_monotonic_time () - stall->begin;
+              continue;
+            }
+        }
+
+      if (g_atomic_int_get (&detector.in_poll))
+        continue;
+
+      iteration = g_atomic_int_get (&detector.iteration);
+      begin = detector.dispatch_begin;
+
+      if (iteration == detector.stalled_iteration ||
+          g_get_monotonic_time () - begin < detector.threshold)
+        continue;
+
+      detector.captured = FALSE;
+      MEMORY_BARRIER;
+      g_atomic_int_set (&detector.stalled_iteration, iteration);
+      pthread_kill (detector.main_thread, STALL_SIGNAL);
+
+      stall = ide_stall_detector_begin_stall (iteration, begin);
+    }
+
+  return NULL;
+}
+
+/**
+ * _ide_stall_detector_init:
+ *
+ * Starts the stall detector if the IDE_STALL_DETECTOR environment variable
+ * is set. This must be called from the main thread.
+ */
+void
+_ide_stall_detector_init (void)
+{
+  static gboolean initialized;
+  struct sigaction sa;
+  const gchar *env;
+  gint64 threshold;
+
+  if (initialized || NULL == (env = g_getenv ("IDE_STALL_DETECTOR")))
+    return;
+
+  initialized = TRUE;
+
+  threshold = g_ascii_strtoll (env, NULL, 10);
+  if (threshold <= 0)
+    threshold = DEFAULT_THRESHOLD;
+  detector.threshold = threshold * 1000;
+
+  if (!stalls_init_local ())
+    {
+      g_warning ("Failed to allocate shared memory for stall detector: %s",
+                 g_strerror (errno));
+      return;
+    }
+
+#ifdef HAVE_EXECINFO_H
+  /* The first call to backtrace() may allocate, which the signal handler must not do */
+  backtrace (detector.addresses, G_N_ELEMENTS (detector.addresses));
+#endif
+
+  memset (&sa, 0, sizeof sa);
+  sa.sa_handler = ide_stall_detector_signal_handler;
+  sa.sa_flags = SA_RESTART;
+  sigemptyset (&sa.sa_mask);
+
+  if (sigaction (STALL_SIGNAL, &sa, NULL) != 0)
+    {
+      g_warning ("Failed to install stall detector signal handler: %s",
+                 g_strerror (errno));
+      return;
+    }
+
+  detector.main_thread = pthread_self ();
+  detector.dispatch_begin = g_get_monotonic_time ();
+  detector.stalled_iteration = G_MAXUINT;
+  detector.finished_iteration = G_MAXUINT;
+  detector.poll_func = g_main_context_get_poll_func (NULL);
+  g_main_context_set_poll_func (NULL, ide_stall_detector_poll);
+
+  detector.thread = g_thread_new ("ide-stall-detector", ide_stall_detector_worker, NULL);
+
+  g_message ("Stall detector enabled with a threshold of %"G_GINT64_FORMAT" msec",
+             threshold);
+}
+
+/**
+ * ide_stall_detector_foreach_pid:
+ * @pid: the process to read stalls from
+ * @foreach_func: (scope call): a function to call for each stall
+ * @user_data: user data for @foreach_func
+ * @error: a location for a #GError, or %NULL
+ *
+ * Reads the most recent main loop stalls recorded by @pid without blocking
+ * it. Stalls are delivered oldest first.
+ *
+ * Returns: %TRUE if the stalls of @pid could be read.
+ */
+gboolean
+ide_stall_detector_foreach_pid (GPid              pid,
+                                IdeStallForeach   foreach_func,
+                                gpointer          user_data,
+                                GError          **error)
+{
+  g_autofree IdeStall *copy = NULL;
+  StallsHeader header;
+  Stalls remote;
+  gchar name [32];
+  gpointer mem;
+  guint64 head;
+  guint64 base;
+  guint64 first;
+  guint64 new_head;
+  gint fd;
+
+  g_return_val_if_fail (foreach_func != NULL, FALSE);
+
+  g_snprintf (name, sizeof name, NAME_FORMAT, (guint)pid);
+
+  if (-1 == (fd = shm_open (name, O_RDONLY, 0)))
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   g_io_error_from_errno (errno),
+                   "Failed to open stalls for process %u: %s",
+                   (guint)pid, g_strerror (errno));
+      return FALSE;
+    }
+
+  if (pread (fd, &header, sizeof header, 0) != sizeof header ||
+      header.magic != MAGIC ||
+      header.size != STALLS_SIZE ||
+      header.n_stalls != N_STALLS)
+    {
+      close (fd);
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_INVALID_DATA,
+                   "Stalls for process %u are not in a supported format",
+                   (guint)pid);
+      return FALSE;
+    }
+
+  mem = mmap (NULL, STALLS_SIZE, PROT_READ, MAP_SHARED, fd, 0);
+  close (fd);
+
+  if (mem == MAP_FAILED)
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   g_io_error_from_errno (errno),
+                   "Failed to map stalls: %s",
+                   g_strerror (errno));
+      return FALSE;
+    }
+
+  stalls_map (&remote, mem);
+
+  copy = g_new (IdeStall, N_STALLS);
+
+  head = remote.header->head;
+  MEMORY_BARRIER;
+
+  base = first = (head > N_STALLS) ? head - N_STALLS : 0;
+
+  for (guint64 i = base; i < head; i++)
+    copy [i - base] = remote.stalls [i % N_STALLS];
+
+  MEMORY_BARRIER;
+  new_head = remote.header->head;
+
+  /*
+   * Skip anything the writer may have overwritten while we copied. The
+   * writer fills the slot of new_head before publishing it, and that slot
+   * is the one of new_head - N_STALLS, so that one may be torn too.
+   */
+  if (new_head >= N_STALLS && first <= new_head - N_STALLS)
+    first = new_head - N_STALLS + 1;
+
+  for (guint64 i = first; i < head; i++)
+    {
+      IdeStall *stall = &copy [i - base];
+
+      stall->source_name [sizeof stall->source_name - 1] = '\0';
+      stall->n_frames = MIN (stall->n_frames, IDE_STALL_MAX_FRAMES);
+
+      for (guint j = 0; j < stall->n_frames; j++)
+        stall->frames [j].module [sizeof stall->frames [j].module - 1] = '\0';
+
+      foreach_func (stall, user_data);
+    }
+
+  munmap (mem, STALLS_SIZE);
+
+  return TRUE;
+}
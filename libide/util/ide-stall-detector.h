@@ -0,0 +1,85 @@
+/* ide-stall-detector.h
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef IDE_STALL_DETECTOR_H
+#define IDE_STALL_DETECTOR_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * The stall detector is a watchdog thread that notices when the main loop
+ * has been dispatching for longer than a threshold without returning to
+ * poll(). When that happens, it interrupts the main thread to capture a
+ * backtrace and records the stall into a ring in a shared memory zone,
+ * where its duration keeps growing until the main loop recovers. Finished
+ * stalls are also counted in the "MainLoop" EggCounters.
+ *
+ * Frames are stored as raw addresses along with the module containing them
+ * and the offset into that module, so that static functions can be
+ * symbolized from debug information by the reader. GLib has no hook to see
+ * which GSource is about to be dispatched, so the source name is only known
+ * when the stall happened inside a nested main loop. It is then the name of
+ * the source that the nested loop was run from.
+ *
+ * The detector is only started when the IDE_STALL_DETECTOR environment
+ * variable is set. Its value is the threshold in milliseconds, or 100 if
+ * it is not a number. Use the ide-list-stalls tool to view the stalls of a
+ * running process.
+ */
+
+#define IDE_STALL_MAX_FRAMES 15
+
+typedef enum
+{
+  IDE_STALL_ONGOING = 1 << 0,
+} IdeStallFlags;
+
+typedef struct
+{
+  guint64 address;
+  guint64 offset;
+  gchar   module [112];
+} IdeStallFrame;
+
+G_STATIC_ASSERT (sizeof (IdeStallFrame) == 128);
+
+typedef struct
+{
+  gint64        begin;
+  gint64        duration;
+  guint32       n_frames;
+  guint32       flags;
+  gchar         source_name [104];
+  IdeStallFrame frames [IDE_STALL_MAX_FRAMES];
+} IdeStall;
+
+G_STATIC_ASSERT (sizeof (IdeStall) == 2048);
+
+typedef void (*IdeStallForeach) (const IdeStall *stall,
+                                 gpointer        user_data);
+
+gboolean ide_stall_detector_foreach_pid (GPid              pid,
+                                         IdeStallForeach   foreach_func,
+                                         gpointer          user_data,
+                                         GError          **error);
+
+G_END_DECLS
+
+#endif /* IDE_STALL_DETECTOR_H */
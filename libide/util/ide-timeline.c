@@ -0,0 +1,436 @@
+/* ide-timeline.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define G_LOG_DOMAIN "ide-timeline"
+
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <gio/gio.h>
+#include <glib/gprintf.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#ifdef __linux__
+# include <sys/syscall.h>
+#endif
+
+#include "ide-timeline.h"
+
+#define NAME_FORMAT     "/IdeTimeline-%u"
+#define MAGIC           0x1DE71E01
+#define MAX_RINGS       32
+#define EVENTS_PER_RING 1024
+#define MEMORY_BARRIER  __sync_synchronize()
+
+/*
+ * Data Layout
+ * ===========
+ *
+ * The shared memory zone starts with a header, followed by MAX_RINGS ring
+ * headers, followed by MAX_RINGS arrays of EVENTS_PER_RING events. Every
+ * structure is a multiple of 64 bytes so that rings written by different
+ * threads do not share a cacheline.
+ *
+ * A ring is claimed by a thread the first time it records an event, and
+ * released when that thread exits. Only the owning thread ever writes to a
+ * ring. The writer fills in the event and then, after a memory barrier,
+ * increments the ring head. A reader copies the events and then re-reads
+ * the head to discard anything that may have been overwritten meanwhile.
+ */
+
+typedef struct
+{
+  guint32 magic;
+  guint32 size;
+  guint32 n_rings;
+  guint32 events_per_ring;
+  gchar   padding [48];
+} TimelineHeader;
+
+typedef struct
+{
+  volatile guint64 head;
+  volatile gint32  owned;
+  guint32          thread_id;
+  gchar            padding [48];
+} RingHeader;
+
+G_STATIC_ASSERT (sizeof (TimelineHeader) == 64);
+G_STATIC_ASSERT (sizeof (RingHeader) == 64);
+
+#define TIMELINE_SIZE \
+  (sizeof (TimelineHeader) + \
+   (sizeof (RingHeader) * MAX_RINGS) + \
+   (sizeof (IdeTimelineEvent) * MAX_RINGS * EVENTS_PER_RING))
+
+typedef struct
+{
+  TimelineHeader   *header;
+  RingHeader       *rings;
+  IdeTimelineEvent *events;
+} Timeline;
+
+static Timeline timeline;
+static gboolean timeline_enabled;
+
+static void release_ring (gpointer data);
+
+static GPrivate current_ring = G_PRIVATE_INIT (release_ring);
+
+static void
+timeline_map (Timeline *tl,
+              gpointer  mem)
+{
+  tl->header = mem;
+  tl->rings = (RingHeader *)&tl->header [1];
+  tl->events = (IdeTimelineEvent *)&tl->rings [MAX_RINGS];
+}
+
+static void
+timeline_atexit (void)
+{
+  gchar name [32];
+
+  g_snprintf (name, sizeof name, NAME_FORMAT, (guint)getpid ());
+  shm_unlink (name);
+}
+
+static gboolean
+timeline_init_local (void)
+{
+  gchar name [32];
+  gpointer mem;
+  gint fd;
+
+  g_snprintf (name, sizeof name, NAME_FORMAT, (guint)getpid ());
+
+  if (-1 == (fd = shm_open (name, O_CREAT|O_RDWR, S_IRUSR|S_IWUSR|S_IRGRP)))
+    return FALSE;
+
+  /*
+   * ftruncate() zeroes the contents and only the pages we touch are backed
+   * by memory, so rings that are never claimed cost nothing.
+   */
+  if (-1 == ftruncate (fd, TIMELINE_SIZE))
+    goto failure;
+
+  mem = mmap (NULL, TIMELINE_SIZE, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+
+  if (mem == MAP_FAILED)
+    goto failure;
+
+  close (fd);
+  atexit (timeline_atexit);
+
+  timeline_map (&timeline, mem);
+
+  timeline.header->magic = MAGIC;
+  timeline.header->n_rings = MAX_RINGS;
+  timeline.header->events_per_ring = EVENTS_PER_RING;
+
+  MEMORY_BARRIER;
+
+  timeline.header->size = TIMELINE_SIZE;
+
+  return TRUE;
+
+failure:
+  shm_unlink (name);
+  close (fd);
+
+  return FALSE;
+}
+
+/**
+ * ide_timeline_get_enabled:
+ *
+ * Checks if timeline recording is enabled for this process.
+ *
+ * Returns: %TRUE if events are being recorded.
+ */
+gboolean
+ide_timeline_get_enabled (void)
+{
+  static gsize initialized;
+
+  if (g_once_init_enter (&initialized))
+    {
+      if (g_getenv ("IDE_TIMELINE") != NULL)
+        {
+          timeline_enabled = timeline_init_local ();
+
+          if (!timeline_enabled)
+            g_warning ("Failed to allocate shared memory for timeline: %s",
+                       g_strerror (errno));
+        }
+
+      g_once_init_leave (&initialized, 1);
+    }
+
+  return timeline_enabled;
+}
+
+static guint32
+get_thread_id (guint ring)
+{
+#ifdef __linux__
+  return (guint32)syscall (SYS_gettid);
+#else
+  return ring + 1;
+#endif
+}
+
+static void
+release_ring (gpointer data)
+{
+  RingHeader *ring = data;
+
+  if (ring != NULL)
+    g_atomic_int_set (&ring->owned, FALSE);
+}
+
+static RingHeader *
+claim_ring (void)
+{
+  RingHeader *ring = g_private_get (&current_ring);
+
+  if G_LIKELY (ring != NULL)
+    return ring;
+
+  for (guint i = 0; i < MAX_RINGS; i++)
+    {
+      ring = &timeline.rings [i];
+
+      if (g_atomic_int_compare_and_exchange (&ring->owned, FALSE, TRUE))
+        {
+          ring->thread_id = get_thread_id (i);
+          g_private_set (&current_ring, ring);
+          return ring;
+        }
+    }
+
+  /* All rings are in use, drop events from this thread */
+  return NULL;
+}
+
+static void
+record_event (const gchar *category,
+              const gchar *name,
+              gint64       begin,
+              gint64       end)
+{
+  IdeTimelineEvent *event;
+  RingHeader *ring;
+  guint index;
+
+  if (NULL == (ring = claim_ring ()))
+    return;
+
+  index = ring - timeline.rings;
+  event = &timeline.events [(index * EVENTS_PER_RING) + (ring->head % EVENTS_PER_RING)];
+
+  event->begin = begin;
+  event->end = end;
+  event->thread_id = ring->thread_id;
+  g_strlcpy (event->category, category, sizeof event->category);
+  g_strlcpy (event->name, name, sizeof event->name);
+
+  MEMORY_BARRIER;
+
+  ring->head++;
+}
+
+/**
+ * ide_timeline_begin:
+ *
+ * Gets the begin time for a span to be recorded with ide_timeline_end().
+ *
+ * Returns: the current monotonic time, or 0 if the timeline is disabled.
+ */
+gint64
+ide_timeline_begin (void)
+{
+  if G_LIKELY (!ide_timeline_get_enabled ())
+    return 0;
+
+  return g_get_monotonic_time ();
+}
+
+/**
+ * ide_timeline_end:
+ * @category: the category of the span, such as "IdeContext"
+ * @name: the name of the span
+ * @begin: the value returned from ide_timeline_begin()
+ *
+ * Records a span of work that started at @begin and ended now. The span
+ * is attributed to the calling thread. Spans do not need to be nested,
+ * so this may be called from an async callback.
+ *
+ * @category and @name are truncated to fit in the shared memory zone.
+ */
+void
+ide_timeline_end (const gchar *category,
+                  const gchar *name,
+                  gint64       begin)
+{
+  g_return_if_fail (category != NULL);
+  g_return_if_fail (name != NULL);
+
+  if G_LIKELY (!ide_timeline_get_enabled () || begin == 0)
+    return;
+
+  record_event (category, name, begin, g_get_monotonic_time ());
+}
+
+/**
+ * ide_timeline_mark:
+ * @category: the category of the event
+ * @name: the name of the event
+ *
+ * Records an instantaneous event, such as the workbench becoming visible.
+ */
+void
+ide_timeline_mark (const gchar *category,
+                   const gchar *name)
+{
+  gint64 now;
+
+  g_return_if_fail (category != NULL);
+  g_return_if_fail (name != NULL);
+
+  if G_LIKELY (!ide_timeline_get_enabled ())
+    return;
+
+  now = g_get_monotonic_time ();
+
+  record_event (category, name, now, now);
+}
+
+/**
+ * ide_timeline_foreach_pid:
+ * @pid: the process to read the timeline from
+ * @foreach_func: (scope call): a function to call for each event
+ * @user_data: user data for @foreach_func
+ * @error: a location for a #GError, or %NULL
+ *
+ * Reads the events recorded by @pid without blocking it. Events are
+ * delivered in order per thread, but not across threads.
+ *
+ * Returns: %TRUE if the timeline of @pid could be read.
+ */
+gboolean
+ide_timeline_foreach_pid (GPid                 pid,
+                          IdeTimelineForeach   foreach_func,
+                          gpointer             user_data,
+                          GError             **error)
+{
+  g_autofree IdeTimelineEvent *copy = NULL;
+  TimelineHeader header;
+  Timeline remote;
+  gchar name [32];
+  gpointer mem;
+  gint fd;
+
+  g_return_val_if_fail (foreach_func != NULL, FALSE);
+
+  g_snprintf (name, sizeof name, NAME_FORMAT, (guint)pid);
+
+  if (-1 == (fd = shm_open (name, O_RDONLY, 0)))
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   g_io_error_from_errno (errno),
+                   "Failed to open timeline for process %u: %s",
+                   (guint)pid, g_strerror (errno));
+      return FALSE;
+    }
+
+  if (pread (fd, &header, sizeof header, 0) != sizeof header ||
+      header.magic != MAGIC ||
+      header.size != TIMELINE_SIZE ||
+      header.n_rings != MAX_RINGS ||
+      header.events_per_ring != EVENTS_PER_RING)
+    {
+      close (fd);
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_INVALID_DATA,
+                   "Timeline for process %u is not in a supported format",
+                   (guint)pid);
+      return FALSE;
+    }
+
+  mem = mmap (NULL, TIMELINE_SIZE, PROT_READ, MAP_SHARED, fd, 0);
+  close (fd);
+
+  if (mem == MAP_FAILED)
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   g_io_error_from_errno (errno),
+                   "Failed to map timeline: %s",
+                   g_strerror (errno));
+      return FALSE;
+    }
+
+  timeline_map (&remote, mem);
+
+  copy = g_new (IdeTimelineEvent, EVENTS_PER_RING);
+
+  for (guint i = 0; i < MAX_RINGS; i++)
+    {
+      const RingHeader *ring = &remote.rings [i];
+      guint64 head;
+      guint64 base;
+      guint64 first;
+      guint64 new_head;
+
+      head = ring->head;
+      MEMORY_BARRIER;
+
+      base = first = (head > EVENTS_PER_RING) ? head - EVENTS_PER_RING : 0;
+
+      for (guint64 j = base; j < head; j++)
+        copy [j - base] = remote.events [(i * EVENTS_PER_RING) + (j % EVENTS_PER_RING)];
+
+      MEMORY_BARRIER;
+      new_head = ring->head;
+
+      /*
+       * Skip events that were overwritten while we copied, including the
+       * oldest one, whose slot is reused for the event being written at
+       * new_head.
+       */
+      if (new_head >= EVENTS_PER_RING && first <= new_head - EVENTS_PER_RING)
+        first = new_head - EVENTS_PER_RING + 1;
+
+      for (guint64 j = first; j < head; j++)
+        foreach_func (&copy [j - base], user_data);
+    }
+
+  munmap (mem, TIMELINE_SIZE);
+
+  return TRUE;
+}
@@ -0,0 +1,73 @@
+/* ide-timeline.h
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef IDE_TIMELINE_H
+#define IDE_TIMELINE_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * IdeTimeline records spans of work (a category, a name, the thread and
+ * the monotonic begin and end time) into a shared memory zone so that an
+ * external process can see where time went, such as during project open.
+ *
+ * Each thread writes to its own ring of events, so recording an event does
+ * not require any locking. When a ring is full, the oldest events are
+ * overwritten.
+ *
+ * Recording is disabled unless the IDE_TIMELINE environment variable is set
+ * when the process starts. Use the ide-dump-timeline tool to convert the
+ * events of a running process into the Chrome trace event format.
+ *
+ *   gint64 begin = ide_timeline_begin ();
+ *   do_some_work ();
+ *   ide_timeline_end ("Category", "do-some-work", begin);
+ */
+
+typedef struct
+{
+  gint64  begin;
+  gint64  end;
+  guint32 thread_id;
+  guint32 padding;
+  gchar   category [32];
+  gchar   name [72];
+} IdeTimelineEvent;
+
+G_STATIC_ASSERT (sizeof (IdeTimelineEvent) == 128);
+
+typedef void (*IdeTimelineForeach) (const IdeTimelineEvent *event,
+                                    gpointer                user_data);
+
+gboolean ide_timeline_get_enabled  (void);
+gint64   ide_timeline_begin        (void);
+void     ide_timeline_end          (const gchar         *category,
+                                    const gchar         *name,
+                                    gint64               begin);
+void     ide_timeline_mark         (const gchar         *category,
+                                    const gchar         *name);
+gboolean ide_timeline_foreach_pid  (GPid                 pid,
+                                    IdeTimelineForeach   foreach_func,
+                                    gpointer             user_data,
+                                    GError             **error);
+
+G_END_DECLS
+
+#endif /* IDE_TIMELINE_H */
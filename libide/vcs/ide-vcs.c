@@ -72,6 +72,19 @@ ide_vcs_default_init (IdeVcsInterface *iface)
                   NULL, NULL, NULL, G_TYPE_NONE, 0);
 }
 
+/**
+ * ide_vcs_is_ignored:
+ * @self: An #IdeVcs
+ * @file: A #GFile
+ * @error: A location for a #GError, or %NULL
+ *
+ * Checks whether @file is ignored by the version control system.
+ *
+ * This function may be called from worker threads, such as indexers walking
+ * the project tree. Implementations must be thread-safe.
+ *
+ * Returns: %TRUE if @file is ignored.
+ */
 gboolean
 ide_vcs_is_ignored (IdeVcs  *self,
                     GFile   *file,
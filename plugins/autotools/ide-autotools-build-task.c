@@ -24,8 +24,10 @@
 
 #include <fcntl.h>
 #include <glib/gi18n.h>
+#include <glib/gstdio.h>
 #include <ide.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 #include "ide-autotools-build-task.h"
@@ -33,6 +35,14 @@
 #define FLAG_SET(_f,_n) (((_f) & (_n)) != 0)
 #define FLAG_UNSET(_f,_n) (((_f) & (_n)) == 0)
 
+/*
+ * Digests of the inputs to autogen.sh and configure are stored in the
+ * build directory so that we can skip those steps when a build requests
+ * them but nothing that would affect their output has changed.
+ */
+#define AUTOGEN_DIGEST_NAME   ".builder-autogen.sha256"
+#define CONFIGURE_DIGEST_NAME ".builder-configure.sha256"
+
 struct _IdeAutotoolsBuildTask
 {
   IdeBuildResult    parent;
@@ -51,6 +61,7 @@ typedef struct
   gchar                 *project_path;
   gchar                 *parallel;
   gchar                 *system_type;
+  gchar                 *autogen_digest;
   gchar                **configure_argv;
   gchar                **make_targets;
   IdeRuntime            *runtime;
@@ -60,6 +71,7 @@ typedef struct
   guint                  require_autogen : 1;
   guint                  require_configure : 1;
   guint                  bootstrap_only : 1;
+  guint                  force_bootstrap : 1;
 } WorkerState;
 
 typedef gboolean (*WorkStep) (GTask                 *task,
@@ -489,7 +501,8 @@ worker_state_new (IdeAutotoolsBuildTask  *self,
 
   state = g_slice_new0 (WorkerState);
   state->sequence = ide_configuration_get_sequence (self->configuration);
-  state->require_autogen = self->require_autogen || FLAG_SET (flags, IDE_BUILDER_BUILD_FLAGS_FORCE_BOOTSTRAP);
+  state->force_bootstrap = FLAG_SET (flags, IDE_BUILDER_BUILD_FLAGS_FORCE_BOOTSTRAP);
+  state->require_autogen = self->require_autogen || state->force_bootstrap;
   state->require_configure = self->require_configure || (state->require_autogen && FLAG_UNSET (flags, IDE_BUILDER_BUILD_FLAGS_NO_CONFIGURE));
   state->directory_path = g_file_get_path (self->directory);
   state->project_path = g_file_get_path (project_dir);
@@ -557,6 +570,7 @@ worker_state_free (void *data)
   g_free (state->directory_path);
   g_free (state->project_path);
   g_free (state->system_type);
+  g_free (state->autogen_digest);
   g_free (state->parallel);
   g_strfreev (state->configure_argv);
   g_strfreev (state->make_targets);
@@ -951,6 +965,206 @@ log_and_spawn (IdeAutotoolsBuildTask  *self,
   return ret;
 }
 
+static gint
+compare_strings (gconstpointer a,
+                 gconstpointer b)
+{
+  return strcmp (*(const gchar **)a, *(const gchar **)b);
+}
+
+static gboolean
+is_autogen_input (const gchar *name)
+{
+  return (g_str_equal (name, "Makefile.am") ||
+          g_str_equal (name, "configure.ac") ||
+          g_str_equal (name, "configure.in") ||
+          g_str_has_suffix (name, ".m4"));
+}
+
+static void
+collect_autogen_inputs (const gchar  *path,
+                        const gchar  *skip_path,
+                        GPtrArray    *inputs,
+                        GCancellable *cancellable)
+{
+  g_autoptr(GDir) dir = NULL;
+  const gchar *name;
+
+  g_assert (path != NULL);
+  g_assert (inputs != NULL);
+
+  if (g_cancellable_is_cancelled (cancellable))
+    return;
+
+  if (NULL == (dir = g_dir_open (path, 0, NULL)))
+    return;
+
+  while (NULL != (name = g_dir_read_name (dir)))
+    {
+      g_autofree gchar *child = NULL;
+      GStatBuf st;
+
+      if (*name == '.')
+        continue;
+
+      child = g_build_filename (path, name, NULL);
+
+      /* Don't follow symlinks, they may lead out of the project */
+      if (g_lstat (child, &st) != 0)
+        continue;
+
+      if (S_ISDIR (st.st_mode))
+        {
+          if (g_strcmp0 (child, skip_path) != 0)
+            collect_autogen_inputs (child, skip_path, inputs, cancellable);
+        }
+      else if (S_ISREG (st.st_mode) && is_autogen_input (name))
+        {
+          g_ptr_array_add (inputs, g_steal_pointer (&child));
+        }
+    }
+}
+
+/*
+ * Hashes everything that autogen.sh consumes. The result is cached on
+ * the worker state since the configure digest builds upon it.
+ */
+static const gchar *
+get_autogen_digest (WorkerState  *state,
+                    GCancellable *cancellable)
+{
+  g_autoptr(GPtrArray) inputs = NULL;
+  g_autoptr(GChecksum) checksum = NULL;
+  g_autofree gchar *autogen_sh_path = NULL;
+  gsize prefix_len;
+
+  g_assert (state != NULL);
+
+  if (state->autogen_digest != NULL)
+    return state->autogen_digest;
+
+  inputs = g_ptr_array_new_with_free_func (g_free);
+  autogen_sh_path = g_build_filename (state->project_path, "autogen.sh", NULL);
+  if (g_file_test (autogen_sh_path, G_FILE_TEST_IS_REGULAR))
+    g_ptr_array_add (inputs, g_steal_pointer (&autogen_sh_path));
+  collect_autogen_inputs (state->project_path, state->directory_path, inputs, cancellable);
+  g_ptr_array_sort (inputs, compare_strings);
+
+  if (g_cancellable_is_cancelled (cancellable))
+    return NULL;
+
+  checksum = g_checksum_new (G_CHECKSUM_SHA256);
+  prefix_len = strlen (state->project_path);
+
+  for (guint i = 0; i < inputs->len; i++)
+    {
+      const gchar *path = g_ptr_array_index (inputs, i);
+      g_autofree gchar *contents = NULL;
+      gsize len = 0;
+
+      /* Include the relative path so that moving files changes the digest */
+      g_checksum_update (checksum, (const guchar *)path + prefix_len, -1);
+      g_checksum_update (checksum, (const guchar *)"", 1);
+
+      if (g_file_get_contents (path, &contents, &len, NULL))
+        g_checksum_update (checksum, (const guchar *)contents, len);
+    }
+
+  state->autogen_digest = g_strdup (g_checksum_get_string (checksum));
+
+  return state->autogen_digest;
+}
+
+/*
+ * Hashes everything that affects the output of configure, which is the
+ * generated configure script along with how we are going to invoke it.
+ */
+static gchar *
+get_configure_digest (WorkerState  *state,
+                      GCancellable *cancellable)
+{
+  g_autoptr(GChecksum) checksum = NULL;
+  g_auto(GStrv) env = NULL;
+  const gchar *autogen_digest;
+  const gchar *runtime_id;
+
+  g_assert (state != NULL);
+
+  if (NULL == (autogen_digest = get_autogen_digest (state, cancellable)))
+    return NULL;
+
+  checksum = g_checksum_new (G_CHECKSUM_SHA256);
+
+  g_checksum_update (checksum, (const guchar *)autogen_digest, -1);
+  g_checksum_update (checksum, (const guchar *)"", 1);
+
+  if (NULL != (runtime_id = ide_runtime_get_id (state->runtime)))
+    g_checksum_update (checksum, (const guchar *)runtime_id, -1);
+  g_checksum_update (checksum, (const guchar *)"", 1);
+
+  for (guint i = 0; state->configure_argv [i]; i++)
+    {
+      g_checksum_update (checksum, (const guchar *)state->configure_argv [i], -1);
+      g_checksum_update (checksum, (const guchar *)"", 1);
+    }
+
+  env = ide_environment_get_environ (state->environment);
+
+  if (env != NULL)
+    {
+      qsort (env, g_strv_length (env), sizeof (gchar *), compare_strings);
+
+      for (guint i = 0; env [i]; i++)
+        {
+          g_checksum_update (checksum, (const guchar *)env [i], -1);
+          g_checksum_update (checksum, (const guchar *)"", 1);
+        }
+    }
+
+  return g_strdup (g_checksum_get_string (checksum));
+}
+
+static gboolean
+digest_matches (WorkerState *state,
+                const gchar *name,
+                const gchar *digest)
+{
+  g_autofree gchar *path = NULL;
+  g_autofree gchar *contents = NULL;
+
+  g_assert (state != NULL);
+  g_assert (name != NULL);
+
+  if (digest == NULL)
+    return FALSE;
+
+  path = g_build_filename (state->directory_path, name, NULL);
+
+  if (!g_file_get_contents (path, &contents, NULL, NULL))
+    return FALSE;
+
+  return g_str_equal (g_strstrip (contents), digest);
+}
+
+static void
+save_digest (WorkerState *state,
+             const gchar *name,
+             const gchar *digest)
+{
+  g_autofree gchar *path = NULL;
+  g_autoptr(GError) error = NULL;
+
+  g_assert (state != NULL);
+  g_assert (name != NULL);
+
+  path = g_build_filename (state->directory_path, name, NULL);
+
+  if (digest == NULL)
+    g_unlink (path);
+  else if (!g_file_set_contents (path, digest, -1, &error))
+    g_warning ("Failed to save %s: %s", name, error->message);
+}
+
 static gboolean
 step_mkdirs (GTask                 *task,
              IdeAutotoolsBuildTask *self,
@@ -996,6 +1210,7 @@ step_autogen (GTask                 *task,
   g_autofree gchar *configure_path = NULL;
   g_autoptr(IdeSubprocessLauncher) launcher = NULL;
   g_autoptr(IdeSubprocess) process = NULL;
+  const gchar *digest;
   GError *error = NULL;
 
   g_assert (G_IS_TASK (task));
@@ -1011,6 +1226,20 @@ step_autogen (GTask                 *task,
         return TRUE;
     }
 
+  digest = get_autogen_digest (state, cancellable);
+
+  if (!state->force_bootstrap &&
+      g_file_test (configure_path, G_FILE_TEST_IS_EXECUTABLE) &&
+      digest_matches (state, AUTOGEN_DIGEST_NAME, digest))
+    {
+      ide_build_result_log_stdout (IDE_BUILD_RESULT (self), "%s",
+                                   _("Skipping autogen.sh, its inputs have not changed"));
+      return TRUE;
+    }
+
+  /* Drop the stale digest so a failed run is retried next time */
+  save_digest (state, AUTOGEN_DIGEST_NAME, NULL);
+
   autogen_sh_path = g_build_filename (state->project_path, "autogen.sh", NULL);
   if (!g_file_test (autogen_sh_path, G_FILE_TEST_EXISTS))
     {
@@ -1071,6 +1300,8 @@ step_autogen (GTask                 *task,
       return FALSE;
     }
 
+  save_digest (state, AUTOGEN_DIGEST_NAME, digest);
+
   return TRUE;
 }
 
@@ -1084,6 +1315,7 @@ step_configure (GTask                 *task,
   g_autoptr(IdeSubprocess) process = NULL;
   g_autofree gchar *makefile_path = NULL;
   g_autofree gchar *config_log = NULL;
+  g_autofree gchar *digest = NULL;
   GError *error = NULL;
 
   g_assert (G_IS_TASK (task));
@@ -1101,6 +1333,27 @@ step_configure (GTask                 *task,
         return TRUE;
     }
 
+  digest = get_configure_digest (state, cancellable);
+
+  if (!state->force_bootstrap && digest_matches (state, CONFIGURE_DIGEST_NAME, digest))
+    {
+      g_autofree gchar *config_status_path = NULL;
+
+      if (makefile_path == NULL)
+        makefile_path = g_build_filename (state->directory_path, "Makefile", NULL);
+      config_status_path = g_build_filename (state->directory_path, "config.status", NULL);
+
+      if (g_file_test (makefile_path, G_FILE_TEST_EXISTS) &&
+          g_file_test (config_status_path, G_FILE_TEST_EXISTS))
+        {
+          ide_build_result_log_stdout (IDE_BUILD_RESULT (self), "%s",
+                                       _("Skipping configure, its inputs have not changed"));
+          goto finish;
+        }
+    }
+
+  save_digest (state, CONFIGURE_DIGEST_NAME, NULL);
+
   ide_build_result_set_mode (IDE_BUILD_RESULT (self), _("Running configure…"));
 
   if (NULL == (launcher = ide_runtime_create_launcher (state->runtime, &error)))
@@ -1131,6 +1384,9 @@ step_configure (GTask                 *task,
       return FALSE;
     }
 
+  save_digest (state, CONFIGURE_DIGEST_NAME, digest);
+
+finish:
   if (state->bootstrap_only)
     {
       g_task_return_boolean (task, TRUE);
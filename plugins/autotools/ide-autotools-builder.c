@@ -140,12 +140,19 @@ ide_autotools_builder_build_async (IdeBuilder           *builder,
   g_autoptr(GFile) directory = NULL;
   IdeConfiguration *configuration;
   IdeContext *context;
+  gboolean needs_bootstrap;
 
   g_return_if_fail (IDE_IS_AUTOTOOLS_BUILDER (builder));
   g_return_if_fail (IDE_IS_AUTOTOOLS_BUILDER (self));
 
-  if (ide_autotools_builder_get_needs_bootstrap (self))
-    flags |= IDE_BUILDER_BUILD_FLAGS_FORCE_BOOTSTRAP;
+  /*
+   * A missing configure script or a dirty configuration only requires that
+   * we bootstrap, it does not force it. The build task still consults its
+   * input digests so that unchanged inputs skip autogen.sh and configure.
+   * IDE_BUILDER_BUILD_FLAGS_FORCE_BOOTSTRAP is reserved for the user
+   * explicitly asking to rebuild from scratch.
+   */
+  needs_bootstrap = ide_autotools_builder_get_needs_bootstrap (self);
 
   task = g_task_new (self, cancellable, callback, user_data);
 
@@ -159,6 +166,7 @@ ide_autotools_builder_build_async (IdeBuilder           *builder,
                                "mode", _("Building…"),
                                "running", TRUE,
                                "install", FALSE,
+                               "require-autogen", needs_bootstrap,
                                NULL);
 
   if (result != NULL)
@@ -43,6 +43,7 @@
 #define FAKE_CXX     "__LIBIDE_FAKE_CXX__"
 #define FAKE_VALAC   "__LIBIDE_FAKE_VALAC__"
 #define PRINT_VARS   "include Makefile\nprint-%: ; @echo $* = $($*)\n"
+#define COMPILE_COMMANDS_NAME "compile_commands.json"
 
 struct _IdeMakecache
 {
@@ -52,6 +53,7 @@ struct _IdeMakecache
   GFile        *parent;
   gchar        *llvm_flags;
   GMappedFile  *mapped;
+  IdeCompileCommands *compile_commands;
   EggTaskCache *file_targets_cache;
   EggTaskCache *file_flags_cache;
   GPtrArray    *build_targets;
@@ -74,6 +76,8 @@ typedef struct
 G_DEFINE_TYPE (IdeMakecache, ide_makecache, IDE_TYPE_OBJECT)
 
 EGG_DEFINE_COUNTER (instances, "IdeMakecache", "Instances", "The number of IdeMakecache")
+EGG_DEFINE_HISTOGRAM (FileFlagsLatency, "Autotools", "File Flags Latency",
+                      "Time taken to extract the compiler flags of a file, in microseconds.")
 
 enum {
   PROP_0,
@@ -83,6 +87,11 @@ enum {
 
 static GParamSpec *properties [LAST_PROP];
 
+static GPtrArray *find_make_directories (IdeMakecache  *self,
+                                         GFile         *build_dir,
+                                         GCancellable  *cancellable,
+                                         GError       **error);
+
 static void
 file_flags_lookup_free (gpointer data)
 {
@@ -122,6 +131,21 @@ file_is_clangable (GFile *file)
           g_str_has_prefix (name, "xxh."));
 }
 
+static gboolean
+file_is_cxx (GFile *file)
+{
+  g_autofree gchar *name = NULL;
+
+  name = g_strreverse (g_file_get_basename (file));
+
+  return (g_str_has_prefix (name, "cc.") ||
+          g_str_has_prefix (name, "hh.") ||
+          g_str_has_prefix (name, "ppc.") ||
+          g_str_has_prefix (name, "pph.") ||
+          g_str_has_prefix (name, "xxc.") ||
+          g_str_has_prefix (name, "xxh."));
+}
+
 static gchar *
 ide_makecache_get_relative_path (IdeMakecache *self,
                                  GFile        *file)
@@ -989,6 +1013,7 @@ ide_makecache_get_file_flags_worker (GTask        *task,
   FileFlagsLookup *lookup = task_data;
   gsize i;
   gsize j;
+  EGG_HISTOGRAM_TIME_SCOPE (FileFlagsLatency);
 
   IDE_ENTRY;
 
@@ -1132,6 +1157,534 @@ ide_makecache_get_file_flags_worker (GTask        *task,
   IDE_EXIT;
 }
 
+static void
+append_json_string (GString     *str,
+                    const gchar *value)
+{
+  g_assert (str != NULL);
+  g_assert (value != NULL);
+
+  g_string_append_c (str, '"');
+
+  for (; *value; value++)
+    {
+      switch (*value)
+        {
+        case '"':
+          g_string_append (str, "\\\"");
+          break;
+
+        case '\\':
+          g_string_append (str, "\\\\");
+          break;
+
+        case '\n':
+          g_string_append (str, "\\n");
+          break;
+
+        case '\t':
+          g_string_append (str, "\\t");
+          break;
+
+        default:
+          if ((guchar)*value < 0x20)
+            g_string_append_printf (str, "\\u%04x", (guint)*value);
+          else
+            g_string_append_c (str, *value);
+          break;
+        }
+    }
+
+  g_string_append_c (str, '"');
+}
+
+static gchar *
+resolve_source (const gchar *directory,
+                const gchar *prefix,
+                const gchar *path)
+{
+  g_autofree gchar *joined = NULL;
+  g_autoptr(GFile) file = NULL;
+
+  g_assert (directory != NULL);
+  g_assert (path != NULL);
+
+  if (g_path_is_absolute (path))
+    return g_strdup (path);
+
+  joined = g_build_filename (directory, path, NULL);
+
+  /*
+   * Automake emits `test -f 'foo.c' || echo '$(srcdir)/'`foo.c so that
+   * VPATH builds can find the source. Mirror what the shell would do.
+   */
+  if (prefix != NULL && !g_file_test (joined, G_FILE_TEST_EXISTS))
+    {
+      g_free (joined);
+      joined = g_build_filename (directory, prefix, path, NULL);
+    }
+
+  /* GFile canonicalizes away any "." or ".." components for us */
+  file = g_file_new_for_path (joined);
+
+  return g_file_get_path (file);
+}
+
+static gboolean
+option_takes_value (const gchar *arg)
+{
+  static const gchar *options[] = {
+    "-o", "-MT", "-MF", "-MQ", "-I", "-D", "-U", "-x",
+    "-include", "-imacros", "-isystem", "-iquote", "-idirafter",
+  };
+
+  for (guint i = 0; i < G_N_ELEMENTS (options); i++)
+    {
+      if (g_str_equal (arg, options [i]))
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+/*
+ * Parses a single line of `make -n` output and, if it is a compile of
+ * a single source file, appends a compile_commands.json entry for it.
+ */
+static gboolean
+ide_makecache_export_line (const gchar *line,
+                           const gchar *directory,
+                           GString     *json,
+                           guint        n_commands)
+{
+  g_auto(GStrv) argv = NULL;
+  g_autoptr(GPtrArray) args = NULL;
+  g_autofree gchar *source = NULL;
+  const gchar *compiler;
+  const gchar *pos;
+  gboolean in_expand = FALSE;
+  gboolean has_compile = FALSE;
+  gint argc = 0;
+  gint i;
+
+  g_assert (line != NULL);
+  g_assert (directory != NULL);
+  g_assert (json != NULL);
+
+  if (NULL != (pos = strstr (line, FAKE_CXX)))
+    {
+      compiler = "c++";
+      pos += strlen (FAKE_CXX);
+    }
+  else if (NULL != (pos = strstr (line, FAKE_CC)))
+    {
+      compiler = "cc";
+      pos += strlen (FAKE_CC);
+    }
+  else
+    return FALSE;
+
+  if (!g_shell_parse_argv (pos, &argc, &argv, NULL))
+    return FALSE;
+
+  args = g_ptr_array_new ();
+  g_ptr_array_add (args, (gchar *)compiler);
+
+  for (i = 0; i < argc; i++)
+    {
+      const gchar *arg = argv [i];
+      const gchar *tick = strrchr (arg, '`');
+
+      if (tick != NULL)
+        {
+          /* Closing `test -f 'foo.c' || echo 'prefix/'`foo.c */
+          if (in_expand && tick [1] != '\0')
+            {
+              g_autofree gchar *prefix = g_strndup (arg, tick - arg);
+
+              g_free (source);
+              source = resolve_source (directory, prefix, tick + 1);
+            }
+
+          for (; *arg; arg++)
+            {
+              if (*arg == '`')
+                in_expand = !in_expand;
+            }
+
+          continue;
+        }
+
+      if (in_expand)
+        continue;
+
+      if (g_str_equal (arg, "-c"))
+        has_compile = TRUE;
+
+      if (arg [0] == '-')
+        {
+          g_ptr_array_add (args, (gchar *)arg);
+          if (option_takes_value (arg) && (i < (argc - 1)))
+            g_ptr_array_add (args, argv [++i]);
+          continue;
+        }
+
+      g_free (source);
+      source = resolve_source (directory, NULL, arg);
+    }
+
+  /* Link lines use $(CC) too, but never with -c */
+  if (!has_compile || source == NULL)
+    return FALSE;
+
+  g_ptr_array_add (args, source);
+
+  g_string_append (json, n_commands ? ",\n  {\n" : "  {\n");
+  g_string_append (json, "    \"directory\": ");
+  append_json_string (json, directory);
+  g_string_append (json, ",\n    \"arguments\": [");
+  for (guint j = 0; j < args->len; j++)
+    {
+      if (j > 0)
+        g_string_append (json, ", ");
+      append_json_string (json, g_ptr_array_index (args, j));
+    }
+  g_string_append (json, "],\n    \"file\": ");
+  append_json_string (json, source);
+  g_string_append (json, "\n  }");
+
+  return TRUE;
+}
+
+static gchar *
+parse_directory_change (const gchar *line,
+                        gboolean    *entering)
+{
+  const gchar *pos;
+  gsize len;
+
+  g_assert (line != NULL);
+  g_assert (entering != NULL);
+
+  if (NULL != (pos = strstr (line, ": Entering directory ")))
+    {
+      *entering = TRUE;
+      pos += IDE_LITERAL_LENGTH (": Entering directory ");
+    }
+  else if (NULL != (pos = strstr (line, ": Leaving directory ")))
+    {
+      *entering = FALSE;
+      pos += IDE_LITERAL_LENGTH (": Leaving directory ");
+    }
+  else
+    return NULL;
+
+  /* We run make with LC_ALL=C, so quoting is either `dir' or 'dir' */
+  len = strlen (pos);
+  if (len < 2)
+    return NULL;
+
+  return g_strndup (pos + 1, len - 2);
+}
+
+/*
+ * Automake regenerates the Makefile of a single subdirectory when its
+ * Makefile.am changes, so the top-level Makefile alone is not enough to
+ * know whether an exported database is still current.
+ */
+static gboolean
+ide_makecache_makefiles_older_than (IdeMakecache *self,
+                                    time_t        mtime,
+                                    GCancellable *cancellable)
+{
+  g_autoptr(GPtrArray) dirs = NULL;
+
+  g_assert (IDE_IS_MAKECACHE (self));
+
+  if (!(dirs = find_make_directories (self, self->parent, cancellable, NULL)))
+    return FALSE;
+
+  for (guint i = 0; i < dirs->len; i++)
+    {
+      GFile *dir = g_ptr_array_index (dirs, i);
+      g_autofree gchar *path = NULL;
+      g_autofree gchar *makefile_path = NULL;
+      GStatBuf st;
+
+      path = g_file_get_path (dir);
+      makefile_path = g_build_filename (path, "Makefile", NULL);
+
+      if (g_stat (makefile_path, &st) != 0 || st.st_mtime > mtime)
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+static void
+ide_makecache_export_compile_commands_worker (GTask        *task,
+                                              gpointer      source_object,
+                                              gpointer      task_data,
+                                              GCancellable *cancellable)
+{
+  IdeMakecache *self = source_object;
+  g_autoptr(GSubprocessLauncher) launcher = NULL;
+  g_autoptr(GSubprocess) subprocess = NULL;
+  g_autoptr(GDataInputStream) stream = NULL;
+  g_autoptr(GPtrArray) directories = NULL;
+  g_autoptr(GString) json = NULL;
+  g_autoptr(GString) command = NULL;
+  g_autofree gchar *workdir = NULL;
+  g_autofree gchar *path = NULL;
+  GError *error = NULL;
+  GStatBuf st;
+  guint n_commands = 0;
+  gchar *line;
+
+  IDE_ENTRY;
+
+  g_assert (G_IS_TASK (task));
+  g_assert (IDE_IS_MAKECACHE (self));
+
+  workdir = g_file_get_path (self->parent);
+  path = g_build_filename (workdir, COMPILE_COMMANDS_NAME, NULL);
+
+  /*
+   * configure and automake rewrite the Makefiles, so if the database is
+   * newer than all of them we can reuse it from a previous session.
+   */
+  if (g_stat (path, &st) == 0 &&
+      ide_makecache_makefiles_older_than (self, st.st_mtime, cancellable))
+    {
+      IDE_TRACE_MSG ("Reusing %s", path);
+      g_task_return_boolean (task, TRUE);
+      IDE_EXIT;
+    }
+
+  /*
+   * Rather than asking make for the flags of each file, ask it for every
+   * compile command in the project at once. -B treats every target as out
+   * of date so we get commands even for things that are already built, and
+   * -w lets us track which directory each command runs within.
+   *
+   * make remakes its makefiles for real even under -n, and -B would make
+   * that always happen, running automake and config.status behind the
+   * user's back. -o marks those files as up to date (and propagates to
+   * recursive makes through MAKEFLAGS) so that never happens.
+   */
+  launcher = g_subprocess_launcher_new (G_SUBPROCESS_FLAGS_STDOUT_PIPE |
+                                        G_SUBPROCESS_FLAGS_STDERR_SILENCE);
+  g_subprocess_launcher_set_cwd (launcher, workdir);
+  g_subprocess_launcher_setenv (launcher, "LC_ALL", "C", TRUE);
+
+  subprocess = g_subprocess_launcher_spawn (launcher, &error,
+                                            GNU_MAKE_NAME, "-w", "-s", "-i", "-k", "-n", "-B",
+                                            "-o", "Makefile",
+                                            "-o", "Makefile.in",
+                                            "-o", "config.status",
+                                            "-o", "configure",
+                                            "-o", "aclocal.m4",
+                                            "V=1", "CC="FAKE_CC, "CXX="FAKE_CXX, "all",
+                                            NULL);
+
+  if (subprocess == NULL)
+    {
+      g_task_return_error (task, error);
+      IDE_EXIT;
+    }
+
+  stream = g_data_input_stream_new (g_subprocess_get_stdout_pipe (subprocess));
+  directories = g_ptr_array_new_with_free_func (g_free);
+  command = g_string_new (NULL);
+  json = g_string_new ("[\n");
+
+  while (NULL != (line = g_data_input_stream_read_line_utf8 (stream, NULL, cancellable, &error)))
+    {
+      g_autofree gchar *directory = NULL;
+      gboolean entering = FALSE;
+      gsize len = strlen (line);
+
+      /* Join escaped newlines into a single command */
+      if (len > 0 && line [len - 1] == '\\')
+        {
+          line [len - 1] = ' ';
+          g_string_append (command, line);
+          g_free (line);
+          continue;
+        }
+
+      g_string_append (command, line);
+      g_free (line);
+
+      if (NULL != (directory = parse_directory_change (command->str, &entering)))
+        {
+          if (entering)
+            g_ptr_array_add (directories, g_steal_pointer (&directory));
+          else if (directories->len > 0)
+            g_ptr_array_remove_index (directories, directories->len - 1);
+        }
+      else if (ide_makecache_export_line (command->str,
+                                          directories->len > 0
+                                            ? g_ptr_array_index (directories, directories->len - 1)
+                                            : workdir,
+                                          json,
+                                          n_commands))
+        {
+          n_commands++;
+        }
+
+      g_string_truncate (command, 0);
+    }
+
+  if (error != NULL)
+    {
+      g_subprocess_force_exit (subprocess);
+      g_task_return_error (task, error);
+      IDE_EXIT;
+    }
+
+  /* make -i -k exits successfully unless something is really wrong */
+  if (!g_subprocess_wait_check (subprocess, cancellable, &error))
+    {
+      g_task_return_error (task, error);
+      IDE_EXIT;
+    }
+
+  if (n_commands == 0)
+    {
+      g_task_return_new_error (task,
+                               G_IO_ERROR,
+                               G_IO_ERROR_NOT_FOUND,
+                               "Failed to locate any compile commands");
+      IDE_EXIT;
+    }
+
+  g_string_append (json, "\n]\n");
+
+  IDE_TRACE_MSG ("Writing %u compile commands to %s", n_commands, path);
+
+  if (!g_file_set_contents (path, json->str, json->len, &error))
+    {
+      g_task_return_error (task, error);
+      IDE_EXIT;
+    }
+
+  g_task_return_boolean (task, TRUE);
+
+  IDE_EXIT;
+}
+
+static void
+ide_makecache_load_compile_commands_cb (GObject      *object,
+                                        GAsyncResult *result,
+                                        gpointer      user_data)
+{
+  IdeCompileCommands *compile_commands = (IdeCompileCommands *)object;
+  g_autoptr(IdeMakecache) self = user_data;
+  g_autoptr(GError) error = NULL;
+
+  g_assert (IDE_IS_COMPILE_COMMANDS (compile_commands));
+  g_assert (IDE_IS_MAKECACHE (self));
+
+  if (!ide_compile_commands_load_finish (compile_commands, result, &error))
+    g_warning ("Failed to load compile commands: %s", error->message);
+}
+
+static void
+ide_makecache_export_compile_commands_cb (GObject      *object,
+                                          GAsyncResult *result,
+                                          gpointer      user_data)
+{
+  IdeMakecache *self = (IdeMakecache *)object;
+  g_autoptr(GError) error = NULL;
+
+  IDE_ENTRY;
+
+  g_assert (IDE_IS_MAKECACHE (self));
+  g_assert (G_IS_TASK (result));
+
+  if (!g_task_propagate_boolean (G_TASK (result), &error))
+    {
+      g_debug ("Not using compile commands: %s", error->message);
+      IDE_EXIT;
+    }
+
+  ide_compile_commands_load_async (self->compile_commands,
+                                   NULL,
+                                   ide_makecache_load_compile_commands_cb,
+                                   g_object_ref (self));
+
+  IDE_EXIT;
+}
+
+/*
+ * Ensures that compile_commands.json exists next to the Makefile, generating
+ * it in the background if necessary. Once loaded, flag lookups are answered
+ * from it without spawning make for each file. Other tools (such as external
+ * language servers) can use the very same file.
+ */
+static void
+ide_makecache_export_compile_commands (IdeMakecache *self)
+{
+  g_autoptr(GTask) task = NULL;
+  g_autoptr(GFile) file = NULL;
+  IdeContext *context;
+
+  IDE_ENTRY;
+
+  g_assert (IDE_IS_MAKECACHE (self));
+  g_assert (self->compile_commands == NULL);
+
+  if (self->parent == NULL)
+    IDE_EXIT;
+
+  context = ide_object_get_context (IDE_OBJECT (self));
+  file = g_file_get_child (self->parent, COMPILE_COMMANDS_NAME);
+  self->compile_commands = ide_compile_commands_new (context, file);
+
+  task = g_task_new (self, NULL, ide_makecache_export_compile_commands_cb, NULL);
+  g_task_set_source_tag (task, ide_makecache_export_compile_commands);
+
+  ide_thread_pool_push_task (IDE_THREAD_POOL_COMPILER,
+                             task,
+                             ide_makecache_export_compile_commands_worker);
+
+  IDE_EXIT;
+}
+
+static gchar **
+ide_makecache_lookup_compile_commands (IdeMakecache *self,
+                                       GFile        *file)
+{
+  g_auto(GStrv) flags = NULL;
+  GPtrArray *ret;
+
+  g_assert (IDE_IS_MAKECACHE (self));
+  g_assert (G_IS_FILE (file));
+
+  if (self->compile_commands == NULL)
+    return NULL;
+
+  /* Fails until the database has been loaded */
+  if (NULL == (flags = ide_compile_commands_lookup (self->compile_commands, file, NULL, NULL)))
+    return NULL;
+
+  ret = g_ptr_array_new ();
+
+  if (file_is_cxx (file))
+    g_ptr_array_add (ret, g_strdup ("-xc++"));
+
+  if (self->llvm_flags != NULL)
+    g_ptr_array_add (ret, g_strdup (self->llvm_flags));
+
+  for (guint i = 0; flags [i]; i++)
+    g_ptr_array_add (ret, g_steal_pointer (&flags [i]));
+
+  g_ptr_array_add (ret, NULL);
+
+  return (gchar **)g_ptr_array_free (ret, FALSE);
+}
+
 static void
 ide_makecache_set_makefile (IdeMakecache *self,
                             GFile        *makefile)
@@ -1370,6 +1923,7 @@ ide_makecache_get_file_flags_dispatch (EggTaskCache  *cache,
   IdeMakecache *self = user_data;
   FileFlagsLookup *lookup;
   GFile *file = (GFile *)key;
+  gchar **flags;
 
   IDE_ENTRY;
 
@@ -1377,6 +1931,12 @@ ide_makecache_get_file_flags_dispatch (EggTaskCache  *cache,
   g_assert (IDE_IS_MAKECACHE (self));
   g_assert (G_IS_FILE (file));
 
+  if (NULL != (flags = ide_makecache_lookup_compile_commands (self, file)))
+    {
+      g_task_return_pointer (task, flags, (GDestroyNotify)g_strfreev);
+      IDE_EXIT;
+    }
+
   lookup = g_slice_new0 (FileFlagsLookup);
   lookup->self = g_object_ref (self);
   lookup->file = g_object_ref (file);
@@ -1412,6 +1972,7 @@ ide_makecache_finalize (GObject *object)
 
   g_clear_object (&self->makefile);
   g_clear_pointer (&self->mapped, g_mapped_file_unref);
+  g_clear_object (&self->compile_commands);
   g_clear_object (&self->file_targets_cache);
   g_clear_object (&self->file_flags_cache);
   g_clear_pointer (&self->llvm_flags, g_free);
@@ -1539,6 +2100,8 @@ ide_makecache__discover_llvm_flags_cb (GObject      *object,
 
   self->llvm_flags = flags;
 
+  ide_makecache_export_compile_commands (self);
+
   ide_thread_pool_push_task (IDE_THREAD_POOL_COMPILER,
                              task,
                              ide_makecache_new_worker);
@@ -24,6 +24,13 @@
 #include "egg-signal-group.h"
 
 #include "gbp-build-log-panel.h"
+#include "gbp-build-log-view.h"
+
+/*
+ * Lines kept in memory. Older lines are evicted from the store and read
+ * back from the build result log with ide_build_result_read_log().
+ */
+#define MAX_LINES_IN_MEMORY 5000
 
 struct _GbpBuildLogPanel
 {
@@ -33,11 +40,9 @@ struct _GbpBuildLogPanel
   EggSignalGroup    *signals;
   GtkCssProvider    *css;
   GSettings         *settings;
-  GtkTextBuffer     *buffer;
 
   GtkScrolledWindow *scroller;
-  GtkTextView       *text_view;
-  GtkTextTag        *stderr_tag;
+  GbpBuildLogView   *log_view;
 };
 
 enum {
@@ -53,37 +58,17 @@ static GParamSpec *properties [LAST_PROP];
 static void
 gbp_build_log_panel_reset_view (GbpBuildLogPanel *self)
 {
-  GtkStyleContext *context;
+  g_autoptr(GbpBuildLogStore) store = NULL;
 
   g_assert (GBP_IS_BUILD_LOG_PANEL (self));
 
-  g_clear_object (&self->buffer);
-
-  if (self->text_view != NULL)
-    gtk_widget_destroy (GTK_WIDGET (self->text_view));
-
-  self->buffer = gtk_text_buffer_new (NULL);
-  self->stderr_tag = gtk_text_buffer_create_tag (self->buffer,
-                                                 "stderr-tag",
-                                                 "foreground", "#ff0000",
-                                                 "weight", PANGO_WEIGHT_BOLD,
-                                                 NULL);
-
-  self->text_view = g_object_new (GTK_TYPE_TEXT_VIEW,
-                                  "bottom-margin", 3,
-                                  "buffer", self->buffer,
-                                  "editable", FALSE,
-                                  "left-margin", 3,
-                                  "monospace", TRUE,
-                                  "right-margin", 3,
-                                  "top-margin", 3,
-                                  "visible", TRUE,
-                                  NULL);
-  context = gtk_widget_get_style_context (GTK_WIDGET (self->text_view));
-  gtk_style_context_add_provider (context,
-                                  GTK_STYLE_PROVIDER (self->css),
-                                  GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
-  gtk_container_add (GTK_CONTAINER (self->scroller), GTK_WIDGET (self->text_view));
+  /*
+   * Each build gets a new store so that the previous log, and the build
+   * result it reads old lines from, is released rather than growing
+   * across rebuilds.
+   */
+  store = gbp_build_log_store_new (MAX_LINES_IN_MEMORY, self->result);
+  gbp_build_log_view_set_store (self->log_view, store);
 }
 
 static void
@@ -92,32 +77,14 @@ gbp_build_log_panel_log (GbpBuildLogPanel  *self,
                          const gchar       *message,
                          IdeBuildResult    *result)
 {
-  GtkTextMark *insert;
-  GtkTextIter iter;
-
   g_assert (GBP_IS_BUILD_LOG_PANEL (self));
   g_assert (message != NULL);
   g_assert (IDE_IS_BUILD_RESULT (result));
 
-  gtk_text_buffer_get_end_iter (self->buffer, &iter);
-
-  if (G_LIKELY (log == IDE_BUILD_RESULT_LOG_STDOUT))
-    {
-      gtk_text_buffer_insert (self->buffer, &iter, message, -1);
-    }
-  else
-    {
-      GtkTextIter begin;
-      guint offset;
-
-      offset = gtk_text_iter_get_offset (&iter);
-      gtk_text_buffer_insert (self->buffer, &iter, message, -1);
-      gtk_text_buffer_get_iter_at_offset (self->buffer, &begin, offset);
-      gtk_text_buffer_apply_tag (self->buffer, self->stderr_tag, &begin, &iter);
-    }
-
-  insert = gtk_text_buffer_get_insert (self->buffer);
-  gtk_text_view_scroll_to_mark (self->text_view, insert, 0.0, TRUE, 0.0, 0.0);
+  gbp_build_log_view_append (self->log_view,
+                             log,
+                             message,
+                             ide_build_result_get_log_offset (result));
 }
 
 void
@@ -155,7 +122,7 @@ gbp_build_log_panel_changed_font_name (GbpBuildLogPanel *self,
       gchar *css;
 
       fragment = ide_pango_font_description_to_css (font_desc);
-      css = g_strdup_printf ("textview { %s }", fragment);
+      css = g_strdup_printf ("buildlogview { %s }", fragment);
 
       gtk_css_provider_load_from_data (self->css, css, -1, NULL);
 
@@ -172,8 +139,6 @@ gbp_build_log_panel_finalize (GObject *object)
 {
   GbpBuildLogPanel *self = (GbpBuildLogPanel *)object;
 
-  self->stderr_tag = NULL;
-
   g_clear_object (&self->result);
   g_clear_object (&self->signals);
   g_clear_object (&self->css);
@@ -247,12 +212,23 @@ gbp_build_log_panel_class_init (GbpBuildLogPanelClass *klass)
 static void
 gbp_build_log_panel_init (GbpBuildLogPanel *self)
 {
+  GtkStyleContext *context;
+
   self->css = gtk_css_provider_new ();
 
   gtk_widget_init_template (GTK_WIDGET (self));
 
   g_object_set (self, "title", _("Build Output"), NULL);
 
+  self->log_view = g_object_new (GBP_TYPE_BUILD_LOG_VIEW,
+                                 "visible", TRUE,
+                                 NULL);
+  context = gtk_widget_get_style_context (GTK_WIDGET (self->log_view));
+  gtk_style_context_add_provider (context,
+                                  GTK_STYLE_PROVIDER (self->css),
+                                  GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
+  gtk_container_add (GTK_CONTAINER (self->scroller), GTK_WIDGET (self->log_view));
+
   gbp_build_log_panel_reset_view (self);
 
   self->signals = egg_signal_group_new (IDE_TYPE_BUILD_RESULT);
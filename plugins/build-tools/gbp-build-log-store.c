@@ -0,0 +1,404 @@
+/* gbp-build-log-store.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "gbp-build-log-store.h"
+
+/*
+ * GbpBuildLogStore keeps the most recent lines of a build log in a ring
+ * so that memory use does not grow with the length of the build.
+ *
+ * IdeBuildResult already writes every line to its stdout and stderr logs.
+ * If the store has a build result, lines that fall out of the ring are read
+ * back from those logs when needed, so only their offsets are kept in
+ * memory. That keeps the whole log viewable for the cost of 16 bytes per
+ * line.
+ */
+
+#define DEFAULT_MAX_LINES 10000
+
+typedef struct
+{
+  gchar  *text;
+  gint64  offset;
+  guint   len : 31;
+  guint   is_stderr : 1;
+} LogLine;
+
+typedef struct
+{
+  guint64 offset;
+  guint32 len;
+  guint32 is_stderr;
+} SpilledLine;
+
+struct _GbpBuildLogStore
+{
+  GObject         parent_instance;
+
+  /* Ring of the most recent lines, starting at head */
+  LogLine        *lines;
+  guint           max_lines;
+  guint           head;
+  guint           n_retained;
+
+  /* Lines that have fallen out of the ring */
+  guint           n_evicted;
+
+  /* Evicted lines that can be read back from the logs of result */
+  GArray         *spilled;
+  IdeBuildResult *result;
+
+  guint           max_chars;
+
+  guint           spill_failed : 1;
+};
+
+enum {
+  PROP_0,
+  PROP_MAX_LINES,
+  PROP_RESULT,
+  N_PROPS
+};
+
+G_DEFINE_TYPE (GbpBuildLogStore, gbp_build_log_store, G_TYPE_OBJECT)
+
+static GParamSpec *properties [N_PROPS];
+
+static void
+gbp_build_log_store_evict (GbpBuildLogStore *self,
+                           LogLine          *line)
+{
+  g_assert (GBP_IS_BUILD_LOG_STORE (self));
+  g_assert (line != NULL);
+
+  /*
+   * Once a line cannot be read back, such as when the build result failed
+   * to write it, stop spilling so that the spilled lines stay contiguous.
+   */
+  if (self->result == NULL || line->offset < 0)
+    self->spill_failed = TRUE;
+
+  if (!self->spill_failed)
+    {
+      SpilledLine spilled;
+
+      spilled.offset = line->offset;
+      spilled.len = line->len;
+      spilled.is_stderr = line->is_stderr;
+
+      g_array_append_val (self->spilled, spilled);
+    }
+
+  g_clear_pointer (&line->text, g_free);
+
+  self->n_evicted++;
+}
+
+/**
+ * gbp_build_log_store_append:
+ * @self: A #GbpBuildLogStore
+ * @log: the stream the line came from
+ * @line: the line of text
+ * @len: the length of @line, or -1 if it is %NULL terminated
+ * @offset: the offset of @line in the log of the build result, or -1
+ *
+ * Appends a line to the store. A trailing newline is removed.
+ *
+ * @offset is the value of ide_build_result_get_log_offset() when the line
+ * was delivered. It is used to read the line back once it no longer fits
+ * in memory.
+ */
+void
+gbp_build_log_store_append (GbpBuildLogStore  *self,
+                            IdeBuildResultLog  log,
+                            const gchar       *line,
+                            gssize             len,
+                            gint64             offset)
+{
+  LogLine *slot;
+  glong n_chars;
+
+  g_return_if_fail (GBP_IS_BUILD_LOG_STORE (self));
+  g_return_if_fail (line != NULL);
+
+  if (len < 0)
+    len = strlen (line);
+
+  if (len > 0 && line [len - 1] == '\n')
+    len--;
+
+  /* Keep pathological lines from using all of the bits */
+  len = MIN (len, G_MAXINT32 / 2);
+
+  if (self->n_retained == self->max_lines)
+    {
+      slot = &self->lines [self->head];
+      gbp_build_log_store_evict (self, slot);
+      self->head = (self->head + 1) % self->max_lines;
+      self->n_retained--;
+    }
+
+  slot = &self->lines [(self->head + self->n_retained) % self->max_lines];
+  slot->text = g_strndup (line, len);
+  slot->offset = offset;
+  slot->len = len;
+  slot->is_stderr = (log == IDE_BUILD_RESULT_LOG_STDERR);
+
+  self->n_retained++;
+
+  n_chars = g_utf8_strlen (slot->text, len);
+  if (n_chars > (glong)self->max_chars)
+    self->max_chars = n_chars;
+}
+
+/**
+ * gbp_build_log_store_get_first_line:
+ *
+ * Gets the first line that can be retrieved with
+ * gbp_build_log_store_get_line(). This is zero unless lines have been
+ * dropped because they could not be read back from the build result.
+ */
+guint
+gbp_build_log_store_get_first_line (GbpBuildLogStore *self)
+{
+  g_return_val_if_fail (GBP_IS_BUILD_LOG_STORE (self), 0);
+
+  /* Lines are spilled from the first eviction until one cannot be */
+  return (self->spilled->len == self->n_evicted) ? 0 : self->n_evicted;
+}
+
+/**
+ * gbp_build_log_store_get_n_lines:
+ *
+ * Gets the number of lines that have been appended to the store,
+ * including those that have been dropped.
+ */
+guint
+gbp_build_log_store_get_n_lines (GbpBuildLogStore *self)
+{
+  g_return_val_if_fail (GBP_IS_BUILD_LOG_STORE (self), 0);
+
+  return self->n_evicted + self->n_retained;
+}
+
+/**
+ * gbp_build_log_store_get_max_chars:
+ *
+ * Gets the number of characters in the longest line appended so far.
+ */
+guint
+gbp_build_log_store_get_max_chars (GbpBuildLogStore *self)
+{
+  g_return_val_if_fail (GBP_IS_BUILD_LOG_STORE (self), 0);
+
+  return self->max_chars;
+}
+
+static gboolean
+gbp_build_log_store_read_spill (GbpBuildLogStore  *self,
+                                guint              index,
+                                GString           *str,
+                                IdeBuildResultLog *log)
+{
+  const SpilledLine *spilled;
+  IdeBuildResultLog line_log;
+
+  g_assert (GBP_IS_BUILD_LOG_STORE (self));
+  g_assert (IDE_IS_BUILD_RESULT (self->result));
+  g_assert (index < self->spilled->len);
+
+  spilled = &g_array_index (self->spilled, SpilledLine, index);
+  line_log = spilled->is_stderr ? IDE_BUILD_RESULT_LOG_STDERR : IDE_BUILD_RESULT_LOG_STDOUT;
+
+  if (log != NULL)
+    *log = line_log;
+
+  return ide_build_result_read_log (self->result, line_log, spilled->offset, spilled->len, str);
+}
+
+/**
+ * gbp_build_log_store_get_line:
+ * @self: A #GbpBuildLogStore
+ * @line: the line number, starting from zero
+ * @str: A #GString to store the line in
+ * @log: (out) (optional): A location for the stream the line came from
+ *
+ * Copies the text of @line into @str. Lines that no longer fit in memory
+ * are read back synchronously from the log of the build result, which is
+ * fast since they were recently written and are in the page cache.
+ *
+ * Returns: %TRUE if the line was available.
+ */
+gboolean
+gbp_build_log_store_get_line (GbpBuildLogStore  *self,
+                              guint              line,
+                              GString           *str,
+                              IdeBuildResultLog *log)
+{
+  const LogLine *slot;
+  guint first_line;
+
+  g_return_val_if_fail (GBP_IS_BUILD_LOG_STORE (self), FALSE);
+  g_return_val_if_fail (str != NULL, FALSE);
+
+  first_line = gbp_build_log_store_get_first_line (self);
+
+  if (line < first_line || line >= self->n_evicted + self->n_retained)
+    return FALSE;
+
+  if (line < self->n_evicted)
+    return gbp_build_log_store_read_spill (self, line, str, log);
+
+  slot = &self->lines [(self->head + (line - self->n_evicted)) % self->max_lines];
+
+  g_string_truncate (str, 0);
+  g_string_append_len (str, slot->text, slot->len);
+
+  if (log != NULL)
+    *log = slot->is_stderr ? IDE_BUILD_RESULT_LOG_STDERR : IDE_BUILD_RESULT_LOG_STDOUT;
+
+  return TRUE;
+}
+
+/**
+ * gbp_build_log_store_new:
+ * @max_lines: the number of lines to keep in memory
+ * @result: (nullable): the #IdeBuildResult the lines come from
+ *
+ * Creates a new store. If @result is %NULL, lines that do not fit in
+ * memory are dropped.
+ */
+GbpBuildLogStore *
+gbp_build_log_store_new (guint           max_lines,
+                         IdeBuildResult *result)
+{
+  return g_object_new (GBP_TYPE_BUILD_LOG_STORE,
+                       "max-lines", max_lines,
+                       "result", result,
+                       NULL);
+}
+
+static void
+gbp_build_log_store_constructed (GObject *object)
+{
+  GbpBuildLogStore *self = (GbpBuildLogStore *)object;
+
+  G_OBJECT_CLASS (gbp_build_log_store_parent_class)->constructed (object);
+
+  self->lines = g_new0 (LogLine, self->max_lines);
+}
+
+static void
+gbp_build_log_store_finalize (GObject *object)
+{
+  GbpBuildLogStore *self = (GbpBuildLogStore *)object;
+  guint i;
+
+  for (i = 0; i < self->n_retained; i++)
+    g_free (self->lines [(self->head + i) % self->max_lines].text);
+
+  g_clear_pointer (&self->lines, g_free);
+  g_clear_pointer (&self->spilled, g_array_unref);
+  g_clear_object (&self->result);
+
+  G_OBJECT_CLASS (gbp_build_log_store_parent_class)->finalize (object);
+}
+
+static void
+gbp_build_log_store_get_property (GObject    *object,
+                                  guint       prop_id,
+                                  GValue     *value,
+                                  GParamSpec *pspec)
+{
+  GbpBuildLogStore *self = GBP_BUILD_LOG_STORE (object);
+
+  switch (prop_id)
+    {
+    case PROP_MAX_LINES:
+      g_value_set_uint (value, self->max_lines);
+      break;
+
+    case PROP_RESULT:
+      g_value_set_object (value, self->result);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+    }
+}
+
+static void
+gbp_build_log_store_set_property (GObject      *object,
+                                  guint         prop_id,
+                                  const GValue *value,
+                                  GParamSpec   *pspec)
+{
+  GbpBuildLogStore *self = GBP_BUILD_LOG_STORE (object);
+
+  switch (prop_id)
+    {
+    case PROP_MAX_LINES:
+      self->max_lines = g_value_get_uint (value);
+      break;
+
+    case PROP_RESULT:
+      self->result = g_value_dup_object (value);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+    }
+}
+
+static void
+gbp_build_log_store_class_init (GbpBuildLogStoreClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->constructed = gbp_build_log_store_constructed;
+  object_class->finalize = gbp_build_log_store_finalize;
+  object_class->get_property = gbp_build_log_store_get_property;
+  object_class->set_property = gbp_build_log_store_set_property;
+
+  properties [PROP_MAX_LINES] =
+    g_param_spec_uint ("max-lines",
+                       "Max Lines",
+                       "The number of lines to keep in memory",
+                       1,
+                       G_MAXUINT,
+                       DEFAULT_MAX_LINES,
+                       (G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS));
+
+  properties [PROP_RESULT] =
+    g_param_spec_object ("result",
+                         "Result",
+                         "The build result to read lines that do not fit in memory from",
+                         IDE_TYPE_BUILD_RESULT,
+                         (G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_properties (object_class, N_PROPS, properties);
+}
+
+static void
+gbp_build_log_store_init (GbpBuildLogStore *self)
+{
+  self->max_lines = DEFAULT_MAX_LINES;
+  self->spilled = g_array_new (FALSE, FALSE, sizeof (SpilledLine));
+}
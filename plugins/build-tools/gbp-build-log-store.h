@@ -0,0 +1,47 @@
+/* gbp-build-log-store.h
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GBP_BUILD_LOG_STORE_H
+#define GBP_BUILD_LOG_STORE_H
+
+#include <ide.h>
+
+G_BEGIN_DECLS
+
+#define GBP_TYPE_BUILD_LOG_STORE (gbp_build_log_store_get_type())
+
+G_DECLARE_FINAL_TYPE (GbpBuildLogStore, gbp_build_log_store, GBP, BUILD_LOG_STORE, GObject)
+
+GbpBuildLogStore *gbp_build_log_store_new            (guint              max_lines,
+                                                      IdeBuildResult    *result);
+void              gbp_build_log_store_append         (GbpBuildLogStore  *self,
+                                                      IdeBuildResultLog  log,
+                                                      const gchar       *line,
+                                                      gssize             len,
+                                                      gint64             offset);
+guint             gbp_build_log_store_get_first_line (GbpBuildLogStore  *self);
+guint             gbp_build_log_store_get_n_lines    (GbpBuildLogStore  *self);
+guint             gbp_build_log_store_get_max_chars  (GbpBuildLogStore  *self);
+gboolean          gbp_build_log_store_get_line       (GbpBuildLogStore  *self,
+                                                      guint              line,
+                                                      GString           *str,
+                                                      IdeBuildResultLog *log);
+
+G_END_DECLS
+
+#endif /* GBP_BUILD_LOG_STORE_H */
@@ -0,0 +1,778 @@
+/* gbp-build-log-view.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gbp-build-log-view.h"
+
+/*
+ * GbpBuildLogView displays a GbpBuildLogStore. Every line has the same
+ * height, so the lines that are visible can be computed directly from the
+ * scroll position and only those are laid out when drawing. Nothing is
+ * done per line as it is appended; the adjustments are updated and the
+ * view redrawn at most once per frame.
+ *
+ * Lines are selected as a whole by clicking and dragging, and copied
+ * with Ctrl+C.
+ */
+
+#define PADDING 3
+
+struct _GbpBuildLogView
+{
+  GtkWidget         parent_instance;
+
+  GbpBuildLogStore *store;
+  GtkAdjustment    *hadjustment;
+  GtkAdjustment    *vadjustment;
+  PangoLayout      *layout;
+  PangoAttrList    *stderr_attrs;
+  GString          *line;
+
+  gint              line_height;
+  gint              char_width;
+
+  /* The first line available when the adjustments were last updated */
+  guint             first_line;
+
+  /* Selected lines as store line numbers, or -1 */
+  gint64            anchor;
+  gint64            cursor;
+
+  guint             tick_id;
+
+  guint             hscroll_policy : 1;
+  guint             vscroll_policy : 1;
+  guint             follow : 1;
+};
+
+enum {
+  PROP_0,
+  PROP_STORE,
+  N_PROPS,
+
+  PROP_HADJUSTMENT,
+  PROP_HSCROLL_POLICY,
+  PROP_VADJUSTMENT,
+  PROP_VSCROLL_POLICY,
+};
+
+G_DEFINE_TYPE_EXTENDED (GbpBuildLogView, gbp_build_log_view, GTK_TYPE_WIDGET, 0,
+                        G_IMPLEMENT_INTERFACE (GTK_TYPE_SCROLLABLE, NULL))
+
+static GParamSpec *properties [N_PROPS];
+
+static void
+gbp_build_log_view_update_adjustments (GbpBuildLogView *self)
+{
+  GtkAllocation alloc;
+  guint first_line = 0;
+  guint n_lines = 0;
+  guint max_chars = 0;
+
+  g_assert (GBP_IS_BUILD_LOG_VIEW (self));
+
+  gtk_widget_get_allocation (GTK_WIDGET (self), &alloc);
+
+  if (self->store != NULL)
+    {
+      first_line = gbp_build_log_store_get_first_line (self->store);
+      n_lines = gbp_build_log_store_get_n_lines (self->store) - first_line;
+      max_chars = gbp_build_log_store_get_max_chars (self->store);
+    }
+
+  if (self->vadjustment != NULL)
+    {
+      gdouble upper = (gdouble)n_lines * self->line_height + (PADDING * 2);
+      gdouble page_size = alloc.height;
+      gdouble value = gtk_adjustment_get_value (self->vadjustment);
+      gboolean follow = self->follow;
+
+      /* Keep the same lines in view when old lines are dropped */
+      if (first_line > self->first_line)
+        value -= (gdouble)(first_line - self->first_line) * self->line_height;
+
+      if (follow)
+        value = upper - page_size;
+
+      value = CLAMP (value, 0, MAX (0, upper - page_size));
+
+      gtk_adjustment_configure (self->vadjustment,
+                                value,
+                                0,
+                                MAX (upper, page_size),
+                                self->line_height,
+                                page_size * 0.9,
+                                page_size);
+
+      /* Configuring may have changed follow through value-changed */
+      self->follow = follow;
+    }
+
+  if (self->hadjustment != NULL)
+    {
+      gdouble upper = (gdouble)max_chars * self->char_width + (PADDING * 2);
+      gdouble page_size = alloc.width;
+      gdouble value = gtk_adjustment_get_value (self->hadjustment);
+
+      value = CLAMP (value, 0, MAX (0, upper - page_size));
+
+      gtk_adjustment_configure (self->hadjustment,
+                                value,
+                                0,
+                                MAX (upper, page_size),
+                                self->char_width,
+                                page_size * 0.9,
+                                page_size);
+    }
+
+  self->first_line = first_line;
+}
+
+static gboolean
+gbp_build_log_view_tick_cb (GtkWidget     *widget,
+                            GdkFrameClock *frame_clock,
+                            gpointer       user_data)
+{
+  GbpBuildLogView *self = (GbpBuildLogView *)widget;
+
+  g_assert (GBP_IS_BUILD_LOG_VIEW (self));
+
+  self->tick_id = 0;
+
+  gbp_build_log_view_update_adjustments (self);
+  gtk_widget_queue_draw (widget);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+gbp_build_log_view_queue_update (GbpBuildLogView *self)
+{
+  g_assert (GBP_IS_BUILD_LOG_VIEW (self));
+
+  /* The adjustments are updated in size_allocate() when we are realized */
+  if (self->tick_id == 0 && gtk_widget_get_realized (GTK_WIDGET (self)))
+    self->tick_id = gtk_widget_add_tick_callback (GTK_WIDGET (self),
+                                                  gbp_build_log_view_tick_cb,
+                                                  NULL, NULL);
+}
+
+/**
+ * gbp_build_log_view_append:
+ * @self: A #GbpBuildLogView
+ * @log: the stream @line came from
+ * @line: the line to append
+ * @offset: the offset of @line in the log of the build result, or -1
+ *
+ * Appends @line to the store. The view is updated on the next frame, so
+ * this is cheap to call for every line of the build.
+ */
+void
+gbp_build_log_view_append (GbpBuildLogView   *self,
+                           IdeBuildResultLog  log,
+                           const gchar       *line,
+                           gint64             offset)
+{
+  g_return_if_fail (GBP_IS_BUILD_LOG_VIEW (self));
+  g_return_if_fail (line != NULL);
+
+  if (self->store == NULL)
+    return;
+
+  gbp_build_log_store_append (self->store, log, line, -1, offset);
+  gbp_build_log_view_queue_update (self);
+}
+
+static gint64
+gbp_build_log_view_get_line_at_y (GbpBuildLogView *self,
+                                  gdouble          y)
+{
+  guint first_line;
+  guint n_lines;
+  gint64 line;
+
+  g_assert (GBP_IS_BUILD_LOG_VIEW (self));
+
+  if (self->store == NULL || self->line_height == 0)
+    return -1;
+
+  first_line = gbp_build_log_store_get_first_line (self->store);
+  n_lines = gbp_build_log_store_get_n_lines (self->store);
+
+  if (n_lines == first_line)
+    return -1;
+
+  if (self->vadjustment != NULL)
+    y += gtk_adjustment_get_value (self->vadjustment);
+
+  line = first_line + (gint64)((y - PADDING) / self->line_height);
+
+  return CLAMP (line, first_line, (gint64)n_lines - 1);
+}
+
+static void
+gbp_build_log_view_copy_clipboard (GbpBuildLogView *self)
+{
+  g_autoptr(GString) str = NULL;
+  GtkClipboard *clipboard;
+  gint64 begin;
+  gint64 end;
+  gint64 i;
+
+  g_assert (GBP_IS_BUILD_LOG_VIEW (self));
+
+  if (self->store == NULL || self->anchor < 0)
+    return;
+
+  begin = MIN (self->anchor, self->cursor);
+  end = MAX (self->anchor, self->cursor);
+
+  str = g_string_new (NULL);
+
+  for (i = begin; i <= end; i++)
+    {
+      if (gbp_build_log_store_get_line (self->store, i, self->line, NULL))
+        {
+          g_string_append_len (str, self->line->str, self->line->len);
+          g_string_append_c (str, '\n');
+        }
+    }
+
+  clipboard = gtk_widget_get_clipboard (GTK_WIDGET (self), GDK_SELECTION_CLIPBOARD);
+  gtk_clipboard_set_text (clipboard, str->str, str->len);
+}
+
+static void
+gbp_build_log_view_select_all (GbpBuildLogView *self)
+{
+  guint first_line;
+  guint n_lines;
+
+  g_assert (GBP_IS_BUILD_LOG_VIEW (self));
+
+  if (self->store == NULL)
+    return;
+
+  first_line = gbp_build_log_store_get_first_line (self->store);
+  n_lines = gbp_build_log_store_get_n_lines (self->store);
+
+  if (n_lines > first_line)
+    {
+      self->anchor = first_line;
+      self->cursor = (gint64)n_lines - 1;
+      gtk_widget_queue_draw (GTK_WIDGET (self));
+    }
+}
+
+static gboolean
+gbp_build_log_view_button_press_event (GtkWidget      *widget,
+                                       GdkEventButton *event)
+{
+  GbpBuildLogView *self = (GbpBuildLogView *)widget;
+  gint64 line;
+
+  g_assert (GBP_IS_BUILD_LOG_VIEW (self));
+
+  if (event->button != GDK_BUTTON_PRIMARY)
+    return GDK_EVENT_PROPAGATE;
+
+  gtk_widget_grab_focus (widget);
+
+  line = gbp_build_log_view_get_line_at_y (self, event->y);
+
+  if ((event->state & GDK_SHIFT_MASK) == 0 || self->anchor < 0)
+    self->anchor = line;
+  self->cursor = line;
+
+  gtk_widget_queue_draw (widget);
+
+  return GDK_EVENT_STOP;
+}
+
+static gboolean
+gbp_build_log_view_motion_notify_event (GtkWidget      *widget,
+                                        GdkEventMotion *event)
+{
+  GbpBuildLogView *self = (GbpBuildLogView *)widget;
+  gint64 line;
+
+  g_assert (GBP_IS_BUILD_LOG_VIEW (self));
+
+  if ((event->state & GDK_BUTTON1_MASK) == 0 || self->anchor < 0)
+    return GDK_EVENT_PROPAGATE;
+
+  line = gbp_build_log_view_get_line_at_y (self, event->y);
+
+  if (line != self->cursor)
+    {
+      self->cursor = line;
+      gtk_widget_queue_draw (widget);
+    }
+
+  return GDK_EVENT_STOP;
+}
+
+static gboolean
+gbp_build_log_view_key_press_event (GtkWidget   *widget,
+                                    GdkEventKey *event)
+{
+  GbpBuildLogView *self = (GbpBuildLogView *)widget;
+
+  g_assert (GBP_IS_BUILD_LOG_VIEW (self));
+
+  if ((event->state & gtk_accelerator_get_default_mod_mask ()) == GDK_CONTROL_MASK)
+    {
+      switch (event->keyval)
+        {
+        case GDK_KEY_c:
+        case GDK_KEY_Insert:
+          gbp_build_log_view_copy_clipboard (self);
+          return GDK_EVENT_STOP;
+
+        case GDK_KEY_a:
+          gbp_build_log_view_select_all (self);
+          return GDK_EVENT_STOP;
+
+        default:
+          break;
+        }
+    }
+
+  return GTK_WIDGET_CLASS (gbp_build_log_view_parent_class)->key_press_event (widget, event);
+}
+
+static gboolean
+gbp_build_log_view_draw (GtkWidget *widget,
+                         cairo_t   *cr)
+{
+  GbpBuildLogView *self = (GbpBuildLogView *)widget;
+  GtkStyleContext *style_context;
+  GtkAllocation alloc;
+  gdouble vvalue = 0;
+  gdouble hvalue = 0;
+  gdouble y;
+  gint64 sel_begin = -1;
+  gint64 sel_end = -1;
+  guint first_line;
+  guint n_lines;
+  guint row;
+  guint line;
+
+  g_assert (GBP_IS_BUILD_LOG_VIEW (self));
+
+  style_context = gtk_widget_get_style_context (widget);
+  gtk_widget_get_allocation (widget, &alloc);
+
+  gtk_render_background (style_context, cr, 0, 0, alloc.width, alloc.height);
+
+  if (self->store == NULL || self->layout == NULL || self->line_height == 0)
+    return GDK_EVENT_PROPAGATE;
+
+  if (self->vadjustment != NULL)
+    vvalue = gtk_adjustment_get_value (self->vadjustment);
+
+  if (self->hadjustment != NULL)
+    hvalue = gtk_adjustment_get_value (self->hadjustment);
+
+  if (self->anchor >= 0)
+    {
+      sel_begin = MIN (self->anchor, self->cursor);
+      sel_end = MAX (self->anchor, self->cursor);
+    }
+
+  first_line = gbp_build_log_store_get_first_line (self->store);
+  n_lines = gbp_build_log_store_get_n_lines (self->store);
+
+  /* Only lay out the lines that intersect the allocation */
+  row = MAX (0, vvalue - PADDING) / self->line_height;
+  y = PADDING + (gdouble)row * self->line_height - vvalue;
+
+  for (line = first_line + row; line < n_lines && y < alloc.height; line++, y += self->line_height)
+    {
+      IdeBuildResultLog log = IDE_BUILD_RESULT_LOG_STDOUT;
+      gboolean selected = (line >= sel_begin && line <= sel_end);
+
+      if (!gbp_build_log_store_get_line (self->store, line, self->line, &log))
+        continue;
+
+      pango_layout_set_text (self->layout, self->line->str, self->line->len);
+      pango_layout_set_attributes (self->layout,
+                                   (log == IDE_BUILD_RESULT_LOG_STDERR) ? self->stderr_attrs : NULL);
+
+      if (selected)
+        {
+          gtk_style_context_save (style_context);
+          gtk_style_context_set_state (style_context,
+                                       gtk_style_context_get_state (style_context) | GTK_STATE_FLAG_SELECTED);
+          gtk_render_background (style_context, cr, 0, y, alloc.width, self->line_height);
+        }
+
+      gtk_render_layout (style_context, cr, PADDING - hvalue, y, self->layout);
+
+      if (selected)
+        gtk_style_context_restore (style_context);
+    }
+
+  return GDK_EVENT_PROPAGATE;
+}
+
+static void
+gbp_build_log_view_style_updated (GtkWidget *widget)
+{
+  GbpBuildLogView *self = (GbpBuildLogView *)widget;
+
+  g_assert (GBP_IS_BUILD_LOG_VIEW (self));
+
+  GTK_WIDGET_CLASS (gbp_build_log_view_parent_class)->style_updated (widget);
+
+  /* The font may have changed, so measure a line again */
+  g_clear_object (&self->layout);
+  self->layout = gtk_widget_create_pango_layout (widget, "M");
+  pango_layout_get_pixel_size (self->layout, &self->char_width, &self->line_height);
+
+  gtk_widget_queue_resize (widget);
+}
+
+static void
+gbp_build_log_view_realize (GtkWidget *widget)
+{
+  GbpBuildLogView *self = (GbpBuildLogView *)widget;
+  GdkWindowAttr attributes = { 0 };
+  GtkAllocation alloc;
+  GdkWindow *window;
+
+  g_assert (GBP_IS_BUILD_LOG_VIEW (self));
+
+  gtk_widget_set_realized (widget, TRUE);
+  gtk_widget_get_allocation (widget, &alloc);
+
+  attributes.window_type = GDK_WINDOW_CHILD;
+  attributes.x = alloc.x;
+  attributes.y = alloc.y;
+  attributes.width = alloc.width;
+  attributes.height = alloc.height;
+  attributes.wclass = GDK_INPUT_OUTPUT;
+  attributes.visual = gtk_widget_get_visual (widget);
+  attributes.event_mask = (gtk_widget_get_events (widget) |
+                           GDK_EXPOSURE_MASK |
+                           GDK_BUTTON_PRESS_MASK |
+                           GDK_BUTTON_RELEASE_MASK |
+                           GDK_BUTTON1_MOTION_MASK |
+                           GDK_KEY_PRESS_MASK);
+
+  window = gdk_window_new (gtk_widget_get_parent_window (widget),
+                           &attributes,
+                           GDK_WA_X | GDK_WA_Y | GDK_WA_VISUAL);
+  gtk_widget_set_window (widget, window);
+  gtk_widget_register_window (widget, window);
+}
+
+static void
+gbp_build_log_view_unrealize (GtkWidget *widget)
+{
+  GbpBuildLogView *self = (GbpBuildLogView *)widget;
+
+  g_assert (GBP_IS_BUILD_LOG_VIEW (self));
+
+  if (self->tick_id != 0)
+    {
+      gtk_widget_remove_tick_callback (widget, self->tick_id);
+      self->tick_id = 0;
+    }
+
+  GTK_WIDGET_CLASS (gbp_build_log_view_parent_class)->unrealize (widget);
+}
+
+static void
+gbp_build_log_view_size_allocate (GtkWidget     *widget,
+                                  GtkAllocation *alloc)
+{
+  GbpBuildLogView *self = (GbpBuildLogView *)widget;
+
+  g_assert (GBP_IS_BUILD_LOG_VIEW (self));
+
+  gtk_widget_set_allocation (widget, alloc);
+
+  if (gtk_widget_get_realized (widget))
+    gdk_window_move_resize (gtk_widget_get_window (widget),
+                            alloc->x, alloc->y, alloc->width, alloc->height);
+
+  gbp_build_log_view_update_adjustments (self);
+}
+
+static void
+gbp_build_log_view_get_preferred_width (GtkWidget *widget,
+                                        gint      *min_width,
+                                        gint      *nat_width)
+{
+  GbpBuildLogView *self = (GbpBuildLogView *)widget;
+
+  *min_width = PADDING * 2;
+  *nat_width = PADDING * 2 + self->char_width * 80;
+}
+
+static void
+gbp_build_log_view_get_preferred_height (GtkWidget *widget,
+                                         gint      *min_height,
+                                         gint      *nat_height)
+{
+  GbpBuildLogView *self = (GbpBuildLogView *)widget;
+
+  *min_height = PADDING * 2 + self->line_height;
+  *nat_height = PADDING * 2 + self->line_height * 10;
+}
+
+static void
+gbp_build_log_view_vadjustment_value_changed (GbpBuildLogView *self,
+                                              GtkAdjustment   *adjustment)
+{
+  gdouble value;
+  gdouble upper;
+  gdouble page_size;
+
+  g_assert (GBP_IS_BUILD_LOG_VIEW (self));
+  g_assert (GTK_IS_ADJUSTMENT (adjustment));
+
+  value = gtk_adjustment_get_value (adjustment);
+  upper = gtk_adjustment_get_upper (adjustment);
+  page_size = gtk_adjustment_get_page_size (adjustment);
+
+  /* Keep following the end of the log unless the user scrolls away */
+  self->follow = (value + page_size >= upper - 1);
+
+  gtk_widget_queue_draw (GTK_WIDGET (self));
+}
+
+static void
+gbp_build_log_view_set_adjustment (GbpBuildLogView  *self,
+                                   GtkAdjustment   **location,
+                                   GtkAdjustment    *adjustment,
+                                   GCallback         value_changed)
+{
+  g_assert (GBP_IS_BUILD_LOG_VIEW (self));
+  g_assert (location != NULL);
+  g_assert (!adjustment || GTK_IS_ADJUSTMENT (adjustment));
+
+  if (*location == adjustment)
+    return;
+
+  if (*location != NULL)
+    {
+      g_signal_handlers_disconnect_by_func (*location, value_changed, self);
+      g_clear_object (location);
+    }
+
+  if (adjustment != NULL)
+    {
+      *location = g_object_ref_sink (adjustment);
+      g_signal_connect_object (adjustment,
+                               "value-changed",
+                               value_changed,
+                               self,
+                               G_CONNECT_SWAPPED);
+    }
+
+  gbp_build_log_view_update_adjustments (self);
+}
+
+GbpBuildLogStore *
+gbp_build_log_view_get_store (GbpBuildLogView *self)
+{
+  g_return_val_if_fail (GBP_IS_BUILD_LOG_VIEW (self), NULL);
+
+  return self->store;
+}
+
+void
+gbp_build_log_view_set_store (GbpBuildLogView  *self,
+                              GbpBuildLogStore *store)
+{
+  g_return_if_fail (GBP_IS_BUILD_LOG_VIEW (self));
+  g_return_if_fail (!store || GBP_IS_BUILD_LOG_STORE (store));
+
+  if (g_set_object (&self->store, store))
+    {
+      self->anchor = -1;
+      self->cursor = -1;
+      self->first_line = 0;
+      self->follow = TRUE;
+
+      gbp_build_log_view_update_adjustments (self);
+      gtk_widget_queue_draw (GTK_WIDGET (self));
+
+      g_object_notify_by_pspec (G_OBJECT (self), properties [PROP_STORE]);
+    }
+}
+
+GtkWidget *
+gbp_build_log_view_new (void)
+{
+  return g_object_new (GBP_TYPE_BUILD_LOG_VIEW, NULL);
+}
+
+static void
+gbp_build_log_view_finalize (GObject *object)
+{
+  GbpBuildLogView *self = (GbpBuildLogView *)object;
+
+  g_clear_object (&self->store);
+  g_clear_object (&self->hadjustment);
+  g_clear_object (&self->vadjustment);
+  g_clear_object (&self->layout);
+  g_clear_pointer (&self->stderr_attrs, pango_attr_list_unref);
+  g_string_free (self->line, TRUE);
+  self->line = NULL;
+
+  G_OBJECT_CLASS (gbp_build_log_view_parent_class)->finalize (object);
+}
+
+static void
+gbp_build_log_view_get_property (GObject    *object,
+                                 guint       prop_id,
+                                 GValue     *value,
+                                 GParamSpec *pspec)
+{
+  GbpBuildLogView *self = GBP_BUILD_LOG_VIEW (object);
+
+  switch (prop_id)
+    {
+    case PROP_STORE:
+      g_value_set_object (value, self->store);
+      break;
+
+    case PROP_HADJUSTMENT:
+      g_value_set_object (value, self->hadjustment);
+      break;
+
+    case PROP_VADJUSTMENT:
+      g_value_set_object (value, self->vadjustment);
+      break;
+
+    case PROP_HSCROLL_POLICY:
+      g_value_set_enum (value, self->hscroll_policy);
+      break;
+
+    case PROP_VSCROLL_POLICY:
+      g_value_set_enum (value, self->vscroll_policy);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+    }
+}
+
+static void
+gbp_build_log_view_set_property (GObject      *object,
+                                 guint         prop_id,
+                                 const GValue *value,
+                                 GParamSpec   *pspec)
+{
+  GbpBuildLogView *self = GBP_BUILD_LOG_VIEW (object);
+
+  switch (prop_id)
+    {
+    case PROP_STORE:
+      gbp_build_log_view_set_store (self, g_value_get_object (value));
+      break;
+
+    case PROP_HADJUSTMENT:
+      gbp_build_log_view_set_adjustment (self,
+                                         &self->hadjustment,
+                                         g_value_get_object (value),
+                                         G_CALLBACK (gtk_widget_queue_draw));
+      break;
+
+    case PROP_VADJUSTMENT:
+      gbp_build_log_view_set_adjustment (self,
+                                         &self->vadjustment,
+                                         g_value_get_object (value),
+                                         G_CALLBACK (gbp_build_log_view_vadjustment_value_changed));
+      break;
+
+    case PROP_HSCROLL_POLICY:
+      self->hscroll_policy = g_value_get_enum (value);
+      gtk_widget_queue_resize (GTK_WIDGET (self));
+      break;
+
+    case PROP_VSCROLL_POLICY:
+      self->vscroll_policy = g_value_get_enum (value);
+      gtk_widget_queue_resize (GTK_WIDGET (self));
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+    }
+}
+
+static void
+gbp_build_log_view_class_init (GbpBuildLogViewClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  GtkWidgetClass *widget_class = GTK_WIDGET_CLASS (klass);
+
+  object_class->finalize = gbp_build_log_view_finalize;
+  object_class->get_property = gbp_build_log_view_get_property;
+  object_class->set_property = gbp_build_log_view_set_property;
+
+  widget_class->button_press_event = gbp_build_log_view_button_press_event;
+  widget_class->draw = gbp_build_log_view_draw;
+  widget_class->get_preferred_height = gbp_build_log_view_get_preferred_height;
+  widget_class->get_preferred_width = gbp_build_log_view_get_preferred_width;
+  widget_class->key_press_event = gbp_build_log_view_key_press_event;
+  widget_class->motion_notify_event = gbp_build_log_view_motion_notify_event;
+  widget_class->realize = gbp_build_log_view_realize;
+  widget_class->size_allocate = gbp_build_log_view_size_allocate;
+  widget_class->style_updated = gbp_build_log_view_style_updated;
+  widget_class->unrealize = gbp_build_log_view_unrealize;
+
+  properties [PROP_STORE] =
+    g_param_spec_object ("store",
+                         "Store",
+                         "The log store to display",
+                         GBP_TYPE_BUILD_LOG_STORE,
+                         (G_PARAM_READWRITE | G_PARAM_EXPLICIT_NOTIFY | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_properties (object_class, N_PROPS, properties);
+
+  g_object_class_override_property (object_class, PROP_HADJUSTMENT, "hadjustment");
+  g_object_class_override_property (object_class, PROP_VADJUSTMENT, "vadjustment");
+  g_object_class_override_property (object_class, PROP_HSCROLL_POLICY, "hscroll-policy");
+  g_object_class_override_property (object_class, PROP_VSCROLL_POLICY, "vscroll-policy");
+
+  gtk_widget_class_set_css_name (widget_class, "buildlogview");
+}
+
+static void
+gbp_build_log_view_init (GbpBuildLogView *self)
+{
+  PangoAttribute *attr;
+
+  self->anchor = -1;
+  self->cursor = -1;
+  self->follow = TRUE;
+  self->line = g_string_new (NULL);
+
+  self->stderr_attrs = pango_attr_list_new ();
+  attr = pango_attr_foreground_new (0xffff, 0, 0);
+  pango_attr_list_insert (self->stderr_attrs, attr);
+  attr = pango_attr_weight_new (PANGO_WEIGHT_BOLD);
+  pango_attr_list_insert (self->stderr_attrs, attr);
+
+  gtk_widget_set_can_focus (GTK_WIDGET (self), TRUE);
+  gtk_style_context_add_class (gtk_widget_get_style_context (GTK_WIDGET (self)),
+                               GTK_STYLE_CLASS_VIEW);
+}
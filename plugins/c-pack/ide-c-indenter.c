@@ -202,9 +202,29 @@ line_is_whitespace_until (GtkTextIter *iter)
   return TRUE;
 }
 
+static IdeBracketIndex *
+get_bracket_index (const GtkTextIter *iter)
+{
+  GtkTextBuffer *buffer = gtk_text_iter_get_buffer (iter);
+  IdeBracketIndex *index;
+
+  if (!IDE_IS_BUFFER (buffer))
+    return NULL;
+
+  index = ide_buffer_get_bracket_index (IDE_BUFFER (buffer));
+  if (!ide_bracket_index_get_syntax_supported (index))
+    return NULL;
+
+  return index;
+}
+
 static gboolean is_special (const GtkTextIter *iter)
 {
   GtkSourceBuffer *buffer;
+  IdeBracketIndex *index;
+
+  if ((index = get_bracket_index (iter)))
+    return ide_bracket_index_get_region (index, iter, NULL, NULL) != IDE_BRACKET_REGION_NONE;
 
   buffer = GTK_SOURCE_BUFFER (gtk_text_iter_get_buffer (iter));
   return (gtk_source_buffer_iter_has_context_class (buffer, iter, "string") ||
@@ -330,6 +350,7 @@ static gboolean
 backward_find_matching_char (GtkTextIter *iter,
                              gunichar     ch)
 {
+  IdeBracketIndex *index;
   GtkTextIter copy;
   gunichar match = 0;
   gunichar cur;
@@ -342,8 +363,8 @@ backward_find_matching_char (GtkTextIter *iter,
   case '}':
     match = '{';
     break;
-  case '[':
-    match = ']';
+  case ']':
+    match = '[';
     break;
   default:
     g_assert_not_reached ();
@@ -352,6 +373,21 @@ backward_find_matching_char (GtkTextIter *iter,
 
   gtk_text_iter_assign (&copy, iter);
 
+  /*
+   * The buffer keeps an index of the brackets outside of comments and
+   * strings, so we don't have to walk back through the whole scope. Like
+   * the scan below, @iter is restored to where it started on failure.
+   */
+  if ((index = get_bracket_index (iter)))
+    {
+      if (ide_bracket_index_backward_find_unmatched (index, iter, match))
+        return TRUE;
+
+      gtk_text_iter_assign (iter, &copy);
+
+      return FALSE;
+    }
+
   while (gtk_text_iter_backward_char (iter))
     {
       cur = gtk_text_iter_get_char (iter);
@@ -482,6 +518,7 @@ in_comment (const GtkTextIter *location,
             gint              *comment_type)
 {
   GtkSourceBuffer *buffer = GTK_SOURCE_BUFFER (gtk_text_iter_get_buffer (location));
+  IdeBracketIndex *index;
   GtkTextIter iter = *location;
   GtkTextIter copy;
   gint type = COMMENT_NONE;
@@ -513,17 +550,34 @@ in_comment (const GtkTextIter *location,
         IDE_RETURN (FALSE);
     }
 
-  if (!gtk_source_buffer_iter_has_context_class (buffer, &iter, "comment"))
-    IDE_RETURN (FALSE);
-
-  copy = iter;
+  if ((index = get_bracket_index (&iter)))
+    {
+      switch (ide_bracket_index_get_region (index, &iter, &copy, NULL))
+        {
+        case IDE_BRACKET_REGION_LINE_COMMENT:
+        case IDE_BRACKET_REGION_BLOCK_COMMENT:
+          break;
 
-  while (gtk_source_buffer_iter_has_context_class (buffer, &iter, "comment"))
+        case IDE_BRACKET_REGION_NONE:
+        case IDE_BRACKET_REGION_STRING:
+        default:
+          IDE_RETURN (FALSE);
+        }
+    }
+  else
     {
+      if (!gtk_source_buffer_iter_has_context_class (buffer, &iter, "comment"))
+        IDE_RETURN (FALSE);
+
       copy = iter;
 
-      if (!gtk_text_iter_backward_char (&iter))
-        break;
+      while (gtk_source_buffer_iter_has_context_class (buffer, &iter, "comment"))
+        {
+          copy = iter;
+
+          if (!gtk_text_iter_backward_char (&iter))
+            break;
+        }
     }
 
   *match_begin = copy;
@@ -43,8 +43,16 @@ struct _IdeClangCompletionItem
   gchar            *brief_comment;
   gchar            *markup;
   IdeRefPtr        *results;
+  IdeRefPtr        *strings;
   IdeSourceSnippet *snippet;
-  gchar            *typed_text;
+
+  /*
+   * typed_text and folded_typed_text point into the GStringChunk held
+   * by strings, which is shared by every item in the result set.
+   */
+  const gchar      *typed_text;
+  const gchar      *folded_typed_text;
+  guint64           mask;
 };
 
 static inline CXCompletionResult *
@@ -55,42 +63,40 @@ ide_clang_completion_item_get_result (const IdeClangCompletionItem *self)
 
 static inline gboolean
 ide_clang_completion_item_match (IdeClangCompletionItem *self,
-                                 const gchar            *lower_is_ascii)
+                                 const gchar            *lower_is_ascii,
+                                 guint64                 lower_mask)
 {
-  const gchar *haystack = self->typed_text;
+  const gchar *haystack = self->folded_typed_text;
   const gchar *needle = lower_is_ascii;
-  const gchar *tmp;
   char ch = *needle;
+  guint i;
+
+  if (!ide_completion_item_mask_match (self->mask, lower_mask))
+    return FALSE;
 
-  if (G_UNLIKELY (haystack == NULL))
-    haystack = ide_clang_completion_item_get_typed_text (self);
+  if (G_UNLIKELY (ch == '\0'))
+    return TRUE;
 
   /*
    * Optimization to require that we find the first character of
    * needle within the first 4 characters of typed_text. Otherwise,
-   * we get way too many bogus results. It's okay to check past
-   * the trailing null byte since we know that malloc allocations
-   * are aligned to a pointer size (and therefore minimum allocation
-   * is 4 byte on 32-bit and 8 byte on 64-bit). If we hit a bogus
-   * condition, oh well, it's just one more compare below.
+   * we get way too many bogus results. The strings are packed into
+   * a GStringChunk, so we must not look past the trailing null byte.
    */
-  if (haystack [0] != ch && haystack [1] != ch && haystack [2] != ch && haystack [3] != ch)
-    return FALSE;
-
-  for (; *needle; needle++)
+  for (i = 0; i < 4 && haystack [i] != '\0'; i++)
     {
-      tmp = strchr (haystack, *needle);
-      if (tmp == NULL)
-        tmp = strchr (haystack, g_ascii_toupper (*needle));
-      if (tmp == NULL)
-        return FALSE;
-      haystack = tmp;
+      if (haystack [i] == ch)
+        break;
     }
 
-  return TRUE;
+  if (i == 4 || haystack [i] == '\0')
+    return FALSE;
+
+  return ide_completion_item_fuzzy_match_folded (haystack + i, needle, NULL);
 }
 
 IdeClangCompletionItem *ide_clang_completion_item_new (IdeRefPtr *results,
+                                                       IdeRefPtr *strings,
                                                        guint      index);
 
 G_END_DECLS
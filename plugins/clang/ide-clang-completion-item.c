@@ -333,7 +333,7 @@ ide_clang_completion_item_finalize (GObject *object)
 
   g_clear_object (&self->snippet);
   g_clear_pointer (&self->brief_comment, g_free);
-  g_clear_pointer (&self->typed_text, g_free);
+  g_clear_pointer (&self->strings, ide_ref_ptr_unref);
   g_clear_pointer (&self->markup, g_free);
   g_clear_pointer (&self->results, ide_ref_ptr_unref);
 
@@ -448,28 +448,29 @@ ide_clang_completion_item_get_snippet (IdeClangCompletionItem *self)
   return self->snippet;
 }
 
-/**
- * ide_clang_completion_item_get_typed_text:
- * @self: An #IdeClangCompletionItem.
- *
- * Gets the text that would be expected to be typed to insert this completion
- * item into the text editor.
- *
- * Returns: A string which should not be modified or freed.
+/*
+ * Loads the typed text into @strings along with a lower case copy and
+ * character mask for filtering. This is performed in the worker thread
+ * when the item is created so that filtering on the main thread does not
+ * need to call into libclang or allocate.
  */
-const gchar *
-ide_clang_completion_item_get_typed_text (IdeClangCompletionItem *self)
+static void
+ide_clang_completion_item_load_typed_text (IdeClangCompletionItem *self,
+                                           GStringChunk           *strings)
 {
   CXCompletionResult *result;
   CXString cxstr;
+  const gchar *iter;
 
-  g_return_val_if_fail (IDE_IS_CLANG_COMPLETION_ITEM (self), NULL);
-
-  if (self->typed_text)
-    return self->typed_text;
+  g_assert (IDE_IS_CLANG_COMPLETION_ITEM (self));
+  g_assert (strings != NULL);
 
   result = ide_clang_completion_item_get_result (self);
 
+  self->typed_text = "";
+  self->folded_typed_text = "";
+  self->mask = 0;
+
   /*
    * Determine the index of the typed text. Each completion result should have
    * exaction one of these.
@@ -502,7 +503,7 @@ ide_clang_completion_item_get_typed_text (IdeClangCompletionItem *self)
        * This seems like an implausible result, but we are definitely
        * hitting it occasionally.
        */
-      return "";
+      return;
     }
 
 #ifdef IDE_ENABLE_TRACE
@@ -521,9 +522,42 @@ ide_clang_completion_item_get_typed_text (IdeClangCompletionItem *self)
 #endif
 
   cxstr = clang_getCompletionChunkText (result->CompletionString, self->typed_text_index);
-  self->typed_text = g_strdup (clang_getCString (cxstr));
+  self->typed_text = g_string_chunk_insert (strings, clang_getCString (cxstr) ?: "");
   clang_disposeString (cxstr);
 
+  self->folded_typed_text = self->typed_text;
+  self->mask = ide_completion_item_get_char_mask (self->typed_text);
+
+  for (iter = self->typed_text; *iter; iter++)
+    {
+      if (g_ascii_isupper (*iter))
+        {
+          gchar *folded = g_string_chunk_insert (strings, self->typed_text);
+          gchar *pos;
+
+          for (pos = folded; *pos; pos++)
+            *pos = g_ascii_tolower (*pos);
+
+          self->folded_typed_text = folded;
+          break;
+        }
+    }
+}
+
+/**
+ * ide_clang_completion_item_get_typed_text:
+ * @self: An #IdeClangCompletionItem.
+ *
+ * Gets the text that would be expected to be typed to insert this completion
+ * item into the text editor.
+ *
+ * Returns: A string which should not be modified or freed.
+ */
+const gchar *
+ide_clang_completion_item_get_typed_text (IdeClangCompletionItem *self)
+{
+  g_return_val_if_fail (IDE_IS_CLANG_COMPLETION_ITEM (self), NULL);
+
   return self->typed_text;
 }
 
@@ -556,8 +590,19 @@ ide_clang_completion_item_get_brief_comment (IdeClangCompletionItem *self)
   return self->brief_comment;
 }
 
+/**
+ * ide_clang_completion_item_new:
+ * @results: An #IdeRefPtr containing the CXCodeCompleteResults.
+ * @strings: An #IdeRefPtr containing a #GStringChunk shared by the result set.
+ * @index: the index of the result within @results.
+ *
+ * Creates a new item for the result at @index. The typed text is stored
+ * in @strings so that the strings for the whole result set are allocated
+ * in bulk and released together with the last item.
+ */
 IdeClangCompletionItem *
 ide_clang_completion_item_new (IdeRefPtr *results,
+                               IdeRefPtr *strings,
                                guint      index)
 {
   IdeClangCompletionItem *ret;
@@ -565,10 +610,13 @@ ide_clang_completion_item_new (IdeRefPtr *results,
 
   ret = g_object_new (IDE_TYPE_CLANG_COMPLETION_ITEM, NULL);
   ret->results = ide_ref_ptr_ref (results);
+  ret->strings = ide_ref_ptr_ref (strings);
   ret->index = index;
 
   result = ide_clang_completion_item_get_result (ret);
   ret->priority = clang_getCompletionPriority (result->CompletionString);
 
+  ide_clang_completion_item_load_typed_text (ret, ide_ref_ptr_get (strings));
+
   return ret;
 }
@@ -18,6 +18,7 @@
 
 #define G_LOG_DOMAIN "clang-completion-provider"
 
+#include <egg-counter.h>
 #include <ide.h>
 #include <string.h>
 
@@ -67,6 +68,7 @@ typedef struct
   GCancellable *cancellable;
   gchar *line;
   gchar *query;
+  gint64 begin;
 } IdeClangCompletionState;
 
 static void ide_clang_completion_provider_iface_init (GtkSourceCompletionProviderIface *iface);
@@ -79,6 +81,9 @@ G_DEFINE_TYPE_EXTENDED (IdeClangCompletionProvider,
                                                ide_clang_completion_provider_iface_init)
                         G_IMPLEMENT_INTERFACE (IDE_TYPE_COMPLETION_PROVIDER, NULL))
 
+EGG_DEFINE_HISTOGRAM (PopulateLatency, "Clang", "Completion Populate Latency",
+                      "Time taken from a completion request until its results are presented, in microseconds.")
+
 static void
 ide_clang_completion_state_free (IdeClangCompletionState *state)
 {
@@ -294,6 +299,7 @@ ide_clang_completion_provider_refilter (IdeClangCompletionProvider *self,
                                         const gchar                *query)
 {
   g_autofree gchar *lower = NULL;
+  guint64 lower_mask;
 
   g_assert (IDE_IS_CLANG_COMPLETION_PROVIDER (self));
   g_assert (results != NULL);
@@ -321,11 +327,13 @@ ide_clang_completion_provider_refilter (IdeClangCompletionProvider *self,
       return;
     }
 
+  lower_mask = ide_completion_item_get_char_mask (lower);
+
   for (GList *iter = self->head; iter; iter = iter->next)
     {
       IdeClangCompletionItem *item = iter->data;
 
-      if (!ide_clang_completion_item_match (item, lower))
+      if (!ide_clang_completion_item_match (item, lower, lower_mask))
         {
           if (iter->prev != NULL)
             iter->prev->next = iter->next;
@@ -385,6 +393,7 @@ ide_clang_completion_provider_code_complete_cb (GObject      *object,
           gtk_source_completion_context_add_proposals (state->context,
                                                        GTK_SOURCE_COMPLETION_PROVIDER (state->self),
                                                        state->self->head, TRUE);
+          EGG_HISTOGRAM_RECORD (PopulateLatency, g_get_monotonic_time () - state->begin);
         }
       else
         {
@@ -475,6 +484,7 @@ ide_clang_completion_provider_populate (GtkSourceCompletionProvider *provider,
   IdeClangService *service;
   GtkTextIter iter;
   GtkTextIter begin;
+  gint64 begin_time = g_get_monotonic_time ();
 
   IDE_ENTRY;
 
@@ -551,6 +561,7 @@ ide_clang_completion_provider_populate (GtkSourceCompletionProvider *provider,
       ide_clang_completion_provider_refilter (self, self->last_results, prefix);
       ide_clang_completion_provider_sort (self);
       gtk_source_completion_context_add_proposals (context, provider, self->head, TRUE);
+      EGG_HISTOGRAM_RECORD (PopulateLatency, g_get_monotonic_time () - begin_time);
 
       IDE_EXIT;
     }
@@ -592,6 +603,7 @@ ide_clang_completion_provider_populate (GtkSourceCompletionProvider *provider,
   state->cancellable = g_cancellable_new ();
   state->query = prefix, prefix = NULL;
   state->line = line, line = NULL;
+  state->begin = begin_time;
 
   g_signal_connect_object (context,
                            "cancelled",
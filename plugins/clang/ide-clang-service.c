@@ -66,6 +66,10 @@ EGG_DEFINE_COUNTER (ParseAttempts,
                     "Clang",
                     "Total Parse Attempts",
                     "Total number of attempts to create a translation unit.")
+EGG_DEFINE_HISTOGRAM (ParseLatency,
+                      "Clang",
+                      "Parse Latency",
+                      "Time taken to create a translation unit, in microseconds.")
 
 static void
 parse_request_free (gpointer data)
@@ -209,6 +213,7 @@ ide_clang_service_parse_worker (GTask        *task,
   const gchar *detail_error = NULL;
   enum CXErrorCode code;
   GArray *ar = NULL;
+  gint64 begin;
   gsize i;
 
   g_assert (G_IS_TASK (task));
@@ -242,6 +247,7 @@ ide_clang_service_parse_worker (GTask        *task,
   argc = argv ? g_strv_length (request->command_line_args) : 0;
 
   EGG_COUNTER_INC (ParseAttempts);
+  begin = g_get_monotonic_time ();
   code = clang_parseTranslationUnit2 (request->index,
                                       request->source_filename,
                                       argv, argc,
@@ -249,6 +255,7 @@ ide_clang_service_parse_worker (GTask        *task,
                                       ar->len,
                                       request->options,
                                       &tu);
+  EGG_HISTOGRAM_RECORD (ParseLatency, g_get_monotonic_time () - begin);
 
   switch (code)
     {
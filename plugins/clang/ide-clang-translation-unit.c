@@ -617,6 +617,7 @@ ide_clang_translation_unit_code_complete_worker (GTask        *task,
   CXCodeCompleteResults *results;
   CXTranslationUnit tu;
   g_autoptr(IdeRefPtr) refptr = NULL;
+  g_autoptr(IdeRefPtr) strings = NULL;
   struct CXUnsavedFile *ufs;
   GPtrArray *ar;
   gsize i;
@@ -684,13 +685,14 @@ ide_clang_translation_unit_code_complete_worker (GTask        *task,
    * we will inflate result strings as necessary.
    */
   refptr = ide_ref_ptr_new (results, (GDestroyNotify)clang_disposeCodeCompleteResults);
-  ar = g_ptr_array_new_with_free_func (g_object_unref);
+  strings = ide_ref_ptr_new (g_string_chunk_new (4096), (GDestroyNotify)g_string_chunk_free);
+  ar = g_ptr_array_new_full (results->NumResults, g_object_unref);
 
   for (i = 0; i < results->NumResults; i++)
     {
       GtkSourceCompletionProposal *proposal;
 
-      proposal = GTK_SOURCE_COMPLETION_PROPOSAL (ide_clang_completion_item_new (refptr, i));
+      proposal = GTK_SOURCE_COMPLETION_PROPOSAL (ide_clang_completion_item_new (refptr, strings, i));
       g_ptr_array_add (ar, proposal);
     }
 
@@ -741,9 +743,10 @@ ide_clang_translation_unit_code_complete_async (IdeClangTranslationUnit *self,
 
   g_task_set_task_data (task, state, code_complete_state_free);
 
-  ide_thread_pool_push_task (IDE_THREAD_POOL_COMPILER,
-                             task,
-                             ide_clang_translation_unit_code_complete_worker);
+  ide_thread_pool_push_task_with_priority (IDE_THREAD_POOL_COMPILER,
+                                           IDE_THREAD_POOL_PRIORITY_INTERACTIVE,
+                                           task,
+                                           ide_clang_translation_unit_code_complete_worker);
 
   IDE_EXIT;
 }
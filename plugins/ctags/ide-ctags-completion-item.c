@@ -31,6 +31,13 @@ struct _IdeCtagsCompletionItem
   IdeCompletionItem           parent_instance;
   const IdeCtagsIndexEntry   *entry;
   IdeCtagsCompletionProvider *provider;
+  /*
+   * The markup is only generated once the row is displayed, and is
+   * cached along with the word it was highlighted for since the
+   * completion window requests it repeatedly.
+   */
+  gchar                      *markup;
+  gchar                      *markup_word;
 };
 
 static void proposal_iface_init (GtkSourceCompletionProposalIface *iface);
@@ -72,12 +79,24 @@ ide_ctags_completion_item_match (IdeCompletionItem *item,
 {
   IdeCtagsCompletionItem *self = (IdeCtagsCompletionItem *)item;
 
-  return ide_completion_item_fuzzy_match (self->entry->name, casefold, &item->priority);
+  /*
+   * Results are only replayed with the provider's current word, so the
+   * provider has already computed the mask for this query.
+   */
+  return ide_ctags_index_entry_fuzzy_match (self->entry,
+                                            casefold,
+                                            self->provider->current_mask,
+                                            &item->priority);
 }
 
 static void
 ide_ctags_completion_item_finalize (GObject *object)
 {
+  IdeCtagsCompletionItem *self = (IdeCtagsCompletionItem *)object;
+
+  g_clear_pointer (&self->markup, g_free);
+  g_clear_pointer (&self->markup_word, g_free);
+
   G_OBJECT_CLASS (ide_ctags_completion_item_parent_class)->finalize (object);
 
   EGG_COUNTER_DEC (instances);
@@ -109,11 +128,20 @@ static gchar *
 get_markup (GtkSourceCompletionProposal *proposal)
 {
   IdeCtagsCompletionItem *self = (IdeCtagsCompletionItem *)proposal;
+  const gchar *word = self->provider->current_word;
 
-  if (self->provider->current_word != NULL)
-    return ide_completion_item_fuzzy_highlight (self->entry->name, self->provider->current_word);
+  if (word == NULL)
+    return g_strdup (self->entry->name);
 
-  return g_strdup (self->entry->name);
+  if (self->markup == NULL || g_strcmp0 (self->markup_word, word) != 0)
+    {
+      g_free (self->markup);
+      g_free (self->markup_word);
+      self->markup = ide_completion_item_fuzzy_highlight (self->entry->name, word);
+      self->markup_word = g_strdup (word);
+    }
+
+  return g_strdup (self->markup);
 }
 
 static gchar *
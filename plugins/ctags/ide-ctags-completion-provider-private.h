@@ -31,6 +31,12 @@ struct _IdeCtagsCompletionProvider
   GPtrArray            *indexes;
   IdeCompletionResults *results;
   gchar                *current_word;
+
+  /*
+   * ide_completion_item_get_char_mask() of the casefolded current_word,
+   * computed once per query so that refiltering items can use it.
+   */
+  guint64               current_mask;
 };
 
 G_END_DECLS
@@ -18,6 +18,7 @@
 
 #define G_LOG_DOMAIN "ide-ctags-completion-provider"
 
+#include <egg-counter.h>
 #include <glib/gi18n.h>
 
 #include "ide-ctags-completion-item.h"
@@ -35,6 +36,9 @@ G_DEFINE_DYNAMIC_TYPE_EXTENDED (IdeCtagsCompletionProvider,
                                 G_IMPLEMENT_INTERFACE (GTK_SOURCE_TYPE_COMPLETION_PROVIDER, provider_iface_init)
                                 G_IMPLEMENT_INTERFACE (IDE_TYPE_COMPLETION_PROVIDER, NULL))
 
+EGG_DEFINE_HISTOGRAM (PopulateLatency, "Ctags", "Completion Populate Latency",
+                      "Time taken to populate the completion window, in microseconds.")
+
 void
 ide_ctags_completion_provider_add_index (IdeCtagsCompletionProvider *self,
                                          IdeCtagsIndex              *index)
@@ -168,6 +172,7 @@ ide_ctags_completion_provider_populate (GtkSourceCompletionProvider *provider,
   guint i;
   guint j;
   g_autoptr(GHashTable) completions = NULL;
+  EGG_HISTOGRAM_TIME_SCOPE (PopulateLatency);
 
   IDE_ENTRY;
 
@@ -177,6 +182,9 @@ ide_ctags_completion_provider_populate (GtkSourceCompletionProvider *provider,
   g_clear_pointer (&self->current_word, g_free);
   self->current_word = ide_completion_provider_context_current_word (context);
 
+  casefold = g_utf8_casefold (self->current_word, -1);
+  self->current_mask = ide_completion_item_get_char_mask (casefold);
+
   allowed = get_allowed_suffixes (context);
 
   if (self->results != NULL)
@@ -193,8 +201,6 @@ ide_ctags_completion_provider_populate (GtkSourceCompletionProvider *provider,
   if (word_len < self->minimum_word_size)
     IDE_GOTO (word_too_small);
 
-  casefold = g_utf8_casefold (self->current_word, -1);
-
   self->results = ide_completion_results_new (self->current_word);
 
   completions = g_hash_table_new (g_str_hash, g_str_equal);
@@ -229,6 +235,15 @@ ide_ctags_completion_provider_populate (GtkSourceCompletionProvider *provider,
         {
           const IdeCtagsIndexEntry *entry = &entries [j];
           IdeCtagsCompletionItem *item;
+          guint priority = 0;
+
+          /*
+           * Match against the precomputed mask and folded name first so
+           * that most entries are rejected without a hash lookup and we
+           * only allocate items for the entries that will be shown.
+           */
+          if (!ide_ctags_index_entry_fuzzy_match (entry, casefold, self->current_mask, &priority))
+            continue;
 
           if (g_hash_table_contains (completions, entry->name))
             continue;
@@ -239,13 +254,7 @@ ide_ctags_completion_provider_populate (GtkSourceCompletionProvider *provider,
             continue;
 
           item = ide_ctags_completion_item_new (self, entry);
-
-          if (!ide_completion_item_match (IDE_COMPLETION_ITEM (item), self->current_word, casefold))
-            {
-              g_object_unref (item);
-              continue;
-            }
-
+          ide_completion_item_set_priority (IDE_COMPLETION_ITEM (item), priority);
           ide_completion_results_take_proposal (self->results, IDE_COMPLETION_ITEM (item));
         }
     }
@@ -30,12 +30,13 @@ struct _IdeCtagsIndex
 {
   IdeObject  parent_instance;
 
-  GArray    *index;
-  GBytes    *buffer;
-  GFile     *file;
-  gchar     *path_root;
+  GArray       *index;
+  GBytes       *buffer;
+  GStringChunk *folded;
+  GFile        *file;
+  gchar        *path_root;
 
-  guint64    mtime;
+  guint64       mtime;
 };
 
 enum {
@@ -102,55 +103,32 @@ ide_ctags_index_entry_compare (gconstpointer a,
   return ret;
 }
 
-static inline gchar *
-forward_to_tab (gchar *iter)
-{
-  while (*iter && g_utf8_get_char (iter) != '\t')
-    iter = g_utf8_next_char (iter);
-  return *iter ? iter : NULL;
-}
-
-static inline gchar *
-forward_to_nontab_and_zero (gchar *iter)
-{
-  while (*iter && (g_utf8_get_char (iter) == '\t'))
-    {
-      gchar *tmp = iter;
-      iter = g_utf8_next_char (iter);
-      *tmp = '\0';
-    }
-
-  return *iter ? iter : NULL;
-}
-
 static gboolean
 ide_ctags_index_parse_line (gchar              *line,
+                            gsize               length,
                             IdeCtagsIndexEntry *entry)
 {
-  gchar *iter = line;
+  gchar *fields[4];
+  gchar *iter;
 
   g_assert (line != NULL);
   g_assert (entry != NULL);
 
   memset (entry, 0, sizeof *entry);
 
-  entry->name = iter;
-  if (!(iter = forward_to_tab (iter)))
-    return FALSE;
-  if (!(iter = forward_to_nontab_and_zero (iter)))
-    return FALSE;
-
-  entry->path = iter;
-  if (!(iter = forward_to_tab (iter)))
-    return FALSE;
-  if (!(iter = forward_to_nontab_and_zero (iter)))
+  /*
+   * name<TAB>path<TAB>pattern<TAB>kind[<TAB>key:val...]
+   *
+   * The first three fields are terminated in place, the remainder starts
+   * with the kind and is terminated by our caller.
+   */
+  if (ide_line_reader_split (line, length, '\t', fields, G_N_ELEMENTS (fields)) != G_N_ELEMENTS (fields))
     return FALSE;
 
-  entry->pattern = iter;
-  if (!(iter = forward_to_tab (iter)))
-    return FALSE;
-  if (!(iter = forward_to_nontab_and_zero (iter)))
-    return FALSE;
+  entry->name = fields [0];
+  entry->path = fields [1];
+  entry->pattern = fields [2];
+  iter = fields [3];
 
   switch (*iter)
     {
@@ -175,14 +153,50 @@ ide_ctags_index_parse_line (gchar              *line,
     }
 
   /* Store a pointer to the beginning of the key/val pairs */
-  if (NULL != (iter = forward_to_tab (iter)))
-    entry->keyval = iter;
-  else
-    entry->keyval = NULL;
+  entry->keyval = memchr (iter, '\t', line + length - iter);
 
   return TRUE;
 }
 
+/*
+ * Precomputes the lower case name and character mask used for completion.
+ * Names without upper case characters (most C symbols) are shared with the
+ * buffer, the rest are stored in @folded, which is freed with the index.
+ */
+static void
+ide_ctags_index_fold_entries (GArray       *index,
+                              GStringChunk *folded)
+{
+  guint i;
+
+  g_assert (index != NULL);
+  g_assert (folded != NULL);
+
+  for (i = 0; i < index->len; i++)
+    {
+      IdeCtagsIndexEntry *entry = &g_array_index (index, IdeCtagsIndexEntry, i);
+      const gchar *iter;
+
+      entry->folded = entry->name;
+      entry->mask = ide_completion_item_get_char_mask (entry->name);
+
+      for (iter = entry->name; *iter; iter++)
+        {
+          if (g_ascii_isupper (*iter))
+            {
+              gchar *copy = g_string_chunk_insert (folded, entry->name);
+              gchar *pos;
+
+              for (pos = copy; *pos; pos++)
+                *pos = g_ascii_tolower (*pos);
+
+              entry->folded = copy;
+              break;
+            }
+        }
+    }
+}
+
 static void
 ide_ctags_index_build_index (GTask        *task,
                              gpointer      source_object,
@@ -193,6 +207,7 @@ ide_ctags_index_build_index (GTask        *task,
   IdeLineReader reader;
   GError *error = NULL;
   GArray *index = NULL;
+  GStringChunk *folded = NULL;
   gchar *contents = NULL;
   gchar *line;
   gsize length = 0;
@@ -233,14 +248,18 @@ ide_ctags_index_build_index (GTask        *task,
        * We could potentially avoid the sort later if we know the tags
        * file was sorted on creation.
        */
-      if (ide_ctags_index_parse_line (line, &entry))
+      if (ide_ctags_index_parse_line (line, line_length, &entry))
         g_array_append_val (index, entry);
     }
 
   g_array_sort (index, ide_ctags_index_entry_compare);
 
+  folded = g_string_chunk_new (4096);
+  ide_ctags_index_fold_entries (index, folded);
+
   self->index = index;
   self->buffer = g_bytes_new_take (contents, length);
+  self->folded = folded;
 
   EGG_COUNTER_ADD (index_entries, (gint64)index->len);
   EGG_COUNTER_ADD (heap_size, (gint64)length);
@@ -368,6 +387,7 @@ ide_ctags_index_finalize (GObject *object)
   g_clear_object (&self->file);
   g_clear_pointer (&self->index, g_array_unref);
   g_clear_pointer (&self->buffer, g_bytes_unref);
+  g_clear_pointer (&self->folded, g_string_chunk_free);
   g_clear_pointer (&self->path_root, g_free);
 
   G_OBJECT_CLASS (ide_ctags_index_parent_class)->finalize (object);
@@ -445,7 +465,7 @@ ide_ctags_index_init_async (GAsyncInitable      *initable,
       return;
     }
 
-  g_task_run_in_thread (task, ide_ctags_index_build_index);
+  ide_thread_pool_push_task (IDE_THREAD_POOL_INDEXER, task, ide_ctags_index_build_index);
 }
 
 static gboolean
@@ -593,6 +613,8 @@ ide_ctags_index_entry_copy (const IdeCtagsIndexEntry *entry)
   copy->name = g_strdup (entry->name);
   copy->path = g_strdup (entry->path);
   copy->pattern = g_strdup (entry->pattern);
+  copy->folded = (entry->folded == entry->name) ? copy->name : g_strdup (entry->folded);
+  copy->mask = entry->mask;
   copy->kind = entry->kind;
 
   return copy;
@@ -601,6 +623,8 @@ ide_ctags_index_entry_copy (const IdeCtagsIndexEntry *entry)
 void
 ide_ctags_index_entry_free (IdeCtagsIndexEntry *entry)
 {
+  if (entry->folded != entry->name)
+    g_free ((gchar *)entry->folded);
   g_free ((gchar *)entry->name);
   g_free ((gchar *)entry->path);
   g_free ((gchar *)entry->pattern);
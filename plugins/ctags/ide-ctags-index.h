@@ -51,6 +51,8 @@ typedef struct
   const gchar            *path;
   const gchar            *pattern;
   const gchar            *keyval;
+  const gchar            *folded;
+  guint64                 mask;
   IdeCtagsIndexEntryKind  kind : 8;
   guint8                  padding[3];
 } IdeCtagsIndexEntry;
@@ -85,6 +87,18 @@ gint                      ide_ctags_index_entry_compare (gconstpointer
 IdeCtagsIndexEntry       *ide_ctags_index_entry_copy    (const IdeCtagsIndexEntry *entry);
 void                      ide_ctags_index_entry_free    (IdeCtagsIndexEntry       *entry);
 
+static inline gboolean
+ide_ctags_index_entry_fuzzy_match (const IdeCtagsIndexEntry *entry,
+                                   const gchar              *casefold,
+                                   guint64                   casefold_mask,
+                                   guint                    *priority)
+{
+  if (!ide_completion_item_mask_match (entry->mask, casefold_mask))
+    return FALSE;
+
+  return ide_completion_item_fuzzy_match_folded (entry->folded, casefold, priority);
+}
+
 static inline IdeSymbolKind
 ide_ctags_index_entry_kind_to_symbol_kind (IdeCtagsIndexEntryKind kind)
 {
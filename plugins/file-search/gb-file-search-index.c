@@ -16,12 +16,12 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <egg-counter.h>
 #include <fuzzy.h>
 #include <glib/gi18n.h>
 #include <ide.h>
 
 #include "gb-file-search-index.h"
-#include "gb-file-search-result.h"
 
 struct _GbFileSearchIndex
 {
@@ -33,6 +33,9 @@ struct _GbFileSearchIndex
 
 G_DEFINE_TYPE (GbFileSearchIndex, gb_file_search_index, IDE_TYPE_OBJECT)
 
+EGG_DEFINE_HISTOGRAM (FuzzyMatchLatency, "FileSearch", "Fuzzy Match Latency",
+                      "Time taken to fuzzy match a query, in microseconds.")
+
 enum {
   PROP_0,
   PROP_ROOT_DIRECTORY,
@@ -271,7 +274,7 @@ gb_file_search_index_build_async (GbFileSearchIndex   *self,
     }
 
   g_task_set_task_data (task, g_object_ref (self->root_directory), g_object_unref);
-  g_task_run_in_thread (task, gb_file_search_index_builder);
+  ide_thread_pool_push_task (IDE_THREAD_POOL_INDEXER, task, gb_file_search_index_builder);
 }
 
 gboolean
@@ -296,8 +299,8 @@ gb_file_search_index_populate (GbFileSearchIndex *self,
 {
   g_autoptr(GArray) ar = NULL;
   g_auto(IdeSearchReducer) reducer = { 0 };
-  IdeContext *icontext;
   gsize max_matches;
+  gint64 begin;
   gsize i;
 
   g_return_if_fail (GB_IS_FILE_SEARCH_INDEX (self));
@@ -308,11 +311,12 @@ gb_file_search_index_populate (GbFileSearchIndex *self,
   if (self->fuzzy == NULL)
     return;
 
-  icontext = ide_object_get_context (IDE_OBJECT (provider));
   max_matches = ide_search_context_get_max_results (context);
   ide_search_reducer_init (&reducer, context, provider, max_matches);
 
+  begin = g_get_monotonic_time ();
   ar = fuzzy_match (self->fuzzy, query, max_matches);
+  EGG_HISTOGRAM_RECORD (FuzzyMatchLatency, g_get_monotonic_time () - begin);
 
   for (i = 0; i < ar->len; i++)
     {
@@ -322,18 +326,17 @@ gb_file_search_index_populate (GbFileSearchIndex *self,
 
       if (ide_search_reducer_accepts (&reducer, match->score))
         {
-          g_autoptr(GbFileSearchResult) result = NULL;
-          g_autofree gchar *markup = NULL;
-
-          markup = ide_completion_item_fuzzy_highlight (match->key, query);
-          result = g_object_new (GB_TYPE_FILE_SEARCH_RESULT,
-                                 "context", icontext,
-                                 "provider", provider,
-                                 "score", match->score,
-                                 "title", markup,
-                                 "path", match->key,
-                                 NULL);
-          ide_search_reducer_push (&reducer, IDE_SEARCH_RESULT (result));
+          IdeSearchHit hit = { 0 };
+
+          /*
+           * Push a compact hit rather than a GbFileSearchResult. The result
+           * object is only created by the provider if the row is displayed.
+           */
+          hit.title = ide_completion_item_fuzzy_highlight (match->key, query);
+          hit.key = g_strdup (match->key);
+          hit.score = match->score;
+
+          ide_search_reducer_push_hit (&reducer, &hit);
         }
     }
 }
@@ -22,6 +22,7 @@
 
 #include "gb-file-search-provider.h"
 #include "gb-file-search-index.h"
+#include "gb-file-search-result.h"
 
 struct _GbFileSearchProvider
 {
@@ -244,6 +245,26 @@ gb_file_search_provider_activate (IdeSearchProvider *provider,
     }
 }
 
+static IdeSearchResult *
+gb_file_search_provider_create_result (IdeSearchProvider  *provider,
+                                       const IdeSearchHit *hit)
+{
+  IdeContext *context;
+
+  g_assert (IDE_IS_SEARCH_PROVIDER (provider));
+  g_assert (hit != NULL);
+
+  context = ide_object_get_context (IDE_OBJECT (provider));
+
+  return g_object_new (GB_TYPE_FILE_SEARCH_RESULT,
+                       "context", context,
+                       "provider", provider,
+                       "score", hit->score,
+                       "title", hit->title,
+                       "path", hit->key,
+                       NULL);
+}
+
 static gint
 gb_file_search_provider_get_priority (IdeSearchProvider *provider)
 {
@@ -311,6 +332,7 @@ search_provider_iface_init (IdeSearchProviderInterface *iface)
   iface->get_verb = gb_file_search_provider_get_verb;
   iface->create_row = gb_file_search_provider_create_row;
   iface->activate = gb_file_search_provider_activate;
+  iface->create_result = gb_file_search_provider_create_result;
   iface->get_priority = gb_file_search_provider_get_priority;
 }
 
@@ -18,25 +18,26 @@
 
 #include <string.h>
 
-#include "egg-signal-group.h"
-
 #include "gbp-gcc-build-result-addin.h"
+#include "gbp-gcc-message.h"
 
-
-#define ERROR_FORMAT_REGEX           \
-  "(?<filename>[a-zA-Z0-9\\-\\.]+):" \
-  "(?<line>\\d+):"                   \
-  "(?<column>\\d+): "                \
-  "(?<level>[\\w\\s]+): "            \
-  "(?<message>.*)"
+#define ENTERING_DIRECTORY_BEGIN "Entering directory '"
+#define ENTERING_DIRECTORY_END   "'"
 
 struct _GbpGccBuildResultAddin
 {
-  IdeObject       parent_instance;
+  IdeObject  parent_instance;
+
+  /*
+   * The line parser is called from the threads reading the build output,
+   * so the state shared between stdout and stderr is protected by mutex.
+   */
+  GMutex     mutex;
+  gchar     *current_dir;
+  gchar     *top_dir;
+  gchar     *workdir;
 
-  EggSignalGroup *signals;
-  gchar          *current_dir;
-  gchar          *top_dir;
+  guint      line_parser_id;
 };
 
 static void build_result_addin_iface_init (IdeBuildResultAddinInterface *iface);
@@ -45,85 +46,28 @@ G_DEFINE_TYPE_EXTENDED (GbpGccBuildResultAddin, gbp_gcc_build_result_addin, IDE_
                         G_IMPLEMENT_INTERFACE (IDE_TYPE_BUILD_RESULT_ADDIN,
                                                build_result_addin_iface_init))
 
-static GRegex *errfmt;
-
-static IdeDiagnosticSeverity
-parse_severity (const gchar *str)
-{
-  g_autofree gchar *lower = NULL;
-
-  if (str == NULL)
-    return IDE_DIAGNOSTIC_WARNING;
-
-  lower = g_utf8_strdown (str, -1);
-
-  if (strstr (lower, "fatal") != NULL)
-    return IDE_DIAGNOSTIC_FATAL;
-
-  if (strstr (lower, "error") != NULL)
-    return IDE_DIAGNOSTIC_ERROR;
-
-  if (strstr (lower, "warning") != NULL)
-    return IDE_DIAGNOSTIC_WARNING;
-
-  if (strstr (lower, "ignored") != NULL)
-    return IDE_DIAGNOSTIC_IGNORED;
-
-  if (strstr (lower, "deprecated") != NULL)
-    return IDE_DIAGNOSTIC_DEPRECATED;
-
-  if (strstr (lower, "note") != NULL)
-    return IDE_DIAGNOSTIC_NOTE;
-
-  return IDE_DIAGNOSTIC_WARNING;
-}
-
 static IdeDiagnostic *
 create_diagnostic (GbpGccBuildResultAddin *self,
-                   GMatchInfo             *match_info)
+                   const GbpGccMessage    *msg)
 {
   g_autofree gchar *filename = NULL;
-  g_autofree gchar *line = NULL;
-  g_autofree gchar *column = NULL;
-  g_autofree gchar *message = NULL;
-  g_autofree gchar *level = NULL;
   g_autoptr(IdeFile) file = NULL;
   g_autoptr(IdeSourceLocation) location = NULL;
-  IdeDiagnostic *diagnostic;
   IdeContext *context;
-  struct {
-    gint64 line;
-    gint64 column;
-    IdeDiagnosticSeverity severity;
-  } parsed;
 
   g_assert (GBP_IS_GCC_BUILD_RESULT_ADDIN (self));
-  g_assert (match_info != NULL);
-
-  message = g_match_info_fetch_named (match_info, "message");
+  g_assert (msg != NULL);
 
   /* Ignore _FORTIFY_SOURCE warnings which require optimization */
-  if (message != NULL && (strncmp (message, "#warning _FORTIFY_SOURCE requires compiling with optimization", 61) == 0))
+  if (strncmp (msg->message, "#warning _FORTIFY_SOURCE requires compiling with optimization", 61) == 0)
     return NULL;
 
-  filename = g_match_info_fetch_named (match_info, "filename");
-  line = g_match_info_fetch_named (match_info, "line");
-  column = g_match_info_fetch_named (match_info, "column");
-  level = g_match_info_fetch_named (match_info, "level");
-
-  parsed.line = g_ascii_strtoll (line, NULL, 10);
-  if (parsed.line < 1 || parsed.line > G_MAXINT32)
-    return NULL;
-  parsed.line--;
-
-  parsed.column = g_ascii_strtoll (column, NULL, 10);
-  if (parsed.column < 1 || parsed.column > G_MAXINT32)
+  if (msg->line < 1 || msg->column < 1)
     return NULL;
-  parsed.column--;
 
-  parsed.severity = parse_severity (level);
+  filename = g_strndup (msg->filename, msg->filename_len);
 
-  context = ide_object_get_context (IDE_OBJECT (self));
+  g_mutex_lock (&self->mutex);
 
   if (!g_path_is_absolute (filename) && self->current_dir != NULL)
     {
@@ -142,51 +86,46 @@ create_diagnostic (GbpGccBuildResultAddin *self,
       filename = path;
     }
 
-  if (!g_path_is_absolute (filename))
+  if (!g_path_is_absolute (filename) && self->workdir != NULL)
     {
-      g_autoptr(GFile) child = NULL;
-      IdeVcs *vcs;
-      GFile *workdir;
       gchar *path;
 
-      vcs = ide_context_get_vcs (context);
-      workdir = ide_vcs_get_working_directory (vcs);
-
-      child = g_file_get_child (workdir, filename);
-      path = g_file_get_path (child);
-
+      path = g_build_filename (self->workdir, filename, NULL);
       g_free (filename);
       filename = path;
     }
 
+  g_mutex_unlock (&self->mutex);
+
+  context = ide_object_get_context (IDE_OBJECT (self));
+
   file = ide_file_new_for_path (context, filename);
-  location = ide_source_location_new (file, parsed.line, parsed.column, 0);
-  diagnostic = ide_diagnostic_new (parsed.severity, message, location);
+  location = ide_source_location_new (file, msg->line - 1, msg->column - 1, 0);
 
-  return diagnostic;
+  return ide_diagnostic_new (msg->severity, msg->message, location);
 }
 
-static void
-gbp_gcc_build_result_addin_log (GbpGccBuildResultAddin *self,
-                                IdeBuildResultLog       log,
-                                const gchar            *message,
-                                IdeBuildResult         *result)
+static IdeDiagnostic *
+gbp_gcc_build_result_addin_parse_line (IdeBuildResult    *result,
+                                       IdeBuildResultLog  log,
+                                       const gchar       *line,
+                                       gpointer           user_data)
 {
-  GMatchInfo *match_info = NULL;
+  GbpGccBuildResultAddin *self = user_data;
   const gchar *enterdir;
+  GbpGccMessage msg;
 
-  g_assert (GBP_IS_GCC_BUILD_RESULT_ADDIN (self));
   g_assert (IDE_IS_BUILD_RESULT (result));
-
-#define ENTERING_DIRECTORY_BEGIN "Entering directory '"
-#define ENTERING_DIRECTORY_END   "'\n"
+  g_assert (GBP_IS_GCC_BUILD_RESULT_ADDIN (self));
+  g_assert (line != NULL);
 
   /*
    * This expects LANG=C, which is defined in the autotools Builder.
    * Not the most ideal decoupling of logic, but we don't have a whole
    * lot to work with here.
    */
-  if (NULL != (enterdir = strstr (message, ENTERING_DIRECTORY_BEGIN)) &&
+  if (log == IDE_BUILD_RESULT_LOG_STDOUT &&
+      NULL != (enterdir = strstr (line, ENTERING_DIRECTORY_BEGIN)) &&
       g_str_has_suffix (enterdir, ENTERING_DIRECTORY_END))
     {
       gssize len;
@@ -196,47 +135,48 @@ gbp_gcc_build_result_addin_log (GbpGccBuildResultAddin *self,
 
       if (len > 0)
         {
+          g_mutex_lock (&self->mutex);
           g_free (self->current_dir);
           self->current_dir = g_strndup (enterdir, len);
           if (self->top_dir == NULL)
             self->top_dir = g_strndup (enterdir, len);
+          g_mutex_unlock (&self->mutex);
         }
+
+      return NULL;
     }
 
-  if (g_regex_match (errfmt, message, 0, &match_info))
-    {
-      IdeDiagnostic *diagnostic;
+  if (gbp_gcc_message_parse (line, &msg))
+    return create_diagnostic (self, &msg);
 
-      if (NULL != (diagnostic = create_diagnostic (self, match_info)))
-        {
-          ide_build_result_emit_diagnostic (result, diagnostic);
-          ide_diagnostic_unref (diagnostic);
-        }
-    }
+  return NULL;
+}
+
+static void
+gbp_gcc_build_result_addin_finalize (GObject *object)
+{
+  GbpGccBuildResultAddin *self = (GbpGccBuildResultAddin *)object;
 
-  g_match_info_free (match_info);
+  g_clear_pointer (&self->current_dir, g_free);
+  g_clear_pointer (&self->top_dir, g_free);
+  g_clear_pointer (&self->workdir, g_free);
+  g_mutex_clear (&self->mutex);
 
-#undef ENTERING_DIRECTORY_BEGIN
-#undef ENTERING_DIRECTORY_END
+  G_OBJECT_CLASS (gbp_gcc_build_result_addin_parent_class)->finalize (object);
 }
 
 static void
 gbp_gcc_build_result_addin_class_init (GbpGccBuildResultAddinClass *klass)
 {
-  errfmt = g_regex_new (ERROR_FORMAT_REGEX, G_REGEX_OPTIMIZE | G_REGEX_CASELESS, 0, NULL);
-  g_assert (errfmt != NULL);
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = gbp_gcc_build_result_addin_finalize;
 }
 
 static void
 gbp_gcc_build_result_addin_init (GbpGccBuildResultAddin *self)
 {
-  self->signals = egg_signal_group_new (IDE_TYPE_BUILD_RESULT);
-
-  egg_signal_group_connect_object (self->signals,
-                                   "log",
-                                   G_CALLBACK (gbp_gcc_build_result_addin_log),
-                                   self,
-                                   G_CONNECT_SWAPPED);
+  g_mutex_init (&self->mutex);
 }
 
 static void
@@ -244,8 +184,30 @@ gbp_gcc_build_result_addin_load (IdeBuildResultAddin *addin,
                                  IdeBuildResult      *result)
 {
   GbpGccBuildResultAddin *self = (GbpGccBuildResultAddin *)addin;
+  IdeContext *context;
+
+  g_assert (GBP_IS_GCC_BUILD_RESULT_ADDIN (self));
+  g_assert (IDE_IS_BUILD_RESULT (result));
+
+  /* Resolve this now, the VCS must only be used from the main thread */
+  context = ide_object_get_context (IDE_OBJECT (self));
+
+  if (context != NULL)
+    {
+      IdeVcs *vcs = ide_context_get_vcs (context);
+      GFile *workdir = ide_vcs_get_working_directory (vcs);
 
-  egg_signal_group_set_target (self->signals, result);
+      g_mutex_lock (&self->mutex);
+      g_free (self->workdir);
+      self->workdir = g_file_get_path (workdir);
+      g_mutex_unlock (&self->mutex);
+    }
+
+  self->line_parser_id =
+    ide_build_result_add_line_parser (result,
+                                      gbp_gcc_build_result_addin_parse_line,
+                                      g_object_ref (self),
+                                      g_object_unref);
 }
 
 static void
@@ -254,9 +216,19 @@ gbp_gcc_build_result_addin_unload (IdeBuildResultAddin *addin,
 {
   GbpGccBuildResultAddin *self = (GbpGccBuildResultAddin *)addin;
 
-  egg_signal_group_set_target (self->signals, NULL);
+  g_assert (GBP_IS_GCC_BUILD_RESULT_ADDIN (self));
+  g_assert (IDE_IS_BUILD_RESULT (result));
+
+  if (self->line_parser_id != 0)
+    {
+      ide_build_result_remove_line_parser (result, self->line_parser_id);
+      self->line_parser_id = 0;
+    }
+
+  g_mutex_lock (&self->mutex);
   g_clear_pointer (&self->current_dir, g_free);
   g_clear_pointer (&self->top_dir, g_free);
+  g_mutex_unlock (&self->mutex);
 }
 
 static void
@@ -0,0 +1,145 @@
+/* gbp-gcc-message.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "gbp-gcc-message.h"
+
+static gboolean
+contains_word (const gchar *str,
+               gsize        len,
+               const gchar *word)
+{
+  gsize word_len = strlen (word);
+  gsize i;
+
+  for (i = 0; i + word_len <= len; i++)
+    {
+      if (g_ascii_strncasecmp (str + i, word, word_len) == 0)
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+static IdeDiagnosticSeverity
+parse_severity (const gchar *str,
+                gsize        len)
+{
+  if (contains_word (str, len, "fatal"))
+    return IDE_DIAGNOSTIC_FATAL;
+
+  if (contains_word (str, len, "error"))
+    return IDE_DIAGNOSTIC_ERROR;
+
+  if (contains_word (str, len, "warning"))
+    return IDE_DIAGNOSTIC_WARNING;
+
+  if (contains_word (str, len, "ignored"))
+    return IDE_DIAGNOSTIC_IGNORED;
+
+  if (contains_word (str, len, "deprecated"))
+    return IDE_DIAGNOSTIC_DEPRECATED;
+
+  if (contains_word (str, len, "note"))
+    return IDE_DIAGNOSTIC_NOTE;
+
+  return IDE_DIAGNOSTIC_WARNING;
+}
+
+static gboolean
+parse_number (const gchar **pos,
+              guint        *value)
+{
+  const gchar *iter = *pos;
+  guint64 v = 0;
+
+  if (!g_ascii_isdigit (*iter))
+    return FALSE;
+
+  for (; g_ascii_isdigit (*iter); iter++)
+    {
+      v = (v * 10) + (*iter - '0');
+      if (v > G_MAXINT32)
+        return FALSE;
+    }
+
+  *value = v;
+  *pos = iter;
+
+  return TRUE;
+}
+
+/**
+ * gbp_gcc_message_parse:
+ * @line: a line of compiler output
+ * @msg: (out): location for the parsed message
+ *
+ * Parses messages in the form used by gcc and clang:
+ *
+ *   filename:line:column: level: message
+ *
+ * where level is something like "warning" or "fatal error".
+ *
+ * The fields of @msg point into @line, which must outlive @msg.
+ *
+ * Returns: %TRUE if @line contained a message and @msg was filled in.
+ */
+gboolean
+gbp_gcc_message_parse (const gchar   *line,
+                       GbpGccMessage *msg)
+{
+  const gchar *colon;
+
+  while (*line == ' ' || *line == '\t')
+    line++;
+
+  for (colon = strchr (line, ':'); colon != NULL; colon = strchr (colon + 1, ':'))
+    {
+      const gchar *pos = colon + 1;
+      const gchar *level;
+
+      if (colon == line)
+        continue;
+
+      if (!parse_number (&pos, &msg->line) || *pos != ':')
+        continue;
+
+      pos++;
+
+      if (!parse_number (&pos, &msg->column) || pos [0] != ':' || pos [1] != ' ')
+        continue;
+
+      pos += 2;
+
+      for (level = pos; g_ascii_isalnum (*pos) || *pos == '_' || *pos == ' '; pos++)
+        { /* Do nothing */ }
+
+      if (pos == level || pos [0] != ':' || pos [1] != ' ')
+        continue;
+
+      msg->filename = line;
+      msg->filename_len = colon - line;
+      msg->severity = parse_severity (level, pos - level);
+      msg->message = pos + 2;
+
+      return TRUE;
+    }
+
+  return FALSE;
+}
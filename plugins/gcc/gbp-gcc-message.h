@@ -0,0 +1,41 @@
+/* gbp-gcc-message.h
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GBP_GCC_MESSAGE_H
+#define GBP_GCC_MESSAGE_H
+
+#include <ide.h>
+
+G_BEGIN_DECLS
+
+typedef struct
+{
+  const gchar           *filename;
+  gsize                  filename_len;
+  guint                  line;
+  guint                  column;
+  IdeDiagnosticSeverity  severity;
+  const gchar           *message;
+} GbpGccMessage;
+
+gboolean gbp_gcc_message_parse (const gchar   *line,
+                                GbpGccMessage *msg);
+
+G_END_DECLS
+
+#endif /* GBP_GCC_MESSAGE_H */
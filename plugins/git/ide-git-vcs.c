@@ -35,6 +35,14 @@ struct _IdeGitVcs
   GgitRepository *repository;
   GgitRepository *change_monitor_repository;
 
+  /*
+   * libgit2 repositories are not safe to share across threads, so ignore
+   * checks (which may come from indexers) get their own instance that is
+   * only touched while holding ignore_mutex.
+   */
+  GgitRepository *ignore_repository;
+  GMutex          ignore_mutex;
+
   GFile          *working_directory;
   GFileMonitor   *monitor;
 
@@ -325,6 +333,7 @@ ide_git_vcs_reload_worker (GTask        *task,
   IdeGitVcs *self = source_object;
   g_autoptr(GgitRepository) repository1 = NULL;
   g_autoptr(GgitRepository) repository2 = NULL;
+  g_autoptr(GgitRepository) repository3 = NULL;
   GError *error = NULL;
 
   IDE_ENTRY;
@@ -334,7 +343,8 @@ ide_git_vcs_reload_worker (GTask        *task,
   g_assert (!cancellable || G_IS_CANCELLABLE (cancellable));
 
   if (!(repository1 = ide_git_vcs_load (self, &error)) ||
-      !(repository2 = ide_git_vcs_load (self, &error)))
+      !(repository2 = ide_git_vcs_load (self, &error)) ||
+      !(repository3 = ide_git_vcs_load (self, &error)))
     {
       g_debug ("%s", error->message);
       g_task_return_error (task, error);
@@ -344,6 +354,10 @@ ide_git_vcs_reload_worker (GTask        *task,
   g_set_object (&self->repository, repository1);
   g_set_object (&self->change_monitor_repository, repository2);
 
+  g_mutex_lock (&self->ignore_mutex);
+  g_set_object (&self->ignore_repository, repository3);
+  g_mutex_unlock (&self->ignore_mutex);
+
   if (!ide_git_vcs_load_monitor (self, &error))
     {
       g_task_return_error (task, error);
@@ -414,7 +428,12 @@ ide_git_vcs_is_ignored (IdeVcs  *vcs,
     return TRUE;
 
   if (name != NULL)
-    return ggit_repository_path_is_ignored (self->repository, name, error);
+    {
+      g_mutex_lock (&self->ignore_mutex);
+      if (self->ignore_repository != NULL)
+        ret = ggit_repository_path_is_ignored (self->ignore_repository, name, error);
+      g_mutex_unlock (&self->ignore_mutex);
+    }
 
   return ret;
 }
@@ -478,11 +497,25 @@ ide_git_vcs_dispose (GObject *object)
   g_clear_object (&self->repository);
   g_clear_object (&self->working_directory);
 
+  g_mutex_lock (&self->ignore_mutex);
+  g_clear_object (&self->ignore_repository);
+  g_mutex_unlock (&self->ignore_mutex);
+
   G_OBJECT_CLASS (ide_git_vcs_parent_class)->dispose (object);
 
   IDE_EXIT;
 }
 
+static void
+ide_git_vcs_finalize (GObject *object)
+{
+  IdeGitVcs *self = (IdeGitVcs *)object;
+
+  g_mutex_clear (&self->ignore_mutex);
+
+  G_OBJECT_CLASS (ide_git_vcs_parent_class)->finalize (object);
+}
+
 static void
 ide_git_vcs_get_property (GObject    *object,
                           guint       prop_id,
@@ -526,6 +559,7 @@ ide_git_vcs_class_init (IdeGitVcsClass *klass)
   GObjectClass *object_class = G_OBJECT_CLASS (klass);
 
   object_class->dispose = ide_git_vcs_dispose;
+  object_class->finalize = ide_git_vcs_finalize;
   object_class->get_property = ide_git_vcs_get_property;
 
   g_object_class_override_property (object_class, PROP_BRANCH_NAME, "branch-name");
@@ -575,6 +609,7 @@ ide_git_vcs_class_init (IdeGitVcsClass *klass)
 static void
 ide_git_vcs_init (IdeGitVcs *self)
 {
+  g_mutex_init (&self->ignore_mutex);
 }
 
 static void
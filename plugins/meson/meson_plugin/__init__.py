@@ -45,6 +45,7 @@ class MesonBuildSystem(Ide.Object, Ide.BuildSystem, Gio.AsyncInitable):
 
         self._cached_config = None
         self._cached_builder = None
+        self._compile_commands = None
 
         # TODO: Be async here also
         project_file = self.get_context().get_project_file()
@@ -83,36 +84,23 @@ class MesonBuildSystem(Ide.Object, Ide.BuildSystem, Gio.AsyncInitable):
             task.return_error(GLib.Error('Meson: Project must be built before we can get flags'))
             return
 
-        def extract_flags(command: str):
-            flags = GLib.shell_parse_argv(command)[1] # Raises on failure
-            return [flag for flag in flags if flag.startswith(('-I', '-isystem', '-W', '-D'))]
+        commands_file = builder._get_build_dir().get_child('compile_commands.json')
+        if not self._compile_commands or not self._compile_commands.get_file().equal(commands_file):
+            self._compile_commands = Ide.CompileCommands.new(self.get_context(), commands_file)
 
-        def build_flags_thread():
-            commands_file = path.join(builder._get_build_dir().get_path(), 'compile_commands.json')
+        def load_cb(compile_commands, result):
             try:
-                with open(commands_file) as f:
-                    commands = json.loads(f.read(), encoding='utf-8')
-            except (json.JSONDecodeError, FileNotFoundError, UnicodeDecodeError) as e:
-                task.return_error(GLib.Error('Failed to decode meson json: {}'.format(e)))
-                return
-
-            infile = ifile.get_path()
-            for c in commands:
-                filepath = path.normpath(path.join(c['directory'], c['file']))
-                if filepath == infile:
-                    try:
-                        task.build_flags = extract_flags(c['command'])
-                    except GLib.Error as e:
-                        task.return_error(e)
-                        return
-                    break
-            else:
+                compile_commands.load_finish(result)
+                task.build_flags, _ = compile_commands.lookup(ifile)
+            except GLib.Error as e:
+                if not e.matches(Gio.io_error_quark(), Gio.IOErrorEnum.NOT_FOUND):
+                    task.return_error(e)
+                    return
                 print('Meson: Warning: No flags found')
 
             task.return_boolean(True)
 
-        thread = threading.Thread(target=build_flags_thread)
-        thread.start()
+        self._compile_commands.load_async(cancellable, load_cb)
 
     def do_get_build_flags_finish(self, result):
         if result.propagate_boolean():
@@ -29,11 +29,35 @@ struct _GbProjectTreeBuilder
 
   GSettings      *file_chooser_settings;
 
+  GHashTable     *loading;
+
   guint           sort_directories_first : 1;
 };
 
+typedef struct
+{
+  GbProjectTreeBuilder *self;
+  IdeTreeNode          *node;
+  IdeTreeNode          *placeholder;
+  GFile                *file;
+  IdeVcs               *vcs;
+  GFileEnumerator      *enumerator;
+  GCancellable         *cancellable;
+  guint                 count;
+  guint                 show_ignored_files : 1;
+} LoadState;
+
+#define BUILD_FILE_BATCH_SIZE 250
+
 G_DEFINE_TYPE (GbProjectTreeBuilder, gb_project_tree_builder, IDE_TYPE_TREE_BUILDER)
 
+enum {
+  LOADED,
+  LAST_SIGNAL
+};
+
+static guint signals [LAST_SIGNAL];
+
 IdeTreeBuilder *
 gb_project_tree_builder_new (void)
 {
@@ -103,112 +127,362 @@ compare_nodes_func (IdeTreeNode *a,
                     IdeTreeNode *b,
                     gpointer     user_data)
 {
-  GbProjectFile *file_a = GB_PROJECT_FILE (ide_tree_node_get_item (a));
-  GbProjectFile *file_b = GB_PROJECT_FILE (ide_tree_node_get_item (b));
+  GObject *item_a = ide_tree_node_get_item (a);
+  GObject *item_b = ide_tree_node_get_item (b);
   GbProjectTreeBuilder *self = user_data;
 
+  /*
+   * Placeholder nodes such as "Loading…" have no file and always sort
+   * after the real files.
+   */
+  if (!GB_IS_PROJECT_FILE (item_a) || !GB_IS_PROJECT_FILE (item_b))
+    return GB_IS_PROJECT_FILE (item_b) - GB_IS_PROJECT_FILE (item_a);
+
   if (self->sort_directories_first)
-    return gb_project_file_compare_directories_first (file_a, file_b);
+    return gb_project_file_compare_directories_first (GB_PROJECT_FILE (item_a),
+                                                      GB_PROJECT_FILE (item_b));
   else
-    return gb_project_file_compare (file_a, file_b);
+    return gb_project_file_compare (GB_PROJECT_FILE (item_a), GB_PROJECT_FILE (item_b));
 }
 
 static void
-build_file (GbProjectTreeBuilder *self,
-            IdeTreeNode          *node)
+load_state_free (LoadState *state)
 {
-  g_autoptr(GFileEnumerator) enumerator = NULL;
-  GbProjectFile *project_file;
-  gpointer file_info_ptr;
-  IdeVcs *vcs;
-  GFile *file;
-  IdeTree *tree;
-  gint count = 0;
-  gboolean show_ignored_files;
+  g_assert (state != NULL);
+
+  if (state->self != NULL &&
+      g_hash_table_lookup (state->self->loading, state->node) == state)
+    g_hash_table_remove (state->self->loading, state->node);
+
+  g_clear_object (&state->self);
+  g_clear_object (&state->node);
+  g_clear_object (&state->placeholder);
+  g_clear_object (&state->file);
+  g_clear_object (&state->vcs);
+  g_clear_object (&state->enumerator);
+  g_clear_object (&state->cancellable);
+  g_slice_free (LoadState, state);
+}
 
-  g_return_if_fail (GB_IS_PROJECT_TREE_BUILDER (self));
-  g_return_if_fail (IDE_IS_TREE_NODE (node));
+static void
+load_state_complete (LoadState *state)
+{
+  g_assert (state != NULL);
 
-  project_file = GB_PROJECT_FILE (ide_tree_node_get_item (node));
+  /*
+   * If we didn't add any children to this node, insert an empty node to
+   * notify the user that nothing was found.
+   */
+  if (state->count == 0)
+    {
+      IdeTreeNode *child;
 
-  tree = ide_tree_builder_get_tree (IDE_TREE_BUILDER (self));
-  show_ignored_files = gb_project_tree_get_show_ignored_files (GB_PROJECT_TREE (tree));
+      child = g_object_new (IDE_TYPE_TREE_NODE,
+                            "icon-name", NULL,
+                            "text", _("Empty"),
+                            "use-dim-label", TRUE,
+                            NULL);
+      ide_tree_node_append (state->node, child);
+    }
 
-  vcs = get_vcs (node);
+  ide_tree_node_remove (state->node, state->placeholder);
+
+  /* Drop our entry first so that handlers see the node as loaded. */
+  g_hash_table_remove (state->self->loading, state->node);
+  g_signal_emit (state->self, signals [LOADED], 0, state->node);
+
+  load_state_free (state);
+}
+
+typedef struct
+{
+  GFile   *directory;
+  IdeVcs  *vcs;
+  GList   *files;
+  GArray  *ignored;
+} IgnoreBatch;
+
+static void
+ignore_batch_free (gpointer data)
+{
+  IgnoreBatch *batch = data;
+
+  g_clear_object (&batch->directory);
+  g_clear_object (&batch->vcs);
+  g_list_free_full (batch->files, g_object_unref);
+  g_clear_pointer (&batch->ignored, g_array_unref);
+  g_slice_free (IgnoreBatch, batch);
+}
+
+static void
+build_file_next_files_cb (GObject      *object,
+                          GAsyncResult *result,
+                          gpointer      user_data);
+
+static void
+ignore_batch_worker (GTask        *task,
+                     gpointer      source_object,
+                     gpointer      task_data,
+                     GCancellable *cancellable)
+{
+  IgnoreBatch *batch = task_data;
+  GList *iter;
+
+  g_assert (G_IS_TASK (task));
+  g_assert (batch != NULL);
 
   /*
-   * TODO: Make this all async.
+   * Checking ignores may hit the disk (and the VCS), so do it here rather
+   * than stalling the main loop for every file in large directories.
    */
+  for (iter = batch->files; iter != NULL; iter = iter->next)
+    {
+      GFileInfo *file_info = iter->data;
+      g_autoptr(GFile) file = NULL;
+      gboolean ignored;
 
-  if (!gb_project_file_get_is_directory (project_file))
-    return;
+      if (g_cancellable_is_cancelled (cancellable))
+        break;
 
-  file = gb_project_file_get_file (project_file);
+      file = g_file_get_child (batch->directory, g_file_info_get_name (file_info));
+      ignored = ide_vcs_is_ignored (batch->vcs, file, NULL);
+      g_array_append_val (batch->ignored, ignored);
+    }
 
-  enumerator = g_file_enumerate_children (file,
-                                          G_FILE_ATTRIBUTE_STANDARD_NAME","
-                                          G_FILE_ATTRIBUTE_STANDARD_DISPLAY_NAME","
-                                          G_FILE_ATTRIBUTE_STANDARD_TYPE,
-                                          G_FILE_QUERY_INFO_NONE,
-                                          NULL,
-                                          NULL);
+  g_task_return_boolean (task, TRUE);
+}
 
-  if (enumerator == NULL)
-    return;
+static void
+ignore_batch_cb (GObject      *object,
+                 GAsyncResult *result,
+                 gpointer      user_data)
+{
+  g_autoptr(GPtrArray) children = NULL;
+  g_autoptr(GError) error = NULL;
+  LoadState *state = user_data;
+  IgnoreBatch *batch;
+  GtkTreeIter iter;
+  GList *list;
+  guint i;
+
+  g_assert (G_IS_TASK (result));
+  g_assert (state != NULL);
+
+  if (!g_task_propagate_boolean (G_TASK (result), &error) ||
+      !ide_tree_node_get_iter (state->node, &iter))
+    {
+      load_state_free (state);
+      return;
+    }
+
+  batch = g_task_get_task_data (G_TASK (result));
+  children = g_ptr_array_new_with_free_func (g_object_unref);
 
-  while ((file_info_ptr = g_file_enumerator_next_file (enumerator, NULL, NULL)))
+  for (list = batch->files, i = 0; list != NULL; list = list->next, i++)
     {
-      g_autoptr(GFileInfo) item_file_info = file_info_ptr;
+      GFileInfo *item_file_info = list->data;
       g_autoptr(GFile) item_file = NULL;
       g_autoptr(GbProjectFile) item = NULL;
       IdeTreeNode *child;
-      const gchar *name;
-      const gchar *display_name;
-      const gchar *icon_name;
       gboolean ignored;
 
-      name = g_file_info_get_name (item_file_info);
-      item_file = g_file_get_child (file, name);
+      g_assert (i < batch->ignored->len);
 
-      ignored = ide_vcs_is_ignored (vcs, item_file, NULL);
-      if (ignored && !show_ignored_files)
+      ignored = g_array_index (batch->ignored, gboolean, i);
+      if (ignored && !state->show_ignored_files)
         continue;
 
+      item_file = g_file_get_child (state->file, g_file_info_get_name (item_file_info));
       item = gb_project_file_new (item_file, item_file_info);
 
-      display_name = gb_project_file_get_display_name (item);
-      icon_name = gb_project_file_get_icon_name (item);
-
       child = g_object_new (IDE_TYPE_TREE_NODE,
-                            "icon-name", icon_name,
-                            "text", display_name,
+                            "icon-name", gb_project_file_get_icon_name (item),
+                            "text", gb_project_file_get_display_name (item),
                             "item", item,
                             "use-dim-label", ignored,
                             NULL);
 
-      ide_tree_node_insert_sorted (node, child, compare_nodes_func, self);
-
       if (g_file_info_get_file_type (item_file_info) == G_FILE_TYPE_DIRECTORY)
         ide_tree_node_set_children_possible (child, TRUE);
 
-      count++;
+      g_ptr_array_add (children, g_object_ref_sink (child));
     }
 
-  /*
-   * If we didn't add any children to this node, insert an empty node to
-   * notify the user that nothing was found.
-   */
-  if (count == 0)
+  ide_tree_node_insert_sorted_batch (state->node, children, compare_nodes_func, state->self);
+  state->count += children->len;
+
+  g_file_enumerator_next_files_async (state->enumerator,
+                                      BUILD_FILE_BATCH_SIZE,
+                                      G_PRIORITY_LOW,
+                                      state->cancellable,
+                                      build_file_next_files_cb,
+                                      state);
+}
+
+static void
+build_file_next_files_cb (GObject      *object,
+                          GAsyncResult *result,
+                          gpointer      user_data)
+{
+  GFileEnumerator *enumerator = (GFileEnumerator *)object;
+  g_autoptr(GTask) task = NULL;
+  g_autoptr(GError) error = NULL;
+  LoadState *state = user_data;
+  IgnoreBatch *batch;
+  GtkTreeIter iter;
+  GList *files;
+
+  g_assert (G_IS_FILE_ENUMERATOR (enumerator));
+  g_assert (state != NULL);
+
+  files = g_file_enumerator_next_files_finish (enumerator, result, &error);
+
+  if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
     {
-      IdeTreeNode *child;
+      load_state_free (state);
+      return;
+    }
 
-      child = g_object_new (IDE_TYPE_TREE_NODE,
-                            "icon-name", NULL,
-                            "text", _("Empty"),
-                            "use-dim-label", TRUE,
-                            NULL);
-      ide_tree_node_append (node, child);
+  /* The node was removed from the tree (or rebuilt) while we were loading. */
+  if (!ide_tree_node_get_iter (state->node, &iter))
+    {
+      g_list_free_full (files, g_object_unref);
+      load_state_free (state);
+      return;
+    }
+
+  if (files == NULL)
+    {
+      load_state_complete (state);
+      return;
+    }
+
+  batch = g_slice_new0 (IgnoreBatch);
+  batch->directory = g_object_ref (state->file);
+  batch->vcs = g_object_ref (state->vcs);
+  batch->files = files;
+  batch->ignored = g_array_sized_new (FALSE, FALSE, sizeof (gboolean), BUILD_FILE_BATCH_SIZE);
+
+  task = g_task_new (state->self, state->cancellable, ignore_batch_cb, state);
+  g_task_set_source_tag (task, build_file_next_files_cb);
+  g_task_set_task_data (task, batch, ignore_batch_free);
+  ide_thread_pool_push_task_with_priority (IDE_THREAD_POOL_INDEXER,
+                                           IDE_THREAD_POOL_PRIORITY_VISIBLE,
+                                           task,
+                                           ignore_batch_worker);
+}
+
+static void
+build_file_enumerate_cb (GObject      *object,
+                         GAsyncResult *result,
+                         gpointer      user_data)
+{
+  GFile *file = (GFile *)object;
+  g_autoptr(GError) error = NULL;
+  LoadState *state = user_data;
+
+  g_assert (G_IS_FILE (file));
+  g_assert (state != NULL);
+
+  state->enumerator = g_file_enumerate_children_finish (file, result, &error);
+
+  if (state->enumerator == NULL)
+    {
+      GtkTreeIter iter;
+
+      if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED) &&
+          ide_tree_node_get_iter (state->node, &iter))
+        load_state_complete (state);
+      else
+        load_state_free (state);
+      return;
     }
+
+  g_file_enumerator_next_files_async (state->enumerator,
+                                      BUILD_FILE_BATCH_SIZE,
+                                      G_PRIORITY_LOW,
+                                      state->cancellable,
+                                      build_file_next_files_cb,
+                                      state);
+}
+
+static void
+build_file (GbProjectTreeBuilder *self,
+            IdeTreeNode          *node)
+{
+  GbProjectFile *project_file;
+  LoadState *state;
+  IdeTree *tree;
+
+  g_return_if_fail (GB_IS_PROJECT_TREE_BUILDER (self));
+  g_return_if_fail (IDE_IS_TREE_NODE (node));
+
+  project_file = GB_PROJECT_FILE (ide_tree_node_get_item (node));
+
+  if (!gb_project_file_get_is_directory (project_file))
+    return;
+
+  /* A rebuild of this node supersedes any load that is still in flight. */
+  if ((state = g_hash_table_lookup (self->loading, node)))
+    {
+      g_cancellable_cancel (state->cancellable);
+      g_hash_table_remove (self->loading, node);
+    }
+
+  tree = ide_tree_builder_get_tree (IDE_TREE_BUILDER (self));
+
+  state = g_slice_new0 (LoadState);
+  state->self = g_object_ref (self);
+  state->node = g_object_ref (node);
+  state->file = g_object_ref (gb_project_file_get_file (project_file));
+  state->vcs = g_object_ref (get_vcs (node));
+  state->cancellable = g_cancellable_new ();
+  state->show_ignored_files = gb_project_tree_get_show_ignored_files (GB_PROJECT_TREE (tree));
+
+  /*
+   * Enumerating large directories can take a while, so children are
+   * loaded asynchronously and inserted in batches. The placeholder keeps
+   * the row expanded until the first batch arrives.
+   */
+  state->placeholder = g_object_new (IDE_TYPE_TREE_NODE,
+                                     "icon-name", NULL,
+                                     "text", _("Loading…"),
+                                     "use-dim-label", TRUE,
+                                     NULL);
+  g_object_ref_sink (state->placeholder);
+  ide_tree_node_append (node, state->placeholder);
+
+  g_hash_table_insert (self->loading, node, state);
+
+  g_file_enumerate_children_async (state->file,
+                                   G_FILE_ATTRIBUTE_STANDARD_NAME","
+                                   G_FILE_ATTRIBUTE_STANDARD_DISPLAY_NAME","
+                                   G_FILE_ATTRIBUTE_STANDARD_TYPE,
+                                   G_FILE_QUERY_INFO_NONE,
+                                   G_PRIORITY_LOW,
+                                   state->cancellable,
+                                   build_file_enumerate_cb,
+                                   state);
+}
+
+/**
+ * gb_project_tree_builder_is_loading:
+ * @self: A #GbProjectTreeBuilder
+ * @node: A #IdeTreeNode
+ *
+ * Checks if the children of @node are still being loaded. When loading
+ * completes, the #GbProjectTreeBuilder::loaded signal is emitted.
+ *
+ * Returns: %TRUE if @node is still being populated.
+ */
+gboolean
+gb_project_tree_builder_is_loading (GbProjectTreeBuilder *self,
+                                    IdeTreeNode          *node)
+{
+  g_return_val_if_fail (GB_IS_PROJECT_TREE_BUILDER (self), FALSE);
+  g_return_val_if_fail (IDE_IS_TREE_NODE (node), FALSE);
+
+  return g_hash_table_contains (self->loading, node);
 }
 
 static void
@@ -385,6 +659,7 @@ gb_project_tree_builder_finalize (GObject *object)
   GbProjectTreeBuilder *self = (GbProjectTreeBuilder *)object;
 
   g_clear_object (&self->file_chooser_settings);
+  g_clear_pointer (&self->loading, g_hash_table_unref);
 
   G_OBJECT_CLASS (gb_project_tree_builder_parent_class)->finalize (object);
 }
@@ -400,11 +675,27 @@ gb_project_tree_builder_class_init (GbProjectTreeBuilderClass *klass)
   tree_builder_class->build_node = gb_project_tree_builder_build_node;
   tree_builder_class->node_activated = gb_project_tree_builder_node_activated;
   tree_builder_class->node_popup = gb_project_tree_builder_node_popup;
+
+  /**
+   * GbProjectTreeBuilder::loaded:
+   * @self: A #GbProjectTreeBuilder
+   * @node: The #IdeTreeNode that finished loading
+   *
+   * This signal is emitted when all of the children of a directory node
+   * have been inserted into the tree.
+   */
+  signals [LOADED] =
+    g_signal_new ("loaded",
+                  G_TYPE_FROM_CLASS (klass),
+                  G_SIGNAL_RUN_LAST,
+                  0, NULL, NULL, NULL,
+                  G_TYPE_NONE, 1, IDE_TYPE_TREE_NODE);
 }
 
 static void
 gb_project_tree_builder_init (GbProjectTreeBuilder *self)
 {
+  self->loading = g_hash_table_new (NULL, NULL);
   self->file_chooser_settings = g_settings_new ("org.gtk.Settings.FileChooser");
   self->sort_directories_first = g_settings_get_boolean (self->file_chooser_settings,
                                                          "sort-directories-first");
@@ -27,7 +27,9 @@ G_BEGIN_DECLS
 
 G_DECLARE_FINAL_TYPE (GbProjectTreeBuilder, gb_project_tree_builder, GB, PROJECT_TREE_BUILDER, IdeTreeBuilder)
 
-IdeTreeBuilder *gb_project_tree_builder_new (void);
+IdeTreeBuilder *gb_project_tree_builder_new        (void);
+gboolean        gb_project_tree_builder_is_loading (GbProjectTreeBuilder *self,
+                                                    IdeTreeNode          *node);
 
 G_END_DECLS
 
@@ -21,16 +21,24 @@
 
 #include <ide.h>
 
+#include "gb-project-tree-builder.h"
+
 G_BEGIN_DECLS
 
 struct _GbProjectTree
 {
-  IdeTree     parent_instance;
+  IdeTree               parent_instance;
+
+  GSettings            *settings;
+  GbProjectTreeBuilder *builder;
 
-  GSettings *settings;
+  /* State for a reveal that is waiting on a directory to load */
+  gchar               **reveal_parts;
+  guint                 reveal_pos;
+  IdeTreeNode          *reveal_node;
 
-  guint      expanded_in_new : 1;
-  guint      show_ignored_files : 1;
+  guint                 expanded_in_new : 1;
+  guint                 show_ignored_files : 1;
 };
 
 G_END_DECLS
@@ -37,6 +37,10 @@ enum {
 
 static GParamSpec *properties [LAST_PROP];
 
+static void gb_project_tree_builder_loaded (GbProjectTree        *self,
+                                            IdeTreeNode          *node,
+                                            GbProjectTreeBuilder *builder);
+
 GtkWidget *
 gb_project_tree_new (void)
 {
@@ -222,6 +226,8 @@ gb_project_tree_finalize (GObject *object)
 {
   GbProjectTree *self = (GbProjectTree *)object;
 
+  g_clear_pointer (&self->reveal_parts, g_strfreev);
+  g_clear_object (&self->reveal_node);
   g_clear_object (&self->settings);
 
   G_OBJECT_CLASS (gb_project_tree_parent_class)->finalize (object);
@@ -304,6 +310,12 @@ gb_project_tree_init (GbProjectTree *self)
                    G_SETTINGS_BIND_DEFAULT);
 
   builder = gb_project_tree_builder_new ();
+  self->builder = GB_PROJECT_TREE_BUILDER (builder);
+  g_signal_connect_object (builder,
+                           "loaded",
+                           G_CALLBACK (gb_project_tree_builder_loaded),
+                           self,
+                           G_CONNECT_SWAPPED);
   ide_tree_add_builder (IDE_TREE (self), builder);
 
   g_signal_connect (self,
@@ -385,21 +397,90 @@ find_files_node (IdeTree     *tree,
   return GB_IS_PROJECT_FILE (item);
 }
 
+static void
+gb_project_tree_clear_reveal (GbProjectTree *self)
+{
+  g_assert (GB_IS_PROJECT_TREE (self));
+
+  g_clear_pointer (&self->reveal_parts, g_strfreev);
+  g_clear_object (&self->reveal_node);
+  self->reveal_pos = 0;
+}
+
+static void
+gb_project_tree_continue_reveal (GbProjectTree *self)
+{
+  IdeTreeNode *node;
+
+  g_assert (GB_IS_PROJECT_TREE (self));
+  g_assert (self->reveal_parts != NULL);
+  g_assert (self->reveal_node != NULL);
+
+  node = self->reveal_node;
+
+  for (; self->reveal_parts [self->reveal_pos]; self->reveal_pos++)
+    {
+      IdeTreeNode *child;
+
+      child = ide_tree_find_child_node (IDE_TREE (self), node, find_child_node,
+                                        self->reveal_parts [self->reveal_pos]);
+
+      if (child == NULL)
+        {
+          /*
+           * Directories are populated asynchronously, so wait for the
+           * builder to finish loading before giving up on this path.
+           */
+          if (gb_project_tree_builder_is_loading (self->builder, node))
+            {
+              g_set_object (&self->reveal_node, node);
+              return;
+            }
+
+          gb_project_tree_clear_reveal (self);
+          return;
+        }
+
+      node = child;
+    }
+
+  ide_tree_expand_to_node (IDE_TREE (self), node);
+  ide_tree_scroll_to_node (IDE_TREE (self), node);
+  ide_tree_node_select (node);
+
+  gb_project_tree_clear_reveal (self);
+
+  ide_workbench_focus (ide_widget_get_workbench (GTK_WIDGET (self)), GTK_WIDGET (self));
+}
+
+static void
+gb_project_tree_builder_loaded (GbProjectTree        *self,
+                                IdeTreeNode          *node,
+                                GbProjectTreeBuilder *builder)
+{
+  g_assert (GB_IS_PROJECT_TREE (self));
+  g_assert (IDE_IS_TREE_NODE (node));
+  g_assert (GB_IS_PROJECT_TREE_BUILDER (builder));
+
+  if (node == self->reveal_node)
+    gb_project_tree_continue_reveal (self);
+}
+
 void
 gb_project_tree_reveal (GbProjectTree *self,
                         GFile         *file)
 {
   g_autofree gchar *relpath = NULL;
-  g_auto(GStrv) parts = NULL;
   IdeContext *context;
   IdeTreeNode *node;
   IdeVcs *vcs;
   GFile *workdir;
-  guint i;
 
   g_return_if_fail (GB_IS_PROJECT_TREE (self));
   g_return_if_fail (G_IS_FILE (file));
 
+  gb_project_tree_clear_reveal (self);
+
   context = gb_project_tree_get_context (self);
   g_assert (IDE_IS_CONTEXT (context));
 
@@ -417,18 +498,8 @@ gb_project_tree_reveal (GbProjectTree *self,
   if (node == NULL)
     return;
 
-  parts = g_strsplit (relpath, G_DIR_SEPARATOR_S, 0);
-
-  for (i = 0; parts [i]; i++)
-    {
-      node = ide_tree_find_child_node (IDE_TREE (self), node, find_child_node, parts [i]);
-      if (node == NULL)
-        return;
-    }
-
-  ide_tree_expand_to_node (IDE_TREE (self), node);
-  ide_tree_scroll_to_node (IDE_TREE (self), node);
-  ide_tree_node_select (node);
+  self->reveal_parts = g_strsplit (relpath, G_DIR_SEPARATOR_S, 0);
+  self->reveal_node = g_object_ref (node);
 
-  ide_workbench_focus (ide_widget_get_workbench (GTK_WIDGET (self)), GTK_WIDGET (self));
+  gb_project_tree_continue_reveal (self);
 }
@@ -0,0 +1,489 @@
+/* gb-sysmon-counter-table.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define G_LOG_DOMAIN "gb-sysmon-counter-table"
+
+#include <egg-counter.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "gb-sysmon-counter-table.h"
+
+/*
+ * GbSysmonCounterTable is an RgTable with a single column that is fed from
+ * one of Builder's own metrics. Counters and histograms are read straight
+ * out of the default EggCounterArena; reading them only sums the per-cpu
+ * cells, so sampling never contends with the threads updating them.
+ */
+
+#define DEFAULT_TIMESPAN    (G_USEC_PER_SEC * 30)
+#define DEFAULT_MAX_SAMPLES 150
+#define HEADROOM            1.25
+
+typedef enum
+{
+  KIND_COUNTER,
+  KIND_HISTOGRAM,
+  KIND_MAIN_LOOP,
+  KIND_RSS,
+} Kind;
+
+struct _GbSysmonCounterTable
+{
+  RgTable       parent_instance;
+
+  Kind          kind;
+  gchar        *category;
+  gchar        *name;
+  gdouble       percentile;
+
+  /* Resolved lazily, plugins may register counters after we are created */
+  EggCounter   *counter;
+  EggHistogram *histogram;
+  gint64        last_buckets [EGG_HISTOGRAM_N_BUCKETS];
+
+  gint64        expected;
+  gdouble       value;
+
+  guint         poll_source;
+  guint         poll_interval_msec;
+};
+
+G_DEFINE_TYPE (GbSysmonCounterTable, gb_sysmon_counter_table, RG_TYPE_TABLE)
+
+enum {
+  PROP_0,
+  PROP_VALUE,
+  LAST_PROP
+};
+
+static GParamSpec *properties [LAST_PROP];
+
+static void
+find_counter_cb (EggCounter *counter,
+                 gpointer    user_data)
+{
+  GbSysmonCounterTable *self = user_data;
+
+  if (self->counter == NULL &&
+      g_strcmp0 (counter->category, self->category) == 0 &&
+      g_strcmp0 (counter->name, self->name) == 0)
+    self->counter = counter;
+}
+
+static void
+find_histogram_cb (EggHistogram *histogram,
+                   gpointer      user_data)
+{
+  GbSysmonCounterTable *self = user_data;
+
+  if (self->histogram == NULL &&
+      g_strcmp0 (histogram->category, self->category) == 0 &&
+      g_strcmp0 (histogram->name, self->name) == 0)
+    self->histogram = histogram;
+}
+
+static gdouble
+gb_sysmon_counter_table_sample_counter (GbSysmonCounterTable *self)
+{
+  g_assert (GB_IS_SYSMON_COUNTER_TABLE (self));
+
+  if (self->counter == NULL)
+    egg_counter_arena_foreach (egg_counter_arena_get_default (), find_counter_cb, self);
+
+  if (self->counter == NULL)
+    return 0.0;
+
+  return egg_counter_get (self->counter);
+}
+
+/*
+ * The histogram is cumulative for the life of the process, which would make
+ * the graph flatten out over time. Instead, we compute the percentile over
+ * the values recorded since the previous sample. The result is in
+ * milliseconds, since histograms are recorded in microseconds.
+ */
+static gdouble
+gb_sysmon_counter_table_sample_histogram (GbSysmonCounterTable *self)
+{
+  gint64 counts [EGG_HISTOGRAM_N_BUCKETS] = { 0 };
+  gint64 total = 0;
+  gint64 target;
+  gint64 seen = 0;
+  guint i;
+
+  g_assert (GB_IS_SYSMON_COUNTER_TABLE (self));
+
+  if (self->histogram == NULL)
+    {
+      egg_counter_arena_foreach_histogram (egg_counter_arena_get_default (), find_histogram_cb, self);
+
+      if (self->histogram == NULL)
+        return 0.0;
+
+      for (i = 0; i < EGG_HISTOGRAM_N_BUCKETS; i++)
+        {
+          if (self->histogram->buckets [i].values != NULL)
+            self->last_buckets [i] = egg_counter_get (&self->histogram->buckets [i]);
+        }
+
+      return 0.0;
+    }
+
+  for (i = 0; i < EGG_HISTOGRAM_N_BUCKETS; i++)
+    {
+      gint64 value;
+
+      if (self->histogram->buckets [i].values == NULL)
+        continue;
+
+      value = egg_counter_get (&self->histogram->buckets [i]);
+      counts [i] = MAX (0, value - self->last_buckets [i]);
+      self->last_buckets [i] = value;
+      total += counts [i];
+    }
+
+  if (total == 0)
+    return 0.0;
+
+  target = MAX (1, (gint64)((total * self->percentile / 100.0) + 0.5));
+
+  for (i = 0; i < EGG_HISTOGRAM_N_BUCKETS - 1; i++)
+    {
+      seen += counts [i];
+
+      if (seen >= target)
+        return (i == 0) ? 0.0 : (G_GINT64_CONSTANT (1) << i) / 1000.0;
+    }
+
+  return (G_GINT64_CONSTANT (1) << (EGG_HISTOGRAM_N_BUCKETS - 2)) / 1000.0;
+}
+
+/*
+ * The poll timeout doubles as the main loop probe. We know when it should
+ * have been dispatched, so any delay past that is time the main loop spent
+ * doing something else.
+ */
+static gdouble
+gb_sysmon_counter_table_sample_main_loop (GbSysmonCounterTable *self)
+{
+  gint64 now;
+
+  g_assert (GB_IS_SYSMON_COUNTER_TABLE (self));
+
+  now = g_get_monotonic_time ();
+
+  if (self->expected == 0 || now < self->expected)
+    return 0.0;
+
+  return (now - self->expected) / 1000.0;
+}
+
+static gdouble
+gb_sysmon_counter_table_sample_rss (GbSysmonCounterTable *self)
+{
+#ifdef __linux__
+  g_autofree gchar *contents = NULL;
+  gulong size;
+  gulong resident;
+
+  g_assert (GB_IS_SYSMON_COUNTER_TABLE (self));
+
+  if (!g_file_get_contents ("/proc/self/statm", &contents, NULL, NULL) ||
+      sscanf (contents, "%lu %lu", &size, &resident) != 2)
+    return 0.0;
+
+  return (gdouble)resident * sysconf (_SC_PAGESIZE) / (1024.0 * 1024.0);
+#else
+  return 0.0;
+#endif
+}
+
+static void
+gb_sysmon_counter_table_autoscale (GbSysmonCounterTable *self)
+{
+  RgTableIter iter;
+  gdouble max_value = 0.0;
+
+  g_assert (GB_IS_SYSMON_COUNTER_TABLE (self));
+
+  if (rg_table_get_iter_first (RG_TABLE (self), &iter))
+    {
+      do
+        {
+          gdouble value = 0.0;
+
+          rg_table_iter_get (&iter, 0, &value, -1);
+          max_value = MAX (max_value, value);
+        }
+      while (rg_table_iter_next (&iter));
+    }
+
+  g_object_set (self, "value-max", MAX (1.0, max_value * HEADROOM), NULL);
+}
+
+static gboolean
+gb_sysmon_counter_table_poll_cb (gpointer user_data)
+{
+  GbSysmonCounterTable *self = user_data;
+  RgTableIter iter;
+  gdouble value = 0.0;
+
+  g_assert (GB_IS_SYSMON_COUNTER_TABLE (self));
+
+  switch (self->kind)
+    {
+    case KIND_COUNTER:
+      value = gb_sysmon_counter_table_sample_counter (self);
+      break;
+
+    case KIND_HISTOGRAM:
+      value = gb_sysmon_counter_table_sample_histogram (self);
+      break;
+
+    case KIND_MAIN_LOOP:
+      value = gb_sysmon_counter_table_sample_main_loop (self);
+      break;
+
+    case KIND_RSS:
+      value = gb_sysmon_counter_table_sample_rss (self);
+      break;
+
+    default:
+      g_assert_not_reached ();
+    }
+
+  rg_table_push (RG_TABLE (self), &iter, g_get_monotonic_time ());
+  rg_table_iter_set (&iter, 0, value, -1);
+
+  gb_sysmon_counter_table_autoscale (self);
+
+  if (self->value != value)
+    {
+      self->value = value;
+      g_object_notify_by_pspec (G_OBJECT (self), properties [PROP_VALUE]);
+    }
+
+  self->expected = g_get_monotonic_time () + (self->poll_interval_msec * 1000L);
+
+  return G_SOURCE_CONTINUE;
+}
+
+static void
+gb_sysmon_counter_table_start (GbSysmonCounterTable *self)
+{
+  gint64 timespan;
+  guint max_samples;
+
+  g_assert (GB_IS_SYSMON_COUNTER_TABLE (self));
+  g_assert (self->poll_source == 0);
+
+  max_samples = rg_table_get_max_samples (RG_TABLE (self));
+  timespan = rg_table_get_timespan (RG_TABLE (self));
+
+  self->poll_interval_msec = (gdouble)timespan / (gdouble)(max_samples - 1) / 1000L;
+
+  if (self->poll_interval_msec == 0)
+    {
+      g_critical ("Implausible timespan/max_samples combination for graph.");
+      self->poll_interval_msec = 1000;
+    }
+
+  self->expected = g_get_monotonic_time () + (self->poll_interval_msec * 1000L);
+  self->poll_source = g_timeout_add (self->poll_interval_msec,
+                                     gb_sysmon_counter_table_poll_cb,
+                                     self);
+}
+
+static GbSysmonCounterTable *
+gb_sysmon_counter_table_new (Kind kind)
+{
+  GbSysmonCounterTable *self;
+  g_autoptr(RgColumn) column = NULL;
+
+  self = g_object_new (GB_TYPE_SYSMON_COUNTER_TABLE,
+                       "timespan", DEFAULT_TIMESPAN,
+                       "max-samples", DEFAULT_MAX_SAMPLES,
+                       NULL);
+  self->kind = kind;
+
+  column = rg_column_new ("Value", G_TYPE_DOUBLE);
+  rg_table_add_column (RG_TABLE (self), column);
+
+  return self;
+}
+
+static void
+gb_sysmon_counter_table_finalize (GObject *object)
+{
+  GbSysmonCounterTable *self = (GbSysmonCounterTable *)object;
+
+  if (self->poll_source != 0)
+    {
+      g_source_remove (self->poll_source);
+      self->poll_source = 0;
+    }
+
+  g_clear_pointer (&self->category, g_free);
+  g_clear_pointer (&self->name, g_free);
+
+  G_OBJECT_CLASS (gb_sysmon_counter_table_parent_class)->finalize (object);
+}
+
+static void
+gb_sysmon_counter_table_get_property (GObject    *object,
+                                      guint       prop_id,
+                                      GValue     *value,
+                                      GParamSpec *pspec)
+{
+  GbSysmonCounterTable *self = GB_SYSMON_COUNTER_TABLE (object);
+
+  switch (prop_id)
+    {
+    case PROP_VALUE:
+      g_value_set_double (value, gb_sysmon_counter_table_get_value (self));
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+    }
+}
+
+static void
+gb_sysmon_counter_table_class_init (GbSysmonCounterTableClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = gb_sysmon_counter_table_finalize;
+  object_class->get_property = gb_sysmon_counter_table_get_property;
+
+  properties [PROP_VALUE] =
+    g_param_spec_double ("value",
+                         "Value",
+                         "The most recently sampled value",
+                         -G_MAXDOUBLE,
+                         G_MAXDOUBLE,
+                         0.0,
+                         (G_PARAM_READABLE | G_PARAM_EXPLICIT_NOTIFY | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_properties (object_class, LAST_PROP, properties);
+}
+
+static void
+gb_sysmon_counter_table_init (GbSysmonCounterTable *self)
+{
+  g_object_set (self,
+                "value-min", 0.0,
+                "value-max", 1.0,
+                NULL);
+}
+
+/**
+ * gb_sysmon_counter_table_new_for_counter:
+ * @category: the category of the #EggCounter
+ * @name: the name of the #EggCounter
+ *
+ * Creates a table tracking the value of the counter matching @category and
+ * @name. The counter does not need to be registered yet.
+ */
+RgTable *
+gb_sysmon_counter_table_new_for_counter (const gchar *category,
+                                         const gchar *name)
+{
+  GbSysmonCounterTable *self;
+
+  g_return_val_if_fail (category != NULL, NULL);
+  g_return_val_if_fail (name != NULL, NULL);
+
+  self = gb_sysmon_counter_table_new (KIND_COUNTER);
+  self->category = g_strdup (category);
+  self->name = g_strdup (name);
+  gb_sysmon_counter_table_start (self);
+
+  return RG_TABLE (self);
+}
+
+/**
+ * gb_sysmon_counter_table_new_for_histogram:
+ * @category: the category of the #EggHistogram
+ * @name: the name of the #EggHistogram
+ * @percentile: the percentile to plot, between 0.0 and 100.0
+ *
+ * Creates a table tracking @percentile of the values recorded into the
+ * histogram during each sampling interval, in milliseconds.
+ */
+RgTable *
+gb_sysmon_counter_table_new_for_histogram (const gchar *category,
+                                           const gchar *name,
+                                           gdouble      percentile)
+{
+  GbSysmonCounterTable *self;
+
+  g_return_val_if_fail (category != NULL, NULL);
+  g_return_val_if_fail (name != NULL, NULL);
+
+  self = gb_sysmon_counter_table_new (KIND_HISTOGRAM);
+  self->category = g_strdup (category);
+  self->name = g_strdup (name);
+  self->percentile = CLAMP (percentile, 0.0, 100.0);
+  gb_sysmon_counter_table_start (self);
+
+  return RG_TABLE (self);
+}
+
+/**
+ * gb_sysmon_counter_table_new_main_loop:
+ *
+ * Creates a table tracking how late the main loop dispatched each sample,
+ * in milliseconds.
+ */
+RgTable *
+gb_sysmon_counter_table_new_main_loop (void)
+{
+  GbSysmonCounterTable *self;
+
+  self = gb_sysmon_counter_table_new (KIND_MAIN_LOOP);
+  gb_sysmon_counter_table_start (self);
+
+  return RG_TABLE (self);
+}
+
+/**
+ * gb_sysmon_counter_table_new_rss:
+ *
+ * Creates a table tracking the resident set size of the process, in
+ * megabytes.
+ */
+RgTable *
+gb_sysmon_counter_table_new_rss (void)
+{
+  GbSysmonCounterTable *self;
+
+  self = gb_sysmon_counter_table_new (KIND_RSS);
+  gb_sysmon_counter_table_start (self);
+
+  return RG_TABLE (self);
+}
+
+gdouble
+gb_sysmon_counter_table_get_value (GbSysmonCounterTable *self)
+{
+  g_return_val_if_fail (GB_IS_SYSMON_COUNTER_TABLE (self), 0.0);
+
+  return self->value;
+}
@@ -16,18 +16,90 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <glib/gi18n.h>
 #include <realtime-graphs.h>
 
+#include "gb-sysmon-counter-table.h"
 #include "gb-sysmon-panel.h"
 
 struct _GbSysmonPanel
 {
   PnlDockWidget  parent_instance;
   RgCpuGraph    *cpu_graph;
+  GtkGrid       *metrics_grid;
+  guint          n_metrics;
 };
 
 G_DEFINE_TYPE (GbSysmonPanel, gb_sysmon_panel, PNL_TYPE_DOCK_WIDGET)
 
+static gboolean
+format_value (GBinding     *binding,
+              const GValue *from_value,
+              GValue       *to_value,
+              gpointer      user_data)
+{
+  const gchar *format = user_data;
+
+  g_value_take_string (to_value, g_strdup_printf (format, g_value_get_double (from_value)));
+
+  return TRUE;
+}
+
+static void
+gb_sysmon_panel_add_metric (GbSysmonPanel *self,
+                            const gchar   *title,
+                            const gchar   *format,
+                            const gchar   *color,
+                            RgTable       *table)
+{
+  g_autoptr(RgLineRenderer) renderer = NULL;
+  GtkWidget *title_label;
+  GtkWidget *value_label;
+  GtkWidget *graph;
+
+  g_assert (GB_IS_SYSMON_PANEL (self));
+  g_assert (title != NULL);
+  g_assert (format != NULL);
+  g_assert (RG_IS_TABLE (table));
+
+  title_label = g_object_new (GTK_TYPE_LABEL,
+                              "label", title,
+                              "visible", TRUE,
+                              "xalign", 0.0f,
+                              NULL);
+  gtk_style_context_add_class (gtk_widget_get_style_context (title_label), "dim-label");
+  gtk_grid_attach (self->metrics_grid, title_label, 0, self->n_metrics, 1, 1);
+
+  value_label = g_object_new (GTK_TYPE_LABEL,
+                              "visible", TRUE,
+                              "width-chars", 10,
+                              "xalign", 1.0f,
+                              NULL);
+  g_object_bind_property_full (table, "value", value_label, "label",
+                               G_BINDING_SYNC_CREATE,
+                               format_value, NULL,
+                               (gpointer)format, NULL);
+  gtk_grid_attach (self->metrics_grid, value_label, 1, self->n_metrics, 1, 1);
+
+  renderer = g_object_new (RG_TYPE_LINE_RENDERER,
+                           "column", 0,
+                           "stroke-color", color,
+                           NULL);
+
+  graph = g_object_new (RG_TYPE_GRAPH,
+                        "height-request", 32,
+                        "hexpand", TRUE,
+                        "table", table,
+                        "visible", TRUE,
+                        NULL);
+  rg_graph_add_renderer (RG_GRAPH (graph), RG_RENDERER (renderer));
+  gtk_grid_attach (self->metrics_grid, graph, 2, self->n_metrics, 1, 1);
+
+  self->n_metrics++;
+
+  g_object_unref (table);
+}
+
 static void
 gb_sysmon_panel_finalize (GObject *object)
 {
@@ -44,6 +116,7 @@ gb_sysmon_panel_class_init (GbSysmonPanelClass *klass)
 
   gtk_widget_class_set_template_from_resource (widget_class, "/org/gnome/builder/plugins/sysmon/gb-sysmon-panel.ui");
   gtk_widget_class_bind_template_child (widget_class, GbSysmonPanel, cpu_graph);
+  gtk_widget_class_bind_template_child (widget_class, GbSysmonPanel, metrics_grid);
 
   g_type_ensure (RG_TYPE_CPU_GRAPH);
 }
@@ -52,4 +125,17 @@ static void
 gb_sysmon_panel_init (GbSysmonPanel *self)
 {
   gtk_widget_init_template (GTK_WIDGET (self));
+
+  gb_sysmon_panel_add_metric (self, _("Main Loop Latency"), "%.1f ms", "#cc0000",
+                              gb_sysmon_counter_table_new_main_loop ());
+  gb_sysmon_panel_add_metric (self, _("Queued Tasks"), "%.0f", "#3465a4",
+                              gb_sysmon_counter_table_new_for_counter ("ThreadPool", "Queued Tasks"));
+  gb_sysmon_panel_add_metric (self, _("Resident Memory"), "%.1f MB", "#73d216",
+                              gb_sysmon_counter_table_new_rss ());
+  gb_sysmon_panel_add_metric (self, _("Highlight Backlog"), "%.0f", "#f57900",
+                              gb_sysmon_counter_table_new_for_counter ("Highlighting", "Pending Engines"));
+  gb_sysmon_panel_add_metric (self, _("Highlight Tick (p90)"), "%.1f ms", "#c17d11",
+                              gb_sysmon_counter_table_new_for_histogram ("Highlighting", "Tick Latency", 90.0));
+  gb_sysmon_panel_add_metric (self, _("Diagnostics In Flight"), "%.0f", "#75507b",
+                              gb_sysmon_counter_table_new_for_counter ("Diagnostics", "In Flight"));
 }
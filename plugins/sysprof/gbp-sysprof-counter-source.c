@@ -0,0 +1,315 @@
+/* gbp-sysprof-counter-source.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define G_LOG_DOMAIN "gbp-sysprof-counter-source"
+
+#include <egg-counter.h>
+#include <ide.h>
+#include <unistd.h>
+
+#include "gbp-sysprof-counter-source.h"
+
+/*
+ * Samples every EggCounter of this process into the capture as a counter
+ * track. Sampling happens on a dedicated thread so that a stalled main loop
+ * still gets samples; they are buffered and written from the main thread
+ * since the capture writer is not thread-safe.
+ */
+
+#define SAMPLE_INTERVAL_USEC (G_USEC_PER_SEC / 20)
+#define FLUSH_INTERVAL_MSEC  500
+
+struct _GbpSysprofCounterSource
+{
+  GObject          parent_instance;
+
+  SpCaptureWriter *writer;
+
+  /* Immutable while sampling */
+  GPtrArray       *counters;
+  guint           *ids;
+
+  /*
+   * Rows of (1 + counters->len) values, the first being the capture
+   * time of the sample. Protected by @mutex.
+   */
+  GMutex           mutex;
+  GArray          *samples;
+
+  GThread         *thread;
+  volatile gint    running;
+  guint            flush_source;
+};
+
+static void source_iface_init (SpSourceInterface *iface);
+
+G_DEFINE_TYPE_EXTENDED (GbpSysprofCounterSource, gbp_sysprof_counter_source, G_TYPE_OBJECT, 0,
+                        G_IMPLEMENT_INTERFACE (SP_TYPE_SOURCE, source_iface_init))
+
+static gpointer
+gbp_sysprof_counter_source_sample_thread (gpointer data)
+{
+  GbpSysprofCounterSource *self = data;
+  g_autofree gint64 *row = NULL;
+  guint n_counters;
+
+  g_assert (GBP_IS_SYSPROF_COUNTER_SOURCE (self));
+
+  n_counters = self->counters->len;
+  row = g_new (gint64, n_counters + 1);
+
+  while (g_atomic_int_get (&self->running))
+    {
+      row [0] = SP_CAPTURE_CURRENT_TIME;
+
+      for (guint i = 0; i < n_counters; i++)
+        row [i + 1] = egg_counter_get (g_ptr_array_index (self->counters, i));
+
+      g_mutex_lock (&self->mutex);
+      g_array_append_vals (self->samples, row, n_counters + 1);
+      g_mutex_unlock (&self->mutex);
+
+      g_usleep (SAMPLE_INTERVAL_USEC);
+    }
+
+  return NULL;
+}
+
+static void
+gbp_sysprof_counter_source_flush (GbpSysprofCounterSource *self)
+{
+  g_autofree SpCaptureCounterValue *values = NULL;
+  GArray *samples;
+  guint n_counters;
+  guint row_len;
+
+  g_assert (GBP_IS_SYSPROF_COUNTER_SOURCE (self));
+
+  if (self->writer == NULL || self->counters == NULL)
+    return;
+
+  n_counters = self->counters->len;
+  row_len = n_counters + 1;
+
+  g_mutex_lock (&self->mutex);
+  samples = self->samples;
+  self->samples = g_array_new (FALSE, FALSE, sizeof (gint64));
+  g_mutex_unlock (&self->mutex);
+
+  values = g_new0 (SpCaptureCounterValue, n_counters);
+
+  for (guint i = 0; i + row_len <= samples->len; i += row_len)
+    {
+      const gint64 *row = &g_array_index (samples, gint64, i);
+
+      for (guint j = 0; j < n_counters; j++)
+        values [j].v64 = row [j + 1];
+
+      sp_capture_writer_set_counters (self->writer,
+                                      row [0],
+                                      -1,
+                                      getpid (),
+                                      self->ids,
+                                      values,
+                                      n_counters);
+    }
+
+  g_array_unref (samples);
+}
+
+static gboolean
+gbp_sysprof_counter_source_flush_cb (gpointer data)
+{
+  GbpSysprofCounterSource *self = data;
+
+  g_assert (GBP_IS_SYSPROF_COUNTER_SOURCE (self));
+
+  gbp_sysprof_counter_source_flush (self);
+
+  return G_SOURCE_CONTINUE;
+}
+
+static void
+collect_counter (EggCounter *counter,
+                 gpointer    user_data)
+{
+  GPtrArray *counters = user_data;
+
+  g_ptr_array_add (counters, counter);
+}
+
+static void
+gbp_sysprof_counter_source_set_writer (SpSource        *source,
+                                       SpCaptureWriter *writer)
+{
+  GbpSysprofCounterSource *self = (GbpSysprofCounterSource *)source;
+
+  g_assert (GBP_IS_SYSPROF_COUNTER_SOURCE (self));
+  g_assert (writer != NULL);
+
+  g_clear_pointer (&self->writer, sp_capture_writer_unref);
+  self->writer = sp_capture_writer_ref (writer);
+}
+
+static void
+gbp_sysprof_counter_source_start (SpSource *source)
+{
+  GbpSysprofCounterSource *self = (GbpSysprofCounterSource *)source;
+  g_autofree SpCaptureCounter *defs = NULL;
+  guint base;
+
+  IDE_ENTRY;
+
+  g_assert (GBP_IS_SYSPROF_COUNTER_SOURCE (self));
+  g_assert (self->writer != NULL);
+  g_assert (self->thread == NULL);
+
+  /*
+   * Counters registered after this point (say, from a plugin that is
+   * loaded later) will not be included in this capture.
+   */
+  g_clear_pointer (&self->counters, g_ptr_array_unref);
+  self->counters = g_ptr_array_new ();
+  egg_counter_arena_foreach (egg_counter_arena_get_default (), collect_counter, self->counters);
+
+  if (self->counters->len == 0)
+    {
+      sp_source_emit_finished (source);
+      IDE_EXIT;
+    }
+
+  base = sp_capture_writer_request_counter (self->writer, self->counters->len);
+  defs = g_new0 (SpCaptureCounter, self->counters->len);
+
+  g_free (self->ids);
+  self->ids = g_new0 (guint, self->counters->len);
+
+  for (guint i = 0; i < self->counters->len; i++)
+    {
+      EggCounter *counter = g_ptr_array_index (self->counters, i);
+
+      g_strlcpy (defs [i].category, counter->category, sizeof defs [i].category);
+      g_strlcpy (defs [i].name, counter->name, sizeof defs [i].name);
+      g_strlcpy (defs [i].description, counter->description, sizeof defs [i].description);
+      defs [i].id = self->ids [i] = base + i;
+      defs [i].type = SP_CAPTURE_COUNTER_INT64;
+      defs [i].value.v64 = egg_counter_get (counter);
+    }
+
+  sp_capture_writer_define_counters (self->writer,
+                                     SP_CAPTURE_CURRENT_TIME,
+                                     -1,
+                                     getpid (),
+                                     defs,
+                                     self->counters->len);
+
+  g_atomic_int_set (&self->running, TRUE);
+  self->thread = g_thread_new ("GbpSysprofCounterSource",
+                               gbp_sysprof_counter_source_sample_thread,
+                               self);
+
+  self->flush_source = g_timeout_add (FLUSH_INTERVAL_MSEC,
+                                      gbp_sysprof_counter_source_flush_cb,
+                                      self);
+
+  IDE_EXIT;
+}
+
+static void
+gbp_sysprof_counter_source_stop_sampling (GbpSysprofCounterSource *self)
+{
+  g_assert (GBP_IS_SYSPROF_COUNTER_SOURCE (self));
+
+  if (self->thread != NULL)
+    {
+      g_atomic_int_set (&self->running, FALSE);
+      g_thread_join (self->thread);
+      self->thread = NULL;
+    }
+
+  ide_clear_source (&self->flush_source);
+}
+
+static void
+gbp_sysprof_counter_source_stop (SpSource *source)
+{
+  GbpSysprofCounterSource *self = (GbpSysprofCounterSource *)source;
+
+  IDE_ENTRY;
+
+  g_assert (GBP_IS_SYSPROF_COUNTER_SOURCE (self));
+
+  gbp_sysprof_counter_source_stop_sampling (self);
+  gbp_sysprof_counter_source_flush (self);
+
+  sp_source_emit_finished (source);
+
+  IDE_EXIT;
+}
+
+static gboolean
+gbp_sysprof_counter_source_get_is_ready (SpSource *source)
+{
+  return TRUE;
+}
+
+static void
+source_iface_init (SpSourceInterface *iface)
+{
+  iface->get_is_ready = gbp_sysprof_counter_source_get_is_ready;
+  iface->set_writer = gbp_sysprof_counter_source_set_writer;
+  iface->start = gbp_sysprof_counter_source_start;
+  iface->stop = gbp_sysprof_counter_source_stop;
+}
+
+static void
+gbp_sysprof_counter_source_finalize (GObject *object)
+{
+  GbpSysprofCounterSource *self = (GbpSysprofCounterSource *)object;
+
+  gbp_sysprof_counter_source_stop_sampling (self);
+
+  g_clear_pointer (&self->writer, sp_capture_writer_unref);
+  g_clear_pointer (&self->counters, g_ptr_array_unref);
+  g_clear_pointer (&self->ids, g_free);
+  g_clear_pointer (&self->samples, g_array_unref);
+  g_mutex_clear (&self->mutex);
+
+  G_OBJECT_CLASS (gbp_sysprof_counter_source_parent_class)->finalize (object);
+}
+
+static void
+gbp_sysprof_counter_source_class_init (GbpSysprofCounterSourceClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = gbp_sysprof_counter_source_finalize;
+}
+
+static void
+gbp_sysprof_counter_source_init (GbpSysprofCounterSource *self)
+{
+  g_mutex_init (&self->mutex);
+  self->samples = g_array_new (FALSE, FALSE, sizeof (gint64));
+}
+
+SpSource *
+gbp_sysprof_counter_source_new (void)
+{
+  return g_object_new (GBP_TYPE_SYSPROF_COUNTER_SOURCE, NULL);
+}
@@ -0,0 +1,34 @@
+/* gbp-sysprof-counter-source.h
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GBP_SYSPROF_COUNTER_SOURCE_H
+#define GBP_SYSPROF_COUNTER_SOURCE_H
+
+#include <sysprof.h>
+
+G_BEGIN_DECLS
+
+#define GBP_TYPE_SYSPROF_COUNTER_SOURCE (gbp_sysprof_counter_source_get_type())
+
+G_DECLARE_FINAL_TYPE (GbpSysprofCounterSource, gbp_sysprof_counter_source, GBP, SYSPROF_COUNTER_SOURCE, GObject)
+
+SpSource *gbp_sysprof_counter_source_new (void);
+
+G_END_DECLS
+
+#endif /* GBP_SYSPROF_COUNTER_SOURCE_H */
@@ -18,7 +18,9 @@
 
 #include <glib/gi18n.h>
 #include <sysprof.h>
+#include <unistd.h>
 
+#include "gbp-sysprof-counter-source.h"
 #include "gbp-sysprof-perspective.h"
 #include "gbp-sysprof-workbench-addin.h"
 
@@ -123,6 +125,122 @@ profiler_child_spawned (GbpSysprofWorkbenchAddin *self,
   sp_profiler_start (self->profiler);
 }
 
+static void
+set_profile_builder_state (GbpSysprofWorkbenchAddin *self,
+                           gboolean                  state)
+{
+  GAction *action;
+
+  g_assert (GBP_IS_SYSPROF_WORKBENCH_ADDIN (self));
+
+  action = g_action_map_lookup_action (G_ACTION_MAP (self->actions), "profile-builder");
+  g_simple_action_set_state (G_SIMPLE_ACTION (action), g_variant_new_boolean (state));
+}
+
+static void
+profile_builder_stopped (GbpSysprofWorkbenchAddin *self,
+                         SpProfiler               *profiler)
+{
+  g_assert (GBP_IS_SYSPROF_WORKBENCH_ADDIN (self));
+  g_assert (SP_IS_PROFILER (profiler));
+
+  if (self->profiler == profiler)
+    set_profile_builder_state (self, FALSE);
+}
+
+static void
+gbp_sysprof_workbench_addin_profile_builder (GbpSysprofWorkbenchAddin *self)
+{
+  g_autoptr(SpSource) proc_source = NULL;
+  g_autoptr(SpSource) perf_source = NULL;
+  g_autoptr(SpSource) hostinfo_source = NULL;
+  g_autoptr(SpSource) counter_source = NULL;
+
+  IDE_ENTRY;
+
+  g_assert (GBP_IS_SYSPROF_WORKBENCH_ADDIN (self));
+
+  if (SP_IS_PROFILER (self->profiler))
+    {
+      if (sp_profiler_get_is_running (self->profiler))
+        sp_profiler_stop (self->profiler);
+      g_clear_object (&self->profiler);
+    }
+
+  self->profiler = sp_local_profiler_new ();
+
+  g_signal_connect_object (self->profiler,
+                           "stopped",
+                           G_CALLBACK (gbp_sysprof_workbench_addin_update_controls),
+                           self,
+                           G_CONNECT_SWAPPED);
+
+  gtk_widget_hide (GTK_WIDGET (self->zoom_controls));
+
+  /*
+   * Unlike profiling the inferior, we know exactly which process we are
+   * interested in, so there is no need to record the whole system.
+   */
+  sp_profiler_set_whole_system (self->profiler, FALSE);
+  sp_profiler_add_pid (self->profiler, getpid ());
+
+  proc_source = sp_proc_source_new ();
+  sp_profiler_add_source (self->profiler, proc_source);
+
+  perf_source = sp_perf_source_new ();
+  sp_profiler_add_source (self->profiler, perf_source);
+
+  hostinfo_source = sp_hostinfo_source_new ();
+  sp_profiler_add_source (self->profiler, hostinfo_source);
+
+  /* Record our own EggCounters so they can be lined up with the stacks */
+  counter_source = gbp_sysprof_counter_source_new ();
+  sp_profiler_add_source (self->profiler, counter_source);
+
+  g_signal_connect_object (self->profiler,
+                           "stopped",
+                           G_CALLBACK (profile_builder_stopped),
+                           self,
+                           G_CONNECT_SWAPPED);
+
+  g_signal_connect_object (self->profiler,
+                           "stopped",
+                           G_CALLBACK (profiler_stopped),
+                           self,
+                           G_CONNECT_SWAPPED);
+
+  gbp_sysprof_perspective_set_profiler (self->perspective, self->profiler);
+
+  /*
+   * We don't switch to the profiler perspective until the capture has
+   * stopped, since whatever the user is doing is what we want to record.
+   */
+  sp_profiler_start (self->profiler);
+
+  IDE_EXIT;
+}
+
+static void
+profile_builder_change_state (GSimpleAction *action,
+                              GVariant      *state,
+                              gpointer       user_data)
+{
+  GbpSysprofWorkbenchAddin *self = user_data;
+
+  g_assert (GBP_IS_SYSPROF_WORKBENCH_ADDIN (self));
+  g_assert (g_variant_is_of_type (state, G_VARIANT_TYPE_BOOLEAN));
+
+  if (self->workbench == NULL)
+    return;
+
+  g_simple_action_set_state (action, state);
+
+  if (g_variant_get_boolean (state))
+    gbp_sysprof_workbench_addin_profile_builder (self);
+  else if (self->profiler != NULL && sp_profiler_get_is_running (self->profiler))
+    sp_profiler_stop (self->profiler);
+}
+
 static void
 profiler_run_handler (IdeRunManager *run_manager,
                       IdeRunner     *runner,
@@ -144,6 +262,8 @@ profiler_run_handler (IdeRunManager *run_manager,
       g_clear_object (&self->profiler);
     }
 
+  set_profile_builder_state (self, FALSE);
+
   self->profiler = sp_local_profiler_new ();
 
   g_signal_connect_object (self->profiler,
@@ -359,6 +479,7 @@ gbp_sysprof_workbench_addin_init (GbpSysprofWorkbenchAddin *self)
 {
   static const GActionEntry entries[] = {
     { "open-profile", open_profile_action },
+    { "profile-builder", NULL, NULL, "false", profile_builder_change_state },
   };
 
   self->actions = g_simple_action_group_new ();
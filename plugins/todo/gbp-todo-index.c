@@ -0,0 +1,857 @@
+/* gbp-todo-index.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "gbp-todo-index.h"
+
+/*
+ * The index contains the todo items of every file in the project. It is
+ * loaded from a cache in the user's cache directory so that the panel can
+ * be populated immediately, and then refreshed with a project-wide
+ * IdeTextSearch in the background.
+ *
+ * Open buffers are rescanned shortly after they change, so that items show
+ * up while typing rather than only after saving.
+ */
+
+#define TODO_PATTERN      "\\b(?:TODO|FIXME|XXX):"
+#define CONTEXT_LINES     5
+#define UPDATE_DELAY_MSEC 500
+#define SAVE_DELAY_SEC    5
+#define CACHE_VARIANT     "a{sa(us)}"
+
+struct _GbpTodoIndex
+{
+  IdeObject      parent_instance;
+
+  /* GFile to GArray of GbpTodoItem */
+  GHashTable    *files;
+
+  /* Set of IdeBuffer that have changed since the last update */
+  GHashTable    *dirty_buffers;
+
+  /* Set of GFile found by the running rescan, or NULL */
+  GHashTable    *seen;
+
+  IdeTextSearch *matcher;
+  GCancellable  *cancellable;
+  GFile         *cache_file;
+
+  guint          update_source;
+  guint          save_source;
+};
+
+enum {
+  FILE_CHANGED,
+  N_SIGNALS
+};
+
+G_DEFINE_TYPE (GbpTodoIndex, gbp_todo_index, IDE_TYPE_OBJECT)
+
+static guint signals [N_SIGNALS];
+
+static void
+gbp_todo_item_clear (gpointer data)
+{
+  GbpTodoItem *item = data;
+
+  g_clear_pointer (&item->message, g_free);
+}
+
+static GArray *
+gbp_todo_items_new (void)
+{
+  GArray *items;
+
+  items = g_array_new (FALSE, FALSE, sizeof (GbpTodoItem));
+  g_array_set_clear_func (items, gbp_todo_item_clear);
+
+  return items;
+}
+
+static gboolean
+should_skip (GFile *file)
+{
+  g_autofree gchar *name = g_file_get_basename (file);
+
+  /* Autotools macros and translations are full of these, but not ours */
+  return name == NULL ||
+         g_str_has_suffix (name, ".m4") ||
+         g_str_has_suffix (name, ".po");
+}
+
+static gboolean
+has_keyword (const gchar *line)
+{
+  return strstr (line, "TODO:") || strstr (line, "FIXME:") || strstr (line, "XXX:");
+}
+
+static const gchar *
+skip_comment_leader (const gchar *line)
+{
+  if (g_str_has_prefix (line, "//"))
+    line += 2;
+  else if (*line == '*' || *line == '#')
+    line++;
+  else
+    return NULL;
+
+  while (g_ascii_isspace (*line))
+    line++;
+
+  return line;
+}
+
+/*
+ * The message starts at the keyword and continues on the following lines as
+ * long as they look like the same comment.
+ */
+static gchar *
+build_message (const IdeTextSearchMatch *match)
+{
+  g_auto(GStrv) lines = NULL;
+  GString *str;
+  guint i;
+
+  str = g_string_new (g_utf8_offset_to_pointer (match->line_text, match->line_offset));
+  g_strstrip (str->str);
+  g_string_set_size (str, strlen (str->str));
+
+  if (g_str_has_suffix (str->str, "*/"))
+    {
+      g_string_truncate (str, str->len - 2);
+      g_strchomp (str->str);
+      return g_string_free (str, FALSE);
+    }
+
+  if (match->context == NULL)
+    return g_string_free (str, FALSE);
+
+  lines = g_strsplit (match->context, "\n", -1);
+
+  for (i = 0; lines [i] != NULL; i++)
+    {
+      const gchar *text = skip_comment_leader (g_strstrip (lines [i]));
+
+      if (text == NULL || *text == '\0' || *text == '/' || has_keyword (text))
+        break;
+
+      g_string_append_c (str, '\n');
+      g_string_append (str, text);
+
+      if (g_str_has_suffix (str->str, "*/"))
+        {
+          g_string_truncate (str, str->len - 2);
+          break;
+        }
+    }
+
+  g_strchomp (str->str);
+
+  return g_string_free (str, FALSE);
+}
+
+static IdeTextSearch *
+gbp_todo_index_create_search (GbpTodoIndex *self)
+{
+  IdeTextSearch *search;
+  IdeContext *context;
+
+  g_assert (GBP_IS_TODO_INDEX (self));
+
+  if (NULL == (context = ide_object_get_context (IDE_OBJECT (self))))
+    return NULL;
+
+  search = ide_text_search_new (context,
+                                TODO_PATTERN,
+                                IDE_TEXT_SEARCH_REGEX | IDE_TEXT_SEARCH_CASE_SENSITIVE);
+  ide_text_search_set_context_lines (search, CONTEXT_LINES);
+  ide_text_search_set_max_matches (search, 0);
+
+  return search;
+}
+
+static gboolean
+gbp_todo_index_save_cb (gpointer user_data)
+{
+  GbpTodoIndex *self = user_data;
+  g_autoptr(GVariantBuilder) builder = NULL;
+  g_autoptr(GFile) parent = NULL;
+  g_autoptr(GVariant) variant = NULL;
+  g_autoptr(GBytes) bytes = NULL;
+  g_autofree gchar *parent_path = NULL;
+  GHashTableIter iter;
+  IdeContext *context;
+  GFile *workdir;
+  gpointer key;
+  gpointer value;
+
+  g_assert (GBP_IS_TODO_INDEX (self));
+
+  self->save_source = 0;
+
+  /* Never replace the cache with whatever is left once the context is gone */
+  if (NULL == (context = ide_object_get_context (IDE_OBJECT (self))))
+    return G_SOURCE_REMOVE;
+
+  workdir = ide_vcs_get_working_directory (ide_context_get_vcs (context));
+
+  builder = g_variant_builder_new (G_VARIANT_TYPE (CACHE_VARIANT));
+
+  g_hash_table_iter_init (&iter, self->files);
+
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      g_autofree gchar *relpath = g_file_get_relative_path (workdir, key);
+      GArray *items = value;
+      guint i;
+
+      if (relpath == NULL)
+        continue;
+
+      g_variant_builder_open (builder, G_VARIANT_TYPE ("{sa(us)}"));
+      g_variant_builder_add (builder, "s", relpath);
+      g_variant_builder_open (builder, G_VARIANT_TYPE ("a(us)"));
+
+      for (i = 0; i < items->len; i++)
+        {
+          const GbpTodoItem *item = &g_array_index (items, GbpTodoItem, i);
+
+          g_variant_builder_add (builder, "(us)", item->line, item->message);
+        }
+
+      g_variant_builder_close (builder);
+      g_variant_builder_close (builder);
+    }
+
+  variant = g_variant_ref_sink (g_variant_builder_end (builder));
+  bytes = g_variant_get_data_as_bytes (variant);
+
+  parent = g_file_get_parent (self->cache_file);
+  parent_path = g_file_get_path (parent);
+  g_mkdir_with_parents (parent_path, 0750);
+
+  g_file_replace_contents_bytes_async (self->cache_file,
+                                       bytes,
+                                       NULL,
+                                       FALSE,
+                                       G_FILE_CREATE_NONE,
+                                       NULL,
+                                       NULL,
+                                       NULL);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+gbp_todo_index_queue_save (GbpTodoIndex *self)
+{
+  g_assert (GBP_IS_TODO_INDEX (self));
+
+  /* A running rescan saves when it completes */
+  if (self->seen != NULL ||
+      self->save_source != 0 ||
+      g_cancellable_is_cancelled (self->cancellable))
+    return;
+
+  self->save_source = g_timeout_add_seconds (SAVE_DELAY_SEC, gbp_todo_index_save_cb, self);
+}
+
+static void
+gbp_todo_index_replace (GbpTodoIndex *self,
+                        GFile        *file,
+                        GArray       *items)
+{
+  g_assert (GBP_IS_TODO_INDEX (self));
+  g_assert (G_IS_FILE (file));
+
+  if (self->seen != NULL)
+    g_hash_table_add (self->seen, g_object_ref (file));
+
+  if (items == NULL || items->len == 0)
+    {
+      if (!g_hash_table_remove (self->files, file))
+        return;
+    }
+  else
+    {
+      g_hash_table_insert (self->files, g_object_ref (file), g_array_ref (items));
+    }
+
+  g_signal_emit (self, signals [FILE_CHANGED], 0, file);
+
+  gbp_todo_index_queue_save (self);
+}
+
+static void
+gbp_todo_index_matches_found (GbpTodoIndex  *self,
+                              GArray        *matches,
+                              IdeTextSearch *search)
+{
+  g_autoptr(GHashTable) found = NULL;
+  GHashTableIter iter;
+  gpointer key;
+  gpointer value;
+  guint i;
+
+  g_assert (GBP_IS_TODO_INDEX (self));
+  g_assert (matches != NULL);
+  g_assert (IDE_IS_TEXT_SEARCH (search));
+
+  /* IdeTextSearch delivers all of the matches for a file in one batch */
+  found = g_hash_table_new_full (g_file_hash,
+                                 (GEqualFunc)g_file_equal,
+                                 g_object_unref,
+                                 (GDestroyNotify)g_array_unref);
+
+  for (i = 0; i < matches->len; i++)
+    {
+      const IdeTextSearchMatch *match = &g_array_index (matches, IdeTextSearchMatch, i);
+      GbpTodoItem item;
+      GArray *items;
+
+      if (NULL == (items = g_hash_table_lookup (found, match->file)))
+        {
+          if (should_skip (match->file))
+            continue;
+
+          items = gbp_todo_items_new ();
+          g_hash_table_insert (found, g_object_ref (match->file), items);
+        }
+
+      item.line = match->line;
+      item.message = build_message (match);
+
+      g_array_append_val (items, item);
+    }
+
+  g_hash_table_iter_init (&iter, found);
+
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    gbp_todo_index_replace (self, key, value);
+}
+
+static void
+gbp_todo_index_rescan_cb (GObject      *object,
+                          GAsyncResult *result,
+                          gpointer      user_data)
+{
+  IdeTextSearch *search = (IdeTextSearch *)object;
+  g_autoptr(GbpTodoIndex) self = user_data;
+  g_autoptr(GPtrArray) removed = NULL;
+  g_autoptr(GError) error = NULL;
+  GHashTableIter iter;
+  gpointer key;
+  guint i;
+
+  g_assert (IDE_IS_TEXT_SEARCH (search));
+  g_assert (GBP_IS_TODO_INDEX (self));
+
+  if (!ide_text_search_execute_finish (search, result, &error) ||
+      g_cancellable_is_cancelled (self->cancellable))
+    {
+      if (error != NULL && !g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        g_warning ("Failed to index todo items: %s", error->message);
+      g_clear_pointer (&self->seen, g_hash_table_unref);
+      return;
+    }
+
+  g_debug ("Indexed todo items from %u files", ide_text_search_get_n_files (search));
+
+  /* Anything we loaded from the cache that no longer has items is stale */
+  removed = g_ptr_array_new_with_free_func (g_object_unref);
+
+  g_hash_table_iter_init (&iter, self->files);
+
+  while (g_hash_table_iter_next (&iter, &key, NULL))
+    {
+      if (!g_hash_table_contains (self->seen, key))
+        g_ptr_array_add (removed, g_object_ref (key));
+    }
+
+  g_clear_pointer (&self->seen, g_hash_table_unref);
+
+  for (i = 0; i < removed->len; i++)
+    gbp_todo_index_replace (self, g_ptr_array_index (removed, i), NULL);
+
+  if (self->save_source != 0)
+    g_source_remove (self->save_source);
+  self->save_source = 0;
+
+  gbp_todo_index_save_cb (self);
+}
+
+static void
+gbp_todo_index_rescan (GbpTodoIndex *self)
+{
+  g_autoptr(IdeTextSearch) search = NULL;
+
+  g_assert (GBP_IS_TODO_INDEX (self));
+
+  if (NULL == (search = gbp_todo_index_create_search (self)))
+    return;
+
+  g_clear_pointer (&self->seen, g_hash_table_unref);
+  self->seen = g_hash_table_new_full (g_file_hash, (GEqualFunc)g_file_equal, g_object_unref, NULL);
+
+  g_signal_connect_object (search,
+                           "matches-found",
+                           G_CALLBACK (gbp_todo_index_matches_found),
+                           self,
+                           G_CONNECT_SWAPPED);
+
+  ide_text_search_execute_async (search,
+                                 self->cancellable,
+                                 gbp_todo_index_rescan_cb,
+                                 g_object_ref (self));
+}
+
+static void
+gbp_todo_index_load_cache_cb (GObject      *object,
+                              GAsyncResult *result,
+                              gpointer      user_data)
+{
+  GFile *cache_file = (GFile *)object;
+  g_autoptr(GbpTodoIndex) self = user_data;
+  g_autoptr(GVariant) variant = NULL;
+  g_autoptr(GBytes) bytes = NULL;
+  g_autoptr(GError) error = NULL;
+  GVariantIter *items_iter;
+  GVariantIter iter;
+  IdeContext *context;
+  const gchar *relpath;
+  gchar *contents = NULL;
+  GFile *workdir;
+  gsize len = 0;
+
+  g_assert (G_IS_FILE (cache_file));
+  g_assert (GBP_IS_TODO_INDEX (self));
+
+  if (g_cancellable_is_cancelled (self->cancellable))
+    return;
+
+  if (!g_file_load_contents_finish (cache_file, result, &contents, &len, NULL, &error))
+    {
+      if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND))
+        g_warning ("Failed to load todo cache: %s", error->message);
+      gbp_todo_index_rescan (self);
+      return;
+    }
+
+  bytes = g_bytes_new_take (contents, len);
+  variant = g_variant_ref_sink (g_variant_new_from_bytes (G_VARIANT_TYPE (CACHE_VARIANT), bytes, FALSE));
+
+  /* Don't trust a truncated or corrupted cache */
+  if (!g_variant_is_normal_form (variant))
+    {
+      gbp_todo_index_rescan (self);
+      return;
+    }
+
+  if (NULL == (context = ide_object_get_context (IDE_OBJECT (self))))
+    return;
+
+  workdir = ide_vcs_get_working_directory (ide_context_get_vcs (context));
+
+  g_variant_iter_init (&iter, variant);
+
+  while (g_variant_iter_next (&iter, "{&sa(us)}", &relpath, &items_iter))
+    {
+      g_autoptr(GFile) file = g_file_resolve_relative_path (workdir, relpath);
+      g_autoptr(GArray) items = gbp_todo_items_new ();
+      GbpTodoItem item;
+
+      while (g_variant_iter_next (items_iter, "(us)", &item.line, &item.message))
+        g_array_append_val (items, item);
+
+      g_variant_iter_free (items_iter);
+
+      /* Open buffers may have been indexed already */
+      if (!g_hash_table_contains (self->files, file))
+        gbp_todo_index_replace (self, file, items);
+    }
+
+  gbp_todo_index_rescan (self);
+}
+
+void
+gbp_todo_index_update_file (GbpTodoIndex *self,
+                            GFile        *file,
+                            GBytes       *contents)
+{
+  g_autoptr(GArray) matches = NULL;
+  g_autoptr(GArray) items = NULL;
+  g_autoptr(GError) error = NULL;
+  IdeContext *context;
+  IdeVcs *vcs;
+  guint i;
+
+  g_return_if_fail (GBP_IS_TODO_INDEX (self));
+  g_return_if_fail (G_IS_FILE (file));
+  g_return_if_fail (contents != NULL);
+
+  if (NULL == (context = ide_object_get_context (IDE_OBJECT (self))))
+    return;
+
+  vcs = ide_context_get_vcs (context);
+
+  if (should_skip (file) ||
+      !g_file_has_prefix (file, ide_vcs_get_working_directory (vcs)) ||
+      ide_vcs_is_ignored (vcs, file, NULL))
+    return;
+
+  if (self->matcher == NULL && NULL == (self->matcher = gbp_todo_index_create_search (self)))
+    return;
+
+  if (NULL == (matches = ide_text_search_search_bytes (self->matcher, file, contents, &error)))
+    {
+      g_warning ("%s", error->message);
+      return;
+    }
+
+  items = gbp_todo_items_new ();
+
+  for (i = 0; i < matches->len; i++)
+    {
+      const IdeTextSearchMatch *match = &g_array_index (matches, IdeTextSearchMatch, i);
+      GbpTodoItem item;
+
+      item.line = match->line;
+      item.message = build_message (match);
+
+      g_array_append_val (items, item);
+    }
+
+  gbp_todo_index_replace (self, file, items);
+}
+
+static gboolean
+gbp_todo_index_update_buffers_cb (gpointer user_data)
+{
+  GbpTodoIndex *self = user_data;
+  GHashTableIter iter;
+  gpointer key;
+
+  g_assert (GBP_IS_TODO_INDEX (self));
+
+  self->update_source = 0;
+
+  g_hash_table_iter_init (&iter, self->dirty_buffers);
+
+  while (g_hash_table_iter_next (&iter, &key, NULL))
+    {
+      IdeBuffer *buffer = key;
+      g_autoptr(GBytes) contents = ide_buffer_get_content (buffer);
+      GFile *file = ide_file_get_file (ide_buffer_get_file (buffer));
+
+      if (contents != NULL && file != NULL)
+        gbp_todo_index_update_file (self, file, contents);
+
+      g_hash_table_iter_remove (&iter);
+    }
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+gbp_todo_index_buffer_changed (GbpTodoIndex *self,
+                               IdeBuffer    *buffer)
+{
+  g_assert (GBP_IS_TODO_INDEX (self));
+  g_assert (IDE_IS_BUFFER (buffer));
+
+  g_hash_table_add (self->dirty_buffers, g_object_ref (buffer));
+
+  if (self->update_source != 0)
+    g_source_remove (self->update_source);
+
+  self->update_source = g_timeout_add_full (G_PRIORITY_LOW,
+                                            UPDATE_DELAY_MSEC,
+                                            gbp_todo_index_update_buffers_cb,
+                                            self,
+                                            NULL);
+}
+
+static void
+gbp_todo_index_buffer_loaded (GbpTodoIndex     *self,
+                              IdeBuffer        *buffer,
+                              IdeBufferManager *buffer_manager)
+{
+  g_assert (GBP_IS_TODO_INDEX (self));
+  g_assert (IDE_IS_BUFFER (buffer));
+
+  g_signal_connect_object (buffer,
+                           "changed",
+                           G_CALLBACK (gbp_todo_index_buffer_changed),
+                           self,
+                           G_CONNECT_SWAPPED);
+}
+
+static void
+gbp_todo_index_reload_file_cb (GObject      *object,
+                               GAsyncResult *result,
+                               gpointer      user_data)
+{
+  GFile *file = (GFile *)object;
+  g_autoptr(GbpTodoIndex) self = user_data;
+  g_autoptr(GBytes) bytes = NULL;
+  gchar *contents = NULL;
+  gsize len = 0;
+
+  g_assert (G_IS_FILE (file));
+  g_assert (GBP_IS_TODO_INDEX (self));
+
+  if (g_cancellable_is_cancelled (self->cancellable) ||
+      !g_file_load_contents_finish (file, result, &contents, &len, NULL, NULL))
+    return;
+
+  bytes = g_bytes_new_take (contents, len);
+  gbp_todo_index_update_file (self, file, bytes);
+}
+
+static void
+gbp_todo_index_buffer_unloaded (GbpTodoIndex     *self,
+                                IdeBuffer        *buffer,
+                                IdeBufferManager *buffer_manager)
+{
+  GFile *file;
+
+  g_assert (GBP_IS_TODO_INDEX (self));
+  g_assert (IDE_IS_BUFFER (buffer));
+
+  g_hash_table_remove (self->dirty_buffers, buffer);
+
+  /* Changes may have been discarded, so go back to what is on disk */
+  if (NULL != (file = ide_file_get_file (ide_buffer_get_file (buffer))))
+    g_file_load_contents_async (file,
+                                self->cancellable,
+                                gbp_todo_index_reload_file_cb,
+                                g_object_ref (self));
+}
+
+/**
+ * gbp_todo_index_load:
+ *
+ * Loads the cached index, then refreshes it from the project files and
+ * starts tracking changes to open buffers.
+ */
+void
+gbp_todo_index_load (GbpTodoIndex *self)
+{
+  g_autoptr(GPtrArray) buffers = NULL;
+  IdeBufferManager *buffer_manager;
+  IdeContext *context;
+  guint i;
+
+  g_return_if_fail (GBP_IS_TODO_INDEX (self));
+
+  if (NULL == (context = ide_object_get_context (IDE_OBJECT (self))) ||
+      g_cancellable_is_cancelled (self->cancellable))
+    return;
+
+  buffer_manager = ide_context_get_buffer_manager (context);
+
+  g_signal_connect_object (buffer_manager,
+                           "buffer-loaded",
+                           G_CALLBACK (gbp_todo_index_buffer_loaded),
+                           self,
+                           G_CONNECT_SWAPPED);
+
+  g_signal_connect_object (buffer_manager,
+                           "buffer-unloaded",
+                           G_CALLBACK (gbp_todo_index_buffer_unloaded),
+                           self,
+                           G_CONNECT_SWAPPED);
+
+  buffers = ide_buffer_manager_get_buffers (buffer_manager);
+
+  for (i = 0; i < buffers->len; i++)
+    gbp_todo_index_buffer_loaded (self, g_ptr_array_index (buffers, i), buffer_manager);
+
+  g_file_load_contents_async (self->cache_file,
+                              self->cancellable,
+                              gbp_todo_index_load_cache_cb,
+                              g_object_ref (self));
+}
+
+/**
+ * gbp_todo_index_get_files:
+ *
+ * Returns: (transfer container) (element-type GFile): the files with todo items.
+ */
+GPtrArray *
+gbp_todo_index_get_files (GbpTodoIndex *self)
+{
+  GHashTableIter iter;
+  GPtrArray *ar;
+  gpointer key;
+
+  g_return_val_if_fail (GBP_IS_TODO_INDEX (self), NULL);
+
+  ar = g_ptr_array_new_with_free_func (g_object_unref);
+
+  g_hash_table_iter_init (&iter, self->files);
+
+  while (g_hash_table_iter_next (&iter, &key, NULL))
+    g_ptr_array_add (ar, g_object_ref (key));
+
+  return ar;
+}
+
+/**
+ * gbp_todo_index_get_items:
+ *
+ * Returns: (transfer none) (nullable): A #GArray of #GbpTodoItem or %NULL.
+ */
+GArray *
+gbp_todo_index_get_items (GbpTodoIndex *self,
+                          GFile        *file)
+{
+  g_return_val_if_fail (GBP_IS_TODO_INDEX (self), NULL);
+  g_return_val_if_fail (G_IS_FILE (file), NULL);
+
+  return g_hash_table_lookup (self->files, file);
+}
+
+/**
+ * gbp_todo_index_shutdown:
+ *
+ * Cancels the running rescan and any pending updates, and saves the index
+ * if it has changed. This must be called while the context is still alive,
+ * since the rescan would otherwise keep the index around after it.
+ */
+void
+gbp_todo_index_shutdown (GbpTodoIndex *self)
+{
+  g_return_if_fail (GBP_IS_TODO_INDEX (self));
+
+  g_cancellable_cancel (self->cancellable);
+
+  if (self->update_source != 0)
+    {
+      g_source_remove (self->update_source);
+      self->update_source = 0;
+    }
+
+  if (self->save_source != 0)
+    {
+      g_source_remove (self->save_source);
+      gbp_todo_index_save_cb (self);
+    }
+
+  g_hash_table_remove_all (self->dirty_buffers);
+}
+
+static void
+gbp_todo_index_constructed (GObject *object)
+{
+  GbpTodoIndex *self = (GbpTodoIndex *)object;
+  g_autofree gchar *name = NULL;
+  g_autofree gchar *path = NULL;
+  IdeContext *context;
+  IdeProject *project;
+
+  G_OBJECT_CLASS (gbp_todo_index_parent_class)->constructed (object);
+
+  if (NULL == (context = ide_object_get_context (IDE_OBJECT (self))))
+    return;
+
+  project = ide_context_get_project (context);
+
+  name = g_strconcat (ide_project_get_id (project), ".todo", NULL);
+  path = g_build_filename (g_get_user_cache_dir (),
+                           ide_get_program_name (),
+                           "todo",
+                           name,
+                           NULL);
+  self->cache_file = g_file_new_for_path (path);
+}
+
+static void
+gbp_todo_index_dispose (GObject *object)
+{
+  GbpTodoIndex *self = (GbpTodoIndex *)object;
+
+  gbp_todo_index_shutdown (self);
+
+  G_OBJECT_CLASS (gbp_todo_index_parent_class)->dispose (object);
+}
+
+static void
+gbp_todo_index_finalize (GObject *object)
+{
+  GbpTodoIndex *self = (GbpTodoIndex *)object;
+
+  g_clear_pointer (&self->files, g_hash_table_unref);
+  g_clear_pointer (&self->dirty_buffers, g_hash_table_unref);
+  g_clear_pointer (&self->seen, g_hash_table_unref);
+  g_clear_object (&self->matcher);
+  g_clear_object (&self->cancellable);
+  g_clear_object (&self->cache_file);
+
+  G_OBJECT_CLASS (gbp_todo_index_parent_class)->finalize (object);
+}
+
+static void
+gbp_todo_index_class_init (GbpTodoIndexClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->constructed = gbp_todo_index_constructed;
+  object_class->dispose = gbp_todo_index_dispose;
+  object_class->finalize = gbp_todo_index_finalize;
+
+  /**
+   * GbpTodoIndex::file-changed:
+   * @self: A #GbpTodoIndex
+   * @file: the #GFile whose items changed
+   *
+   * Emitted when the items for @file have been added, replaced or removed.
+   */
+  signals [FILE_CHANGED] =
+    g_signal_new ("file-changed",
+                  G_TYPE_FROM_CLASS (klass),
+                  G_SIGNAL_RUN_LAST,
+                  0,
+                  NULL, NULL, NULL,
+                  G_TYPE_NONE,
+                  1,
+                  G_TYPE_FILE);
+}
+
+static void
+gbp_todo_index_init (GbpTodoIndex *self)
+{
+  self->files = g_hash_table_new_full (g_file_hash,
+                                       (GEqualFunc)g_file_equal,
+                                       g_object_unref,
+                                       (GDestroyNotify)g_array_unref);
+  self->dirty_buffers = g_hash_table_new_full (NULL, NULL, g_object_unref, NULL);
+  self->cancellable = g_cancellable_new ();
+}
+
+GbpTodoIndex *
+gbp_todo_index_new (IdeContext *context)
+{
+  g_return_val_if_fail (IDE_IS_CONTEXT (context), NULL);
+
+  return g_object_new (GBP_TYPE_TODO_INDEX,
+                       "context", context,
+                       NULL);
+}
@@ -0,0 +1,45 @@
+/* gbp-todo-index.h
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <ide.h>
+
+G_BEGIN_DECLS
+
+#define GBP_TYPE_TODO_INDEX (gbp_todo_index_get_type())
+
+G_DECLARE_FINAL_TYPE (GbpTodoIndex, gbp_todo_index, GBP, TODO_INDEX, IdeObject)
+
+typedef struct
+{
+  guint  line;
+  gchar *message;
+} GbpTodoItem;
+
+GbpTodoIndex *gbp_todo_index_new         (IdeContext   *context);
+void          gbp_todo_index_load        (GbpTodoIndex *self);
+void          gbp_todo_index_shutdown    (GbpTodoIndex *self);
+GPtrArray    *gbp_todo_index_get_files   (GbpTodoIndex *self);
+GArray       *gbp_todo_index_get_items   (GbpTodoIndex *self,
+                                          GFile        *file);
+void          gbp_todo_index_update_file (GbpTodoIndex *self,
+                                          GFile        *file,
+                                          GBytes       *contents);
+
+G_END_DECLS
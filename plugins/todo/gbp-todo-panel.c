@@ -0,0 +1,447 @@
+/* gbp-todo-panel.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib/gi18n.h>
+#include <string.h>
+
+#include "gbp-todo-panel.h"
+
+struct _GbpTodoPanel
+{
+  PnlDockWidget  parent_instance;
+
+  GbpTodoIndex  *index;
+  GFile         *workdir;
+  GtkListStore  *model;
+  GtkTreeView   *tree_view;
+
+  /*
+   * GFile to FileRows. The rows of a file are contiguous, and GtkListStore
+   * iters stay valid while their row exists, so a file can be replaced
+   * without walking the whole model.
+   */
+  GHashTable    *rows;
+};
+
+typedef struct
+{
+  GtkTreeIter first;
+  guint       count;
+} FileRows;
+
+enum {
+  COLUMN_FILE,
+  COLUMN_LINE,
+  COLUMN_MESSAGE,
+  N_COLUMNS
+};
+
+enum {
+  PROP_0,
+  PROP_INDEX,
+  N_PROPS
+};
+
+G_DEFINE_TYPE (GbpTodoPanel, gbp_todo_panel, PNL_TYPE_DOCK_WIDGET)
+
+static GParamSpec *properties [N_PROPS];
+
+static void
+gbp_todo_panel_file_changed (GbpTodoPanel *self,
+                             GFile        *file,
+                             GbpTodoIndex *index)
+{
+  GtkTreeIter iter;
+  FileRows *rows;
+  GArray *items;
+  gboolean valid = FALSE;
+  guint i;
+
+  g_assert (GBP_IS_TODO_PANEL (self));
+  g_assert (G_IS_FILE (file));
+  g_assert (GBP_IS_TODO_INDEX (index));
+
+  if (NULL != (rows = g_hash_table_lookup (self->rows, file)))
+    {
+      iter = rows->first;
+      valid = TRUE;
+
+      for (i = 0; valid && i < rows->count; i++)
+        valid = gtk_list_store_remove (self->model, &iter);
+
+      g_hash_table_remove (self->rows, file);
+    }
+
+  items = gbp_todo_index_get_items (index, file);
+
+  if (items == NULL || items->len == 0)
+    return;
+
+  rows = g_slice_new0 (FileRows);
+  rows->count = items->len;
+
+  /* Keep the items of a file where they were, otherwise append */
+  for (i = 0; i < items->len; i++)
+    {
+      const GbpTodoItem *item = &g_array_index (items, GbpTodoItem, i);
+      GtkTreeIter row;
+
+      gtk_list_store_insert_before (self->model, &row, valid ? &iter : NULL);
+      gtk_list_store_set (self->model, &row,
+                          COLUMN_FILE, file,
+                          COLUMN_LINE, item->line,
+                          COLUMN_MESSAGE, item->message,
+                          -1);
+
+      if (i == 0)
+        rows->first = row;
+    }
+
+  g_hash_table_insert (self->rows, g_object_ref (file), rows);
+}
+
+static void
+gbp_todo_panel_file_data_func (GtkCellLayout   *cell_layout,
+                               GtkCellRenderer *cell,
+                               GtkTreeModel    *model,
+                               GtkTreeIter     *iter,
+                               gpointer         user_data)
+{
+  GbpTodoPanel *self = user_data;
+  g_autoptr(GFile) file = NULL;
+  g_autofree gchar *relpath = NULL;
+  g_autofree gchar *text = NULL;
+  guint line = 0;
+
+  gtk_tree_model_get (model, iter,
+                      COLUMN_FILE, &file,
+                      COLUMN_LINE, &line,
+                      -1);
+
+  if (self->workdir != NULL)
+    relpath = g_file_get_relative_path (self->workdir, file);
+
+  if (relpath == NULL)
+    relpath = g_file_get_path (file);
+
+  text = g_strdup_printf ("%s:%u", relpath, line + 1);
+  g_object_set (cell, "text", text, NULL);
+}
+
+static void
+gbp_todo_panel_message_data_func (GtkCellLayout   *cell_layout,
+                                  GtkCellRenderer *cell,
+                                  GtkTreeModel    *model,
+                                  GtkTreeIter     *iter,
+                                  gpointer         user_data)
+{
+  g_autofree gchar *message = NULL;
+  gchar *eol;
+
+  gtk_tree_model_get (model, iter, COLUMN_MESSAGE, &message, -1);
+
+  /* Only the first line, the tooltip has the rest */
+  if (message != NULL && NULL != (eol = strchr (message, '\n')))
+    *eol = '\0';
+
+  g_object_set (cell, "text", message, NULL);
+}
+
+static gboolean
+gbp_todo_panel_query_tooltip (GbpTodoPanel *self,
+                              gint          x,
+                              gint          y,
+                              gboolean      keyboard_mode,
+                              GtkTooltip   *tooltip,
+                              GtkTreeView  *tree_view)
+{
+  g_autofree gchar *message = NULL;
+  g_autofree gchar *escaped = NULL;
+  g_autofree gchar *markup = NULL;
+  GtkTreeModel *model = NULL;
+  GtkTreeIter iter;
+
+  g_assert (GBP_IS_TODO_PANEL (self));
+  g_assert (GTK_IS_TOOLTIP (tooltip));
+  g_assert (GTK_IS_TREE_VIEW (tree_view));
+
+  if (!gtk_tree_view_get_tooltip_context (tree_view, &x, &y, keyboard_mode, &model, NULL, &iter))
+    return FALSE;
+
+  gtk_tree_model_get (model, &iter, COLUMN_MESSAGE, &message, -1);
+
+  if (message == NULL)
+    return FALSE;
+
+  escaped = g_markup_escape_text (message, -1);
+  markup = g_strdup_printf ("<tt>%s</tt>", escaped);
+  gtk_tooltip_set_markup (tooltip, markup);
+
+  return TRUE;
+}
+
+static void
+gbp_todo_panel_row_activated (GbpTodoPanel      *self,
+                              GtkTreePath       *path,
+                              GtkTreeViewColumn *column,
+                              GtkTreeView       *tree_view)
+{
+  g_autoptr(GFile) file = NULL;
+  g_autoptr(IdeUri) uri = NULL;
+  g_autofree gchar *fragment = NULL;
+  GtkWidget *workbench;
+  GtkTreeIter iter;
+  guint line = 0;
+
+  g_assert (GBP_IS_TODO_PANEL (self));
+  g_assert (path != NULL);
+  g_assert (GTK_IS_TREE_VIEW (tree_view));
+
+  if (!gtk_tree_model_get_iter (GTK_TREE_MODEL (self->model), &iter, path))
+    return;
+
+  gtk_tree_model_get (GTK_TREE_MODEL (self->model), &iter,
+                      COLUMN_FILE, &file,
+                      COLUMN_LINE, &line,
+                      -1);
+
+  if (NULL == (workbench = gtk_widget_get_ancestor (GTK_WIDGET (self), IDE_TYPE_WORKBENCH)))
+    return;
+
+  uri = ide_uri_new_from_file (file);
+  fragment = g_strdup_printf ("L%u", line);
+  ide_uri_set_fragment (uri, fragment);
+
+  ide_workbench_open_uri_async (IDE_WORKBENCH (workbench),
+                                uri,
+                                "editor",
+                                IDE_WORKBENCH_OPEN_FLAGS_NONE,
+                                NULL,
+                                NULL,
+                                NULL);
+}
+
+static void
+file_rows_free (gpointer data)
+{
+  g_slice_free (FileRows, data);
+}
+
+GbpTodoIndex *
+gbp_todo_panel_get_index (GbpTodoPanel *self)
+{
+  g_return_val_if_fail (GBP_IS_TODO_PANEL (self), NULL);
+
+  return self->index;
+}
+
+void
+gbp_todo_panel_set_index (GbpTodoPanel *self,
+                          GbpTodoIndex *index)
+{
+  g_autoptr(GPtrArray) files = NULL;
+  guint i;
+
+  g_return_if_fail (GBP_IS_TODO_PANEL (self));
+  g_return_if_fail (!index || GBP_IS_TODO_INDEX (index));
+
+  if (self->index == index)
+    return;
+
+  if (self->index != NULL)
+    {
+      g_signal_handlers_disconnect_by_func (self->index,
+                                            G_CALLBACK (gbp_todo_panel_file_changed),
+                                            self);
+      g_hash_table_remove_all (self->rows);
+      gtk_list_store_clear (self->model);
+      g_clear_object (&self->workdir);
+      g_clear_object (&self->index);
+    }
+
+  if (index != NULL)
+    {
+      IdeContext *context = ide_object_get_context (IDE_OBJECT (index));
+      IdeVcs *vcs = ide_context_get_vcs (context);
+
+      self->index = g_object_ref (index);
+      self->workdir = g_object_ref (ide_vcs_get_working_directory (vcs));
+
+      g_signal_connect_object (index,
+                               "file-changed",
+                               G_CALLBACK (gbp_todo_panel_file_changed),
+                               self,
+                               G_CONNECT_SWAPPED);
+
+      files = gbp_todo_index_get_files (index);
+
+      for (i = 0; i < files->len; i++)
+        gbp_todo_panel_file_changed (self, g_ptr_array_index (files, i), index);
+    }
+
+  g_object_notify_by_pspec (G_OBJECT (self), properties [PROP_INDEX]);
+}
+
+static void
+gbp_todo_panel_destroy (GtkWidget *widget)
+{
+  GbpTodoPanel *self = (GbpTodoPanel *)widget;
+
+  if (self->index != NULL)
+    gbp_todo_panel_set_index (self, NULL);
+
+  GTK_WIDGET_CLASS (gbp_todo_panel_parent_class)->destroy (widget);
+}
+
+static void
+gbp_todo_panel_finalize (GObject *object)
+{
+  GbpTodoPanel *self = (GbpTodoPanel *)object;
+
+  g_clear_pointer (&self->rows, g_hash_table_unref);
+  g_clear_object (&self->model);
+  g_clear_object (&self->workdir);
+  g_clear_object (&self->index);
+
+  G_OBJECT_CLASS (gbp_todo_panel_parent_class)->finalize (object);
+}
+
+static void
+gbp_todo_panel_get_property (GObject    *object,
+                             guint       prop_id,
+                             GValue     *value,
+                             GParamSpec *pspec)
+{
+  GbpTodoPanel *self = GBP_TODO_PANEL (object);
+
+  switch (prop_id)
+    {
+    case PROP_INDEX:
+      g_value_set_object (value, gbp_todo_panel_get_index (self));
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+    }
+}
+
+static void
+gbp_todo_panel_set_property (GObject      *object,
+                             guint         prop_id,
+                             const GValue *value,
+                             GParamSpec   *pspec)
+{
+  GbpTodoPanel *self = GBP_TODO_PANEL (object);
+
+  switch (prop_id)
+    {
+    case PROP_INDEX:
+      gbp_todo_panel_set_index (self, g_value_get_object (value));
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+    }
+}
+
+static void
+gbp_todo_panel_class_init (GbpTodoPanelClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  GtkWidgetClass *widget_class = GTK_WIDGET_CLASS (klass);
+
+  object_class->finalize = gbp_todo_panel_finalize;
+  object_class->get_property = gbp_todo_panel_get_property;
+  object_class->set_property = gbp_todo_panel_set_property;
+
+  widget_class->destroy = gbp_todo_panel_destroy;
+
+  properties [PROP_INDEX] =
+    g_param_spec_object ("index",
+                         "Index",
+                         "The todo index to display",
+                         GBP_TYPE_TODO_INDEX,
+                         (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_properties (object_class, N_PROPS, properties);
+}
+
+static void
+gbp_todo_panel_init (GbpTodoPanel *self)
+{
+  GtkTreeViewColumn *column;
+  GtkCellRenderer *cell;
+  GtkWidget *scroller;
+
+  self->rows = g_hash_table_new_full (g_file_hash,
+                                      (GEqualFunc)g_file_equal,
+                                      g_object_unref,
+                                      file_rows_free);
+  self->model = gtk_list_store_new (N_COLUMNS, G_TYPE_FILE, G_TYPE_UINT, G_TYPE_STRING);
+
+  g_object_set (self,
+                "title", _("Todo"),
+                "expand", TRUE,
+                NULL);
+
+  scroller = g_object_new (GTK_TYPE_SCROLLED_WINDOW,
+                           "visible", TRUE,
+                           NULL);
+  gtk_container_add (GTK_CONTAINER (self), scroller);
+
+  self->tree_view = g_object_new (GTK_TYPE_TREE_VIEW,
+                                  "has-tooltip", TRUE,
+                                  "model", self->model,
+                                  "visible", TRUE,
+                                  NULL);
+  g_signal_connect_object (self->tree_view,
+                           "query-tooltip",
+                           G_CALLBACK (gbp_todo_panel_query_tooltip),
+                           self,
+                           G_CONNECT_SWAPPED);
+  g_signal_connect_object (self->tree_view,
+                           "row-activated",
+                           G_CALLBACK (gbp_todo_panel_row_activated),
+                           self,
+                           G_CONNECT_SWAPPED);
+  gtk_container_add (GTK_CONTAINER (scroller), GTK_WIDGET (self->tree_view));
+
+  column = g_object_new (GTK_TYPE_TREE_VIEW_COLUMN,
+                         "title", _("File"),
+                         NULL);
+  cell = g_object_new (GTK_TYPE_CELL_RENDERER_TEXT,
+                       "xalign", 0.0f,
+                       NULL);
+  gtk_cell_layout_pack_start (GTK_CELL_LAYOUT (column), cell, TRUE);
+  gtk_cell_layout_set_cell_data_func (GTK_CELL_LAYOUT (column), cell,
+                                      gbp_todo_panel_file_data_func,
+                                      self, NULL);
+  gtk_tree_view_append_column (self->tree_view, column);
+
+  column = g_object_new (GTK_TYPE_TREE_VIEW_COLUMN,
+                         "title", _("Message"),
+                         NULL);
+  cell = g_object_new (GTK_TYPE_CELL_RENDERER_TEXT,
+                       "xalign", 0.0f,
+                       NULL);
+  gtk_cell_layout_pack_start (GTK_CELL_LAYOUT (column), cell, TRUE);
+  gtk_cell_layout_set_cell_data_func (GTK_CELL_LAYOUT (column), cell,
+                                      gbp_todo_panel_message_data_func,
+                                      NULL, NULL);
+  gtk_tree_view_append_column (self->tree_view, column);
+}
@@ -0,0 +1,98 @@
+/* gbp-todo-workbench-addin.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gbp-todo-index.h"
+#include "gbp-todo-panel.h"
+#include "gbp-todo-workbench-addin.h"
+
+struct _GbpTodoWorkbenchAddin
+{
+  GObject       parent_instance;
+
+  /* Unowned */
+  GbpTodoPanel *panel;
+
+  /* Owned */
+  GbpTodoIndex *index;
+};
+
+static void workbench_addin_iface_init (IdeWorkbenchAddinInterface *iface);
+
+G_DEFINE_TYPE_EXTENDED (GbpTodoWorkbenchAddin, gbp_todo_workbench_addin, G_TYPE_OBJECT, 0,
+                        G_IMPLEMENT_INTERFACE (IDE_TYPE_WORKBENCH_ADDIN, workbench_addin_iface_init))
+
+static void
+gbp_todo_workbench_addin_load (IdeWorkbenchAddin *addin,
+                               IdeWorkbench      *workbench)
+{
+  GbpTodoWorkbenchAddin *self = (GbpTodoWorkbenchAddin *)addin;
+  IdePerspective *editor;
+  IdeContext *context;
+  GtkWidget *pane;
+
+  g_assert (GBP_IS_TODO_WORKBENCH_ADDIN (self));
+  g_assert (IDE_IS_WORKBENCH (workbench));
+
+  context = ide_workbench_get_context (workbench);
+
+  self->index = gbp_todo_index_new (context);
+
+  editor = ide_workbench_get_perspective_by_name (workbench, "editor");
+  pane = pnl_dock_bin_get_bottom_edge (PNL_DOCK_BIN (editor));
+  self->panel = g_object_new (GBP_TYPE_TODO_PANEL,
+                              "index", self->index,
+                              "visible", TRUE,
+                              NULL);
+  gtk_container_add (GTK_CONTAINER (pane), GTK_WIDGET (self->panel));
+
+  gbp_todo_index_load (self->index);
+}
+
+static void
+gbp_todo_workbench_addin_unload (IdeWorkbenchAddin *addin,
+                                 IdeWorkbench      *workbench)
+{
+  GbpTodoWorkbenchAddin *self = (GbpTodoWorkbenchAddin *)addin;
+
+  g_assert (GBP_IS_TODO_WORKBENCH_ADDIN (self));
+  g_assert (IDE_IS_WORKBENCH (workbench));
+
+  gtk_widget_destroy (GTK_WIDGET (self->panel));
+  self->panel = NULL;
+
+  /* The running rescan holds a reference, so stop it before the context goes */
+  gbp_todo_index_shutdown (self->index);
+  g_clear_object (&self->index);
+}
+
+static void
+gbp_todo_workbench_addin_class_init (GbpTodoWorkbenchAddinClass *klass)
+{
+}
+
+static void
+gbp_todo_workbench_addin_init (GbpTodoWorkbenchAddin *self)
+{
+}
+
+static void
+workbench_addin_iface_init (IdeWorkbenchAddinInterface *iface)
+{
+  iface->load = gbp_todo_workbench_addin_load;
+  iface->unload = gbp_todo_workbench_addin_unload;
+}
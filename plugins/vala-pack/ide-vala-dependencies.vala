@@ -0,0 +1,102 @@
+/* ide-vala-dependencies.vala
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+using GLib;
+using Vala;
+
+/* Finds the project source files whose symbols are referenced by a checked file */
+namespace Ide
+{
+	public class ValaDependencyVisitor: Vala.CodeVisitor
+	{
+		Vala.SourceFile source_file;
+		HashSet<Vala.SourceFile> found;
+
+		public HashSet<Vala.SourceFile> collect (Vala.SourceFile source_file)
+		{
+			this.source_file = source_file;
+			this.found = new HashSet<Vala.SourceFile> ();
+			source_file.accept_children (this);
+			return this.found;
+		}
+
+		void add (Vala.Symbol? symbol)
+		{
+			if (symbol == null || symbol.source_reference == null)
+				return;
+
+			var file = symbol.source_reference.file;
+
+			/* Packages are never reparsed, so they are not interesting */
+			if (file != null && file != this.source_file &&
+			    file.file_type == Vala.SourceFileType.SOURCE) {
+				this.found.add (file);
+			}
+		}
+
+		public override void visit_data_type (Vala.DataType type) {
+			this.add (type.data_type);
+			type.accept_children (this);
+		}
+		public override void visit_expression (Vala.Expression expr) {
+			this.add (expr.symbol_reference);
+			expr.accept_children (this);
+		}
+
+		public override void visit_namespace (Vala.Namespace ns) { ns.accept_children (this); }
+		public override void visit_class (Vala.Class cl) { cl.accept_children (this); }
+		public override void visit_struct (Vala.Struct st) { st.accept_children (this); }
+		public override void visit_interface (Vala.Interface iface) { iface.accept_children (this); }
+		public override void visit_enum (Vala.Enum en) { en.accept_children (this); }
+		public override void visit_enum_value (Vala.EnumValue ev) { ev.accept_children (this); }
+		public override void visit_error_domain (Vala.ErrorDomain edomain) { edomain.accept_children (this); }
+		public override void visit_delegate (Vala.Delegate d) { d.accept_children (this); }
+		public override void visit_constant (Vala.Constant c) { c.accept_children (this); }
+		public override void visit_field (Vala.Field f) { f.accept_children (this); }
+		public override void visit_method (Vala.Method m) { m.accept_children (this); }
+		public override void visit_creation_method (Vala.CreationMethod m) { m.accept_children (this); }
+		public override void visit_formal_parameter (Vala.Parameter p) { p.accept_children (this); }
+		public override void visit_property (Vala.Property prop) { prop.accept_children (this); }
+		public override void visit_property_accessor (Vala.PropertyAccessor acc) { acc.accept_children (this); }
+		public override void visit_signal (Vala.Signal sig) { sig.accept_children (this); }
+		public override void visit_constructor (Vala.Constructor c) { c.accept_children (this); }
+		public override void visit_destructor (Vala.Destructor d) { d.accept_children (this); }
+
+		public override void visit_block (Vala.Block b) { b.accept_children (this); }
+		public override void visit_declaration_statement (Vala.DeclarationStatement stmt) { stmt.accept_children (this); }
+		public override void visit_local_variable (Vala.LocalVariable local) { local.accept_children (this); }
+		public override void visit_expression_statement (Vala.ExpressionStatement stmt) { stmt.accept_children (this); }
+		public override void visit_if_statement (Vala.IfStatement stmt) { stmt.accept_children (this); }
+		public override void visit_switch_statement (Vala.SwitchStatement stmt) { stmt.accept_children (this); }
+		public override void visit_switch_section (Vala.SwitchSection section) { section.accept_children (this); }
+		public override void visit_switch_label (Vala.SwitchLabel label) { label.accept_children (this); }
+		public override void visit_loop (Vala.Loop stmt) { stmt.accept_children (this); }
+		public override void visit_while_statement (Vala.WhileStatement stmt) { stmt.accept_children (this); }
+		public override void visit_do_statement (Vala.DoStatement stmt) { stmt.accept_children (this); }
+		public override void visit_for_statement (Vala.ForStatement stmt) { stmt.accept_children (this); }
+		public override void visit_foreach_statement (Vala.ForeachStatement stmt) { stmt.accept_children (this); }
+		public override void visit_return_statement (Vala.ReturnStatement stmt) { stmt.accept_children (this); }
+		public override void visit_yield_statement (Vala.YieldStatement stmt) { stmt.accept_children (this); }
+		public override void visit_throw_statement (Vala.ThrowStatement stmt) { stmt.accept_children (this); }
+		public override void visit_try_statement (Vala.TryStatement stmt) { stmt.accept_children (this); }
+		public override void visit_catch_clause (Vala.CatchClause clause) { clause.accept_children (this); }
+		public override void visit_lock_statement (Vala.LockStatement stmt) { stmt.accept_children (this); }
+		public override void visit_unlock_statement (Vala.UnlockStatement stmt) { stmt.accept_children (this); }
+		public override void visit_delete_statement (Vala.DeleteStatement stmt) { stmt.accept_children (this); }
+	}
+}
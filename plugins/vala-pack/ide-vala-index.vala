@@ -22,6 +22,23 @@
  * files for a particular context. Typically, you would have one index
  * per project. Therefore, we use the singleton-per-project nature of
  * Ide.Service (via Ide.ValaService) to keep an index-per-project.
+ *
+ * The Vala code context is modified in place by the parser and the semantic
+ * analyzer. Anything that modifies it (adding files, reparsing) holds the
+ * writer side of tree_lock, and code that only walks the tree (completion,
+ * symbol lookup) holds the reader side, so those can run in parallel with
+ * each other. Results that do not need the tree, such as diagnostics and
+ * symbol trees, are published in an Ide.ValaSnapshot after each reparse and
+ * can be used without waiting for a reparse that is in progress.
+ *
+ * Nothing is parsed while the index is created. The default packages are
+ * added and parsed by the first operation that needs the tree, on a worker
+ * thread, so opening a project does not wait for the vapi files.
+ *
+ * The parsed vapi files are not cached on disk. libvala cannot serialize a
+ * parsed or checked tree, and finding the vapi files is cheap next to
+ * parsing them, so a cache keyed by path and mtime would only save a few
+ * stat() calls. Every session parses the packages it uses again.
  */
 
 using GLib;
@@ -38,6 +55,16 @@ namespace Ide
 		Vala.Parser parser;
 		HashMap<GLib.File,Ide.ValaSourceFile> source_files;
 		Ide.ValaDiagnostics report;
+		GLib.RWLock tree_lock = GLib.RWLock ();
+
+		/* Which files reference the symbols of a file, and the reverse */
+		HashMap<Vala.SourceFile,HashSet<Vala.SourceFile>> dependents;
+		HashMap<Vala.SourceFile,HashSet<Vala.SourceFile>> dependencies;
+
+		Ide.ValaSnapshot snapshot;
+		uint generation;
+		bool needs_check;
+		bool loaded;
 
 		public ValaIndex (Ide.Context context)
 		{
@@ -45,6 +72,9 @@ namespace Ide
 			var workdir = vcs.get_working_directory();
 
 			this.source_files = new HashMap<GLib.File,Ide.ValaSourceFile> (GLib.File.hash, (GLib.EqualFunc)GLib.File.equal);
+			this.dependents = new HashMap<Vala.SourceFile,HashSet<Vala.SourceFile>> ();
+			this.dependencies = new HashMap<Vala.SourceFile,HashSet<Vala.SourceFile>> ();
+			this.snapshot = new Ide.ValaSnapshot (0, null);
 
 			this.context = context;
 			this.code_context = new Vala.CodeContext ();
@@ -114,16 +144,10 @@ namespace Ide
 				this.add_vapidir_locked (unversioned_vapidir);
 			}
 
-			this.code_context.add_external_package ("glib-2.0");
-			this.code_context.add_external_package ("gobject-2.0");
-
 			this.report = new Ide.ValaDiagnostics ();
 			this.code_context.report = this.report;
 
 			this.parser = new Vala.Parser ();
-			this.parser.parse (this.code_context);
-
-			this.code_context.check ();
 
 			Vala.CodeContext.pop ();
 		}
@@ -152,19 +176,19 @@ namespace Ide
 		                             GLib.Cancellable? cancellable)
 		{
 			Ide.ThreadPool.push (Ide.ThreadPoolKind.COMPILER, () => {
-				lock (this.code_context) {
-					Vala.CodeContext.push (this.code_context);
-					foreach (var file in files)
-						this.add_file (file);
-					Vala.CodeContext.pop ();
-					GLib.Idle.add(add_files.callback);
-				}
+				this.tree_lock.writer_lock ();
+				Vala.CodeContext.push (this.code_context);
+				foreach (var file in files)
+					this.add_file (file);
+				Vala.CodeContext.pop ();
+				this.tree_lock.writer_unlock ();
+				GLib.Idle.add(add_files.callback);
 			});
 
 			yield;
 		}
 
-		/* Caller is expected to hold code_context lock */
+		/* Caller is expected to hold the writer lock */
 		void add_vapidir_locked (string vapidir)
 		{
 			var dirs = this.code_context.vapi_directories;
@@ -180,7 +204,22 @@ namespace Ide
 			this.code_context.vapi_directories = dirs;
 		}
 
-		/* Caller is expected to hold code_context lock */
+		/*
+		 * Caller is expected to hold the writer lock. This parses the
+		 * default packages from their vapi files, there is no cache.
+		 */
+		void ensure_loaded_locked ()
+		{
+			if (this.loaded)
+				return;
+
+			this.loaded = true;
+
+			this.code_context.add_external_package ("glib-2.0");
+			this.code_context.add_external_package ("gobject-2.0");
+		}
+
+		/* Caller is expected to hold the writer lock */
 		void add_girdir_locked (string girdir)
 		{
 			var dirs = this.code_context.gir_directories;
@@ -195,7 +234,7 @@ namespace Ide
 			this.code_context.gir_directories = dirs;
 		}
 
-		/* Caller is expected to hold code_context lock */
+		/* Caller is expected to hold the writer lock */
 		void add_metadatadir_locked (string metadata_dir)
 		{
 			var dirs = this.code_context.metadata_directories;
@@ -212,65 +251,71 @@ namespace Ide
 
 		void load_build_flags (string[] flags)
 		{
-			var len = GLib.strv_length (flags);
+			this.tree_lock.writer_lock ();
+			this.load_build_flags_locked (flags);
+			this.tree_lock.writer_unlock ();
+		}
 
-			lock (this.code_context) {
-				Vala.CodeContext.push (this.code_context);
+		/* Caller is expected to hold the writer lock */
+		void load_build_flags_locked (string[] flags)
+		{
+			var len = GLib.strv_length (flags);
 
-				var packages = new ArrayList<string> ();
+			Vala.CodeContext.push (this.code_context);
 
-				for (var i = 0; i < len; i++) {
-					string next_param = null;
-					string param = flags[i];
+			var packages = new ArrayList<string> ();
 
-					if (param.contains ("=")) {
-						var offset = param.index_of("=") + 1;
-						next_param = param.offset(offset);
-					} else if (i + 1 < len) {
-						next_param = flags[i + 1];
-					}
+			for (var i = 0; i < len; i++) {
+				string next_param = null;
+				string param = flags[i];
 
-					if (next_param != null) {
-						if (param.has_prefix("--pkg")) {
-							packages.add (next_param);
-						} else if (param.has_prefix ("--vapidir")) {
-							this.add_vapidir_locked (next_param);
-						} else if (param.has_prefix ("--vapi")) {
-							packages.add (next_param);
-						} else if (param.has_prefix ("--girdir")) {
-							this.add_girdir_locked (next_param);
-						} else if (param.has_prefix ("--metadatadir")) {
-							this.add_metadatadir_locked (next_param);
-						} else if (param.has_prefix ("--target-glib")) {
-							/* TODO: Parse glib version ~= 2.44 */
-						}
+				if (param.contains ("=")) {
+					var offset = param.index_of("=") + 1;
+					next_param = param.offset(offset);
+				} else if (i + 1 < len) {
+					next_param = flags[i + 1];
+				}
 
-						continue;
+				if (next_param != null) {
+					if (param.has_prefix("--pkg")) {
+						packages.add (next_param);
+					} else if (param.has_prefix ("--vapidir")) {
+						this.add_vapidir_locked (next_param);
+					} else if (param.has_prefix ("--vapi")) {
+						packages.add (next_param);
+					} else if (param.has_prefix ("--girdir")) {
+						this.add_girdir_locked (next_param);
+					} else if (param.has_prefix ("--metadatadir")) {
+						this.add_metadatadir_locked (next_param);
+					} else if (param.has_prefix ("--target-glib")) {
+						/* TODO: Parse glib version ~= 2.44 */
 					}
-					else if (param.has_suffix (".vapi")) {
-						if (!GLib.Path.is_absolute (param)) {
-							var vcs = this.context.get_vcs ();
-							var workdir = vcs.get_working_directory ();
-							var child = workdir.get_child (param);
-							this.add_file (child);
-						} else {
-							this.add_file (GLib.File.new_for_path (param));
-						}
+
+					continue;
+				}
+				else if (param.has_suffix (".vapi")) {
+					if (!GLib.Path.is_absolute (param)) {
+						var vcs = this.context.get_vcs ();
+						var workdir = vcs.get_working_directory ();
+						var child = workdir.get_child (param);
+						this.add_file (child);
+					} else {
+						this.add_file (GLib.File.new_for_path (param));
 					}
-					else if (param == "--thread") {
+				}
+				else if (param == "--thread") {
 #if ENABLE_VALA_CODE_CONTEXT_SET_THREAD
-						this.code_context.thread = true;
+					this.code_context.thread = true;
 #endif
-					}
-				}
-
-				/* Now add external packages after vapidir/girdir have been added */
-				foreach (var package in packages) {
-					this.code_context.add_external_package (package);
 				}
+			}
 
-				Vala.CodeContext.pop ();
+			/* Now add external packages after vapidir/girdir have been added */
+			foreach (var package in packages) {
+				this.code_context.add_external_package (package);
 			}
+
+			Vala.CodeContext.pop ();
 		}
 
 		async void update_build_flags (GLib.File file,
@@ -302,29 +347,23 @@ namespace Ide
 
 			Ide.ThreadPool.push (Ide.ThreadPoolKind.COMPILER, () => {
 				if ((cancellable == null) || !cancellable.is_cancelled ()) {
-					lock (this.code_context) {
-						Vala.CodeContext.push (this.code_context);
-
-						if (!this.source_files.contains (file))
-							this.add_file (file);
+					this.tree_lock.writer_lock ();
+					Vala.CodeContext.push (this.code_context);
 
-						/* Ensure vala has loaded the contents */
-						var source_file = this.source_files[file];
-						source_file.get_mapped_contents ();
+					if (!this.source_files.contains (file))
+						this.add_file (file);
 
-						this.apply_unsaved_files (unsaved_files_copy);
-						this.report.clear ();
-						this.reparse ();
-						if (this.report.get_errors () == 0 &&
-						        (cancellable == null || !cancellable.is_cancelled ())) {
-						    this.code_context.check ();
-						}
+					/* Ensure vala has loaded the contents */
+					var source_file = this.source_files[file];
+					source_file.get_mapped_contents ();
 
-						GLib.Idle.add(this.parse_file.callback);
+					this.update_locked (unsaved_files_copy, cancellable);
 
-						Vala.CodeContext.pop ();
-					}
+					Vala.CodeContext.pop ();
+					this.tree_lock.writer_unlock ();
 				}
+
+				GLib.Idle.add(this.parse_file.callback);
 			});
 
 			yield;
@@ -346,28 +385,33 @@ namespace Ide
 			var result = new Ide.CompletionResults (provider.query);
 
 			if ((cancellable == null) || !cancellable.is_cancelled ()) {
-				lock (this.code_context) {
-					Vala.CodeContext.push (this.code_context);
+				/* Only take the writer lock if something actually changed */
+				this.tree_lock.reader_lock ();
+				var needs_update = this.needs_update_locked (unsaved_files_copy);
+				this.tree_lock.reader_unlock ();
 
-					this.apply_unsaved_files (unsaved_files_copy);
-					this.report.clear ();
-					this.reparse ();
-					if (this.report.get_errors () == 0 &&
-					        (cancellable == null || !cancellable.is_cancelled ())) {
-					    this.code_context.check ();
-					}
+				if (needs_update) {
+					this.tree_lock.writer_lock ();
+					Vala.CodeContext.push (this.code_context);
+					this.update_locked (unsaved_files_copy, cancellable);
+					Vala.CodeContext.pop ();
+					this.tree_lock.writer_unlock ();
+				}
 
-					if (this.source_files.contains (file)) {
-						var source_file = this.source_files [file];
-						string? text = (line_text == null) ? source_file.get_source_line (line) : line_text;
-						var locator = new Ide.ValaLocator ();
-						var nearest = locator.locate (source_file, line, column);
+				this.tree_lock.reader_lock ();
+				Vala.CodeContext.push (this.code_context);
 
-						this.add_completions (source_file, ref line, ref column, text, nearest, result, provider);
-					}
+				if (this.source_files.contains (file)) {
+					var source_file = this.source_files [file];
+					string? text = (line_text == null) ? source_file.get_source_line (line) : line_text;
+					var locator = new Ide.ValaLocator ();
+					var nearest = locator.locate (source_file, line, column);
 
-					Vala.CodeContext.pop ();
+					this.add_completions (source_file, ref line, ref column, text, nearest, result, provider);
 				}
+
+				Vala.CodeContext.pop ();
+				this.tree_lock.reader_unlock ();
 			}
 
 			result_line = line;
@@ -379,24 +423,119 @@ namespace Ide
 		public async Ide.Diagnostics? get_diagnostics (GLib.File file,
 		                                               GLib.Cancellable? cancellable = null)
 		{
-			Ide.Diagnostics? diagnostics = null;
+			/* The diagnostics of the last reparse, which parse_file() waits for */
+			return this.get_snapshot ().get_diagnostics (file);
+		}
 
-			Ide.ThreadPool.push (Ide.ThreadPoolKind.COMPILER, () => {
-				if ((cancellable == null) || !cancellable.is_cancelled ()) {
-					lock (this.code_context) {
-						Vala.CodeContext.push (this.code_context);
-						if (this.source_files.contains (file)) {
-							diagnostics = this.source_files[file].diagnose ();
-						}
-						Vala.CodeContext.pop ();
-					}
+		Ide.ValaSnapshot get_snapshot ()
+		{
+			Ide.ValaSnapshot ret;
+
+			lock (this.snapshot) {
+				ret = this.snapshot;
+			}
+
+			return ret;
+		}
+
+		/* Caller is expected to hold the writer lock */
+		void publish_snapshot (HashSet<Vala.SourceFile> revisited)
+		{
+			var diagnostics = new HashMap<GLib.File,Ide.Diagnostics> (GLib.File.hash, (GLib.EqualFunc)GLib.File.equal);
+			var changed = new HashSet<GLib.File> (GLib.File.hash, (GLib.EqualFunc)GLib.File.equal);
+
+			foreach (var file in this.source_files.get_keys ()) {
+				diagnostics [file] = this.source_files [file].diagnose ();
+			}
+
+			foreach (var source_file in revisited) {
+				if (source_file is Ide.ValaSourceFile) {
+					changed.add ((source_file as Ide.ValaSourceFile).get_file ());
 				}
-				GLib.Idle.add(this.get_diagnostics.callback);
-			});
+			}
 
-			yield;
+			var snapshot = new Ide.ValaSnapshot (++this.generation, diagnostics);
+			snapshot.inherit_symbol_trees (this.get_snapshot (), changed);
 
-			return diagnostics;
+			lock (this.snapshot) {
+				this.snapshot = snapshot;
+			}
+		}
+
+		/* Caller is expected to hold the reader lock */
+		bool needs_update_locked (GLib.GenericArray<Ide.UnsavedFile>? unsaved_files)
+		{
+			if (!this.loaded || this.needs_check)
+				return true;
+
+			foreach (var source_file in this.source_files.get_values ()) {
+				if (source_file.dirty)
+					return true;
+
+				if ((unsaved_files != null) &&
+				    (source_file.file_type == Vala.SourceFileType.SOURCE) &&
+				    source_file.needs_sync (unsaved_files))
+					return true;
+			}
+
+			return false;
+		}
+
+		/* Caller is expected to hold the writer lock */
+		void update_locked (GLib.GenericArray<Ide.UnsavedFile>? unsaved_files,
+		                    GLib.Cancellable? cancellable)
+		{
+			this.ensure_loaded_locked ();
+
+			if (unsaved_files != null)
+				this.apply_unsaved_files (unsaved_files);
+
+			var revisited = this.reparse ();
+
+			if (revisited.size == 0 && !this.needs_check)
+				return;
+
+			if (this.report.get_errors () == 0 &&
+			        (cancellable == null || !cancellable.is_cancelled ())) {
+			    this.code_context.check ();
+			    this.needs_check = false;
+			} else {
+			    this.needs_check = true;
+			}
+
+			foreach (var source_file in revisited) {
+				this.update_dependencies (source_file);
+			}
+
+			this.publish_snapshot (revisited);
+		}
+
+		/* Caller is expected to hold the writer lock */
+		void update_dependencies (Vala.SourceFile source_file)
+		{
+			var previous = this.dependencies [source_file];
+
+			if (previous != null) {
+				foreach (var target in previous) {
+					var set = this.dependents [target];
+					if (set != null)
+						set.remove (source_file);
+				}
+			}
+
+			var visitor = new Ide.ValaDependencyVisitor ();
+			var targets = visitor.collect (source_file);
+
+			this.dependencies [source_file] = targets;
+
+			foreach (var target in targets) {
+				var set = this.dependents [target];
+				if (set == null) {
+					set = new HashSet<Vala.SourceFile> ();
+					this.dependents [target] = set;
+				}
+				set.add (source_file);
+			}
 		}
 
 		void apply_unsaved_files (GLib.GenericArray<Ide.UnsavedFile> unsaved_files)
@@ -409,18 +548,63 @@ namespace Ide
 			}
 		}
 
-		void reparse ()
+		/*
+		 * Parses the files that were reset along with the files depending on
+		 * them, and returns them.
+		 *
+		 * Caller is expected to hold the writer lock
+		 */
+		HashSet<Vala.SourceFile> reparse ()
 		{
+			var revisit = new HashSet<Vala.SourceFile> ();
+			var queue = new GLib.Queue<Vala.SourceFile> ();
+
 			this.report.clear ();
 
 			foreach (var source_file in this.code_context.get_source_files ()) {
 				if (source_file.get_nodes ().size == 0) {
-					this.parser.visit_source_file (source_file);
-					if (source_file is Ide.ValaSourceFile) {
-						(source_file as Ide.ValaSourceFile).dirty = false;
-					}
+					revisit.add (source_file);
+					queue.push_tail (source_file);
+				}
+			}
+
+			/*
+			 * Files that were checked against the symbols of a changed file
+			 * still reference the old symbols. Resetting them recreates their
+			 * own symbols too, so this has to be transitive.
+			 */
+			while (queue.length > 0) {
+				var source_file = queue.pop_head ();
+				var set = this.dependents [source_file];
+
+				if (set == null)
+					continue;
+
+				foreach (var dependent in set) {
+					if (revisit.contains (dependent) || !(dependent is Ide.ValaSourceFile))
+						continue;
+
+					(dependent as Ide.ValaSourceFile).reset ();
+					revisit.add (dependent);
+					queue.push_tail (dependent);
 				}
 			}
+
+			foreach (var source_file in revisit) {
+				this.parser.visit_source_file (source_file);
+				if (source_file is Ide.ValaSourceFile) {
+					(source_file as Ide.ValaSourceFile).dirty = false;
+
+					/*
+					 * get_source_line() fills in the line array lazily, which
+					 * is not safe from several readers at once. Do it now while
+					 * we hold the writer lock so readers only ever read it.
+					 */
+					source_file.get_source_line (1);
+				}
+			}
+
+			return revisit;
 		}
 
 		void add_completions (Ide.ValaSourceFile source_file,
@@ -461,22 +645,18 @@ namespace Ide
 			 */
 
 			Ide.ThreadPool.push (Ide.ThreadPoolKind.COMPILER, () => {
-				lock (this.code_context) {
-					Vala.CodeContext.push (this.code_context);
-
-					if (!this.source_files.contains (file)) {
-						this.add_file (file);
-						this.reparse ();
-					}
+				this.lock_file_for_reading (file);
+				Vala.CodeContext.push (this.code_context);
 
-					var source_file = this.source_files [file];
+				var source_file = this.source_files [file];
+				if (source_file != null) {
 					var locator = new Ide.ValaLocator ();
-
 					symbol = locator.locate (source_file, line, column);
-
-					Vala.CodeContext.pop ();
 				}
 
+				Vala.CodeContext.pop ();
+				this.tree_lock.reader_unlock ();
+
 				GLib.Idle.add (this.find_symbol_at.callback);
 			});
 
@@ -489,30 +669,29 @@ namespace Ide
 		                                              GLib.Cancellable? cancellable)
 			throws GLib.Error
 		{
-			Ide.SymbolTree? ret = null;
+			Ide.SymbolTree? ret = this.get_snapshot ().get_symbol_tree (file);
 
-			Ide.ThreadPool.push (Ide.ThreadPoolKind.COMPILER, () => {
-				lock (this.code_context) {
-					Vala.CodeContext.push (this.code_context);
-
-					if (!this.source_files.contains (file)) {
-						this.add_file (file);
-						this.reparse ();
-					}
+			if (ret != null)
+				return ret;
 
-					var source_file = this.source_files [file];
-					if (source_file.dirty) {
-						this.reparse ();
-					}
+			Ide.ThreadPool.push (Ide.ThreadPoolKind.COMPILER, () => {
+				this.lock_file_for_reading (file);
+				Vala.CodeContext.push (this.code_context);
 
+				var source_file = this.source_files [file];
+				if (source_file != null) {
 					var tree_builder = new Ide.ValaSymbolTreeVisitor ();
 					source_file.accept_children (tree_builder);
 					ret = tree_builder.build_tree ();
 
-					Vala.CodeContext.pop ();
-
-					GLib.Idle.add (this.get_symbol_tree.callback);
+					/* No reparse can happen while we hold the lock, so this is current */
+					this.get_snapshot ().add_symbol_tree (file, ret);
 				}
+
+				Vala.CodeContext.pop ();
+				this.tree_lock.reader_unlock ();
+
+				GLib.Idle.add (this.get_symbol_tree.callback);
 			});
 
 			yield;
@@ -520,6 +699,30 @@ namespace Ide
 			return ret;
 		}
 
+		/*
+		 * Acquires the reader lock, making sure that file has been added
+		 * and parsed first. Caller must release the reader lock.
+		 */
+		void lock_file_for_reading (GLib.File file)
+		{
+			this.tree_lock.reader_lock ();
+
+			if (this.loaded && this.source_files.contains (file) && !this.source_files [file].dirty)
+				return;
+
+			this.tree_lock.reader_unlock ();
+			this.tree_lock.writer_lock ();
+			Vala.CodeContext.push (this.code_context);
+
+			if (!this.source_files.contains (file))
+				this.add_file (file);
+			this.update_locked (null, null);
+
+			Vala.CodeContext.pop ();
+			this.tree_lock.writer_unlock ();
+			this.tree_lock.reader_lock ();
+		}
+
 		string? get_versioned_vapidir ()
 		{
 			try {
@@ -0,0 +1,102 @@
+/* ide-vala-snapshot.vala
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Ide.ValaSnapshot contains the results of one consistent generation of
+ * the Ide.ValaIndex. A new snapshot is published after every reparse, and
+ * since a snapshot is never changed afterwards (other than filling in the
+ * symbol tree cache), it can be used without waiting on the index.
+ */
+
+using GLib;
+using Ide;
+using Vala;
+
+namespace Ide
+{
+	public class ValaSnapshot: GLib.Object
+	{
+		HashMap<GLib.File,Ide.Diagnostics> diagnostics;
+		HashMap<GLib.File,Ide.SymbolTree> symbol_trees;
+
+		public uint generation { get; construct; }
+
+		public ValaSnapshot (uint generation,
+		                     HashMap<GLib.File,Ide.Diagnostics>? diagnostics)
+		{
+			GLib.Object (generation: generation);
+
+			if (diagnostics != null) {
+				this.diagnostics = diagnostics;
+			} else {
+				this.diagnostics = new HashMap<GLib.File,Ide.Diagnostics> (GLib.File.hash, (GLib.EqualFunc)GLib.File.equal);
+			}
+
+			this.symbol_trees = new HashMap<GLib.File,Ide.SymbolTree> (GLib.File.hash, (GLib.EqualFunc)GLib.File.equal);
+		}
+
+		public Ide.Diagnostics? get_diagnostics (GLib.File file)
+		{
+			return this.diagnostics [file];
+		}
+
+		public Ide.SymbolTree? get_symbol_tree (GLib.File file)
+		{
+			Ide.SymbolTree? ret = null;
+
+			lock (this.symbol_trees) {
+				ret = this.symbol_trees [file];
+			}
+
+			return ret;
+		}
+
+		public void add_symbol_tree (GLib.File file,
+		                             Ide.SymbolTree symbol_tree)
+		{
+			lock (this.symbol_trees) {
+				this.symbol_trees [file] = symbol_tree;
+			}
+		}
+
+		/*
+		 * Symbol trees reference the nodes of the file they were built from,
+		 * so they stay valid until that file is parsed again.
+		 */
+		public void inherit_symbol_trees (Ide.ValaSnapshot previous,
+		                                  HashSet<GLib.File> changed)
+		{
+			previous.foreach_symbol_tree ((file, symbol_tree) => {
+				if (!changed.contains (file)) {
+					this.add_symbol_tree (file, symbol_tree);
+				}
+			});
+		}
+
+		delegate void SymbolTreeFunc (GLib.File file, Ide.SymbolTree symbol_tree);
+
+		void foreach_symbol_tree (SymbolTreeFunc func)
+		{
+			lock (this.symbol_trees) {
+				foreach (var file in this.symbol_trees.get_keys ()) {
+					func (file, this.symbol_trees [file]);
+				}
+			}
+		}
+	}
+}
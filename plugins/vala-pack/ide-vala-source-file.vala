@@ -115,6 +115,22 @@ namespace Ide
 			});
 		}
 
+		/* Like sync(), but only checks whether the contents would change */
+		public bool needs_sync (GenericArray<Ide.UnsavedFile> unsaved_files)
+		{
+			var gfile = this.file.file;
+
+			for (var i = 0; i < unsaved_files.length; i++) {
+				var unsaved_file = unsaved_files[i];
+				if (unsaved_file.get_file ().equal (gfile)) {
+					var bytes = unsaved_file.get_content ();
+					return bytes.get_data () != (uint8[]) this.content;
+				}
+			}
+
+			return false;
+		}
+
 		public void report (Vala.SourceReference source_reference,
 		                    string message,
 		                    Ide.DiagnosticSeverity severity)
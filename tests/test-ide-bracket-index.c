@@ -0,0 +1,168 @@
+/* test-ide-bracket-index.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <ide.h>
+#include <string.h>
+
+static gint
+find (GtkTextBuffer *buffer,
+      const gchar   *needle)
+{
+  GtkTextIter begin;
+  GtkTextIter end;
+  g_autofree gchar *text = NULL;
+  const gchar *ptr;
+
+  gtk_text_buffer_get_bounds (buffer, &begin, &end);
+  text = gtk_text_buffer_get_text (buffer, &begin, &end, TRUE);
+  ptr = strstr (text, needle);
+  g_assert (ptr != NULL);
+
+  return g_utf8_pointer_to_offset (text, ptr);
+}
+
+static void
+test_bracket_index_basic (void)
+{
+  g_autoptr(GtkTextBuffer) buffer = NULL;
+  g_autoptr(IdeBracketIndex) index = NULL;
+  GtkTextIter iter;
+
+  buffer = gtk_text_buffer_new (NULL);
+  index = ide_bracket_index_new (buffer);
+
+  /* Without a language, callers should not trust the string handling */
+  g_assert (!ide_bracket_index_get_syntax_supported (index));
+
+  gtk_text_buffer_set_text (buffer, "a (b [c {d} \")\" e] f) g", -1);
+
+  /* Inside of [], the enclosing ( is skipped over the string */
+  gtk_text_buffer_get_iter_at_offset (buffer, &iter, find (buffer, "e]"));
+  g_assert (ide_bracket_index_backward_find_unmatched (index, &iter, '('));
+  g_assert_cmpint (gtk_text_iter_get_offset (&iter), ==, find (buffer, "(b"));
+
+  gtk_text_buffer_get_iter_at_offset (buffer, &iter, find (buffer, "e]"));
+  g_assert_cmpint (ide_bracket_index_get_depth (index, &iter), ==, 2);
+  g_assert (ide_bracket_index_forward_find_unmatched (index, &iter, ')'));
+  g_assert_cmpint (gtk_text_iter_get_offset (&iter), ==, find (buffer, ") g"));
+
+  gtk_text_buffer_get_iter_at_offset (buffer, &iter, find (buffer, "{d"));
+  g_assert (ide_bracket_index_get_match (index, &iter));
+  g_assert_cmpint (gtk_text_iter_get_offset (&iter), ==, find (buffer, "} "));
+
+  gtk_text_buffer_get_iter_at_offset (buffer, &iter, find (buffer, ")\""));
+  g_assert_cmpint (ide_bracket_index_get_region (index, &iter, NULL, NULL), ==, IDE_BRACKET_REGION_STRING);
+  g_assert (!ide_bracket_index_get_match (index, &iter));
+
+  gtk_text_buffer_get_iter_at_offset (buffer, &iter, find (buffer, "a"));
+  g_assert (!ide_bracket_index_backward_find_unmatched (index, &iter, '('));
+  g_assert_cmpint (ide_bracket_index_get_depth (index, &iter), ==, 0);
+}
+
+static void
+test_bracket_index_edit (void)
+{
+  g_autoptr(GtkTextBuffer) buffer = NULL;
+  g_autoptr(IdeBracketIndex) index = NULL;
+  GtkTextIter iter;
+
+  buffer = gtk_text_buffer_new (NULL);
+  index = ide_bracket_index_new (buffer);
+
+  gtk_text_buffer_set_text (buffer, "{\n  (\n  x\n}\n", -1);
+
+  gtk_text_buffer_get_iter_at_offset (buffer, &iter, find (buffer, "x"));
+  g_assert_cmpint (ide_bracket_index_get_depth (index, &iter), ==, 2);
+
+  /* Closing the ( on its own line must update the match of { as well */
+  gtk_text_buffer_get_iter_at_offset (buffer, &iter, find (buffer, "x"));
+  gtk_text_buffer_insert (buffer, &iter, ")", -1);
+
+  gtk_text_buffer_get_iter_at_offset (buffer, &iter, find (buffer, "x"));
+  g_assert_cmpint (ide_bracket_index_get_depth (index, &iter), ==, 1);
+
+  gtk_text_buffer_get_start_iter (buffer, &iter);
+  g_assert (ide_bracket_index_get_match (index, &iter));
+  g_assert_cmpint (gtk_text_iter_get_offset (&iter), ==, find (buffer, "}"));
+
+  /* Quoting the ( hides it */
+  gtk_text_buffer_get_iter_at_offset (buffer, &iter, find (buffer, "("));
+  gtk_text_buffer_insert (buffer, &iter, "\"", -1);
+
+  gtk_text_buffer_get_iter_at_offset (buffer, &iter, find (buffer, "x"));
+  g_assert_cmpint (ide_bracket_index_get_depth (index, &iter), ==, 1);
+  g_assert (!ide_bracket_index_backward_find_unmatched (index, &iter, '('));
+}
+
+static void
+test_bracket_index_comments (void)
+{
+  g_autoptr(GtkSourceBuffer) buffer = NULL;
+  g_autoptr(IdeBracketIndex) index = NULL;
+  GtkSourceLanguage *language;
+  GtkTextIter iter;
+  GtkTextIter begin;
+  GtkTextIter end;
+
+  language = gtk_source_language_manager_get_language (gtk_source_language_manager_get_default (), "c");
+
+  if (language == NULL)
+    {
+      g_test_skip ("C language definition is not available");
+      return;
+    }
+
+  buffer = gtk_source_buffer_new_with_language (language);
+  index = ide_bracket_index_new (GTK_TEXT_BUFFER (buffer));
+  g_assert (ide_bracket_index_get_syntax_supported (index));
+
+  gtk_text_buffer_set_text (GTK_TEXT_BUFFER (buffer),
+                            "f (/* ( */\n"
+                            "   a, // )\n"
+                            "   b)\n", -1);
+
+  gtk_text_buffer_get_iter_at_offset (GTK_TEXT_BUFFER (buffer), &iter, find (GTK_TEXT_BUFFER (buffer), "b)"));
+  g_assert (ide_bracket_index_backward_find_unmatched (index, &iter, '('));
+  g_assert_cmpint (gtk_text_iter_get_offset (&iter), ==, 2);
+
+  gtk_text_buffer_get_iter_at_offset (GTK_TEXT_BUFFER (buffer), &iter, find (GTK_TEXT_BUFFER (buffer), "( *"));
+  g_assert_cmpint (ide_bracket_index_get_region (index, &iter, &begin, &end), ==, IDE_BRACKET_REGION_BLOCK_COMMENT);
+  g_assert_cmpint (gtk_text_iter_get_offset (&begin), ==, 3);
+  g_assert_cmpint (gtk_text_iter_get_offset (&end), ==, 10);
+
+  gtk_text_buffer_get_iter_at_offset (GTK_TEXT_BUFFER (buffer), &iter, find (GTK_TEXT_BUFFER (buffer), ")\n"));
+  g_assert_cmpint (ide_bracket_index_get_region (index, &iter, NULL, NULL), ==, IDE_BRACKET_REGION_LINE_COMMENT);
+
+  /* Opening a comment at the start hides everything after it */
+  gtk_text_buffer_get_start_iter (GTK_TEXT_BUFFER (buffer), &iter);
+  gtk_text_buffer_insert (GTK_TEXT_BUFFER (buffer), &iter, "/*", -1);
+
+  gtk_text_buffer_get_iter_at_offset (GTK_TEXT_BUFFER (buffer), &iter, find (GTK_TEXT_BUFFER (buffer), "b)"));
+  g_assert (!ide_bracket_index_backward_find_unmatched (index, &iter, '('));
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+  g_test_add_func ("/Ide/BracketIndex/basic", test_bracket_index_basic);
+  g_test_add_func ("/Ide/BracketIndex/edit", test_bracket_index_edit);
+  g_test_add_func ("/Ide/BracketIndex/comments", test_bracket_index_comments);
+  return g_test_run ();
+}
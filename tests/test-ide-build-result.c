@@ -0,0 +1,270 @@
+/* test-ide-build-result.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <ide.h>
+#include <string.h>
+
+#include "gbp-gcc-message.h"
+
+typedef struct
+{
+  GMainLoop *main_loop;
+  GThread   *main_thread;
+  guint      n_lines;
+  guint      n_diagnostics;
+  guint      n_expected;
+} ParseState;
+
+static IdeDiagnostic *
+parse_line (IdeBuildResult    *result,
+            IdeBuildResultLog  log,
+            const gchar       *line,
+            gpointer           user_data)
+{
+  ParseState *state = user_data;
+
+  g_assert (IDE_IS_BUILD_RESULT (result));
+  g_assert (state->main_thread != g_thread_self ());
+
+  g_atomic_int_inc (&state->n_lines);
+
+  if (g_str_has_prefix (line, "error: "))
+    {
+      g_assert_cmpint (log, ==, IDE_BUILD_RESULT_LOG_STDERR);
+      return ide_diagnostic_new (IDE_DIAGNOSTIC_ERROR, line + 7, NULL);
+    }
+
+  return NULL;
+}
+
+static void
+diagnostic_cb (IdeBuildResult *result,
+               IdeDiagnostic  *diagnostic,
+               ParseState     *state)
+{
+  g_assert (IDE_IS_BUILD_RESULT (result));
+  g_assert (state->main_thread == g_thread_self ());
+  g_assert_cmpint (ide_diagnostic_get_severity (diagnostic), ==, IDE_DIAGNOSTIC_ERROR);
+  g_assert_cmpstr (ide_diagnostic_get_text (diagnostic), ==, "bad things");
+
+  if (++state->n_diagnostics == state->n_expected)
+    g_main_loop_quit (state->main_loop);
+}
+
+static void
+test_line_parser (void)
+{
+  g_autoptr(IdeBuildResult) result = NULL;
+  g_autoptr(IdeSubprocessLauncher) launcher = NULL;
+  g_autoptr(IdeSubprocess) subprocess = NULL;
+  g_autoptr(GError) error = NULL;
+  /* Reader threads may outlive this function */
+  static ParseState state;
+  guint parser_id;
+
+  state.main_loop = g_main_loop_new (NULL, FALSE);
+  state.main_thread = g_thread_self ();
+  state.n_expected = 100;
+
+  result = g_object_new (IDE_TYPE_BUILD_RESULT, NULL);
+  g_signal_connect (result, "diagnostic", G_CALLBACK (diagnostic_cb), &state);
+
+  parser_id = ide_build_result_add_line_parser (result, parse_line, &state, NULL);
+  g_assert_cmpint (parser_id, !=, 0);
+
+  launcher = ide_subprocess_launcher_new (G_SUBPROCESS_FLAGS_STDOUT_PIPE | G_SUBPROCESS_FLAGS_STDERR_PIPE);
+  ide_subprocess_launcher_push_argv (launcher, "sh");
+  ide_subprocess_launcher_push_argv (launcher, "-c");
+  ide_subprocess_launcher_push_argv (launcher,
+                                     "for i in $(seq 100); do "
+                                     "echo \"compiling $i\"; "
+                                     "echo \"error: bad things\" >&2; "
+                                     "done");
+
+  subprocess = ide_subprocess_launcher_spawn (launcher, NULL, &error);
+  g_assert_no_error (error);
+  g_assert (subprocess != NULL);
+
+  ide_build_result_log_subprocess (result, subprocess);
+
+  g_main_loop_run (state.main_loop);
+
+  ide_subprocess_wait (subprocess, NULL, NULL);
+
+  g_assert_cmpint (state.n_diagnostics, ==, 100);
+  g_assert_cmpint (g_atomic_int_get (&state.n_lines), >=, 100);
+
+  ide_build_result_remove_line_parser (result, parser_id);
+
+  g_main_loop_unref (state.main_loop);
+}
+
+static void
+notify_cb (gpointer data)
+{
+  guint *count = data;
+
+  (*count)++;
+}
+
+static IdeDiagnostic *
+null_parser (IdeBuildResult    *result,
+             IdeBuildResultLog  log,
+             const gchar       *line,
+             gpointer           user_data)
+{
+  return NULL;
+}
+
+static void
+test_remove_line_parser (void)
+{
+  g_autoptr(IdeBuildResult) result = NULL;
+  guint n_notify1 = 0;
+  guint n_notify2 = 0;
+  guint id1;
+  guint id2;
+
+  result = g_object_new (IDE_TYPE_BUILD_RESULT, NULL);
+
+  id1 = ide_build_result_add_line_parser (result, null_parser, &n_notify1, notify_cb);
+  id2 = ide_build_result_add_line_parser (result, null_parser, &n_notify2, notify_cb);
+  g_assert_cmpint (id1, !=, id2);
+
+  ide_build_result_remove_line_parser (result, id1);
+  g_assert_cmpint (n_notify1, ==, 1);
+  g_assert_cmpint (n_notify2, ==, 0);
+
+  g_clear_object (&result);
+  g_assert_cmpint (n_notify1, ==, 1);
+  g_assert_cmpint (n_notify2, ==, 1);
+}
+
+static void
+log_offset_cb (IdeBuildResult    *result,
+               IdeBuildResultLog  log,
+               const gchar       *message,
+               GArray            *offsets)
+{
+  gint64 offset = ide_build_result_get_log_offset (result);
+
+  g_assert_cmpint (offset, >=, 0);
+  g_array_append_val (offsets, offset);
+}
+
+static void
+test_read_log (void)
+{
+  g_autoptr(IdeBuildResult) result = NULL;
+  g_autoptr(GArray) offsets = NULL;
+  g_autoptr(GString) str = NULL;
+
+  result = g_object_new (IDE_TYPE_BUILD_RESULT, NULL);
+  offsets = g_array_new (FALSE, FALSE, sizeof (gint64));
+  str = g_string_new (NULL);
+
+  g_signal_connect (result, "log", G_CALLBACK (log_offset_cb), offsets);
+
+  ide_build_result_log_stdout (result, "%s", "first");
+  ide_build_result_log_stderr (result, "%s", "oops");
+  ide_build_result_log_stdout (result, "%s", "second line");
+
+  while (offsets->len < 3)
+    g_main_context_iteration (NULL, TRUE);
+
+  g_assert_cmpint (ide_build_result_get_log_offset (result), ==, -1);
+
+  /* Each log has its own offsets */
+  g_assert_cmpint (g_array_index (offsets, gint64, 0), ==, 0);
+  g_assert_cmpint (g_array_index (offsets, gint64, 1), ==, 0);
+  g_assert_cmpint (g_array_index (offsets, gint64, 2), ==, 6);
+
+  g_assert (ide_build_result_read_log (result, IDE_BUILD_RESULT_LOG_STDOUT,
+                                       g_array_index (offsets, gint64, 2), 11, str));
+  g_assert_cmpstr (str->str, ==, "second line");
+
+  g_assert (ide_build_result_read_log (result, IDE_BUILD_RESULT_LOG_STDERR,
+                                       g_array_index (offsets, gint64, 1), 4, str));
+  g_assert_cmpstr (str->str, ==, "oops");
+
+  /* Reading past the end of the log fails */
+  g_assert (!ide_build_result_read_log (result, IDE_BUILD_RESULT_LOG_STDOUT, 100, 4, str));
+  g_assert_cmpint (str->len, ==, 0);
+}
+
+static void
+assert_message (const gchar           *line,
+                const gchar           *filename,
+                guint                  lineno,
+                guint                  column,
+                IdeDiagnosticSeverity  severity,
+                const gchar           *message)
+{
+  GbpGccMessage msg = { 0 };
+
+  g_assert (gbp_gcc_message_parse (line, &msg));
+  g_assert_cmpint (msg.filename_len, ==, strlen (filename));
+  g_assert (strncmp (msg.filename, filename, msg.filename_len) == 0);
+  g_assert_cmpint (msg.line, ==, lineno);
+  g_assert_cmpint (msg.column, ==, column);
+  g_assert_cmpint (msg.severity, ==, severity);
+  g_assert_cmpstr (msg.message, ==, message);
+}
+
+static void
+test_gcc_message (void)
+{
+  GbpGccMessage msg = { 0 };
+
+  assert_message ("../src/main.c:12:5: warning: unused variable 'x' [-Wunused-variable]",
+                  "../src/main.c", 12, 5, IDE_DIAGNOSTIC_WARNING,
+                  "unused variable 'x' [-Wunused-variable]");
+  assert_message ("/home/user/project/foo.c:1:1: error: expected ';' before '}' token",
+                  "/home/user/project/foo.c", 1, 1, IDE_DIAGNOSTIC_ERROR,
+                  "expected ';' before '}' token");
+  assert_message ("foo.c:3:10: fatal error: bar.h: No such file or directory",
+                  "foo.c", 3, 10, IDE_DIAGNOSTIC_FATAL,
+                  "bar.h: No such file or directory");
+  assert_message ("  foo.c:7:2: note: declared here",
+                  "foo.c", 7, 2, IDE_DIAGNOSTIC_NOTE,
+                  "declared here");
+
+  /* Colons within the filename must not confuse the parser */
+  assert_message ("C:/src/a.c:4:8: warning: oops",
+                  "C:/src/a.c", 4, 8, IDE_DIAGNOSTIC_WARNING, "oops");
+
+  g_assert (!gbp_gcc_message_parse ("", &msg));
+  g_assert (!gbp_gcc_message_parse ("make[1]: Entering directory '/tmp/build'", &msg));
+  g_assert (!gbp_gcc_message_parse ("  CC       libfoo_la-foo.lo", &msg));
+  g_assert (!gbp_gcc_message_parse ("foo.c: In function 'main':", &msg));
+  g_assert (!gbp_gcc_message_parse ("foo.c:12: warning: missing column", &msg));
+  g_assert (!gbp_gcc_message_parse (":1:2: error: no filename", &msg));
+  g_assert (!gbp_gcc_message_parse ("foo.c:99999999999:1: error: overflow", &msg));
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+  g_test_add_func ("/Ide/BuildResult/line_parser", test_line_parser);
+  g_test_add_func ("/Ide/BuildResult/remove_line_parser", test_remove_line_parser);
+  g_test_add_func ("/Ide/BuildResult/read_log", test_read_log);
+  g_test_add_func ("/Ide/BuildResult/gcc_message", test_gcc_message);
+  return g_test_run ();
+}
@@ -0,0 +1,190 @@
+/* test-ide-compile-commands.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <ide.h>
+#include <string.h>
+
+static const gchar *database =
+  "[\n"
+  "  {\n"
+  "    \"directory\": \"/home/user/project/build\",\n"
+  "    \"command\": \"cc -I../src -I /usr/include/glib-2.0 -DFOO=\\\"bar baz\\\" -Wall -Wl,--as-needed -O2 -o main.o -c ../src/main.c\",\n"
+  "    \"file\": \"../src/main.c\"\n"
+  "  },\n"
+  "  {\n"
+  "    \"directory\": \"/home/user/project/build\",\n"
+  "    \"arguments\": [\"cc\", \"-isystem\", \"include\", \"-D\", \"DEBUG\", \"-std=gnu11\", \"-c\", \"\\u0063\\/util.c\"],\n"
+  "    \"file\": \"/home/user/project/./src/../src/util.c\",\n"
+  "    \"output\": { \"ignored\": [1, 2.5e3, true, null] }\n"
+  "  },\n"
+  "  {\n"
+  "    \"directory\": \"/home/user/project/build\",\n"
+  "    \"command\": \"cc -DSECOND -c ../src/main.c\",\n"
+  "    \"file\": \"../src/main.c\"\n"
+  "  }\n"
+  "]\n";
+
+static void
+load_cb (GObject      *object,
+         GAsyncResult *result,
+         gpointer      user_data)
+{
+  IdeCompileCommands *compile_commands = (IdeCompileCommands *)object;
+  GMainLoop *main_loop = user_data;
+  g_autoptr(GError) error = NULL;
+  gboolean ret;
+
+  ret = ide_compile_commands_load_finish (compile_commands, result, &error);
+  g_assert_no_error (error);
+  g_assert (ret);
+
+  g_main_loop_quit (main_loop);
+}
+
+static void
+test_lookup (void)
+{
+  g_autoptr(IdeCompileCommands) compile_commands = NULL;
+  g_autoptr(GMainLoop) main_loop = NULL;
+  g_autoptr(GFileIOStream) stream = NULL;
+  g_autoptr(GFile) file = NULL;
+  g_autoptr(GFile) source = NULL;
+  g_autoptr(GFile) directory = NULL;
+  g_autoptr(GError) error = NULL;
+  g_auto(GStrv) flags = NULL;
+  g_autofree gchar *path = NULL;
+  gboolean ret;
+
+  file = g_file_new_tmp ("compile_commands-XXXXXX.json", &stream, &error);
+  g_assert_no_error (error);
+  g_assert (file != NULL);
+
+  ret = g_file_replace_contents (file, database, strlen (database), NULL, FALSE,
+                                 G_FILE_CREATE_NONE, NULL, NULL, &error);
+  g_assert_no_error (error);
+  g_assert (ret);
+
+  compile_commands = ide_compile_commands_new (NULL, file);
+  source = g_file_new_for_path ("/home/user/project/src/main.c");
+
+  /* Lookups fail until the database is loaded */
+  flags = ide_compile_commands_lookup (compile_commands, source, NULL, &error);
+  g_assert_error (error, G_IO_ERROR, G_IO_ERROR_NOT_INITIALIZED);
+  g_assert (flags == NULL);
+  g_clear_error (&error);
+
+  main_loop = g_main_loop_new (NULL, FALSE);
+  ide_compile_commands_load_async (compile_commands, NULL, load_cb, main_loop);
+  g_main_loop_run (main_loop);
+
+  /* The duplicate entry for main.c is ignored */
+  g_assert_cmpint (ide_compile_commands_get_size (compile_commands), ==, 2);
+
+  flags = ide_compile_commands_lookup (compile_commands, source, &directory, &error);
+  g_assert_no_error (error);
+  g_assert (flags != NULL);
+  g_assert_cmpint (g_strv_length (flags), ==, 4);
+  g_assert_cmpstr (flags [0], ==, "-I/home/user/project/src");
+  g_assert_cmpstr (flags [1], ==, "-I/usr/include/glib-2.0");
+  g_assert_cmpstr (flags [2], ==, "-DFOO=bar baz");
+  g_assert_cmpstr (flags [3], ==, "-Wall");
+  g_assert (directory != NULL);
+  path = g_file_get_path (directory);
+  g_assert_cmpstr (path, ==, "/home/user/project/build");
+  g_clear_pointer (&flags, g_strfreev);
+  g_clear_object (&directory);
+  g_clear_object (&source);
+
+  source = g_file_new_for_path ("/home/user/project/src/util.c");
+  flags = ide_compile_commands_lookup (compile_commands, source, NULL, &error);
+  g_assert_no_error (error);
+  g_assert (flags != NULL);
+  g_assert_cmpint (g_strv_length (flags), ==, 5);
+  g_assert_cmpstr (flags [0], ==, "-isystem");
+  g_assert_cmpstr (flags [1], ==, "/home/user/project/build/include");
+  g_assert_cmpstr (flags [2], ==, "-D");
+  g_assert_cmpstr (flags [3], ==, "DEBUG");
+  g_assert_cmpstr (flags [4], ==, "-std=gnu11");
+  g_clear_pointer (&flags, g_strfreev);
+  g_clear_object (&source);
+
+  source = g_file_new_for_path ("/home/user/project/src/missing.c");
+  flags = ide_compile_commands_lookup (compile_commands, source, NULL, &error);
+  g_assert_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND);
+  g_assert (flags == NULL);
+  g_clear_error (&error);
+
+  g_file_delete (file, NULL, NULL);
+}
+
+static void
+load_error_cb (GObject      *object,
+               GAsyncResult *result,
+               gpointer      user_data)
+{
+  IdeCompileCommands *compile_commands = (IdeCompileCommands *)object;
+  GMainLoop *main_loop = user_data;
+  g_autoptr(GError) error = NULL;
+  gboolean ret;
+
+  ret = ide_compile_commands_load_finish (compile_commands, result, &error);
+  g_assert_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA);
+  g_assert (!ret);
+
+  g_main_loop_quit (main_loop);
+}
+
+static void
+test_invalid (void)
+{
+  static const gchar *invalid = "[ { \"file\": \"foo.c\", \"command\": \"cc foo.c }";
+  g_autoptr(IdeCompileCommands) compile_commands = NULL;
+  g_autoptr(GMainLoop) main_loop = NULL;
+  g_autoptr(GFileIOStream) stream = NULL;
+  g_autoptr(GFile) file = NULL;
+  g_autoptr(GError) error = NULL;
+  gboolean ret;
+
+  file = g_file_new_tmp ("compile_commands-XXXXXX.json", &stream, &error);
+  g_assert_no_error (error);
+
+  ret = g_file_replace_contents (file, invalid, strlen (invalid), NULL, FALSE,
+                                 G_FILE_CREATE_NONE, NULL, NULL, &error);
+  g_assert_no_error (error);
+  g_assert (ret);
+
+  compile_commands = ide_compile_commands_new (NULL, file);
+
+  main_loop = g_main_loop_new (NULL, FALSE);
+  ide_compile_commands_load_async (compile_commands, NULL, load_error_cb, main_loop);
+  g_main_loop_run (main_loop);
+
+  g_assert_cmpint (ide_compile_commands_get_size (compile_commands), ==, 0);
+
+  g_file_delete (file, NULL, NULL);
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+  g_test_add_func ("/Ide/CompileCommands/lookup", test_lookup);
+  g_test_add_func ("/Ide/CompileCommands/invalid", test_invalid);
+  return g_test_run ();
+}
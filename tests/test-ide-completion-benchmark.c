@@ -0,0 +1,397 @@
+/* test-ide-completion-benchmark.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <ide.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Measures populating an IdeCompletionResults from a set of symbols and
+ * then refiltering it as the user types more characters, which is what
+ * the ctags provider does on every keystroke.
+ *
+ * The baseline allocates an item for every candidate and matches it with
+ * ide_completion_item_fuzzy_match(). The new path uses the lower case
+ * names and character masks that are computed once when the index is
+ * loaded, and only allocates items for the candidates that match.
+ *
+ *   ./test-ide-completion-benchmark
+ *   ./test-ide-completion-benchmark --proposals=200000 --query=gtkwidget
+ */
+
+static gint n_proposals = 50000;
+static gint n_iterations = 10;
+static gchar *query = "gtkwid";
+
+static GOptionEntry entries[] = {
+  { "proposals", 0, 0, G_OPTION_ARG_INT, &n_proposals, "Number of proposals to generate", "N" },
+  { "iterations", 0, 0, G_OPTION_ARG_INT, &n_iterations, "Number of timed runs", "N" },
+  { "query", 0, 0, G_OPTION_ARG_STRING, &query, "The word to type, one character at a time", "WORD" },
+  { NULL }
+};
+
+typedef struct
+{
+  const gchar *name;
+  const gchar *folded;
+  guint64      mask;
+} Candidate;
+
+typedef struct
+{
+  GPtrArray    *names;
+  GStringChunk *folded;
+  Candidate    *candidates;
+  guint         n_candidates;
+} Index;
+
+typedef struct
+{
+  gint64 populate;
+  gint64 refilter;
+  guint  n_populated;
+  guint  n_matched;
+} Result;
+
+#define BENCH_TYPE_ITEM (bench_item_get_type())
+G_DECLARE_FINAL_TYPE (BenchItem, bench_item, BENCH, ITEM, IdeCompletionItem)
+
+struct _BenchItem
+{
+  IdeCompletionItem  parent_instance;
+  const Candidate   *candidate;
+};
+
+G_DEFINE_TYPE (BenchItem, bench_item, IDE_TYPE_COMPLETION_ITEM)
+
+static void
+bench_item_class_init (BenchItemClass *klass)
+{
+}
+
+static void
+bench_item_init (BenchItem *self)
+{
+}
+
+static BenchItem *
+bench_item_new (const Candidate *candidate)
+{
+  BenchItem *self = g_object_new (BENCH_TYPE_ITEM, NULL);
+  self->candidate = candidate;
+  return self;
+}
+
+static Index *
+index_new (void)
+{
+  static const gchar *prefixes[] = {
+    "g_", "gtk_", "Gtk", "GTK_", "gdk_", "Gdk", "ide_", "Ide", "IDE_", "egg_", "pnl_",
+  };
+  static const gchar *words[] = {
+    "widget", "window", "object", "buffer", "source", "view", "completion", "item",
+    "context", "get", "set", "new", "free", "ref", "unref", "list", "store", "model",
+    "text", "iter", "file", "task", "signal", "connect", "property", "notify", "class",
+  };
+  g_autoptr(GRand) rand = g_rand_new_with_seed (1234);
+  Index *index = g_new0 (Index, 1);
+  gint i;
+
+  index->names = g_ptr_array_new_with_free_func (g_free);
+
+  for (i = 0; i < n_proposals; i++)
+    {
+      const gchar *prefix = prefixes [g_rand_int_range (rand, 0, G_N_ELEMENTS (prefixes))];
+      const gchar *word1 = words [g_rand_int_range (rand, 0, G_N_ELEMENTS (words))];
+      const gchar *word2 = words [g_rand_int_range (rand, 0, G_N_ELEMENTS (words))];
+      gchar *name;
+
+      if (g_ascii_isupper (prefix [0]) && g_ascii_islower (prefix [1]))
+        name = g_strdup_printf ("%s%c%s%c%s%d", prefix,
+                                g_ascii_toupper (word1 [0]), word1 + 1,
+                                g_ascii_toupper (word2 [0]), word2 + 1, i);
+      else
+        name = g_strdup_printf ("%s%s_%s_%d", prefix, word1, word2, i);
+
+      /* Macros such as GTK_IS_WIDGET are all upper case */
+      if (g_ascii_isupper (prefix [0]) && g_ascii_isupper (prefix [1]))
+        {
+          gchar *pos;
+
+          for (pos = name; *pos; pos++)
+            *pos = g_ascii_toupper (*pos);
+        }
+
+      g_ptr_array_add (index->names, name);
+    }
+
+  return index;
+}
+
+/* This is what IdeCtagsIndex does once after loading the tags file */
+static void
+index_fold (Index *index)
+{
+  guint i;
+
+  g_clear_pointer (&index->folded, g_string_chunk_free);
+  g_clear_pointer (&index->candidates, g_free);
+
+  index->folded = g_string_chunk_new (4096);
+  index->n_candidates = index->names->len;
+  index->candidates = g_new0 (Candidate, index->n_candidates);
+
+  for (i = 0; i < index->names->len; i++)
+    {
+      Candidate *candidate = &index->candidates [i];
+      const gchar *name = g_ptr_array_index (index->names, i);
+      const gchar *iter;
+
+      candidate->name = name;
+      candidate->folded = name;
+      candidate->mask = ide_completion_item_get_char_mask (name);
+
+      for (iter = name; *iter; iter++)
+        {
+          if (g_ascii_isupper (*iter))
+            {
+              gchar *copy = g_string_chunk_insert (index->folded, name);
+              gchar *pos;
+
+              for (pos = copy; *pos; pos++)
+                *pos = g_ascii_tolower (*pos);
+
+              candidate->folded = copy;
+              break;
+            }
+        }
+    }
+}
+
+static void
+index_free (Index *index)
+{
+  g_clear_pointer (&index->folded, g_string_chunk_free);
+  g_clear_pointer (&index->candidates, g_free);
+  g_clear_pointer (&index->names, g_ptr_array_unref);
+  g_free (index);
+}
+
+static gboolean
+baseline_match (const Candidate *candidate,
+                const gchar     *casefold,
+                guint64          casefold_mask,
+                guint           *priority)
+{
+  return ide_completion_item_fuzzy_match (candidate->name, casefold, priority);
+}
+
+static gboolean
+folded_match (const Candidate *candidate,
+              const gchar     *casefold,
+              guint64          casefold_mask,
+              guint           *priority)
+{
+  if (!ide_completion_item_mask_match (candidate->mask, casefold_mask))
+    return FALSE;
+
+  return ide_completion_item_fuzzy_match_folded (candidate->folded, casefold, priority);
+}
+
+typedef gboolean (*MatchFunc) (const Candidate *candidate,
+                               const gchar     *casefold,
+                               guint64          casefold_mask,
+                               guint           *priority);
+
+static void
+run_once (Index     *index,
+          MatchFunc  match,
+          gboolean   match_first,
+          Result    *result)
+{
+  g_autoptr(IdeCompletionResults) results = NULL;
+  g_autoptr(GPtrArray) visible = NULL;
+  g_autofree gchar *casefold = NULL;
+  g_autofree gchar *word = NULL;
+  guint64 casefold_mask;
+  gint64 begin;
+  guint len;
+  guint i;
+
+  word = g_strndup (query, 1);
+  casefold = g_utf8_casefold (word, -1);
+  casefold_mask = ide_completion_item_get_char_mask (casefold);
+
+  begin = g_get_monotonic_time ();
+
+  results = ide_completion_results_new (word);
+  visible = g_ptr_array_new ();
+
+  for (i = 0; i < index->n_candidates; i++)
+    {
+      const Candidate *candidate = &index->candidates [i];
+      guint priority = 0;
+      BenchItem *item;
+
+      if (match_first)
+        {
+          if (!match (candidate, casefold, casefold_mask, &priority))
+            continue;
+          item = bench_item_new (candidate);
+        }
+      else
+        {
+          item = bench_item_new (candidate);
+          if (!match (candidate, casefold, casefold_mask, &priority))
+            {
+              g_object_unref (item);
+              continue;
+            }
+        }
+
+      ide_completion_item_set_priority (IDE_COMPLETION_ITEM (item), priority);
+      ide_completion_results_take_proposal (results, IDE_COMPLETION_ITEM (item));
+      g_ptr_array_add (visible, item);
+    }
+
+  result->populate += g_get_monotonic_time () - begin;
+  result->n_populated = visible->len;
+
+  begin = g_get_monotonic_time ();
+
+  /* Now type the rest of the word, refiltering the visible items each time */
+  for (len = 2; len <= strlen (query); len++)
+    {
+      guint j = 0;
+
+      g_free (word);
+      g_free (casefold);
+
+      word = g_strndup (query, len);
+      casefold = g_utf8_casefold (word, -1);
+      casefold_mask = ide_completion_item_get_char_mask (casefold);
+
+      for (i = 0; i < visible->len; i++)
+        {
+          BenchItem *item = g_ptr_array_index (visible, i);
+          guint priority = 0;
+
+          if (match (item->candidate, casefold, casefold_mask, &priority))
+            {
+              IDE_COMPLETION_ITEM (item)->priority = priority;
+              visible->pdata [j++] = item;
+            }
+        }
+
+      g_ptr_array_set_size (visible, j);
+    }
+
+  result->refilter += g_get_monotonic_time () - begin;
+  result->n_matched = visible->len;
+}
+
+static void
+run (const gchar *name,
+     Index       *index,
+     MatchFunc    match,
+     gboolean     match_first,
+     Result      *result)
+{
+  Result tmp;
+  gint i;
+
+  memset (result, 0, sizeof *result);
+
+  /* The first run is a warm up */
+  for (i = 0; i <= n_iterations; i++)
+    {
+      memset (&tmp, 0, sizeof tmp);
+      run_once (index, match, match_first, &tmp);
+
+      if (i == 0)
+        continue;
+
+      result->populate += tmp.populate;
+      result->refilter += tmp.refilter;
+      result->n_populated = tmp.n_populated;
+      result->n_matched = tmp.n_matched;
+    }
+
+  result->populate /= MAX (n_iterations, 1);
+  result->refilter /= MAX (n_iterations, 1);
+
+  g_print ("%-10s populate %8.3lf ms (%6u items)  refilter %8.3lf ms (%6u items)  total %8.3lf ms\n",
+           name,
+           result->populate / 1000.0, result->n_populated,
+           result->refilter / 1000.0, result->n_matched,
+           (result->populate + result->refilter) / 1000.0);
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+  g_autoptr(GOptionContext) context = NULL;
+  g_autoptr(GError) error = NULL;
+  Result before;
+  Result after;
+  Index *index;
+  gint64 begin;
+  gint64 fold;
+
+  context = g_option_context_new ("- measure completion populate and refilter");
+  g_option_context_add_main_entries (context, entries, NULL);
+
+  if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      return EXIT_FAILURE;
+    }
+
+  if (query == NULL || *query == '\0' || !g_str_is_ascii (query))
+    {
+      g_printerr ("--query must be a non-empty ascii word\n");
+      return EXIT_FAILURE;
+    }
+
+  index = index_new ();
+
+  begin = g_get_monotonic_time ();
+  index_fold (index);
+  fold = g_get_monotonic_time () - begin;
+
+  g_print ("%d proposals, typing \"%s\", precomputing keys took %.3lf ms\n",
+           n_proposals, query, fold / 1000.0);
+
+  run ("baseline", index, baseline_match, FALSE, &before);
+  run ("folded", index, folded_match, TRUE, &after);
+
+  /*
+   * The folded match finds the first occurrence of each character in
+   * either case, so it may only ever find more matches than the baseline.
+   */
+  g_assert_cmpint (after.n_populated, >=, before.n_populated);
+  g_assert_cmpint (after.n_matched, >=, before.n_matched);
+
+  g_print ("speedup    %.2lfx\n",
+           (gdouble)(before.populate + before.refilter) / MAX (after.populate + after.refilter, 1));
+
+  index_free (index);
+
+  return EXIT_SUCCESS;
+}
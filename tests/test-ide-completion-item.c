@@ -0,0 +1,89 @@
+/* test-ide-completion-item.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <ide.h>
+
+static void
+test_char_mask (void)
+{
+  g_assert_cmpint (ide_completion_item_get_char_mask (""), ==, 0);
+  g_assert_cmpint (ide_completion_item_get_char_mask ("abc"), ==, ide_completion_item_get_char_mask ("CBA"));
+  g_assert_cmpint (ide_completion_item_get_char_mask ("gtk_widget"), ==, ide_completion_item_get_char_mask ("GtkWidget_"));
+
+  g_assert (ide_completion_item_mask_match (ide_completion_item_get_char_mask ("gtk_widget_show"),
+                                            ide_completion_item_get_char_mask ("gws")));
+  g_assert (ide_completion_item_mask_match (ide_completion_item_get_char_mask ("GtkWidget"),
+                                            ide_completion_item_get_char_mask ("gtkw")));
+  g_assert (!ide_completion_item_mask_match (ide_completion_item_get_char_mask ("gtk_widget_show"),
+                                             ide_completion_item_get_char_mask ("gwz")));
+  g_assert (!ide_completion_item_mask_match (ide_completion_item_get_char_mask ("gtk_widget"),
+                                             ide_completion_item_get_char_mask ("gtk2")));
+  g_assert (!ide_completion_item_mask_match (ide_completion_item_get_char_mask ("gtkwidget"),
+                                             ide_completion_item_get_char_mask ("gtk_")));
+}
+
+static void
+test_fuzzy_match_folded (void)
+{
+  static const struct {
+    const gchar *haystack;
+    const gchar *needle;
+  } cases[] = {
+    { "gtk_widget_show", "gws" },
+    { "gtk_widget_show", "gtkw" },
+    { "gtk_widget_show", "swg" },
+    { "gtk_widget_show", "" },
+    { "GtkWidget", "gtkw" },
+    { "GtkWidget", "gtkx" },
+    { "IDE_IS_BUFFER", "idebuf" },
+    { "g_object_unref", "gobjunref" },
+    { "g_object_unref", "gobjref2" },
+  };
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (cases); i++)
+    {
+      g_autofree gchar *folded = g_ascii_strdown (cases [i].haystack, -1);
+      guint priority = 0;
+      guint folded_priority = 0;
+      gboolean ret;
+      gboolean folded_ret;
+
+      ret = ide_completion_item_fuzzy_match (folded, cases [i].needle, &priority);
+      folded_ret = ide_completion_item_fuzzy_match_folded (folded, cases [i].needle, &folded_priority);
+
+      g_assert_cmpint (ret, ==, folded_ret);
+      if (ret)
+        g_assert_cmpint (priority, ==, folded_priority);
+
+      /* The mask must never reject an item that matches */
+      if (folded_ret)
+        g_assert (ide_completion_item_mask_match (ide_completion_item_get_char_mask (cases [i].haystack),
+                                                  ide_completion_item_get_char_mask (cases [i].needle)));
+    }
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+  g_test_add_func ("/Ide/CompletionItem/char_mask", test_char_mask);
+  g_test_add_func ("/Ide/CompletionItem/fuzzy_match_folded", test_fuzzy_match_folded);
+  return g_test_run ();
+}
@@ -0,0 +1,382 @@
+/* test-ide-line-reader-benchmark.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <ide.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Measures the throughput of IdeLineReader on a tags file and on the output
+ * of `make -p`, which are what the ctags index and the makecache read. The
+ * previous byte-at-a-time implementations are kept here as the baseline.
+ *
+ *   ./test-ide-line-reader-benchmark
+ *   ./test-ide-line-reader-benchmark --tags=tags --make-db=make-p.txt
+ */
+
+#define MIN_MAKE_DB_SIZE (32 * 1024 * 1024)
+
+static gchar *tags_path;
+static gchar *make_db_path;
+static gint n_lines = 500000;
+static gint n_iterations = 10;
+
+static GOptionEntry entries[] = {
+  { "tags", 0, 0, G_OPTION_ARG_FILENAME, &tags_path, "A tags file to parse", "FILE" },
+  { "make-db", 0, 0, G_OPTION_ARG_FILENAME, &make_db_path, "The saved output of make -p", "FILE" },
+  { "lines", 0, 0, G_OPTION_ARG_INT, &n_lines, "Number of tags to generate", "N" },
+  { "iterations", 0, 0, G_OPTION_ARG_INT, &n_iterations, "Number of timed runs", "N" },
+  { NULL }
+};
+
+typedef struct
+{
+  guint   n_lines;
+  guint64 checksum;
+} Result;
+
+typedef void (*BenchFunc) (gchar  *contents,
+                           gsize   length,
+                           Result *result);
+
+static gchar *
+baseline_line_reader_next (IdeLineReader *reader,
+                           gsize         *length)
+{
+  gchar *ret;
+
+  if ((reader->contents == NULL) || (reader->pos >= reader->length))
+    {
+      *length = 0;
+      return NULL;
+    }
+
+  ret = &reader->contents [reader->pos];
+
+  for (; reader->pos < reader->length; reader->pos++)
+    {
+      if (reader->contents [reader->pos] == '\n')
+        {
+          *length = &reader->contents [reader->pos] - ret;
+          reader->pos++;
+          return ret;
+        }
+    }
+
+  *length = &reader->contents [reader->pos] - ret;
+
+  return ret;
+}
+
+static inline gchar *
+baseline_forward_to_tab (gchar *iter)
+{
+  while (*iter && g_utf8_get_char (iter) != '\t')
+    iter = g_utf8_next_char (iter);
+  return *iter ? iter : NULL;
+}
+
+static inline gchar *
+baseline_forward_to_nontab_and_zero (gchar *iter)
+{
+  while (*iter && (g_utf8_get_char (iter) == '\t'))
+    {
+      gchar *tmp = iter;
+      iter = g_utf8_next_char (iter);
+      *tmp = '\0';
+    }
+
+  return *iter ? iter : NULL;
+}
+
+static gboolean
+baseline_parse_tag (gchar   *line,
+                    guint64 *checksum)
+{
+  gchar *name = line;
+  gchar *path;
+  gchar *pattern;
+  gchar *iter = line;
+  gchar *keyval;
+
+  if (!(iter = baseline_forward_to_tab (iter)) || !(iter = baseline_forward_to_nontab_and_zero (iter)))
+    return FALSE;
+  path = iter;
+  if (!(iter = baseline_forward_to_tab (iter)) || !(iter = baseline_forward_to_nontab_and_zero (iter)))
+    return FALSE;
+  pattern = iter;
+  if (!(iter = baseline_forward_to_tab (iter)) || !(iter = baseline_forward_to_nontab_and_zero (iter)))
+    return FALSE;
+  keyval = baseline_forward_to_tab (iter);
+
+  *checksum += strlen (name) + strlen (path) + strlen (pattern) + *iter + (keyval ? strlen (keyval) : 0);
+
+  return TRUE;
+}
+
+static gboolean
+parse_tag (gchar   *line,
+           gsize    length,
+           guint64 *checksum)
+{
+  gchar *fields[4];
+  gchar *keyval;
+
+  if (ide_line_reader_split (line, length, '\t', fields, G_N_ELEMENTS (fields)) != G_N_ELEMENTS (fields))
+    return FALSE;
+
+  keyval = memchr (fields [3], '\t', line + length - fields [3]);
+
+  *checksum += strlen (fields [0]) + strlen (fields [1]) + strlen (fields [2]) + *fields [3] +
+               (keyval ? strlen (keyval) : 0);
+
+  return TRUE;
+}
+
+static void
+bench_tags_baseline (gchar  *contents,
+                     gsize   length,
+                     Result *result)
+{
+  IdeLineReader reader;
+  gchar *line;
+  gsize line_len;
+
+  ide_line_reader_init (&reader, contents, length);
+
+  while (NULL != (line = baseline_line_reader_next (&reader, &line_len)))
+    {
+      if (line [0] == '!')
+        continue;
+      line [line_len] = '\0';
+      if (baseline_parse_tag (line, &result->checksum))
+        result->n_lines++;
+    }
+}
+
+static void
+bench_tags (gchar  *contents,
+            gsize   length,
+            Result *result)
+{
+  IdeLineReader reader;
+  gchar *line;
+  gsize line_len;
+
+  ide_line_reader_init (&reader, contents, length);
+
+  while (NULL != (line = ide_line_reader_next (&reader, &line_len)))
+    {
+      if (line [0] == '!')
+        continue;
+      line [line_len] = '\0';
+      if (parse_tag (line, line_len, &result->checksum))
+        result->n_lines++;
+    }
+}
+
+static void
+bench_lines_baseline (gchar  *contents,
+                      gsize   length,
+                      Result *result)
+{
+  IdeLineReader reader;
+  gsize line_len;
+
+  ide_line_reader_init (&reader, contents, length);
+
+  while (NULL != baseline_line_reader_next (&reader, &line_len))
+    {
+      result->n_lines++;
+      result->checksum += line_len;
+    }
+}
+
+static void
+bench_lines (gchar  *contents,
+             gsize   length,
+             Result *result)
+{
+  IdeLineReader reader;
+  gsize line_len;
+
+  ide_line_reader_init (&reader, contents, length);
+
+  while (NULL != ide_line_reader_next (&reader, &line_len))
+    {
+      result->n_lines++;
+      result->checksum += line_len;
+    }
+}
+
+static gdouble
+run (BenchFunc    func,
+     const gchar *contents,
+     gsize        length,
+     Result      *result)
+{
+  gchar *copy = g_malloc (length + 1);
+  gint64 best = G_MAXINT64;
+  gint i;
+
+  /* The first run is a warm up */
+  for (i = 0; i <= n_iterations; i++)
+    {
+      gint64 begin;
+      gint64 elapsed;
+
+      /* Parsing modifies the buffer, so always start from a pristine copy */
+      memcpy (copy, contents, length + 1);
+      memset (result, 0, sizeof *result);
+
+      begin = g_get_monotonic_time ();
+      func (copy, length, result);
+      elapsed = g_get_monotonic_time () - begin;
+
+      if (i > 0)
+        best = MIN (best, elapsed);
+    }
+
+  g_free (copy);
+
+  return (length / (1024.0 * 1024.0)) / (MAX (best, 1) / (gdouble)G_USEC_PER_SEC);
+}
+
+static void
+compare (const gchar *name,
+         BenchFunc    baseline,
+         BenchFunc    func,
+         const gchar *contents,
+         gsize        length)
+{
+  Result before;
+  Result after;
+  gdouble before_mbs;
+  gdouble after_mbs;
+
+  before_mbs = run (baseline, contents, length, &before);
+  after_mbs = run (func, contents, length, &after);
+
+  g_assert_cmpint (before.n_lines, ==, after.n_lines);
+  g_assert_cmpint (before.checksum, ==, after.checksum);
+
+  g_print ("%-8s %8.1lf MB  %9u lines  before %8.1lf MB/s  after %8.1lf MB/s  (%.2lfx)\n",
+           name, length / (1024.0 * 1024.0), after.n_lines, before_mbs, after_mbs,
+           after_mbs / before_mbs);
+}
+
+static gchar *
+generate_tags (gsize *length)
+{
+  g_autoptr(GRand) rand = g_rand_new_with_seed (1234);
+  static const gchar kinds[] = "cdefgmpstuv";
+  GString *str = g_string_new ("!_TAG_FILE_FORMAT\t2\t/extended format/\n");
+  gint i;
+
+  for (i = 0; i < n_lines; i++)
+    {
+      guint dir = g_rand_int_range (rand, 0, 100);
+      guint file = g_rand_int_range (rand, 0, 1000);
+
+      g_string_append_printf (str,
+                              "ide_symbol_%07d\tsrc/dir%02u/file%04u.c\t"
+                              "/^ide_symbol_%07d (IdeObject *self, gint value)$/;\"\t%c",
+                              i, dir, file, i, kinds [g_rand_int_range (rand, 0, sizeof kinds - 1)]);
+
+      if (g_rand_boolean (rand))
+        g_string_append_printf (str, "\tline:%u\tsignature:(IdeObject *self, gint value)",
+                                g_rand_int_range (rand, 1, 5000));
+
+      g_string_append_c (str, '\n');
+    }
+
+  *length = str->len;
+
+  return g_string_free (str, FALSE);
+}
+
+static gchar *
+generate_make_db (gsize *length)
+{
+  const gchar *argv[] = { "make", "-p", "-n", "-f", "/dev/null", NULL };
+  g_autofree gchar *stdout_buf = NULL;
+  GString *str;
+
+  /* Repeat the builtin database of make until it is big enough to time */
+  if (!g_spawn_sync (NULL, (gchar **)argv, NULL,
+                     G_SPAWN_SEARCH_PATH | G_SPAWN_STDERR_TO_DEV_NULL,
+                     NULL, NULL, &stdout_buf, NULL, NULL, NULL) ||
+      stdout_buf == NULL || *stdout_buf == '\0')
+    {
+      g_free (stdout_buf);
+      stdout_buf = g_strdup ("# Implicit Rules\n\n%.o: %.c\n#  recipe to execute (built-in):\n"
+                             "\t$(COMPILE.c) $(OUTPUT_OPTION) $<\n\n"
+                             "subdir = libide\nCFLAGS = -g -O2 -Wall\n");
+    }
+
+  str = g_string_new (NULL);
+
+  while (str->len < MIN_MAKE_DB_SIZE)
+    g_string_append (str, stdout_buf);
+
+  *length = str->len;
+
+  return g_string_free (str, FALSE);
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+  g_autoptr(GOptionContext) context = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autofree gchar *tags = NULL;
+  g_autofree gchar *make_db = NULL;
+  gsize tags_len = 0;
+  gsize make_db_len = 0;
+
+  context = g_option_context_new ("- measure IdeLineReader throughput");
+  g_option_context_add_main_entries (context, entries, NULL);
+
+  if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      return EXIT_FAILURE;
+    }
+
+  if (tags_path != NULL)
+    {
+      if (!g_file_get_contents (tags_path, &tags, &tags_len, &error))
+        g_error ("%s", error->message);
+    }
+  else
+    tags = generate_tags (&tags_len);
+
+  if (make_db_path != NULL)
+    {
+      if (!g_file_get_contents (make_db_path, &make_db, &make_db_len, &error))
+        g_error ("%s", error->message);
+    }
+  else
+    make_db = generate_make_db (&make_db_len);
+
+  compare ("tags", bench_tags_baseline, bench_tags, tags, tags_len);
+  compare ("make -p", bench_lines_baseline, bench_lines, make_db, make_db_len);
+
+  return EXIT_SUCCESS;
+}
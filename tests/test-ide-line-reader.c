@@ -0,0 +1,107 @@
+/* test-ide-line-reader.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <ide.h>
+#include <string.h>
+
+static void
+test_next (void)
+{
+  g_autofree gchar *contents = g_strdup ("a\n\nccc\nlast");
+  IdeLineReader reader;
+  const gchar *line;
+  gsize len;
+
+  ide_line_reader_init (&reader, contents, -1);
+
+  line = ide_line_reader_next (&reader, &len);
+  g_assert (line == contents);
+  g_assert_cmpint (len, ==, 1);
+
+  line = ide_line_reader_next (&reader, &len);
+  g_assert (line == contents + 2);
+  g_assert_cmpint (len, ==, 0);
+
+  line = ide_line_reader_next (&reader, &len);
+  g_assert (line == contents + 3);
+  g_assert_cmpint (len, ==, 3);
+
+  line = ide_line_reader_next (&reader, &len);
+  g_assert (line == contents + 7);
+  g_assert_cmpint (len, ==, 4);
+
+  g_assert (ide_line_reader_next (&reader, &len) == NULL);
+  g_assert_cmpint (len, ==, 0);
+
+  ide_line_reader_init (&reader, NULL, 0);
+  g_assert (ide_line_reader_next (&reader, &len) == NULL);
+}
+
+static void
+test_split (void)
+{
+  /* Long enough to cross several 16 byte blocks */
+  g_autofree gchar *line = g_strdup ("ide_line_reader_split_with_a_long_name\t\t"
+                                     "libide/util/ide-line-reader.c\t"
+                                     "/^ide_line_reader_split (gchar  *line,$/;\"\t"
+                                     "f\tsignature:(gchar *line)");
+  gchar *fields[4];
+  guint n;
+
+  n = ide_line_reader_split (line, strlen (line), '\t', fields, G_N_ELEMENTS (fields));
+
+  g_assert_cmpint (n, ==, 4);
+  g_assert_cmpstr (fields [0], ==, "ide_line_reader_split_with_a_long_name");
+  g_assert_cmpstr (fields [1], ==, "libide/util/ide-line-reader.c");
+  g_assert_cmpstr (fields [2], ==, "/^ide_line_reader_split (gchar  *line,$/;\"");
+  g_assert_cmpstr (fields [3], ==, "f\tsignature:(gchar *line)");
+}
+
+static void
+test_split_short (void)
+{
+  g_autofree gchar *line = g_strdup ("a\tb\t\t");
+  g_autofree gchar *empty = g_strdup ("\tx");
+  gchar *fields[4];
+  guint n;
+
+  /* Trailing delimiters do not create an empty field */
+  n = ide_line_reader_split (line, strlen (line), '\t', fields, G_N_ELEMENTS (fields));
+  g_assert_cmpint (n, ==, 2);
+  g_assert_cmpstr (fields [0], ==, "a");
+  g_assert_cmpstr (fields [1], ==, "b");
+
+  /* A leading delimiter does */
+  n = ide_line_reader_split (empty, strlen (empty), '\t', fields, G_N_ELEMENTS (fields));
+  g_assert_cmpint (n, ==, 2);
+  g_assert_cmpstr (fields [0], ==, "");
+  g_assert_cmpstr (fields [1], ==, "x");
+
+  g_assert_cmpint (ide_line_reader_split (line, 0, '\t', fields, G_N_ELEMENTS (fields)), ==, 0);
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+  g_test_add_func ("/Ide/LineReader/next", test_next);
+  g_test_add_func ("/Ide/LineReader/split", test_split);
+  g_test_add_func ("/Ide/LineReader/split_short", test_split_short);
+  return g_test_run ();
+}
@@ -0,0 +1,192 @@
+/* test-ide-search-results.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <ide.h>
+
+typedef struct
+{
+  IdeObject parent_instance;
+  guint     n_created;
+} TestProvider;
+
+typedef IdeObjectClass TestProviderClass;
+
+static void test_provider_iface_init (IdeSearchProviderInterface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (TestProvider, test_provider, IDE_TYPE_OBJECT,
+                         G_IMPLEMENT_INTERFACE (IDE_TYPE_SEARCH_PROVIDER,
+                                                test_provider_iface_init))
+
+static void
+test_provider_populate (IdeSearchProvider *provider,
+                        IdeSearchContext  *context,
+                        const gchar       *search_terms,
+                        gsize              max_results,
+                        GCancellable      *cancellable)
+{
+}
+
+static IdeSearchResult *
+test_provider_create_result (IdeSearchProvider  *provider,
+                             const IdeSearchHit *hit)
+{
+  ((TestProvider *)provider)->n_created++;
+
+  return ide_search_result_new (provider, hit->title, hit->key, hit->score);
+}
+
+static void
+test_provider_iface_init (IdeSearchProviderInterface *iface)
+{
+  iface->populate = test_provider_populate;
+  iface->create_result = test_provider_create_result;
+}
+
+static void
+test_provider_class_init (TestProviderClass *klass)
+{
+}
+
+static void
+test_provider_init (TestProvider *self)
+{
+}
+
+static void
+add_hits (IdeSearchResults *results,
+          const gfloat     *scores,
+          guint             n_scores)
+{
+  g_autoptr(GArray) hits = NULL;
+  guint i;
+
+  hits = g_array_new (FALSE, TRUE, sizeof (IdeSearchHit));
+  g_array_set_clear_func (hits, (GDestroyNotify)ide_search_hit_clear);
+
+  for (i = 0; i < n_scores; i++)
+    {
+      IdeSearchHit hit = { 0 };
+
+      hit.title = g_strdup_printf ("%.1f", scores [i]);
+      hit.key = g_strdup_printf ("key-%.1f", scores [i]);
+      hit.score = scores [i];
+
+      g_array_append_val (hits, hit);
+    }
+
+  ide_search_results_add_hits (results, (IdeSearchHit *)(gpointer)hits->data, hits->len);
+
+  /* The hits were stolen by the results */
+  for (i = 0; i < hits->len; i++)
+    g_assert (g_array_index (hits, IdeSearchHit, i).title == NULL);
+}
+
+static void
+items_changed_cb (GListModel *model,
+                  guint       position,
+                  guint       removed,
+                  guint       added,
+                  guint      *n_emissions)
+{
+  (*n_emissions)++;
+}
+
+static void
+test_search_results_merge (void)
+{
+  static const gfloat first [] = { 0.5, 0.9, 0.1 };
+  static const gfloat second [] = { 0.3, 1.0, 0.7, 0.05 };
+  static const gfloat expected [] = { 1.0, 0.9, 0.7, 0.5, 0.3 };
+  TestProvider *provider;
+  g_autoptr(IdeSearchResults) results = NULL;
+  g_autoptr(IdeSearchResult) result = NULL;
+  guint n_emissions = 0;
+  guint i;
+
+  provider = g_object_new (test_provider_get_type (), NULL);
+  results = ide_search_results_new (IDE_SEARCH_PROVIDER (provider));
+  ide_search_results_set_max_results (results, 5);
+
+  g_signal_connect (results, "items-changed", G_CALLBACK (items_changed_cb), &n_emissions);
+
+  add_hits (results, first, G_N_ELEMENTS (first));
+  add_hits (results, second, G_N_ELEMENTS (second));
+
+  /* One emission per batch, and only the best five are kept */
+  g_assert_cmpint (n_emissions, ==, 2);
+  g_assert_cmpint (g_list_model_get_n_items (G_LIST_MODEL (results)), ==, G_N_ELEMENTS (expected));
+
+  for (i = 0; i < G_N_ELEMENTS (expected); i++)
+    g_assert_cmpfloat (ide_search_results_get_score (results, i), ==, expected [i]);
+
+  /* Nothing is materialized until it is requested */
+  g_assert_cmpint (provider->n_created, ==, 0);
+
+  result = g_list_model_get_item (G_LIST_MODEL (results), 1);
+  g_assert (IDE_IS_SEARCH_RESULT (result));
+  g_assert_cmpstr (ide_search_result_get_subtitle (result), ==, "key-0.9");
+  g_assert_cmpint (provider->n_created, ==, 1);
+  g_clear_object (&result);
+
+  /* And it is only materialized once */
+  result = g_list_model_get_item (G_LIST_MODEL (results), 1);
+  g_assert_cmpint (provider->n_created, ==, 1);
+  g_clear_object (&result);
+
+  g_clear_object (&results);
+  g_object_unref (provider);
+}
+
+static void
+test_search_results_legacy (void)
+{
+  static const gfloat scores [] = { 0.2, 0.8 };
+  TestProvider *provider;
+  g_autoptr(IdeSearchResults) results = NULL;
+  g_autoptr(IdeSearchResult) result = NULL;
+  g_autoptr(IdeSearchResult) item = NULL;
+
+  provider = g_object_new (test_provider_get_type (), NULL);
+  results = ide_search_results_new (IDE_SEARCH_PROVIDER (provider));
+
+  add_hits (results, scores, G_N_ELEMENTS (scores));
+
+  result = ide_search_result_new (IDE_SEARCH_PROVIDER (provider), "legacy", NULL, 0.5);
+  ide_search_results_add_result (results, result);
+
+  g_assert_cmpint (g_list_model_get_n_items (G_LIST_MODEL (results)), ==, 3);
+  item = g_list_model_get_item (G_LIST_MODEL (results), 1);
+  g_assert (item == result);
+
+  ide_search_results_remove_result (results, result);
+  g_assert_cmpint (g_list_model_get_n_items (G_LIST_MODEL (results)), ==, 2);
+  g_assert_cmpfloat (ide_search_results_get_score (results, 1), ==, 0.2f);
+
+  g_clear_object (&results);
+  g_object_unref (provider);
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+  g_test_add_func ("/Ide/SearchResults/merge", test_search_results_merge);
+  g_test_add_func ("/Ide/SearchResults/legacy", test_search_results_legacy);
+  return g_test_run ();
+}
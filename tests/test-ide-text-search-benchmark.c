@@ -0,0 +1,376 @@
+/* test-ide-text-search-benchmark.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib/gstdio.h>
+#include <ide.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "application/ide-application-tests.h"
+
+/*
+ * Compares IdeTextSearch against `grep -r` on a generated tree of source-like
+ * files. Both are run several times after a warm up so that the page cache
+ * is hot for each, and the best time is reported.
+ *
+ *   ./test-ide-text-search-benchmark --files=50000 --iterations=5
+ *   ./test-ide-text-search-benchmark --directory=$HOME/src/linux --query=kmalloc
+ */
+
+#define NEEDLE "ide_text_search_needle"
+
+static gint n_files = 20000;
+static gint n_iterations = 5;
+static gchar *directory;
+static gchar *query;
+static gboolean regex;
+static gboolean keep;
+
+static GOptionEntry entries[] = {
+  { "files", 0, 0, G_OPTION_ARG_INT, &n_files, "Number of files to generate", "N" },
+  { "iterations", 0, 0, G_OPTION_ARG_INT, &n_iterations, "Number of timed runs", "N" },
+  { "directory", 0, 0, G_OPTION_ARG_FILENAME, &directory, "Search an existing tree instead", "DIR" },
+  { "query", 0, 0, G_OPTION_ARG_STRING, &query, "The text to search for", "TEXT" },
+  { "regex", 0, 0, G_OPTION_ARG_NONE, &regex, "Treat the query as a regular expression", NULL },
+  { "keep", 0, 0, G_OPTION_ARG_NONE, &keep, "Do not delete the generated tree", NULL },
+  { NULL }
+};
+
+static const gchar *words[] = {
+  "static", "void", "gint", "gchar", "const", "return", "if", "else", "while",
+  "for", "struct", "self", "buffer", "iter", "context", "priv", "g_assert",
+  "g_return_if_fail", "NULL", "TRUE", "FALSE", "g_object_unref", "g_free",
+  "length", "offset", "line", "column", "file", "result", "error", "task",
+};
+
+typedef struct
+{
+  GTask         *task;
+  IdeContext    *context;
+  GFile         *directory;
+  GHashTable    *lines;
+  gint           iteration;
+  gint64         begin;
+  gint64         best_grep;
+  gint64         best_ide;
+  guint          grep_lines;
+  guint64        n_bytes;
+} Benchmark;
+
+static void run_iteration (Benchmark *bench);
+
+static void
+write_fixture_file (GRand       *rand,
+                    const gchar *path,
+                    guint64     *n_bytes)
+{
+  g_autoptr(GString) str = g_string_new (NULL);
+  g_autoptr(GError) error = NULL;
+  guint n_lines = g_rand_int_range (rand, 50, 500);
+  guint i;
+
+  for (i = 0; i < n_lines; i++)
+    {
+      guint n_words = g_rand_int_range (rand, 0, 12);
+      guint j;
+
+      g_string_append_len (str, "                ", g_rand_int_range (rand, 0, 4) * 2);
+
+      for (j = 0; j < n_words; j++)
+        {
+          g_string_append (str, words [g_rand_int_range (rand, 0, G_N_ELEMENTS (words))]);
+          g_string_append_c (str, ' ');
+        }
+
+      /* Roughly one line in ten thousand has the needle */
+      if (g_rand_int_range (rand, 0, 10000) == 0)
+        g_string_append (str, NEEDLE);
+
+      g_string_append_c (str, '\n');
+    }
+
+  if (!g_file_set_contents (path, str->str, str->len, &error))
+    g_error ("%s", error->message);
+
+  *n_bytes += str->len;
+}
+
+static gchar *
+create_fixture (guint64 *n_bytes)
+{
+  g_autoptr(GRand) rand = g_rand_new_with_seed (1234);
+  g_autoptr(GError) error = NULL;
+  gchar *path;
+  gint i;
+
+  if (NULL == (path = g_dir_make_tmp ("ide-text-search-XXXXXX", &error)))
+    g_error ("%s", error->message);
+
+  for (i = 0; i < n_files; i++)
+    {
+      g_autofree gchar *dir = g_strdup_printf ("%s/dir%03d", path, i % 200);
+      g_autofree gchar *name = g_strdup_printf ("%s/file%06d.c", dir, i);
+
+      g_mkdir_with_parents (dir, 0750);
+      write_fixture_file (rand, name, n_bytes);
+    }
+
+  return path;
+}
+
+static void
+remove_tree (const gchar *path)
+{
+  GDir *dir;
+
+  if (NULL != (dir = g_dir_open (path, 0, NULL)))
+    {
+      const gchar *name;
+
+      while (NULL != (name = g_dir_read_name (dir)))
+        {
+          g_autofree gchar *child = g_build_filename (path, name, NULL);
+
+          if (g_file_test (child, G_FILE_TEST_IS_DIR))
+            remove_tree (child);
+          else
+            g_unlink (child);
+        }
+
+      g_dir_close (dir);
+    }
+
+  g_rmdir (path);
+}
+
+static guint
+run_grep (Benchmark *bench)
+{
+  g_autofree gchar *stdout_buf = NULL;
+  g_autofree gchar *path = g_file_get_path (bench->directory);
+  g_autoptr(GError) error = NULL;
+  const gchar *argv[] = { "grep", "-r", "-n", "-I", regex ? "-E" : "-F", "--", query, path, NULL };
+  const gchar *iter;
+  guint count = 0;
+
+  if (!g_spawn_sync (NULL, (gchar **)argv, NULL, G_SPAWN_SEARCH_PATH | G_SPAWN_STDERR_TO_DEV_NULL,
+                     NULL, NULL, &stdout_buf, NULL, NULL, &error))
+    g_error ("%s", error->message);
+
+  for (iter = stdout_buf; NULL != (iter = strchr (iter, '\n')); iter++)
+    count++;
+
+  return count;
+}
+
+static void
+matches_found_cb (IdeTextSearch *search,
+                  GArray        *matches,
+                  Benchmark     *bench)
+{
+  guint i;
+
+  for (i = 0; i < matches->len; i++)
+    {
+      const IdeTextSearchMatch *match = &g_array_index (matches, IdeTextSearchMatch, i);
+      g_autofree gchar *path = g_file_get_path (match->file);
+
+      g_hash_table_add (bench->lines, g_strdup_printf ("%s:%u", path, match->line));
+    }
+}
+
+static void
+print_result (const gchar *name,
+              gint64       usec,
+              guint        n_lines,
+              guint64      n_bytes)
+{
+  g_print ("%-16s %8.1lf ms  %6u lines", name, usec / 1000.0, n_lines);
+
+  if (n_bytes > 0)
+    g_print ("  %8.1lf MB/s", (n_bytes / (1024.0 * 1024.0)) / (usec / (gdouble)G_USEC_PER_SEC));
+
+  g_print ("\n");
+}
+
+static void
+search_cb (GObject      *object,
+           GAsyncResult *result,
+           gpointer      user_data)
+{
+  IdeTextSearch *search = (IdeTextSearch *)object;
+  Benchmark *bench = user_data;
+  g_autoptr(GError) error = NULL;
+  gint64 elapsed;
+
+  elapsed = g_get_monotonic_time () - bench->begin;
+
+  if (!ide_text_search_execute_finish (search, result, &error))
+    g_error ("%s", error->message);
+
+  /* The first iteration is a warm up */
+  if (bench->iteration > 0)
+    {
+      g_autofree gchar *name = g_strdup_printf ("IdeTextSearch #%d", bench->iteration);
+
+      print_result (name, elapsed, g_hash_table_size (bench->lines), bench->n_bytes);
+
+      if (bench->best_ide == 0 || elapsed < bench->best_ide)
+        bench->best_ide = elapsed;
+    }
+
+  /* Existing trees may contain files ignored by the VCS, which grep searches */
+  if (directory == NULL)
+    g_assert_cmpint (g_hash_table_size (bench->lines), ==, bench->grep_lines);
+
+  bench->iteration++;
+  run_iteration (bench);
+}
+
+static void
+run_iteration (Benchmark *bench)
+{
+  g_autoptr(IdeTextSearch) search = NULL;
+  IdeTextSearchFlags flags = IDE_TEXT_SEARCH_CASE_SENSITIVE;
+  gint64 elapsed;
+
+  if (bench->iteration > n_iterations)
+    {
+      GTask *task = bench->task;
+
+      g_print ("\n");
+      print_result ("grep -r (best)", bench->best_grep, bench->grep_lines, bench->n_bytes);
+      print_result ("IdeTextSearch", bench->best_ide, bench->grep_lines, bench->n_bytes);
+
+      if (!keep && directory == NULL)
+        {
+          g_autofree gchar *path = g_file_get_path (bench->directory);
+          remove_tree (path);
+        }
+
+      g_clear_object (&bench->context);
+      g_clear_object (&bench->directory);
+      g_clear_pointer (&bench->lines, g_hash_table_unref);
+      g_slice_free (Benchmark, bench);
+
+      g_task_return_boolean (task, TRUE);
+      g_object_unref (task);
+
+      return;
+    }
+
+  bench->begin = g_get_monotonic_time ();
+  bench->grep_lines = run_grep (bench);
+  elapsed = g_get_monotonic_time () - bench->begin;
+
+  if (bench->iteration > 0)
+    {
+      g_autofree gchar *name = g_strdup_printf ("grep -r #%d", bench->iteration);
+
+      print_result (name, elapsed, bench->grep_lines, bench->n_bytes);
+
+      if (bench->best_grep == 0 || elapsed < bench->best_grep)
+        bench->best_grep = elapsed;
+    }
+
+  if (regex)
+    flags |= IDE_TEXT_SEARCH_REGEX;
+
+  g_hash_table_remove_all (bench->lines);
+
+  search = ide_text_search_new (bench->context, query, flags);
+  ide_text_search_set_directory (search, bench->directory);
+  ide_text_search_set_max_matches (search, 0);
+  g_signal_connect (search, "matches-found", G_CALLBACK (matches_found_cb), bench);
+
+  bench->begin = g_get_monotonic_time ();
+  ide_text_search_execute_async (search, NULL, search_cb, bench);
+}
+
+static void
+context_cb (GObject      *object,
+            GAsyncResult *result,
+            gpointer      user_data)
+{
+  Benchmark *bench = user_data;
+  g_autoptr(GError) error = NULL;
+
+  if (NULL == (bench->context = ide_context_new_finish (result, &error)))
+    g_error ("%s", error->message);
+
+  run_iteration (bench);
+}
+
+static void
+test_benchmark (GCancellable        *cancellable,
+                GAsyncReadyCallback  callback,
+                gpointer             user_data)
+{
+  g_autofree gchar *path = NULL;
+  Benchmark *bench;
+
+  bench = g_slice_new0 (Benchmark);
+  bench->task = g_task_new (NULL, cancellable, callback, user_data);
+  bench->lines = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+  if (directory != NULL)
+    {
+      path = g_strdup (directory);
+    }
+  else
+    {
+      g_print ("Generating %d files…\n", n_files);
+      path = create_fixture (&bench->n_bytes);
+      g_print ("Generated %.1lf MB in %s\n\n", bench->n_bytes / (1024.0 * 1024.0), path);
+    }
+
+  bench->directory = g_file_new_for_path (path);
+
+  ide_context_new_async (bench->directory, cancellable, context_cb, bench);
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+  g_autoptr(GOptionContext) context = NULL;
+  g_autoptr(GError) error = NULL;
+  IdeApplication *app;
+  gint ret;
+
+  g_test_init (&argc, &argv, NULL);
+
+  context = g_option_context_new ("- compare IdeTextSearch with grep -r");
+  g_option_context_add_main_entries (context, entries, NULL);
+
+  if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      return EXIT_FAILURE;
+    }
+
+  if (query == NULL)
+    query = g_strdup (NEEDLE);
+
+  app = ide_application_new ();
+  ide_application_add_test (app, "/Ide/TextSearch/benchmark", test_benchmark, NULL);
+  ret = g_application_run (G_APPLICATION (app), argc, argv);
+  g_object_unref (app);
+
+  return ret;
+}
@@ -0,0 +1,245 @@
+/* test-ide-text-search.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <ide.h>
+
+#include "application/ide-application-tests.h"
+
+typedef struct
+{
+  GTask      *task;
+  IdeContext *context;
+  GFile      *directory;
+  GPtrArray  *found;
+  guint       escape;
+} SearchTest;
+
+/*
+ * Escapes with arguments must not leak their arguments into the literal
+ * used to skip lines, or matching lines would be skipped.
+ */
+static const gchar *escapes[] = {
+  "LT\\x5fINIT_X",
+  "LT\\x{5f}INIT_X",
+  "LT\\137INIT_X",
+  "LT\\p{Pc}INIT_X",
+  "\\QLT_INIT_X\\E",
+  "LT(?<u>_)INIT\\k<u>X",
+  "LT(_)INIT\\g{1}X",
+  "LT_INIT_X\\cA{0}",
+};
+
+static void
+search_test_free (SearchTest *test)
+{
+  g_clear_object (&test->context);
+  g_clear_object (&test->directory);
+  g_clear_pointer (&test->found, g_ptr_array_unref);
+  g_slice_free (SearchTest, test);
+}
+
+static gint
+compare_strings (gconstpointer a,
+                 gconstpointer b)
+{
+  return g_strcmp0 (*(const gchar **)a, *(const gchar **)b);
+}
+
+static void
+matches_found_cb (IdeTextSearch *search,
+                  GArray        *matches,
+                  SearchTest    *test)
+{
+  guint i;
+
+  for (i = 0; i < matches->len; i++)
+    {
+      const IdeTextSearchMatch *match = &g_array_index (matches, IdeTextSearchMatch, i);
+      g_autofree gchar *name = g_file_get_basename (match->file);
+
+      g_ptr_array_add (test->found,
+                       g_strdup_printf ("%s:%u:%u:%u",
+                                        name,
+                                        match->line,
+                                        match->line_offset,
+                                        match->length));
+    }
+}
+
+static void
+assert_found (SearchTest         *test,
+              const gchar * const *expected)
+{
+  guint i;
+
+  g_ptr_array_sort (test->found, compare_strings);
+
+  g_assert_cmpint (test->found->len, ==, g_strv_length ((gchar **)expected));
+
+  for (i = 0; i < test->found->len; i++)
+    g_assert_cmpstr (g_ptr_array_index (test->found, i), ==, expected [i]);
+
+  g_ptr_array_set_size (test->found, 0);
+}
+
+static void
+search (SearchTest          *test,
+        const gchar         *query,
+        IdeTextSearchFlags   flags,
+        GAsyncReadyCallback  callback)
+{
+  g_autoptr(IdeTextSearch) text_search = NULL;
+
+  text_search = ide_text_search_new (test->context, query, flags);
+  ide_text_search_set_directory (text_search, test->directory);
+  g_signal_connect (text_search, "matches-found", G_CALLBACK (matches_found_cb), test);
+  ide_text_search_execute_async (text_search, NULL, callback, test);
+}
+
+static void
+test_escape_cb (GObject      *object,
+                GAsyncResult *result,
+                gpointer      user_data)
+{
+  SearchTest *test = user_data;
+  g_autoptr(GTask) task = NULL;
+  GError *error = NULL;
+  static const gchar *expected[] = { "configure.ac:1:2:9", NULL };
+
+  ide_text_search_execute_finish (IDE_TEXT_SEARCH (object), result, &error);
+  g_assert_no_error (error);
+
+  assert_found (test, expected);
+
+  if (++test->escape < G_N_ELEMENTS (escapes))
+    {
+      search (test, escapes [test->escape], IDE_TEXT_SEARCH_REGEX | IDE_TEXT_SEARCH_CASE_SENSITIVE, test_escape_cb);
+      return;
+    }
+
+  task = test->task;
+
+  search_test_free (test);
+
+  g_task_return_boolean (task, TRUE);
+}
+
+static void
+test_unsaved_cb (GObject      *object,
+                 GAsyncResult *result,
+                 gpointer      user_data)
+{
+  SearchTest *test = user_data;
+  GError *error = NULL;
+  static const gchar *expected[] = {
+    "configure.ac:0:4:7",
+    "configure.ac:1:2:9",
+    "configure.ac:2:6:7",
+    NULL
+  };
+
+  ide_text_search_execute_finish (IDE_TEXT_SEARCH (object), result, &error);
+  g_assert_no_error (error);
+
+  assert_found (test, expected);
+
+  search (test, escapes [0], IDE_TEXT_SEARCH_REGEX | IDE_TEXT_SEARCH_CASE_SENSITIVE, test_escape_cb);
+}
+
+static void
+test_literal_cb (GObject      *object,
+                 GAsyncResult *result,
+                 gpointer      user_data)
+{
+  SearchTest *test = user_data;
+  g_autoptr(GFile) file = NULL;
+  g_autoptr(GBytes) bytes = NULL;
+  IdeUnsavedFiles *unsaved_files;
+  GError *error = NULL;
+  static const gchar *expected[] = { "configure.ac:0:0:7", NULL };
+  static const gchar contents[] = "dnl LT_INIT\n  LT_INIT_X\r\nfoo   LT_INIT\n";
+
+  ide_text_search_execute_finish (IDE_TEXT_SEARCH (object), result, &error);
+  g_assert_no_error (error);
+
+  assert_found (test, expected);
+
+  /* Unsaved contents must be searched instead of the file on disk */
+  file = g_file_get_child (test->directory, "configure.ac");
+  bytes = g_bytes_new_static (contents, sizeof contents - 1);
+  unsaved_files = ide_context_get_unsaved_files (test->context);
+  ide_unsaved_files_update (unsaved_files, file, bytes);
+
+  search (test, "LT_[A-Z]+(_X)?", IDE_TEXT_SEARCH_REGEX | IDE_TEXT_SEARCH_CASE_SENSITIVE, test_unsaved_cb);
+}
+
+static void
+test_search_context_cb (GObject      *object,
+                        GAsyncResult *result,
+                        gpointer      user_data)
+{
+  SearchTest *test = user_data;
+  GError *error = NULL;
+
+  test->context = ide_context_new_finish (result, &error);
+  g_assert_no_error (error);
+  g_assert (test->context != NULL);
+
+  search (test, "lt_init", IDE_TEXT_SEARCH_WHOLE_WORDS, test_literal_cb);
+}
+
+static void
+test_search (GCancellable        *cancellable,
+             GAsyncReadyCallback  callback,
+             gpointer             user_data)
+{
+  g_autofree gchar *path = NULL;
+  g_autoptr(GFile) project_file = NULL;
+  SearchTest *test;
+
+  path = g_build_filename (g_getenv ("G_TEST_SRCDIR"), "data", "project1", NULL);
+
+  test = g_slice_new0 (SearchTest);
+  test->task = g_task_new (NULL, cancellable, callback, user_data);
+  test->directory = g_file_new_for_path (path);
+  test->found = g_ptr_array_new_with_free_func (g_free);
+
+  project_file = g_file_get_child (test->directory, "configure.ac");
+
+  ide_context_new_async (project_file, cancellable, test_search_context_cb, test);
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+  IdeApplication *app;
+  gint ret;
+
+  g_test_init (&argc, &argv, NULL);
+
+  ide_log_init (TRUE, NULL);
+  ide_log_set_verbosity (4);
+
+  app = ide_application_new ();
+  ide_application_add_test (app, "/Ide/TextSearch/search", test_search, NULL);
+  ret = g_application_run (G_APPLICATION (app), argc, argv);
+  g_object_unref (app);
+
+  return ret;
+}
@@ -0,0 +1,285 @@
+/* test-ide-thread-pool.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <egg-counter.h>
+#include <ide.h>
+#include <unistd.h>
+
+#include "ide-internal.h"
+
+typedef struct
+{
+  GMutex     mutex;
+  GCond      cond;
+  gboolean   released;
+  GPtrArray *order;
+  GMainLoop *main_loop;
+} State;
+
+typedef struct
+{
+  State       *state;
+  const gchar *name;
+  gboolean     blocks;
+} Job;
+
+static gboolean
+quit_cb (gpointer data)
+{
+  g_main_loop_quit (data);
+  return G_SOURCE_REMOVE;
+}
+
+static void
+job_func (gpointer data)
+{
+  Job *job = data;
+  State *state = job->state;
+
+  g_mutex_lock (&state->mutex);
+  g_ptr_array_add (state->order, (gpointer)job->name);
+  g_cond_broadcast (&state->cond);
+  while (job->blocks && !state->released)
+    g_cond_wait (&state->cond, &state->mutex);
+  if (state->order->len == 3)
+    g_idle_add (quit_cb, state->main_loop);
+  g_mutex_unlock (&state->mutex);
+}
+
+/*
+ * Saturates the budget of @low with a blocking job and then checks that a
+ * job of @high still runs before a queued job of @low.
+ */
+static void
+check_reserved_slot (IdeThreadPoolPriority low,
+                     IdeThreadPoolPriority high)
+{
+  State state = { 0 };
+  Job blocker = { &state, "blocker", TRUE };
+  Job waiting = { &state, "waiting", FALSE };
+  Job reserved = { &state, "reserved", FALSE };
+
+  g_mutex_init (&state.mutex);
+  g_cond_init (&state.cond);
+  state.order = g_ptr_array_new ();
+  state.main_loop = g_main_loop_new (NULL, FALSE);
+
+  ide_thread_pool_push_with_priority (IDE_THREAD_POOL_INDEXER, low, job_func, &blocker);
+
+  g_mutex_lock (&state.mutex);
+  while (state.order->len < 1)
+    g_cond_wait (&state.cond, &state.mutex);
+  g_mutex_unlock (&state.mutex);
+
+  /* Only one job of @low may run at a time, so this one must wait */
+  ide_thread_pool_push_with_priority (IDE_THREAD_POOL_INDEXER, low, job_func, &waiting);
+  ide_thread_pool_push_with_priority (IDE_THREAD_POOL_COMPILER, high, job_func, &reserved);
+
+  g_mutex_lock (&state.mutex);
+  while (state.order->len < 2)
+    g_cond_wait (&state.cond, &state.mutex);
+  g_assert_cmpstr (g_ptr_array_index (state.order, 0), ==, "blocker");
+  g_assert_cmpstr (g_ptr_array_index (state.order, 1), ==, "reserved");
+  state.released = TRUE;
+  g_cond_broadcast (&state.cond);
+  g_mutex_unlock (&state.mutex);
+
+  g_main_loop_run (state.main_loop);
+
+  g_assert_cmpint (state.order->len, ==, 3);
+  g_assert_cmpstr (g_ptr_array_index (state.order, 2), ==, "waiting");
+
+  g_ptr_array_unref (state.order);
+  g_main_loop_unref (state.main_loop);
+  g_mutex_clear (&state.mutex);
+  g_cond_clear (&state.cond);
+}
+
+static void
+test_priority (void)
+{
+  check_reserved_slot (IDE_THREAD_POOL_PRIORITY_IDLE,
+                       IDE_THREAD_POOL_PRIORITY_INTERACTIVE);
+}
+
+static void
+test_visible_slot (void)
+{
+  check_reserved_slot (IDE_THREAD_POOL_PRIORITY_BACKGROUND,
+                       IDE_THREAD_POOL_PRIORITY_VISIBLE);
+}
+
+static void
+cancelled_worker (GTask        *task,
+                  gpointer      source_object,
+                  gpointer      task_data,
+                  GCancellable *cancellable)
+{
+  g_assert_not_reached ();
+}
+
+static void
+cancelled_cb (GObject      *object,
+              GAsyncResult *result,
+              gpointer      user_data)
+{
+  GMainLoop *main_loop = user_data;
+  g_autoptr(GError) error = NULL;
+  gboolean ret;
+
+  ret = g_task_propagate_boolean (G_TASK (result), &error);
+  g_assert_error (error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+  g_assert (!ret);
+
+  g_main_loop_quit (main_loop);
+}
+
+static void
+test_cancelled (void)
+{
+  g_autoptr(GCancellable) cancellable = g_cancellable_new ();
+  g_autoptr(GMainLoop) main_loop = g_main_loop_new (NULL, FALSE);
+  g_autoptr(GTask) task = NULL;
+
+  task = g_task_new (NULL, cancellable, cancelled_cb, main_loop);
+  g_cancellable_cancel (cancellable);
+
+  ide_thread_pool_push_task (IDE_THREAD_POOL_INDEXER, task, cancelled_worker);
+
+  g_main_loop_run (main_loop);
+}
+
+typedef struct
+{
+  const gchar *name;
+  gint64       value;
+} CounterLookup;
+
+static void
+find_counter_cb (EggCounter *counter,
+                 gpointer    user_data)
+{
+  CounterLookup *lookup = user_data;
+
+  if (g_str_equal (counter->category, "ThreadPool") &&
+      g_str_equal (counter->name, lookup->name))
+    lookup->value = egg_counter_get (counter);
+}
+
+static gint64
+get_counter (const gchar *name)
+{
+  CounterLookup lookup = { name, -1 };
+  EggCounterArena *arena;
+
+  /* Read the counters of libide the way ide-list-counters does */
+  arena = egg_counter_arena_new_for_pid (getpid ());
+  g_assert (arena != NULL);
+  egg_counter_arena_foreach (arena, find_counter_cb, &lookup);
+  egg_counter_arena_unref (arena);
+
+  g_assert_cmpint (lookup.value, !=, -1);
+
+  return lookup.value;
+}
+
+static void
+wait_for_jobs (State *state,
+               guint  n_jobs)
+{
+  g_mutex_lock (&state->mutex);
+  while (state->order->len < n_jobs)
+    g_cond_wait (&state->cond, &state->mutex);
+  g_mutex_unlock (&state->mutex);
+}
+
+static guint
+count_jobs (State *state)
+{
+  guint ret;
+
+  g_mutex_lock (&state->mutex);
+  ret = state->order->len;
+  g_mutex_unlock (&state->mutex);
+
+  return ret;
+}
+
+static void
+test_throttled (void)
+{
+  State state = { 0 };
+  Job deferred = { &state, "deferred", FALSE };
+  Job visible = { &state, "visible", FALSE };
+  gdouble high_load = g_get_num_processors () * 0.9;
+
+  g_mutex_init (&state.mutex);
+  g_cond_init (&state.cond);
+  state.order = g_ptr_array_new ();
+
+  g_assert (!ide_thread_pool_get_throttled ());
+
+  _ide_thread_pool_update_governor (TRUE, 0.0);
+  g_assert (ide_thread_pool_get_throttled ());
+  g_assert_cmpint (get_counter ("Throttled"), ==, 1);
+  g_assert_cmpint (get_counter ("On Battery"), ==, 1);
+
+  /* Background work is held back, visible work is not */
+  ide_thread_pool_push_with_priority (IDE_THREAD_POOL_INDEXER, IDE_THREAD_POOL_PRIORITY_BACKGROUND, job_func, &deferred);
+  ide_thread_pool_push_with_priority (IDE_THREAD_POOL_COMPILER, IDE_THREAD_POOL_PRIORITY_VISIBLE, job_func, &visible);
+
+  wait_for_jobs (&state, 1);
+  g_assert_cmpstr (g_ptr_array_index (state.order, 0), ==, "visible");
+  g_usleep (G_USEC_PER_SEC / 10);
+  g_assert_cmpint (count_jobs (&state), ==, 1);
+
+  /* Still throttled until the load drops below three quarters of the processors */
+  _ide_thread_pool_update_governor (FALSE, high_load);
+  g_assert (ide_thread_pool_get_throttled ());
+  g_assert_cmpint (get_counter ("On Battery"), ==, 0);
+  g_assert_cmpint (get_counter ("Load Average"), ==, (gint64)(high_load * 100.0));
+  g_usleep (G_USEC_PER_SEC / 10);
+  g_assert_cmpint (count_jobs (&state), ==, 1);
+
+  _ide_thread_pool_update_governor (FALSE, 0.0);
+  g_assert (!ide_thread_pool_get_throttled ());
+  g_assert_cmpint (get_counter ("Throttled"), ==, 0);
+  g_assert_cmpint (get_counter ("Load Average"), ==, 0);
+
+  wait_for_jobs (&state, 2);
+  g_assert_cmpstr (g_ptr_array_index (state.order, 1), ==, "deferred");
+
+  g_ptr_array_unref (state.order);
+  g_mutex_clear (&state.mutex);
+  g_cond_clear (&state.cond);
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+  /* Background work would be deferred on a loaded machine or on battery */
+  g_setenv ("IDE_THREAD_POOL_GOVERNOR", "0", TRUE);
+
+  g_test_init (&argc, &argv, NULL);
+  g_test_add_func ("/Ide/ThreadPool/priority", test_priority);
+  g_test_add_func ("/Ide/ThreadPool/visible-slot", test_visible_slot);
+  g_test_add_func ("/Ide/ThreadPool/cancelled", test_cancelled);
+  g_test_add_func ("/Ide/ThreadPool/throttled", test_throttled);
+  return g_test_run ();
+}
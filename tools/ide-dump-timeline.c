@@ -0,0 +1,180 @@
+/* ide-dump-timeline.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/ide-timeline.h"
+
+/*
+ * Dumps the timeline of a running Builder (started with IDE_TIMELINE=1) in
+ * the Chrome trace event format. Load the output in chrome://tracing.
+ */
+
+typedef struct
+{
+  GArray *events;
+  gint64  first_time;
+} DumpState;
+
+static void
+append_json_string (GString     *str,
+                    const gchar *value,
+                    gsize        max_len)
+{
+  g_string_append_c (str, '"');
+
+  for (gsize i = 0; i < max_len && value [i] != '\0'; i++)
+    {
+      guchar ch = value [i];
+
+      if (ch == '"' || ch == '\\')
+        g_string_append_printf (str, "\\%c", ch);
+      else if (ch < 0x20)
+        g_string_append_printf (str, "\\u%04x", ch);
+      else
+        g_string_append_c (str, ch);
+    }
+
+  g_string_append_c (str, '"');
+}
+
+static void
+foreach_cb (const IdeTimelineEvent *event,
+            gpointer                user_data)
+{
+  DumpState *state = user_data;
+
+  if (event->begin == 0)
+    return;
+
+  if (state->first_time == 0 || event->begin < state->first_time)
+    state->first_time = event->begin;
+
+  g_array_append_val (state->events, *event);
+}
+
+static gint
+compare_by_begin (gconstpointer a,
+                  gconstpointer b)
+{
+  const IdeTimelineEvent *event_a = a;
+  const IdeTimelineEvent *event_b = b;
+
+  if (event_a->begin < event_b->begin)
+    return -1;
+  else if (event_a->begin > event_b->begin)
+    return 1;
+  else
+    return 0;
+}
+
+static gboolean
+int_parse_with_range (gint        *value,
+                      gint         lower,
+                      gint         upper,
+                      const gchar *str)
+{
+  gint64 v64;
+
+  g_assert (value);
+  g_assert (lower <= upper);
+
+  v64 = g_ascii_strtoll (str, NULL, 10);
+
+  if (((v64 == G_MININT64) || (v64 == G_MAXINT64)) && (errno == ERANGE))
+    return FALSE;
+
+  if ((v64 < lower) || (v64 > upper))
+    return FALSE;
+
+  *value = (gint)v64;
+
+  return TRUE;
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+  g_autoptr(GError) error = NULL;
+  g_autoptr(GString) str = NULL;
+  DumpState state = { 0 };
+  gint pid;
+
+  if (argc != 2)
+    {
+      fprintf (stderr, "usage: %s <pid>\n", argv [0]);
+      return EXIT_FAILURE;
+    }
+
+  if (g_str_has_prefix (argv [1], "/dev/shm/IdeTimeline-"))
+    argv [1] += strlen ("/dev/shm/IdeTimeline-");
+
+  if (!int_parse_with_range (&pid, 1, G_MAXINT, argv [1]))
+    {
+      fprintf (stderr, "usage: %s <pid>\n", argv [0]);
+      return EXIT_FAILURE;
+    }
+
+  state.events = g_array_new (FALSE, FALSE, sizeof (IdeTimelineEvent));
+
+  if (!ide_timeline_foreach_pid (pid, foreach_cb, &state, &error))
+    {
+      fprintf (stderr, "%s\n", error->message);
+      g_array_unref (state.events);
+      return EXIT_FAILURE;
+    }
+
+  g_array_sort (state.events, compare_by_begin);
+
+  str = g_string_new ("{\"traceEvents\":[\n");
+
+  for (guint i = 0; i < state.events->len; i++)
+    {
+      const IdeTimelineEvent *event = &g_array_index (state.events, IdeTimelineEvent, i);
+
+      g_string_append (str, "  {\"name\":");
+      append_json_string (str, event->name, sizeof event->name);
+      g_string_append (str, ",\"cat\":");
+      append_json_string (str, event->category, sizeof event->category);
+
+      if (event->end == event->begin)
+        g_string_append (str, ",\"ph\":\"i\",\"s\":\"t\"");
+      else
+        g_string_append_printf (str, ",\"ph\":\"X\",\"dur\":%"G_GINT64_FORMAT,
+                                event->end - event->begin);
+
+      g_string_append_printf (str,
+                              ",\"ts\":%"G_GINT64_FORMAT",\"pid\":%d,\"tid\":%u}%s\n",
+                              event->begin - state.first_time,
+                              pid,
+                              event->thread_id,
+                              (i + 1 < state.events->len) ? "," : "");
+    }
+
+  g_string_append (str, "],\"displayTimeUnit\":\"ms\"}\n");
+
+  fwrite (str->str, 1, str->len, stdout);
+
+  g_array_unref (state.events);
+
+  return EXIT_SUCCESS;
+}
@@ -38,6 +38,24 @@ foreach_cb (EggCounter *counter,
            counter->description);
 }
 
+static void
+foreach_histogram_cb (EggHistogram *histogram,
+                      gpointer      user_data)
+{
+  guint *n_histograms = user_data;
+
+  (*n_histograms)++;
+
+  g_print ("%-20s : %-32s : %10"G_GINT64_FORMAT" : %10"G_GINT64_FORMAT
+           " : %10"G_GINT64_FORMAT" : %10"G_GINT64_FORMAT"\n",
+           histogram->category,
+           histogram->name,
+           egg_histogram_get_count (histogram),
+           egg_histogram_get_percentile (histogram, 50.0),
+           egg_histogram_get_percentile (histogram, 95.0),
+           egg_histogram_get_percentile (histogram, 99.0));
+}
+
 static gboolean
 int_parse_with_range (gint        *value,
                       gint         lower,
@@ -68,6 +86,7 @@ main (gint   argc,
 {
   EggCounterArena *arena;
   guint n_counters = 0;
+  guint n_histograms = 0;
   gint pid;
 
   if (argc != 2)
@@ -107,5 +126,18 @@ main (gint   argc,
            "------------------------------------------------------------------------\n");
   g_print ("Discovered %u counters\n", n_counters);
 
+  g_print ("\n");
+  g_print ("%-20s : %-32s : %10s : %10s : %10s : %10s\n",
+           "      Category",
+           "             Name", "Count", "p50 (usec)", "p95 (usec)", "p99 (usec)");
+  g_print ("-------------------- : "
+           "-------------------------------- : "
+           "---------- : ---------- : ---------- : ----------\n");
+  egg_counter_arena_foreach_histogram (arena, foreach_histogram_cb, &n_histograms);
+  g_print ("-------------------- : "
+           "-------------------------------- : "
+           "---------- : ---------- : ---------- : ----------\n");
+  g_print ("Discovered %u histograms\n", n_histograms);
+
   return EXIT_SUCCESS;
 }
@@ -0,0 +1,175 @@
+/* ide-list-stalls.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/ide-stall-detector.h"
+
+/*
+ * Lists the most recent main loop stalls of a running Builder (started
+ * with IDE_STALL_DETECTOR=<msec>), along with a backtrace of the main
+ * thread taken during the stall. Frames are symbolized with addr2line(1)
+ * when it is available, which also works for static functions as long as
+ * debug information is installed.
+ */
+
+static gboolean
+symbolize (const IdeStallFrame  *frame,
+           gboolean              is_return_address,
+           gchar               **function,
+           gchar               **location)
+{
+  g_autofree gchar *address = NULL;
+  g_autofree gchar *output = NULL;
+  g_auto(GStrv) lines = NULL;
+  gint exit_status = 0;
+  guint64 offset = frame->offset;
+  const gchar *argv[] = { "addr2line", "-f", "-C", "-e", frame->module, NULL, NULL };
+
+  /* Return addresses point after the call, so look up the call itself */
+  if (is_return_address && offset > 0)
+    offset--;
+
+  address = g_strdup_printf ("0x%"G_GINT64_MODIFIER"x", offset);
+  argv [5] = address;
+
+  if (!g_spawn_sync (NULL, (gchar **)argv, NULL,
+                     G_SPAWN_SEARCH_PATH | G_SPAWN_STDERR_TO_DEV_NULL,
+                     NULL, NULL, &output, NULL, &exit_status, NULL) ||
+      exit_status != 0)
+    return FALSE;
+
+  lines = g_strsplit (output, "\n", 3);
+
+  if (g_strv_length (lines) < 2 || g_str_equal (lines [0], "??"))
+    return FALSE;
+
+  *function = g_strdup (lines [0]);
+  *location = g_str_has_prefix (lines [1], "??") ? NULL : g_strdup (lines [1]);
+
+  return TRUE;
+}
+
+static void
+print_frame (guint                n,
+             const IdeStallFrame *frame)
+{
+  g_autofree gchar *function = NULL;
+  g_autofree gchar *location = NULL;
+  g_autofree gchar *module = NULL;
+
+  if (frame->module [0] == '\0')
+    {
+      g_print ("  #%-2u 0x%"G_GINT64_MODIFIER"x\n", n, frame->address);
+      return;
+    }
+
+  module = g_path_get_basename (frame->module);
+
+  /* The first frame is where the main thread was interrupted */
+  if (!symbolize (frame, n > 0, &function, &location))
+    g_print ("  #%-2u %s+0x%"G_GINT64_MODIFIER"x\n", n, module, frame->offset);
+  else if (location == NULL)
+    g_print ("  #%-2u %s (%s+0x%"G_GINT64_MODIFIER"x)\n", n, function, module, frame->offset);
+  else
+    g_print ("  #%-2u %s at %s (%s+0x%"G_GINT64_MODIFIER"x)\n", n, function, location, module, frame->offset);
+}
+
+static void
+foreach_cb (const IdeStall *stall,
+            gpointer        user_data)
+{
+  guint *n_stalls = user_data;
+
+  (*n_stalls)++;
+
+  g_print ("Stall of %"G_GINT64_FORMAT".%03"G_GINT64_FORMAT" msec%s at %"G_GINT64_FORMAT"\n",
+           stall->duration / 1000,
+           stall->duration % 1000,
+           (stall->flags & IDE_STALL_ONGOING) ? " (ongoing)" : "",
+           stall->begin);
+
+  if (stall->source_name [0])
+    g_print ("  in a nested main loop run from %s\n", stall->source_name);
+
+  for (guint i = 0; i < stall->n_frames; i++)
+    print_frame (i, &stall->frames [i]);
+
+  g_print ("\n");
+}
+
+static gboolean
+int_parse_with_range (gint        *value,
+                      gint         lower,
+                      gint         upper,
+                      const gchar *str)
+{
+  gint64 v64;
+
+  g_assert (value);
+  g_assert (lower <= upper);
+
+  v64 = g_ascii_strtoll (str, NULL, 10);
+
+  if (((v64 == G_MININT64) || (v64 == G_MAXINT64)) && (errno == ERANGE))
+    return FALSE;
+
+  if ((v64 < lower) || (v64 > upper))
+    return FALSE;
+
+  *value = (gint)v64;
+
+  return TRUE;
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+  g_autoptr(GError) error = NULL;
+  guint n_stalls = 0;
+  gint pid;
+
+  if (argc != 2)
+    {
+      fprintf (stderr, "usage: %s <pid>\n", argv [0]);
+      return EXIT_FAILURE;
+    }
+
+  if (g_str_has_prefix (argv [1], "/dev/shm/IdeStalls-"))
+    argv [1] += strlen ("/dev/shm/IdeStalls-");
+
+  if (!int_parse_with_range (&pid, 1, G_MAXINT, argv [1]))
+    {
+      fprintf (stderr, "usage: %s <pid>\n", argv [0]);
+      return EXIT_FAILURE;
+    }
+
+  if (!ide_stall_detector_foreach_pid (pid, foreach_cb, &n_stalls, &error))
+    {
+      fprintf (stderr, "%s\n", error->message);
+      return EXIT_FAILURE;
+    }
+
+  g_print ("Discovered %u stalls\n", n_stalls);
+
+  return EXIT_SUCCESS;
+}
@@ -40,30 +40,45 @@ quit (gint code)
 }
 
 static void
-on_result_added_cb (IdeSearchContext  *search_context,
-                    IdeSearchProvider *provider,
-                    IdeSearchResult   *result,
-                    gpointer           user_data)
+print_results (IdeSearchContext  *search_context,
+               IdeSearchProvider *provider)
 {
-  const gchar *title;
-  const gchar *subtitle;
+  IdeSearchResults *results;
+  guint n_items;
+  guint i;
 
-  count++;
+  results = ide_search_context_get_results (search_context, provider);
+  n_items = g_list_model_get_n_items (G_LIST_MODEL (results));
 
-  title = ide_search_result_get_title (result);
-  subtitle = ide_search_result_get_subtitle (result);
+  for (i = 0; i < n_items; i++)
+    {
+      g_autoptr(IdeSearchResult) result = NULL;
+      const gchar *title;
+      const gchar *subtitle;
+
+      result = g_list_model_get_item (G_LIST_MODEL (results), i);
+
+      count++;
 
-  g_print ("%s\n", title);
-  g_print ("%s\n", subtitle);
-  g_print ("------------------------------------------------------------\n");
+      title = ide_search_result_get_title (result);
+      subtitle = ide_search_result_get_subtitle (result);
 
+      g_print ("%s\n", title);
+      g_print ("%s\n", subtitle);
+      g_print ("------------------------------------------------------------\n");
+    }
 }
 
 static void
 on_completed_cb (IdeSearchContext *search_context,
                  IdeContext       *context)
 {
+  const GList *iter;
   gchar *count_str;
+
+  for (iter = ide_search_context_get_providers (search_context); iter; iter = iter->next)
+    print_results (search_context, iter->data);
+
   count_str = g_strdup_printf ("%"G_GSIZE_FORMAT, count);
   g_print (ngettext ("%s result\n", "%s results\n", count), count_str);
   g_free (count_str);
@@ -94,8 +109,6 @@ context_cb (GObject      *object,
   search_context = ide_search_engine_search (search_engine, search_terms);
   /* FIXME: ^ search terms duplicated */
 
-  g_signal_connect (search_context, "result-added",
-                    G_CALLBACK (on_result_added_cb), NULL);
   g_signal_connect (search_context, "completed",
                     G_CALLBACK (on_completed_cb),
                     g_object_ref (context));